@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+# Copyright (c) 2016 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# keccak.py - Keccak-256 implementation
+#
+# This implements the original Keccak-256 (not the SHA3-256 standard, which
+# pads differently), as used for SmartCash block header hashes and base58
+# checksums.
+
+RATE = 136
+
+ROUND_CONSTANTS = [
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808A, 0x8000000080008000,
+    0x000000000000808B, 0x0000000080000001, 0x8000000080008081, 0x8000000000008009,
+    0x000000000000008A, 0x0000000000000088, 0x0000000080008009, 0x000000008000000A,
+    0x000000008000808B, 0x800000000000008B, 0x8000000000008089, 0x8000000000008003,
+    0x8000000000008002, 0x8000000000000080, 0x000000000000800A, 0x800000008000000A,
+    0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008,
+]
+
+ROTATIONS = [
+    [0, 36, 3, 41, 18],
+    [1, 44, 10, 45, 2],
+    [62, 6, 43, 15, 61],
+    [28, 55, 25, 21, 56],
+    [27, 20, 39, 8, 14],
+]
+
+MASK = (1 << 64) - 1
+
+def rotl64(n, b):
+    return ((n << b) | (n >> (64 - b))) & MASK if b else n
+
+def keccak_f(state):
+    for rc in ROUND_CONSTANTS:
+        # theta
+        c = [state[x][0] ^ state[x][1] ^ state[x][2] ^ state[x][3] ^ state[x][4] for x in range(5)]
+        d = [c[(x - 1) % 5] ^ rotl64(c[(x + 1) % 5], 1) for x in range(5)]
+        state = [[state[x][y] ^ d[x] for y in range(5)] for x in range(5)]
+        # rho and pi
+        b = [[0] * 5 for _ in range(5)]
+        for x in range(5):
+            for y in range(5):
+                b[y][(2 * x + 3 * y) % 5] = rotl64(state[x][y], ROTATIONS[x][y])
+        # chi
+        state = [[b[x][y] ^ ((~b[(x + 1) % 5][y]) & b[(x + 2) % 5][y]) for y in range(5)] for x in range(5)]
+        # iota
+        state[0][0] ^= rc
+    return state
+
+def keccak256(data):
+    padded = bytearray(data)
+    padded.append(0x01)
+    while len(padded) % RATE:
+        padded.append(0x00)
+    padded[-1] |= 0x80
+
+    state = [[0] * 5 for _ in range(5)]
+    for offset in range(0, len(padded), RATE):
+        block = padded[offset:offset + RATE]
+        for i in range(RATE // 8):
+            state[i % 5][i // 5] ^= int.from_bytes(block[8 * i:8 * i + 8], 'little')
+        state = keccak_f(state)
+
+    out = b""
+    for i in range(4):
+        out += state[i % 5][i // 5].to_bytes(8, 'little')
+    return out
@@ -37,9 +37,10 @@ from threading import Thread
 import logging
 import copy
 from test_framework.siphash import siphash256
+from test_framework.keccak import keccak256
 
 BIP0031_VERSION = 60000
-MY_VERSION = 70014  # past bip-31 for ping/pong
+MY_VERSION = 90032  # past bip-31 for ping/pong, at least MIN_PEER_PROTO_VERSION
 MY_SUBVERSION = b"/python-mininode-tester:0.0.3/"
 
 MAX_INV_SZ = 50000
@@ -215,14 +216,18 @@ def ToHex(obj):
 
 # Objects that map to bitcoind objects, which can be serialized/deserialized
 
+# INIT_PROTO_VERSION is past CADDR_TIME_VERSION on this network, so every
+# address on the wire, including the ones in version, carries its time.
 class CAddress(object):
     def __init__(self):
+        self.nTime = 0
         self.nServices = 1
         self.pchReserved = b"\x00" * 10 + b"\xff" * 2
         self.ip = "0.0.0.0"
         self.port = 0
 
     def deserialize(self, f):
+        self.nTime = struct.unpack("<I", f.read(4))[0]
         self.nServices = struct.unpack("<Q", f.read(8))[0]
         self.pchReserved = f.read(12)
         self.ip = socket.inet_ntoa(f.read(4))
@@ -230,6 +235,7 @@ class CAddress(object):
 
     def serialize(self):
         r = b""
+        r += struct.pack("<I", self.nTime)
         r += struct.pack("<Q", self.nServices)
         r += self.pchReserved
         r += socket.inet_aton(self.ip)
@@ -501,14 +507,15 @@ class CTransaction(object):
 
     # We will only cache the serialization without witness in
     # self.sha256 and self.hash -- those are expected to be the txid.
+    # Transaction ids are a single SHA-256 on this network.
     def calc_sha256(self, with_witness=False):
         if with_witness:
             # Don't cache the result, just return it
-            return uint256_from_str(hash256(self.serialize_with_witness()))
+            return uint256_from_str(sha256(self.serialize_with_witness()))
 
         if self.sha256 is None:
-            self.sha256 = uint256_from_str(hash256(self.serialize_without_witness()))
-        self.hash = encode(hash256(self.serialize())[::-1], 'hex_codec').decode('ascii')
+            self.sha256 = uint256_from_str(sha256(self.serialize_without_witness()))
+        self.hash = encode(sha256(self.serialize())[::-1], 'hex_codec').decode('ascii')
 
     def is_valid(self):
         self.calc_sha256()
@@ -576,8 +583,9 @@ class CBlockHeader(object):
             r += struct.pack("<I", self.nTime)
             r += struct.pack("<I", self.nBits)
             r += struct.pack("<I", self.nNonce)
-            self.sha256 = uint256_from_str(hash256(r))
-            self.hash = encode(hash256(r)[::-1], 'hex_codec').decode('ascii')
+            # Block headers are hashed with a single Keccak-256
+            self.sha256 = uint256_from_str(keccak256(r))
+            self.hash = encode(keccak256(r)[::-1], 'hex_codec').decode('ascii')
 
     def rehash(self):
         self.sha256 = None
@@ -1705,8 +1713,8 @@ class NodeConn(asyncore.dispatcher):
                     if len(self.recvbuf) < 4 + 12 + 4 + 4 + msglen:
                         return
                     msg = self.recvbuf[4+12+4+4:4+12+4+4+msglen]
-                    th = sha256(msg)
-                    h = sha256(th)
+                    # Message checksums are Keccak-256 on this network
+                    h = keccak256(msg)
                     if checksum != h[:4]:
                         raise ValueError("got bad checksum " + repr(self.recvbuf))
                     self.recvbuf = self.recvbuf[4+12+4+4+msglen:]
@@ -1716,7 +1724,7 @@ class NodeConn(asyncore.dispatcher):
                     t.deserialize(f)
                     self.got_message(t)
                 else:
-                    self.show_debug_msg("Unknown command: '" + command + "' " +
+                    self.show_debug_msg("Unknown command: '" + command.decode('ascii') + "' " +
                                         repr(msg))
         except Exception as e:
             print('got_data:', repr(e))
@@ -1734,8 +1742,7 @@ class NodeConn(asyncore.dispatcher):
         tmsg += b"\x00" * (12 - len(command))
         tmsg += struct.pack("<I", len(data))
         if self.ver_send >= 209:
-            th = sha256(data)
-            h = sha256(th)
+            h = keccak256(data)
             tmsg += h[:4]
         tmsg += data
         with mininode_lock:
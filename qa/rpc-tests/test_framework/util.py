@@ -37,6 +37,9 @@ PORT_RANGE = 5000
 
 BITCOIND_PROC_WAIT_TIMEOUT = 60
 
+# A valid regtest address (version byte 111, Keccak-256 checksum) for -sporkaddr
+REGTEST_SPORK_ADDRESS = "mfWyW5fc9NUj75YAnFgoRLrjxgLDmVbqRF"
+
 
 class PortSeed:
     # Must be initialized with a unique integer for each process
@@ -102,6 +105,9 @@ def p2p_port(n):
 def rpc_port(n):
     return PORT_MIN + PORT_RANGE + n + (MAX_NODES * PortSeed.n) % (PORT_RANGE - 1 - MAX_NODES)
 
+def sapi_port(n):
+    return PORT_MIN + 2 * PORT_RANGE + n + (MAX_NODES * PortSeed.n) % (PORT_RANGE - 1 - MAX_NODES)
+
 def check_json_precision():
     """Make sure json library being used does not lose precision converting BTC values"""
     n = Decimal("20000000.00000003")
@@ -157,12 +163,15 @@ def initialize_datadir(dirname, n):
     if not os.path.isdir(datadir):
         os.makedirs(datadir)
     rpc_u, rpc_p = rpc_auth_pair(n)
-    with open(os.path.join(datadir, "bitcoin.conf"), 'w', encoding='utf8') as f:
+    with open(os.path.join(datadir, "smartcash.conf"), 'w', encoding='utf8') as f:
         f.write("regtest=1\n")
+        # Regtest has no spork address of its own
+        f.write("sporkaddr=" + REGTEST_SPORK_ADDRESS + "\n")
         f.write("rpcuser=" + rpc_u + "\n")
         f.write("rpcpassword=" + rpc_p + "\n")
         f.write("port="+str(p2p_port(n))+"\n")
         f.write("rpcport="+str(rpc_port(n))+"\n")
+        f.write("sapiport="+str(sapi_port(n))+"\n")
         f.write("listenonion=0\n")
     return datadir
 
@@ -273,7 +282,7 @@ def initialize_chain(test_dir, num_nodes):
         from_dir = os.path.join("cache", "node"+str(i))
         to_dir = os.path.join(test_dir,  "node"+str(i))
         shutil.copytree(from_dir, to_dir)
-        initialize_datadir(test_dir, i) # Overwrite port/rpcport in bitcoin.conf
+        initialize_datadir(test_dir, i) # Overwrite port/rpcport in smartcash.conf
 
 def initialize_chain_clean(test_dir, num_nodes):
     """
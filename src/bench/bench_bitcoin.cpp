@@ -4,6 +4,8 @@
 
 #include "bench.h"
 
+#include "crypto/keccak256.h"
+#include "crypto/sha256.h"
 #include "key.h"
 #include "validation.h"
 #include "util.h"
@@ -12,6 +14,8 @@ int
 main(int argc, char** argv)
 {
     ECC_Start();
+    SHA256AutoDetect();
+    Keccak256AutoDetect();
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
 
@@ -0,0 +1,141 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "miner.h"
+#include "random.h"
+#include "txmempool.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <list>
+#include <vector>
+
+// Template assembly from a mempool of nTx transactions, in chains of four.
+// The incremental benchmarks add one transaction per iteration to the
+// template, half of them spending a transaction that is already in it, and
+// start a new template after every hundred arrivals like a miner would on a
+// new block.
+static const int BLOCK_ASSEMBLE_CHAIN = 4;
+static const size_t BLOCK_ASSEMBLE_ARRIVALS = 100;
+
+static CTransaction BenchTransaction(const COutPoint& prevout, FastRandomContext& rng)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, rng.rand32() & 0xff);
+    tx.vout.resize(2);
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        tx.vout[i].nValue = 100000;
+        tx.vout[i].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, i) << OP_EQUALVERIFY << OP_CHECKSIG;
+    }
+    return tx;
+}
+
+static void AddBenchTransaction(CTxMemPool& pool, const CTransaction& tx, FastRandomContext& rng)
+{
+    CAmount nFee = 2000 + rng.rand32() % 8000;
+    pool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, nFee, GetTime(), 0.0, 1, false, 0, false, 1, LockPoints()));
+}
+
+static void FillBenchMemPool(CTxMemPool& pool, int nTx, std::vector<CTransaction>& vBase, FastRandomContext& rng)
+{
+    for (int i = 0; i < nTx; i++) {
+        COutPoint prevout(GetRandHash(), 0);
+        if (i % BLOCK_ASSEMBLE_CHAIN != 0)
+            prevout = COutPoint(vBase.back().GetHash(), 0);
+        vBase.push_back(BenchTransaction(prevout, rng));
+        AddBenchTransaction(pool, vBase.back(), rng);
+    }
+}
+
+static void BlockAssembleFull(benchmark::State& state, int nTx)
+{
+    FastRandomContext rng(true);
+    CTxMemPool pool(::minRelayTxFee);
+    std::vector<CTransaction> vBase;
+    FillBenchMemPool(pool, nTx, vBase, rng);
+
+    BlockAssembler assembler(Params(CBaseChainParams::REGTEST), pool);
+    while (state.KeepRunning()) {
+        delete assembler.SelectTransactions(1, GetTime());
+    }
+}
+
+static void BlockAssembleIncremental(benchmark::State& state, int nTx)
+{
+    FastRandomContext rng(true);
+    CTxMemPool pool(::minRelayTxFee);
+    std::vector<CTransaction> vBase;
+    FillBenchMemPool(pool, nTx, vBase, rng);
+
+    BlockAssembler assembler(Params(CBaseChainParams::REGTEST), pool);
+    CBlockTemplate* pblocktemplate = assembler.SelectTransactions(1, GetTime());
+    std::vector<CTransaction> vArrived;
+    std::list<CTransaction> removed;
+    size_t nBase = 0;
+
+    while (state.KeepRunning()) {
+        if (vArrived.size() == BLOCK_ASSEMBLE_ARRIVALS) {
+            for (const CTransaction& tx : vArrived)
+                pool.remove(tx, removed, false);
+            vArrived.clear();
+            delete pblocktemplate;
+            pblocktemplate = assembler.SelectTransactions(1, GetTime());
+        }
+
+        COutPoint prevout(GetRandHash(), 0);
+        if (vArrived.size() % 2)
+            prevout = COutPoint(vBase[nBase++ % vBase.size()].GetHash(), 1);
+        vArrived.push_back(BenchTransaction(prevout, rng));
+        AddBenchTransaction(pool, vArrived.back(), rng);
+
+        if (!assembler.AddNewTransactions(pblocktemplate)) {
+            delete pblocktemplate;
+            pblocktemplate = assembler.SelectTransactions(1, GetTime());
+        }
+    }
+
+    delete pblocktemplate;
+}
+
+static void BlockAssembleFull1k(benchmark::State& state)
+{
+    BlockAssembleFull(state, 1000);
+}
+
+static void BlockAssembleFull10k(benchmark::State& state)
+{
+    BlockAssembleFull(state, 10000);
+}
+
+static void BlockAssembleFull100k(benchmark::State& state)
+{
+    BlockAssembleFull(state, 100000);
+}
+
+static void BlockAssembleIncremental1k(benchmark::State& state)
+{
+    BlockAssembleIncremental(state, 1000);
+}
+
+static void BlockAssembleIncremental10k(benchmark::State& state)
+{
+    BlockAssembleIncremental(state, 10000);
+}
+
+static void BlockAssembleIncremental100k(benchmark::State& state)
+{
+    BlockAssembleIncremental(state, 100000);
+}
+
+BENCHMARK(BlockAssembleFull1k);
+BENCHMARK(BlockAssembleFull10k);
+BENCHMARK(BlockAssembleFull100k);
+BENCHMARK(BlockAssembleIncremental1k);
+BENCHMARK(BlockAssembleIncremental10k);
+BENCHMARK(BlockAssembleIncremental100k);
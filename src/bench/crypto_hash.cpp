@@ -8,7 +8,9 @@
 #include "bloom.h"
 #include "hash.h"
 #include "uint256.h"
+#include "primitives/block.h"
 #include "utiltime.h"
+#include "crypto/keccak256.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
@@ -69,6 +71,53 @@ static void SipHash_32b(benchmark::State& state)
     }
 }
 
+/* Number of block headers hashed per iteration */
+static const size_t HEADER_COUNT = 2000;
+
+static void KeccakHeader_sph(benchmark::State& state)
+{
+    std::vector<uint8_t> in(HEADER_COUNT * CBlockHeader::HEADER_SIZE, 1);
+    uint256 hash;
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < HEADER_COUNT; i++) {
+            hash = HashKeccak(in.begin() + i * CBlockHeader::HEADER_SIZE, in.begin() + (i + 1) * CBlockHeader::HEADER_SIZE);
+        }
+    }
+}
+
+static void KeccakHeader_portable(benchmark::State& state)
+{
+    std::vector<uint8_t> in(HEADER_COUNT * CBlockHeader::HEADER_SIZE, 1);
+    uint256 hash;
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < HEADER_COUNT; i++) {
+            Keccak256(hash.begin(), &in[i * CBlockHeader::HEADER_SIZE], CBlockHeader::HEADER_SIZE);
+        }
+    }
+}
+
+static void KeccakHeader_multibuffer(benchmark::State& state)
+{
+    std::vector<uint8_t> in(HEADER_COUNT * CBlockHeader::HEADER_SIZE, 1);
+    std::vector<uint256> hashes(HEADER_COUNT);
+    while (state.KeepRunning()) {
+        Keccak256_80(hashes[0].begin(), in.data(), HEADER_COUNT);
+    }
+}
+
+static void BlockHeaderHash(benchmark::State& state)
+{
+    CBlockHeader header;
+    header.nBits = 0x1e0ffff0;
+    uint256 hash;
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < HEADER_COUNT; i++) {
+            header.nNonce++;
+            hash = header.GetHash();
+        }
+    }
+}
+
 //BENCHMARK(RIPEMD160);
 //BENCHMARK(SHA1);
 //BENCHMARK(SHA256);
@@ -76,3 +125,8 @@ static void SipHash_32b(benchmark::State& state)
 
 //BENCHMARK(SHA256_32b);
 //BENCHMARK(SipHash_32b);
+
+BENCHMARK(KeccakHeader_sph);
+BENCHMARK(KeccakHeader_portable);
+BENCHMARK(KeccakHeader_multibuffer);
+BENCHMARK(BlockHeaderHash);
@@ -0,0 +1,113 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "dbwrapper.h"
+#include "random.h"
+#include "spentindex.h"
+#include "txdb.h"
+
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+// Point lookups of spent index entries, like ReadSpentIndex does them, in a
+// database written with the options of the benchmark. The small cache makes
+// most lookups go to the table files.
+static const int DB_BENCH_ENTRIES = 200000;
+static const size_t DB_BENCH_CACHE = 1 << 20;
+
+static void DBLookup(benchmark::State& state, const CDBOptions& dbOptions, bool fExisting)
+{
+    boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    std::vector<CSpentIndexKey> vKeys;
+
+    {
+        CDBWrapper db(path, DB_BENCH_CACHE, false, true, false, dbOptions);
+        CDBBatch batch(db);
+
+        for (int i = 0; i < DB_BENCH_ENTRIES; i++) {
+            CSpentIndexKey key(GetRandHash(), i % 8);
+            batch.Write(std::make_pair('p', key), CSpentIndexValue(GetRandHash(), 0, i, 1000, 1, uint160()));
+            vKeys.push_back(key);
+
+            if (batch.SizeEstimate() > 1024 * 1024) {
+                db.WriteBatch(batch);
+                batch.Clear();
+            }
+        }
+        db.WriteBatch(batch, true);
+    }
+
+    if (!fExisting) {
+        for (auto &key : vKeys)
+            key.txid = GetRandHash();
+    }
+
+    {
+        // Reopen to read from the table files only
+        CDBWrapper db(path, DB_BENCH_CACHE, false, false, false, dbOptions);
+        CSpentIndexValue value;
+        size_t nIndex = 0;
+
+        while (state.KeepRunning()) {
+            db.Read(std::make_pair('p', vKeys[nIndex]), value);
+            nIndex = (nIndex + 7919) % vKeys.size();
+        }
+    }
+
+    boost::filesystem::remove_all(path);
+}
+
+static void DBLookupNoFilter(benchmark::State& state)
+{
+    DBLookup(state, CDBOptions(0, 64, 4096, false), true);
+}
+
+static void DBLookupMissingNoFilter(benchmark::State& state)
+{
+    DBLookup(state, CDBOptions(0, 64, 4096, false), false);
+}
+
+static void DBLookupChainstateProfile(benchmark::State& state)
+{
+    DBLookup(state, CHAINSTATE_DB_OPTIONS, true);
+}
+
+static void DBLookupMissingChainstateProfile(benchmark::State& state)
+{
+    DBLookup(state, CHAINSTATE_DB_OPTIONS, false);
+}
+
+static void DBLookupIndexProfile(benchmark::State& state)
+{
+    DBLookup(state, BLOCKTREE_DB_OPTIONS, true);
+}
+
+static void DBLookupMissingIndexProfile(benchmark::State& state)
+{
+    DBLookup(state, BLOCKTREE_DB_OPTIONS, false);
+}
+
+static void DBLookupLargeBlocks(benchmark::State& state)
+{
+    DBLookup(state, CDBOptions(10, 64, 16 * 1024, false), true);
+}
+
+static void DBLookupIndexProfileCompressed(benchmark::State& state)
+{
+    CDBOptions dbOptions(BLOCKTREE_DB_OPTIONS);
+    dbOptions.fCompression = true;
+    DBLookup(state, dbOptions, true);
+}
+
+BENCHMARK(DBLookupNoFilter);
+BENCHMARK(DBLookupMissingNoFilter);
+BENCHMARK(DBLookupChainstateProfile);
+BENCHMARK(DBLookupMissingChainstateProfile);
+BENCHMARK(DBLookupIndexProfile);
+BENCHMARK(DBLookupMissingIndexProfile);
+BENCHMARK(DBLookupLargeBlocks);
+BENCHMARK(DBLookupIndexProfileCompressed);
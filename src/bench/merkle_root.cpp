@@ -0,0 +1,55 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "uint256.h"
+#include "random.h"
+#include "consensus/merkle.h"
+
+static std::vector<uint256> MerkleLeaves(size_t nLeaves)
+{
+    FastRandomContext rng(true);
+    std::vector<uint256> leaves(nLeaves);
+    for (auto& leaf : leaves) {
+        for (uint32_t* word = (uint32_t*)leaf.begin(); word != (uint32_t*)leaf.end(); ++word) {
+            *word = rng.rand32();
+        }
+    }
+    return leaves;
+}
+
+static void MerkleRoot(benchmark::State& state, size_t nLeaves)
+{
+    std::vector<uint256> leaves = MerkleLeaves(nLeaves);
+    while (state.KeepRunning()) {
+        bool mutation = false;
+        uint256 hash = ComputeMerkleRoot(leaves, &mutation);
+        leaves[mutation] = hash;
+    }
+}
+
+static void MerkleRootConstantSpace(benchmark::State& state, size_t nLeaves)
+{
+    std::vector<uint256> leaves = MerkleLeaves(nLeaves);
+    while (state.KeepRunning()) {
+        bool mutation = false;
+        uint256 hash = ComputeMerkleRootConstantSpace(leaves, &mutation);
+        leaves[mutation] = hash;
+    }
+}
+
+static void MerkleRoot_1k(benchmark::State& state) { MerkleRoot(state, 1000); }
+static void MerkleRoot_4k(benchmark::State& state) { MerkleRoot(state, 4000); }
+static void MerkleRoot_10k(benchmark::State& state) { MerkleRoot(state, 10000); }
+static void MerkleRootConstantSpace_1k(benchmark::State& state) { MerkleRootConstantSpace(state, 1000); }
+static void MerkleRootConstantSpace_4k(benchmark::State& state) { MerkleRootConstantSpace(state, 4000); }
+static void MerkleRootConstantSpace_10k(benchmark::State& state) { MerkleRootConstantSpace(state, 10000); }
+
+BENCHMARK(MerkleRoot_1k);
+BENCHMARK(MerkleRoot_4k);
+BENCHMARK(MerkleRoot_10k);
+BENCHMARK(MerkleRootConstantSpace_1k);
+BENCHMARK(MerkleRootConstantSpace_4k);
+BENCHMARK(MerkleRootConstantSpace_10k);
@@ -132,6 +132,17 @@ public:
         return true;
     }
 
+    /// Mark the item as most recently used so it gets pruned last
+    bool Touch(const K& key)
+    {
+        map_it it = mapIndex.find(key);
+        if(it == mapIndex.end()) {
+            return false;
+        }
+        listItems.splice(listItems.begin(), listItems, it->second);
+        return true;
+    }
+
     void Erase(const K& key)
     {
         map_it it = mapIndex.find(key);
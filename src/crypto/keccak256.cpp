@@ -0,0 +1,172 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/keccak256.h>
+#include <crypto/common.h>
+#include <crypto/keccakf1600.h>
+#include <crypto/sph_keccak.h>
+
+#include <assert.h>
+#include <string.h>
+
+#include <compat/cpuid.h>
+
+namespace keccak256_avx2
+{
+void Hash80_4way(unsigned char* out, const unsigned char* in);
+}
+
+// Internal implementation code.
+namespace
+{
+namespace keccak256
+{
+/** Number of input bytes absorbed per permutation for a 256-bit output. */
+static const size_t RATE = 136;
+
+struct Ops
+{
+    static inline uint64_t Xor(uint64_t x, uint64_t y) { return x ^ y; }
+    static inline uint64_t AndNot(uint64_t x, uint64_t y) { return ~x & y; }
+    static inline uint64_t Rotl(uint64_t x, int n) { return (x << n) | (x >> (64 - n)); }
+    static inline uint64_t Const(uint64_t c) { return c; }
+};
+
+void Permute(uint64_t* st)
+{
+    KeccakF1600<Ops>(st);
+}
+
+void Hash(unsigned char* out, const unsigned char* in, size_t len)
+{
+    uint64_t st[25] = {0};
+    while (len >= RATE) {
+        for (size_t i = 0; i < RATE / 8; i++)
+            st[i] ^= ReadLE64(in + 8 * i);
+        Permute(st);
+        in += RATE;
+        len -= RATE;
+    }
+    unsigned char last[RATE] = {0};
+    if (len) memcpy(last, in, len);
+    last[len] ^= 0x01;
+    last[RATE - 1] ^= 0x80;
+    for (size_t i = 0; i < RATE / 8; i++)
+        st[i] ^= ReadLE64(last + 8 * i);
+    Permute(st);
+    for (int i = 0; i < 4; i++)
+        WriteLE64(out + 8 * i, st[i]);
+}
+
+void Hash80(unsigned char* out, const unsigned char* in)
+{
+    Hash(out, in, KECCAK256_HEADER_SIZE);
+}
+
+} // namespace keccak256
+
+typedef void (*Hash80Type)(unsigned char*, const unsigned char*);
+
+Hash80Type Hash80_4way = nullptr;
+
+bool SelfTest() {
+    // Keccak-256 of the empty string
+    static const unsigned char empty[32] = {
+        0xc5, 0xd2, 0x46, 0x01, 0x86, 0xf7, 0x23, 0x3c, 0x92, 0x7e, 0x7d, 0xb2, 0xdc, 0xc7, 0x03, 0xc0,
+        0xe5, 0x00, 0xb6, 0x53, 0xca, 0x82, 0x27, 0x3b, 0x7b, 0xfa, 0xd8, 0x04, 0x5d, 0x85, 0xa4, 0x70
+    };
+    unsigned char out[32 * 4];
+    keccak256::Hash(out, nullptr, 0);
+    if (memcmp(out, empty, 32)) return false;
+
+    // Compare the multi-buffer implementation against the portable one
+    if (Hash80_4way) {
+        unsigned char in[KECCAK256_HEADER_SIZE * 4];
+        unsigned char check[32];
+        for (size_t i = 0; i < sizeof(in); i++) in[i] = (unsigned char)(i * 7 + 1);
+        Hash80_4way(out, in);
+        for (int i = 0; i < 4; i++) {
+            keccak256::Hash80(check, in + KECCAK256_HEADER_SIZE * i);
+            if (memcmp(out + 32 * i, check, 32)) return false;
+        }
+    }
+
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+} // namespace
+
+
+std::string Keccak256AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && defined(HAVE_GETCPUID)
+    bool have_xsave = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool enabled_avx = false;
+
+    (void)AVXEnabled;
+    (void)have_avx;
+    (void)have_xsave;
+    (void)have_avx2;
+    (void)enabled_avx;
+
+    uint32_t eax, ebx, ecx, edx;
+    GetCPUID(1, 0, eax, ebx, ecx, edx);
+    have_xsave = (ecx >> 27) & 1;
+    have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx) {
+        enabled_avx = AVXEnabled();
+    }
+    GetCPUID(7, 0, eax, ebx, ecx, edx);
+    have_avx2 = (ebx >> 5) & 1;
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_avx2 && have_avx && enabled_avx) {
+        Hash80_4way = keccak256_avx2::Hash80_4way;
+        ret += ",avx2(4way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
+void Keccak256(unsigned char* out, const unsigned char* in, size_t len)
+{
+    keccak256::Hash(out, in, len);
+}
+
+void Keccak256_80(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    if (Hash80_4way) {
+        while (blocks >= 4) {
+            Hash80_4way(out, in);
+            out += 32 * 4;
+            in += KECCAK256_HEADER_SIZE * 4;
+            blocks -= 4;
+        }
+    }
+    // sph_keccak is faster than the portable code for single buffers
+    while (blocks) {
+        sph_keccak256_context ctx;
+        sph_keccak256_init(&ctx);
+        sph_keccak256(&ctx, in, KECCAK256_HEADER_SIZE);
+        sph_keccak256_close(&ctx, out);
+        out += 32;
+        in += KECCAK256_HEADER_SIZE;
+        --blocks;
+    }
+}
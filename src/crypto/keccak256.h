@@ -0,0 +1,33 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_KECCAK256_H
+#define BITCOIN_CRYPTO_KECCAK256_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/** Size of a serialized block header, the input of Keccak256_80. */
+static const size_t KECCAK256_HEADER_SIZE = 80;
+
+/** Compute the Keccak-256 hash (original Keccak padding, as sph_keccak256)
+ *  of a buffer with the portable 64-bit lane implementation.
+ */
+void Keccak256(unsigned char* output, const unsigned char* input, size_t len);
+
+/** Autodetect the best available multi-buffer Keccak-256 implementation.
+ *  Returns the name of the implementation.
+ */
+std::string Keccak256AutoDetect();
+
+/** Compute multiple Keccak-256's of 80-byte blobs (block headers), four at a
+ *  time with AVX2 and one by one with sph_keccak otherwise.
+ *  output:  pointer to a blocks*32 byte output buffer
+ *  input:   pointer to a blocks*80 byte input buffer
+ *  blocks:  the number of hashes to compute.
+ */
+void Keccak256_80(unsigned char* output, const unsigned char* input, size_t blocks);
+
+#endif // BITCOIN_CRYPTO_KECCAK256_H
@@ -0,0 +1,57 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+#include <crypto/keccakf1600.h>
+
+namespace keccak256_avx2 {
+namespace {
+
+struct Ops
+{
+    static inline __m256i Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+    static inline __m256i AndNot(__m256i x, __m256i y) { return _mm256_andnot_si256(x, y); }
+    static inline __m256i Rotl(__m256i x, int n) { return _mm256_or_si256(_mm256_slli_epi64(x, n), _mm256_srli_epi64(x, 64 - n)); }
+    static inline __m256i Const(uint64_t c) { return _mm256_set1_epi64x(c); }
+};
+
+/** Load one 64-bit lane of each of the four 80-byte inputs. */
+__m256i inline Load(const unsigned char* in, int lane)
+{
+    return _mm256_set_epi64x(ReadLE64(in + 240 + 8 * lane), ReadLE64(in + 160 + 8 * lane), ReadLE64(in + 80 + 8 * lane), ReadLE64(in + 8 * lane));
+}
+
+}
+
+/** Hash four 80-byte inputs, each fits a single 136-byte rate block. */
+void Hash80_4way(unsigned char* out, const unsigned char* in)
+{
+    __m256i st[25];
+    for (int i = 0; i < 10; i++)
+        st[i] = Load(in, i);
+    for (int i = 10; i < 25; i++)
+        st[i] = _mm256_setzero_si256();
+    // Padding: 0x01 right after the 80 input bytes, 0x80 at the end of the rate
+    st[10] = _mm256_set1_epi64x(0x01);
+    st[16] = _mm256_set1_epi64x(0x8000000000000000ULL);
+
+    // Four Keccak-f[1600] permutations, one per 64-bit lane of the state words
+    KeccakF1600<Ops>(st);
+
+    alignas(32) uint64_t lanes[4];
+    for (int i = 0; i < 4; i++) {
+        _mm256_store_si256((__m256i*)lanes, st[i]);
+        for (int j = 0; j < 4; j++)
+            WriteLE64(out + 32 * j + 8 * i, lanes[j]);
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,104 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_KECCAKF1600_H
+#define BITCOIN_CRYPTO_KECCAKF1600_H
+
+#include <stdint.h>
+
+/** Round constants of the Keccak-f[1600] permutation. */
+static const uint64_t KECCAKF1600_RC[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+    0x000000000000808bULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+/** Keccak-f[1600] with theta, rho, pi, chi and iota fused and unrolled per round.
+ *  The lane type and its operations come from Ops, so the same code serves the
+ *  scalar implementation and the SIMD ones hashing several states at once.
+ *  Ops provides Xor(a, b), AndNot(a, b) = ~a & b, Rotl(a, n) and Const(c).
+ */
+template<typename Ops, typename Lane>
+inline void KeccakF1600(Lane* A)
+{
+    for (int round = 0; round < 24; round++) {
+        Lane C0 = Ops::Xor(Ops::Xor(Ops::Xor(A[0], A[5]), Ops::Xor(A[10], A[15])), A[20]);
+        Lane C1 = Ops::Xor(Ops::Xor(Ops::Xor(A[1], A[6]), Ops::Xor(A[11], A[16])), A[21]);
+        Lane C2 = Ops::Xor(Ops::Xor(Ops::Xor(A[2], A[7]), Ops::Xor(A[12], A[17])), A[22]);
+        Lane C3 = Ops::Xor(Ops::Xor(Ops::Xor(A[3], A[8]), Ops::Xor(A[13], A[18])), A[23]);
+        Lane C4 = Ops::Xor(Ops::Xor(Ops::Xor(A[4], A[9]), Ops::Xor(A[14], A[19])), A[24]);
+
+        Lane D0 = Ops::Xor(C4, Ops::Rotl(C1, 1));
+        Lane D1 = Ops::Xor(C0, Ops::Rotl(C2, 1));
+        Lane D2 = Ops::Xor(C1, Ops::Rotl(C3, 1));
+        Lane D3 = Ops::Xor(C2, Ops::Rotl(C4, 1));
+        Lane D4 = Ops::Xor(C3, Ops::Rotl(C0, 1));
+
+        Lane B0, B1, B2, B3, B4;
+        Lane E[25];
+
+        B0 = Ops::Xor(A[0], D0);
+        B1 = Ops::Rotl(Ops::Xor(A[6], D1), 44);
+        B2 = Ops::Rotl(Ops::Xor(A[12], D2), 43);
+        B3 = Ops::Rotl(Ops::Xor(A[18], D3), 21);
+        B4 = Ops::Rotl(Ops::Xor(A[24], D4), 14);
+        E[0] = Ops::Xor(Ops::Xor(B0, Ops::AndNot(B1, B2)), Ops::Const(KECCAKF1600_RC[round]));
+        E[1] = Ops::Xor(B1, Ops::AndNot(B2, B3));
+        E[2] = Ops::Xor(B2, Ops::AndNot(B3, B4));
+        E[3] = Ops::Xor(B3, Ops::AndNot(B4, B0));
+        E[4] = Ops::Xor(B4, Ops::AndNot(B0, B1));
+
+        B0 = Ops::Rotl(Ops::Xor(A[3], D3), 28);
+        B1 = Ops::Rotl(Ops::Xor(A[9], D4), 20);
+        B2 = Ops::Rotl(Ops::Xor(A[10], D0), 3);
+        B3 = Ops::Rotl(Ops::Xor(A[16], D1), 45);
+        B4 = Ops::Rotl(Ops::Xor(A[22], D2), 61);
+        E[5] = Ops::Xor(B0, Ops::AndNot(B1, B2));
+        E[6] = Ops::Xor(B1, Ops::AndNot(B2, B3));
+        E[7] = Ops::Xor(B2, Ops::AndNot(B3, B4));
+        E[8] = Ops::Xor(B3, Ops::AndNot(B4, B0));
+        E[9] = Ops::Xor(B4, Ops::AndNot(B0, B1));
+
+        B0 = Ops::Rotl(Ops::Xor(A[1], D1), 1);
+        B1 = Ops::Rotl(Ops::Xor(A[7], D2), 6);
+        B2 = Ops::Rotl(Ops::Xor(A[13], D3), 25);
+        B3 = Ops::Rotl(Ops::Xor(A[19], D4), 8);
+        B4 = Ops::Rotl(Ops::Xor(A[20], D0), 18);
+        E[10] = Ops::Xor(B0, Ops::AndNot(B1, B2));
+        E[11] = Ops::Xor(B1, Ops::AndNot(B2, B3));
+        E[12] = Ops::Xor(B2, Ops::AndNot(B3, B4));
+        E[13] = Ops::Xor(B3, Ops::AndNot(B4, B0));
+        E[14] = Ops::Xor(B4, Ops::AndNot(B0, B1));
+
+        B0 = Ops::Rotl(Ops::Xor(A[4], D4), 27);
+        B1 = Ops::Rotl(Ops::Xor(A[5], D0), 36);
+        B2 = Ops::Rotl(Ops::Xor(A[11], D1), 10);
+        B3 = Ops::Rotl(Ops::Xor(A[17], D2), 15);
+        B4 = Ops::Rotl(Ops::Xor(A[23], D3), 56);
+        E[15] = Ops::Xor(B0, Ops::AndNot(B1, B2));
+        E[16] = Ops::Xor(B1, Ops::AndNot(B2, B3));
+        E[17] = Ops::Xor(B2, Ops::AndNot(B3, B4));
+        E[18] = Ops::Xor(B3, Ops::AndNot(B4, B0));
+        E[19] = Ops::Xor(B4, Ops::AndNot(B0, B1));
+
+        B0 = Ops::Rotl(Ops::Xor(A[2], D2), 62);
+        B1 = Ops::Rotl(Ops::Xor(A[8], D3), 55);
+        B2 = Ops::Rotl(Ops::Xor(A[14], D4), 39);
+        B3 = Ops::Rotl(Ops::Xor(A[15], D0), 41);
+        B4 = Ops::Rotl(Ops::Xor(A[21], D1), 2);
+        E[20] = Ops::Xor(B0, Ops::AndNot(B1, B2));
+        E[21] = Ops::Xor(B1, Ops::AndNot(B2, B3));
+        E[22] = Ops::Xor(B2, Ops::AndNot(B3, B4));
+        E[23] = Ops::Xor(B3, Ops::AndNot(B4, B0));
+        E[24] = Ops::Xor(B4, Ops::AndNot(B0, B1));
+
+        for (int i = 0; i < 25; i++)
+            A[i] = E[i];
+    }
+}
+
+#endif // BITCOIN_CRYPTO_KECCAKF1600_H
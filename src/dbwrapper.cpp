@@ -73,14 +73,31 @@ public:
     }
 };
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+CDBOptions CDBOptions::FromArgs(const std::string& strName) const
+{
+    CDBOptions result(*this);
+    result.nBloomFilterBits = std::max(0, (int)GetArg("-" + strName + "dbbloombits", nBloomFilterBits));
+    result.nMaxOpenFiles = std::max(16, (int)GetArg("-" + strName + "dbmaxopenfiles", nMaxOpenFiles));
+    result.nBlockSize = std::max((int64_t)1024, GetArg("-" + strName + "dbblocksize", (int64_t)nBlockSize));
+    result.fCompression = GetBoolArg("-" + strName + "dbcompression", fCompression);
+    return result;
+}
+
+std::string CDBOptions::ToString() const
+{
+    return strprintf("bloombits=%d maxopenfiles=%d blocksize=%u compression=%d",
+                     nBloomFilterBits, nMaxOpenFiles, nBlockSize, fCompression);
+}
+
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBOptions& dbOptions)
 {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
     options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    options.filter_policy = dbOptions.nBloomFilterBits > 0 ? leveldb::NewBloomFilterPolicy(dbOptions.nBloomFilterBits) : NULL;
+    options.compression = dbOptions.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    options.block_size = dbOptions.nBlockSize;
+    options.max_open_files = dbOptions.nMaxOpenFiles;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -90,14 +107,14 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const CDBOptions& dbOptions)
 {
     penv = NULL;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, dbOptions);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -109,7 +126,7 @@ CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, b
             dbwrapper_private::HandleError(result);
         }
         TryCreateDirectory(path);
-        LogPrintf("Opening LevelDB in %s\n", path.string());
+        LogPrintf("Opening LevelDB in %s (%s)\n", path.string(), dbOptions.ToString());
     }
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     dbwrapper_private::HandleError(status);
@@ -192,6 +209,7 @@ bool CDBWrapper::IsEmpty()
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
+void CDBIterator::SeekToLast() { piter->SeekToLast(); }
 void CDBIterator::Next() { piter->Next(); }
 void CDBIterator::Prev() { piter->Prev(); }
 
@@ -28,6 +28,31 @@ public:
 
 class CDBWrapper;
 
+/**
+ * LevelDB tuning of a database. Each database picks defaults which fit its
+ * access pattern, they can be overridden with -<name>dbbloombits,
+ * -<name>dbmaxopenfiles, -<name>dbblocksize and -<name>dbcompression.
+ */
+struct CDBOptions
+{
+    //! bits per key of the bloom filter, 0 disables it
+    int nBloomFilterBits;
+    //! number of table files leveldb keeps open
+    int nMaxOpenFiles;
+    //! approximate size of the uncompressed data blocks in bytes
+    size_t nBlockSize;
+    //! compress the blocks with Snappy, if leveldb was built with it
+    bool fCompression;
+
+    CDBOptions(int nBloomFilterBitsIn = 10, int nMaxOpenFilesIn = 64, size_t nBlockSizeIn = 4096, bool fCompressionIn = false) :
+        nBloomFilterBits(nBloomFilterBitsIn), nMaxOpenFiles(nMaxOpenFilesIn), nBlockSize(nBlockSizeIn), fCompression(fCompressionIn) {}
+
+    /** Get these options with the ones set by the arguments of the database strName applied */
+    CDBOptions FromArgs(const std::string& strName) const;
+
+    std::string ToString() const;
+};
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -131,6 +156,7 @@ public:
     bool Valid();
 
     void SeekToFirst();
+    void SeekToLast();
 
     template<typename K> void Seek(const K& key) {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
@@ -220,8 +246,9 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] dbOptions   LevelDB tuning of the database.
      */
-    CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const CDBOptions& dbOptions = CDBOptions());
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -304,6 +331,26 @@ public:
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    /**
+     * Iterate over the database as it was when the snapshot was taken.
+     */
+    CDBIterator *NewIterator(const leveldb::Snapshot *snapshot)
+    {
+        leveldb::ReadOptions options = iteroptions;
+        options.snapshot = snapshot;
+        return new CDBIterator(*this, pdb->NewIterator(options));
+    }
+
+    const leveldb::Snapshot *GetSnapshot()
+    {
+        return pdb->GetSnapshot();
+    }
+
+    void ReleaseSnapshot(const leveldb::Snapshot *snapshot)
+    {
+        pdb->ReleaseSnapshot(snapshot);
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
@@ -343,4 +390,22 @@ public:
 
 };
 
+/** Consistent view of a database which keeps getting written, released when it goes out of scope */
+class CDBSnapshot
+{
+private:
+    CDBWrapper &parent;
+    const leveldb::Snapshot *psnapshot;
+
+public:
+    explicit CDBSnapshot(CDBWrapper &_parent) :
+        parent(_parent), psnapshot(_parent.GetSnapshot()) { };
+    ~CDBSnapshot() { parent.ReleaseSnapshot(psnapshot); }
+
+    CDBSnapshot(const CDBSnapshot&) = delete;
+    CDBSnapshot& operator=(const CDBSnapshot&) = delete;
+
+    CDBIterator *NewIterator() const { return parent.NewIterator(psnapshot); }
+};
+
 #endif // BITCOIN_DBWRAPPER_H
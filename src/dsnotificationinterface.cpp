@@ -50,5 +50,6 @@ void CDSNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, con
 void CDSNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
 {
     instantsend.SyncTransaction(tx, pblock);
+    mnodeman.SyncTransaction(tx, pblock);
     //CPrivateSend::SyncTransaction(tx, pblock);
 }
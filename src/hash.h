@@ -44,6 +44,32 @@ public:
     }
 };
 
+/** A hasher class for SmartCash's 256-bit Keccak hash, fed incrementally. */
+class CHashKeccak {
+private:
+    sph_keccak256_context ctx;
+public:
+    static const size_t OUTPUT_SIZE = 32;
+
+    CHashKeccak() {
+        sph_keccak256_init(&ctx);
+    }
+
+    void Finalize(unsigned char hash[OUTPUT_SIZE]) {
+        sph_keccak256_close(&ctx, hash);
+    }
+
+    CHashKeccak& Write(const unsigned char *data, size_t len) {
+        sph_keccak256(&ctx, data, len);
+        return *this;
+    }
+
+    CHashKeccak& Reset() {
+        sph_keccak256_init(&ctx);
+        return *this;
+    }
+};
+
 /** A hasher class for Bitcoin's 160-bit hash (SHA-256 + RIPEMD-160). */
 class CHash160 {
 private:
@@ -0,0 +1,391 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "indexbuilder.h"
+
+#include "chainparams.h"
+#include "primitives/block.h"
+#include "pubkey.h"
+#include "spentindex.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <map>
+
+#include <boost/thread.hpp>
+
+CIndexBuilder *pindexbuilder = NULL;
+
+typedef std::map<std::pair<uint160, int>, CAmount> AddressAmounts;
+
+bool GetScriptAddress(const CScript &script, uint160 &hashBytes, int &addressType)
+{
+    if (script.IsPayToScriptHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+2, script.begin()+22));
+        addressType = 2;
+    } else if (script.IsPayToPublicKeyHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(script.begin()+3, script.begin()+23));
+        addressType = 1;
+    } else if (script.IsPayToPublicKey()) {
+        std::vector<unsigned char> pubKeyBytes(script.begin()+1, script.begin()+34);
+        CPubKey pubKey(pubKeyBytes);
+        hashBytes = pubKey.GetID();
+        addressType = 1;
+    } else if (script.IsPayToScriptHashLocked()) {
+        int nOffset = script[0] + 5;
+        hashBytes = uint160(std::vector<unsigned char>(script.begin() + nOffset, script.begin() + nOffset + 20));
+        addressType = 2;
+    } else if (script.IsPayToPublicKeyHashLocked()) {
+        int nOffset = script[0] + 6;
+        hashBytes = uint160(std::vector<unsigned char>(script.begin() + nOffset, script.begin() + nOffset + 20));
+        addressType = 1;
+    } else {
+        hashBytes.SetNull();
+        addressType = 0;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Get the height of the block of a spent transaction. Undo data written by old
+ * versions only has it for the last spent output of a transaction.
+ */
+static bool GetPrevHeight(const uint256 &txid, int &nHeight, std::map<uint256, int> &mapHeights)
+{
+    auto it = mapHeights.find(txid);
+
+    if (it != mapHeights.end()) {
+        nHeight = it->second;
+        return true;
+    }
+
+    CTransaction tx;
+    uint256 hashBlock;
+
+    if (!GetTransaction(txid, tx, Params().GetConsensus(), hashBlock, false))
+        return error("%s: transaction %s not found", __func__, txid.ToString());
+
+    LOCK(cs_main);
+
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+    if (mi == mapBlockIndex.end() || !mi->second)
+        return error("%s: block of transaction %s not found", __func__, txid.ToString());
+
+    nHeight = mi->second->nHeight;
+    mapHeights.insert(std::make_pair(txid, nHeight));
+
+    return true;
+}
+
+/** Add the deposits of a transaction, the amount its outputs exceed its inputs for each address */
+static void AddDeposits(const CTransaction &tx, const CBlock &block, const CBlockIndex *pindex,
+                        const AddressAmounts &mapInputs, const AddressAmounts &mapOutputs,
+                        std::vector<std::pair<CDepositIndexKey, CDepositValue> > &depositIndex)
+{
+    for (const auto &output : mapOutputs) {
+
+        auto input = mapInputs.find(output.first);
+
+        if (input == mapInputs.end()) {
+            // If there is no input related to the address of this output just add it as deposit
+            depositIndex.push_back(std::make_pair(CDepositIndexKey(output.first.second, output.first.first, block.nTime, tx.GetHash()), CDepositValue(output.second, pindex->nHeight)));
+        } else {
+
+            // If there is an input related to the address of this output evaluate if the outputs exceed the inputs
+            CAmount nDeposit = output.second - input->second;
+
+            if (nDeposit > 0) {
+                depositIndex.push_back(std::make_pair(CDepositIndexKey(output.first.second, output.first.first, block.nTime, tx.GetHash()), CDepositValue(nDeposit, pindex->nHeight)));
+            }
+        }
+    }
+}
+
+bool GetIndexBlockEntries(const CBlock &block, const CBlockUndo &blockUndo, const CBlockIndex *pindex, bool fUndo, CIndexBlockEntries &entries)
+{
+    if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block and undo data inconsistent", __func__);
+
+    std::map<uint256, int> mapPrevHeights;
+
+    for (unsigned int n = 0; n < block.vtx.size(); n++) {
+
+        // Undo transactions in reverse order, an output spent in the same block
+        // has to be restored to the unspent index before it gets removed again.
+        unsigned int i = fUndo ? block.vtx.size() - 1 - n : n;
+
+        const CTransaction &tx = block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+        AddressAmounts mapInputs;
+        AddressAmounts mapOutputs;
+
+        if (!tx.IsCoinBase() && !tx.IsZerocoinSpend()) {
+
+            const CTxUndo &txundo = blockUndo.vtxundo[i - 1];
+
+            if (txundo.vprevout.size() != tx.vin.size())
+                return error("%s: transaction and undo data inconsistent", __func__);
+
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+
+                const CTxIn &input = tx.vin[j];
+                const Coin &coin = txundo.vprevout[j];
+                const CTxOut &prevout = coin.out;
+                uint160 hashBytes;
+                int addressType;
+
+                bool fAddress = GetScriptAddress(prevout.scriptPubKey, hashBytes, addressType);
+
+                if (fDepositIndex && fAddress)
+                    mapInputs[std::make_pair(hashBytes, addressType)] += prevout.nValue;
+
+                if (fAddressIndex && fAddress) {
+
+                    int nPrevHeight = coin.nHeight;
+
+                    if (!nPrevHeight && !GetPrevHeight(input.prevout.hash, nPrevHeight, mapPrevHeights))
+                        return false;
+
+                    // spending activity
+                    entries.addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), prevout.nValue * -1));
+
+                    // remove the spent output from the unspent index, or restore it
+                    CAddressUnspentKey unspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n, nPrevHeight);
+
+                    if (fUndo)
+                        entries.addressUnspentIndex.push_back(std::make_pair(unspentKey, CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, nPrevHeight)));
+                    else
+                        entries.addressUnspentIndex.push_back(std::make_pair(unspentKey, CAddressUnspentValue()));
+                }
+
+                if (fSpentIndex) {
+                    // the spent index determines the txid and input that spent an output
+                    // and the amount and address of an input
+                    CSpentIndexKey spentKey(input.prevout.hash, input.prevout.n);
+
+                    if (fUndo)
+                        entries.spentIndex.push_back(std::make_pair(spentKey, CSpentIndexValue()));
+                    else
+                        entries.spentIndex.push_back(std::make_pair(spentKey, CSpentIndexValue(txhash, j, pindex->nHeight, prevout.nValue, addressType, hashBytes)));
+                }
+            }
+        }
+
+        for (unsigned int k = 0; k < tx.vout.size(); k++) {
+
+            const CTxOut &out = tx.vout[k];
+            uint160 hashBytes;
+            int addressType;
+
+            if (!GetScriptAddress(out.scriptPubKey, hashBytes, addressType))
+                continue;
+
+            if (fDepositIndex)
+                mapOutputs[std::make_pair(hashBytes, addressType)] += out.nValue;
+
+            if (fAddressIndex) {
+
+                // receiving activity
+                entries.addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
+
+                // add the output to the unspent index, or remove it
+                CAddressUnspentKey unspentKey(addressType, hashBytes, txhash, k, pindex->nHeight);
+
+                if (fUndo)
+                    entries.addressUnspentIndex.push_back(std::make_pair(unspentKey, CAddressUnspentValue()));
+                else
+                    entries.addressUnspentIndex.push_back(std::make_pair(unspentKey, CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+            }
+        }
+
+        if (fDepositIndex)
+            AddDeposits(tx, block, pindex, mapInputs, mapOutputs, entries.depositIndex);
+    }
+
+    if (fTimestampIndex)
+        entries.timestampIndex.push_back(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash()));
+
+    return true;
+}
+
+CIndexBuilder::CIndexBuilder() :
+    pindexBest(NULL),
+    fNotified(false)
+{}
+
+bool CIndexBuilder::Init(bool fRebuild)
+{
+    LOCK2(cs_main, cs);
+
+    uint256 hashBest;
+
+    if (!fRebuild && !pblocktree->ReadIndexesBestBlock(hashBest)) {
+        // Databases written by versions without the index builder have the
+        // indexes built up to the chain tip by ConnectBlock.
+        if (chainActive.Tip())
+            hashBest = chainActive.Tip()->GetBlockHash();
+
+        if (!pblocktree->WriteIndexesBestBlock(hashBest))
+            return error("%s: failed to write the best block of the indexes", __func__);
+    }
+
+    BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+
+    if (!fRebuild && !hashBest.IsNull() && mi == mapBlockIndex.end()) {
+        LogPrintf("%s: best block of the indexes %s not found, rebuilding them\n", __func__, hashBest.ToString());
+        fRebuild = true;
+    }
+
+    if (fRebuild) {
+
+        if (!pblocktree->EraseIndexes())
+            return error("%s: failed to erase the indexes", __func__);
+
+        pindexBest = NULL;
+
+    } else {
+        pindexBest = hashBest.IsNull() ? NULL : mi->second;
+    }
+
+    LogPrintf("%s: indexes built up to height %d\n", __func__, GetBestHeight());
+
+    return true;
+}
+
+const CBlockIndex *CIndexBuilder::GetBestBlock() const
+{
+    LOCK(cs);
+    return pindexBest;
+}
+
+int CIndexBuilder::GetBestHeight() const
+{
+    LOCK(cs);
+    return pindexBest ? pindexBest->nHeight : -1;
+}
+
+bool CIndexBuilder::ProcessNextBlock(bool &fProgress)
+{
+    const CBlockIndex *pindex;
+    CDiskBlockPos blockPos;
+    CDiskBlockPos undoPos;
+    bool fUndo;
+
+    fProgress = false;
+
+    {
+        LOCK(cs_main);
+
+        const CBlockIndex *pindexTip = chainActive.Tip();
+        const CBlockIndex *pindexCurrent = GetBestBlock();
+
+        if (!pindexTip)
+            return true;
+
+        if (pindexCurrent && !chainActive.Contains(pindexCurrent)) {
+
+            // The chain is only behind the indexes, e.g. while -reindex-chainstate
+            // connects its blocks again. Wait for it instead of undoing them.
+            if (pindexCurrent->GetAncestor(pindexTip->nHeight) == pindexTip)
+                return true;
+
+            pindex = pindexCurrent;
+            fUndo = true;
+
+        } else {
+
+            pindex = pindexCurrent ? chainActive.Next(pindexCurrent) : chainActive.Genesis();
+
+            if (!pindex)
+                return true;
+
+            fUndo = false;
+        }
+
+        blockPos = pindex->GetBlockPos();
+        undoPos = pindex->GetUndoPos();
+    }
+
+    int64_t nTimeStart = GetTimeMicros();
+    CIndexBlockEntries entries;
+
+    // The outputs of the genesis block are not spendable, it adds nothing to the indexes
+    if (pindex->pprev) {
+
+        CBlock block;
+        CBlockUndo blockUndo;
+
+        if (!ReadBlockFromDisk(block, blockPos, Params().GetConsensus()) || block.GetHash() != pindex->GetBlockHash())
+            return AbortNode(strprintf("%s: failed to read block %s", __func__, pindex->GetBlockHash().ToString()));
+
+        if (undoPos.IsNull() || !UndoReadFromDisk(blockUndo, undoPos, pindex->pprev->GetBlockHash()))
+            return AbortNode(strprintf("%s: failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString()));
+
+        if (!GetIndexBlockEntries(block, blockUndo, pindex, fUndo, entries))
+            return AbortNode(strprintf("%s: failed to get the index entries of block %s", __func__, pindex->GetBlockHash().ToString()));
+    }
+
+    {
+        LOCK(cs);
+
+        const CBlockIndex *pindexNew = fUndo ? pindex->pprev : pindex;
+
+        if (!pblocktree->WriteIndexes(entries, fUndo, pindexNew->GetBlockHash()))
+            return AbortNode("Failed to write address, spent, deposit and timestamp indexes");
+
+        pindexBest = pindexNew;
+    }
+
+    // Only this thread moves the indexes, the listeners get the blocks in order without holding cs
+    if (fAddressIndex)
+        GetMainSignals().AddressIndexUpdated(pindex, entries.addressIndex, !fUndo);
+
+    LogPrint("index", "%s: %s block %s at height %d, %u address index entries (%.2fms)\n", __func__,
+             fUndo ? "disconnected" : "connected", pindex->GetBlockHash().ToString(), pindex->nHeight,
+             entries.addressIndex.size(), 0.001 * (GetTimeMicros() - nTimeStart));
+
+    fProgress = true;
+
+    return true;
+}
+
+void CIndexBuilder::ThreadIndexBuilder()
+{
+    RenameThread("smartcash-indexer");
+
+    while (true) {
+
+        {
+            boost::unique_lock<boost::mutex> lock(csNotify);
+            fNotified = false;
+        }
+
+        bool fProgress = true;
+
+        while (fProgress) {
+            boost::this_thread::interruption_point();
+
+            if (!ProcessNextBlock(fProgress))
+                return;
+        }
+
+        // Wait for the next tip update, a tip change while indexing set fNotified already
+        boost::unique_lock<boost::mutex> lock(csNotify);
+
+        while (!fNotified)
+            condNotify.wait(lock);
+    }
+}
+
+void CIndexBuilder::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    boost::unique_lock<boost::mutex> lock(csNotify);
+    fNotified = true;
+    condNotify.notify_one();
+}
@@ -0,0 +1,68 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SMARTCASH_INDEXBUILDER_H
+#define SMARTCASH_INDEXBUILDER_H
+
+#include "sync.h"
+#include "validationinterface.h"
+
+class CBlock;
+class CBlockIndex;
+class CBlockUndo;
+class CIndexBuilder;
+class CScript;
+class uint160;
+struct CIndexBlockEntries;
+
+extern CIndexBuilder *pindexbuilder;
+
+static const bool DEFAULT_REBUILDINDEXES = false;
+
+/**
+ * Builds the address, address unspent, address summary, spent, deposit and
+ * timestamp indexes in a background thread from the blocks and undo data on
+ * disk. It follows the active chain by itself, disconnecting the blocks of a
+ * reorg and connecting the new ones, and keeps its own best block in the block
+ * tree database. This keeps the index I/O out of ConnectBlock/DisconnectBlock
+ * and lets it catch up or rebuild the indexes without a reindex.
+ */
+class CIndexBuilder final : public CValidationInterface
+{
+    // Best block the indexes are built up to, NULL if nothing is indexed
+    const CBlockIndex *pindexBest;
+
+    CWaitableCriticalSection csNotify;
+    CConditionVariable condNotify;
+    bool fNotified;
+
+    /** Index the next block, fProgress is false if the indexes are at the tip */
+    bool ProcessNextBlock(bool &fProgress);
+
+public:
+    // Held while a block gets written to the indexes, lock it before reading
+    // the indexes to get them consistent with GetBestHeight()
+    mutable CCriticalSection cs;
+
+    CIndexBuilder();
+
+    /** Load the best block of the indexes, with fRebuild erase them to build them from scratch */
+    bool Init(bool fRebuild);
+
+    const CBlockIndex *GetBestBlock() const;
+    int GetBestHeight() const;
+
+    void ThreadIndexBuilder();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+};
+
+/** Get the address index key of a script, false if it doesn't pay to an address */
+bool GetScriptAddress(const CScript &script, uint160 &hashBytes, int &addressType);
+
+/** Get the entries a block adds to the indexes, or with fUndo removes from them */
+bool GetIndexBlockEntries(const CBlock &block, const CBlockUndo &blockUndo, const CBlockIndex *pindex, bool fUndo, CIndexBlockEntries &entries);
+
+#endif // SMARTCASH_INDEXBUILDER_H
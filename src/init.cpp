@@ -17,8 +17,10 @@
 #include "checkpoints.h"
 #include "compat/sanity.h"
 #include "consensus/validation.h"
+#include "crypto/keccak256.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "indexbuilder.h"
 #include "key.h"
 #include "validation.h"
 #include "miner.h"
@@ -29,6 +31,7 @@
 #include "smartvoting/votevalidation.h"
 #include "smartmining/miningpayments.h"
 #include "net_processing.h"
+#include "paralleltask.h"
 #include "policy/policy.h"
 #include "rpc/server.h"
 #include "script/standard.h"
@@ -75,6 +78,7 @@
 #include "smarthive/hivepayments.h"
 
 #include "sapi/sapi.h"
+#include "sapi/sapi_cache.h"
 
 #include <stdint.h>
 #include <stdio.h>
@@ -126,6 +130,7 @@ static CZMQNotificationInterface* pzmqNotificationInterface = NULL;
 #endif
 
 static CDSNotificationInterface* pdsNotificationInterface = NULL;
+static CVotingPowerTracker* pVotingPowerTracker = NULL;
 
 #ifdef WIN32
 // Win32 LevelDB doesn't use filedescriptors, and the ones used for
@@ -346,6 +351,18 @@ void PrepareShutdown()
         pdsNotificationInterface = NULL;
     }
 
+    if (pVotingPowerTracker) {
+        UnregisterValidationInterface(pVotingPowerTracker);
+        delete pVotingPowerTracker;
+        pVotingPowerTracker = NULL;
+    }
+
+    if (pindexbuilder) {
+        UnregisterValidationInterface(pindexbuilder);
+        delete pindexbuilder;
+        pindexbuilder = NULL;
+    }
+
 #ifndef WIN32
     try {
         boost::filesystem::remove(GetPidFile());
@@ -449,6 +466,17 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    if (showDebug) {
+        // <db> is one of chainstate, index or rewards
+        strUsage += HelpMessageOpt("-<db>dbbloombits=<n>", strprintf("Bits per key of the bloom filter of the chainstate, index or rewards database, 0 disables it (default: %d, %d, %d)",
+            CHAINSTATE_DB_OPTIONS.nBloomFilterBits, BLOCKTREE_DB_OPTIONS.nBloomFilterBits, REWARDS_DB_OPTIONS.nBloomFilterBits));
+        strUsage += HelpMessageOpt("-<db>dbmaxopenfiles=<n>", strprintf("Number of table files the database keeps open (default: %d, %d, %d)",
+            CHAINSTATE_DB_OPTIONS.nMaxOpenFiles, BLOCKTREE_DB_OPTIONS.nMaxOpenFiles, REWARDS_DB_OPTIONS.nMaxOpenFiles));
+        strUsage += HelpMessageOpt("-<db>dbblocksize=<n>", strprintf("Size of the data blocks of the database in bytes (default: %u, %u, %u)",
+            CHAINSTATE_DB_OPTIONS.nBlockSize, BLOCKTREE_DB_OPTIONS.nBlockSize, REWARDS_DB_OPTIONS.nBlockSize));
+        strUsage += HelpMessageOpt("-<db>dbcompression", strprintf("Compress the data blocks of the database with Snappy if LevelDB was built with it (default: %u, %u, %u)",
+            CHAINSTATE_DB_OPTIONS.fCompression, BLOCKTREE_DB_OPTIONS.fCompression, REWARDS_DB_OPTIONS.fCompression));
+    }
     if (showDebug)
         strUsage += HelpMessageOpt("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
@@ -472,6 +500,7 @@ std::string HelpMessage(HelpMessageMode mode)
     // txindex option is currently disabled, defaults to true.
     //strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
     strUsage += HelpMessageOpt("-depositindex", strprintf(_("Maintain a address deposit index, used by the SAPI and the getdeposits rpc call (not yet implemented) (default: %u)"), DEFAULT_DEPOSITINDEX));
+    strUsage += HelpMessageOpt("-rebuildindexes", strprintf(_("Erase the address, spent, deposit and timestamp indexes on startup and rebuild them from the blocks on disk in the background (default: %u)"), DEFAULT_REBUILDINDEXES));
 
     strUsage += HelpMessageGroup(_("Options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
@@ -547,7 +576,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitdescendantsize=<n>", strprintf("Do not accept transactions if any ancestor would have more than <n> kilobytes of in-mempool descendants (default: %u).", DEFAULT_DESCENDANT_SIZE_LIMIT));
         strUsage += HelpMessageOpt("-bip9params=deployment:start:end", "Use given start/end times for specified bip9 deployment (regtest-only)");
     }
-    string debugCategories = "addrman, alert, bench, cmpctblock, coindb, db, http, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, tor, zmq"; // Don't translate these and qt below
+    string debugCategories = "addrman, alert, bench, cmpctblock, coindb, db, http, index, libevent, lock, mempool, mempoolrej, net, proxy, prune, rand, reindex, rpc, selectcoins, tor, zmq"; // Don't translate these and qt below
     if (mode == HMM_BITCOIN_QT)
         debugCategories += ", qt";
     strUsage += HelpMessageOpt("-debug=<category>", strprintf(_("Output debugging information (default: %u, supplying <category> is optional)"), 0) + ". " +
@@ -564,6 +593,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default: %u)", DEFAULT_LIMITFREERELAY));
         strUsage += HelpMessageOpt("-relaypriority", strprintf("Require high priority for relaying free or low-fee transactions (default: %u)", DEFAULT_RELAYPRIORITY));
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit size of signature cache to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxmsgsigcachesize=<n>", strprintf("Limit size of the smartnode message signature cache to <n> MiB (default: %u)", DEFAULT_MAX_MSG_SIG_CACHE_SIZE));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in %s/kB) smaller than this are considered zero fee for relaying, mining and transaction creation (default: %s)"),
@@ -616,6 +646,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-sapithreads=<n>",_("Set the number of threads for SAPI requests (default: 4)"));
     strUsage += HelpMessageOpt("-sapiworkqueue=<n>",_("Set the queue for SAPI requests (default: 16)"));
     strUsage += HelpMessageOpt("-sapiservertimeout=<n>",_("Set the seconds before SAPI timeout (default: 30)"));
+    strUsage += HelpMessageOpt("-sapicachesize=<n>", strprintf(_("Maximum size of the SAPI block and transaction response cache in megabytes, 0 to disable (default: %u)"), DEFAULT_SAPI_CACHE_SIZE));
+    strUsage += HelpMessageOpt("-sapicachedepth=<n>", strprintf(_("Drop cached SAPI responses of blocks with less confirmations on reorgs (default: %u)"), DEFAULT_SAPI_CACHE_DEPTH));
     strUsage += HelpMessageOpt("-sapiwhitelist=<ip>",_("Whitelist ip for SAPI"));
     return strUsage;
 }
@@ -783,6 +815,8 @@ bool InitSanityCheck(void)
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string keccak256_algo = Keccak256AutoDetect();
+    LogPrintf("Using the '%s' Keccak256 implementation\n", keccak256_algo);
 
     if(!ECC_InitSanityCheck()) {
         InitError("Elliptic curve cryptography sanity check failure. Aborting.");
@@ -945,19 +979,6 @@ void InitParameterInteraction()
     }
 
     fInstantPayIndex = GetBoolArg("-instantpayindex", DEFAULT_INSTANTPAYINDEX);
-
-    // Make sure additional indexes are recalculated correctly in VerifyDB
-    // (we must reconnect blocks whenever we disconnect them for these indexes to work)
-    bool fAdditionalIndexes =
-        GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) ||
-        GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) ||
-        GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX) ||
-        GetBoolArg("-depositindex", DEFAULT_DEPOSITINDEX);
-
-    if (fAdditionalIndexes && GetArg("-checklevel", DEFAULT_CHECKLEVEL) < 4) {
-        mapArgs["-checklevel"] = "4";
-        LogPrintf("%s: parameter interaction: additional indexes -> setting -checklevel=4\n", __func__);
-    }
 }
 
 // static std::string ResolveErrMsg(const char * const optname, const std::string& strBind)
@@ -1361,6 +1382,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadParallelTask);
+#ifdef ENABLE_WALLET
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadWalletScanCheck);
+#endif
     }
 
     if (!sporkManager.SetSporkAddress(GetArg("-sporkaddr", Params().SporkAddress())))
@@ -1867,6 +1894,17 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         mempool.ReadFeeEstimates(est_filein);
     fFeeEstimatesInitialized = true;
 
+    // The index builder follows the chain from here on, start it before any block gets connected
+    // and before a wallet rescan looks up the blocks of the wallet's keys in the address index
+    if (fAddressIndex || fSpentIndex || fDepositIndex || fTimestampIndex) {
+        pindexbuilder = new CIndexBuilder();
+        if (!pindexbuilder->Init(GetBoolArg("-rebuildindexes", DEFAULT_REBUILDINDEXES)))
+            return InitError(_("Failed to load the address, spent, deposit and timestamp indexes"));
+        RegisterValidationInterface(pindexbuilder);
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "indexbuilder",
+                                  boost::function<void()>(boost::bind(&CIndexBuilder::ThreadIndexBuilder, pindexbuilder))));
+    }
+
     // ********************************************************* Step 8: load wallet
 #ifdef ENABLE_WALLET
     if (fDisableWallet) {
@@ -2243,8 +2281,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
     threadGroup.create_thread(boost::bind(&ThreadSmartnode, boost::ref(*g_connman)));
 
-//  WIP-VOTING uncomment
-//    threadGroup.create_thread(&ThreadSmartVoting);
+    // keep the voting power of the active vote keys up to date with the address index
+    if (!fLiteMode) {
+        pVotingPowerTracker = new CVotingPowerTracker();
+        RegisterValidationInterface(pVotingPowerTracker);
+    }
 
     // ********************************************************* Step 12: start node
 
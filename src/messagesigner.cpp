@@ -4,11 +4,91 @@
 
 #include "base58.h"
 #include "hash.h"
+#include "memusage.h"
+#include "random.h"
 #include "validation.h" // For strMessageMagic
 #include "messagesigner.h"
+#include "paralleltask.h"
 #include "tinyformat.h"
+#include "util.h"
 #include "utilstrencodings.h"
 
+#include <boost/thread.hpp>
+#include <boost/unordered_set.hpp>
+
+namespace {
+
+class CMessageSignatureCacheHasher
+{
+public:
+    size_t operator()(const uint256& key) const {
+        return key.GetCheapHash();
+    }
+};
+
+/**
+ * Valid hash signature cache. Smartnode messages are relayed by many peers
+ * and most of them are checked more than once, so recovering the public key
+ * is only done the first time a valid signature is seen. Invalid signatures
+ * are not kept, a peer sending junk signatures can't push out valid entries.
+ */
+class CMessageSignatureCache
+{
+private:
+     //! Entries are SHA256(nonce || hash || key id || signature):
+    uint256 nonce;
+    typedef boost::unordered_set<uint256, CMessageSignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_sigcache;
+    size_t nMaxCacheSize;
+
+public:
+    CMessageSignatureCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+        nMaxCacheSize = GetArg("-maxmsgsigcachesize", DEFAULT_MAX_MSG_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    }
+
+    void
+    ComputeEntry(uint256& entry, const uint256 &hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(keyID.begin(), keyID.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+    }
+
+    bool
+    Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.count(entry);
+    }
+
+    void Set(const uint256& entry)
+    {
+        if (nMaxCacheSize <= 0) return;
+
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        while (memusage::DynamicUsage(setValid) > nMaxCacheSize)
+        {
+            map_type::size_type s = GetRand(setValid.bucket_count());
+            map_type::local_iterator it = setValid.begin(s);
+            if (it != setValid.end(s)) {
+                setValid.erase(*it);
+            }
+        }
+
+        setValid.insert(entry);
+    }
+};
+
+// Constructed on first use, after the arguments got parsed
+CMessageSignatureCache& GetMessageSignatureCache()
+{
+    static CMessageSignatureCache messageSignatureCache;
+    return messageSignatureCache;
+}
+
+}
+
 bool CMessageSigner::GetKeysFromSecret(const std::string strSecret, CKey& keyRet, CPubKey& pubkeyRet)
 {
     CBitcoinSecret vchSecret;
@@ -36,12 +116,17 @@ bool CMessageSigner::VerifyMessage(const CPubKey& pubkey, const std::vector<unsi
 }
 
 bool CMessageSigner::VerifyMessage(const CKeyID& keyID, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet)
+{
+    return CHashSigner::VerifyHash(GetMessageHash(strMessage), keyID, vchSig, strErrorRet);
+}
+
+uint256 CMessageSigner::GetMessageHash(const std::string& strMessage)
 {
     CHashWriter ss(SER_GETHASH, 0);
     ss << strMessageMagic;
     ss << strMessage;
 
-    return CHashSigner::VerifyHash(ss.GetHash(), keyID, vchSig, strErrorRet);
+    return ss.GetHash();
 }
 
 bool CHashSigner::SignHash(const uint256& hash, const CKey key, std::vector<unsigned char>& vchSigRet)
@@ -56,6 +141,15 @@ bool CHashSigner::VerifyHash(const uint256& hash, const CPubKey& pubkey, const s
 
 bool CHashSigner::VerifyHash(const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig, std::string& strErrorRet)
 {
+    CMessageSignatureCache& messageSignatureCache = GetMessageSignatureCache();
+
+    uint256 entry;
+    messageSignatureCache.ComputeEntry(entry, hash, keyID, vchSig);
+
+    if (messageSignatureCache.Get(entry)) {
+        return true;
+    }
+
     CPubKey pubkeyFromSig;
     if(!pubkeyFromSig.RecoverCompact(hash, vchSig)) {
         strErrorRet = "Error recovering public key.";
@@ -69,5 +163,30 @@ bool CHashSigner::VerifyHash(const uint256& hash, const CKeyID& keyID, const std
         return false;
     }
 
+    messageSignatureCache.Set(entry);
     return true;
 }
+
+bool CHashSigner::VerifyHashes(std::vector<CHashSignatureCheck>& vChecks)
+{
+    // Handing the one or two signatures of a single message to other threads costs more than checking them
+    int nParts = vChecks.size() < MIN_MSG_SIG_CHECK_BATCH_SIZE ? 1 : GetParallelTaskThreads();
+    std::vector<int> vPartOk(nParts, 1);
+
+    // Don't wait for the queue while it is busy with a block, check the signatures here instead
+    ParallelForRanges(vChecks.size(), nParts, [&](size_t nBegin, size_t nEnd, int nPart) {
+        for (size_t i = nBegin; i < nEnd; ++i) {
+            if (!vChecks[i]()) {
+                vPartOk[nPart] = 0;
+            }
+        }
+    }, false);
+
+    return std::find(vPartOk.begin(), vPartOk.end(), 0) == vPartOk.end();
+}
+
+bool CHashSignatureCheck::operator()()
+{
+    std::string strError;
+    return CHashSigner::VerifyHash(hash, keyID, vchSig, strError);
+}
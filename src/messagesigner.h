@@ -7,6 +7,11 @@
 
 #include "key.h"
 
+// Limit the cache of message signature results to 8MB (about 100000 entries on 64-bit systems)
+static const unsigned int DEFAULT_MAX_MSG_SIG_CACHE_SIZE = 8;
+// Smaller batches of signatures are checked on the calling thread
+static const unsigned int MIN_MSG_SIG_CHECK_BATCH_SIZE = 4;
+
 /** Helper class for signing messages and checking their signatures
  */
 class CMessageSigner
@@ -20,6 +25,25 @@ public:
     static bool VerifyMessage(const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet);
     /// Verify the message signature, returns true if succcessful
     static bool VerifyMessage(const CKeyID& keyID, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& strErrorRet);
+    /// Return the hash that is signed for strMessage
+    static uint256 GetMessageHash(const std::string& strMessage);
+};
+
+/** A hash signature to be verified, used to check the signatures of a message before taking locks
+ */
+class CHashSignatureCheck
+{
+private:
+    uint256 hash;
+    CKeyID keyID;
+    std::vector<unsigned char> vchSig;
+
+public:
+    CHashSignatureCheck() {}
+    CHashSignatureCheck(const uint256& hashIn, const CKeyID& keyIDIn, const std::vector<unsigned char>& vchSigIn) :
+        hash(hashIn), keyID(keyIDIn), vchSig(vchSigIn) {}
+
+    bool operator()();
 };
 
 /** Helper class for signing hashes and checking their signatures
@@ -33,6 +57,9 @@ public:
     static bool VerifyHash(const uint256& hash, const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
     /// Verify the hash signature, returns true if succcessful
     static bool VerifyHash(const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
+    /// Verify a batch of hash signatures, returns true if all of them are valid.
+    /// Valid signatures are cached so the handlers checking them later don't have to recover the keys again.
+    static bool VerifyHashes(std::vector<CHashSignatureCheck>& vChecks);
 };
 
 #endif
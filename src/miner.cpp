@@ -53,17 +53,6 @@ uint64_t nLastBlockTx = 0;
 uint64_t nLastBlockSize = 0;
 uint64_t nLastBlockWeight = 0;
 
-class ScoreCompare
-{
-public:
-    ScoreCompare() {}
-
-    bool operator()(const CTxMemPool::txiter a, const CTxMemPool::txiter b)
-    {
-        return CompareTxMemPoolEntryByScore()(*b,*a); // Convert to less than
-    }
-};
-
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev)
 {
     int64_t nOldTime = pblock->nTime;
@@ -80,37 +69,26 @@ int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParam
 }
 
 BlockAssembler::BlockAssembler(const CChainParams& _chainparams)
-    : chainparams(_chainparams)
+    : BlockAssembler(_chainparams, mempool)
 {
-    // Block resource limits
-    // If neither -blockmaxsize or -blockmaxweight is given, limit to DEFAULT_BLOCK_MAX_*
-    // If only one is given, only restrict the specified resource.
-    // If both are given, restrict both.
-    nBlockMaxWeight = DEFAULT_BLOCK_MAX_WEIGHT;
-    nBlockMaxSize = DEFAULT_BLOCK_MAX_SIZE;
-    nTxMaxCount = DEFAULT_TX_MAX_COUNT;
-    bool fWeightSet = false;
-    if (mapArgs.count("-blockmaxweight")) {
-        nBlockMaxWeight = GetArg("-blockmaxweight", DEFAULT_BLOCK_MAX_WEIGHT);
-        nBlockMaxSize = MAX_BLOCK_SERIALIZED_SIZE;
-        fWeightSet = true;
-    }
-    if (mapArgs.count("-blockmaxsize")) {
-        nBlockMaxSize = GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
-        if (!fWeightSet) {
-            nBlockMaxWeight = nBlockMaxSize * WITNESS_SCALE_FACTOR;
-        }
-    }
-    if(mapArgs.count("-txmaxcount")){
-        nTxMaxCount = GetArg("-txmaxcount", DEFAULT_TX_MAX_COUNT);
-    }
-    // Limit weight to between 4K and MAX_BLOCK_WEIGHT-4K for sanity:
-    nBlockMaxWeight = std::max((unsigned int)4000, std::min((unsigned int)(MAX_BLOCK_WEIGHT-4000), nBlockMaxWeight));
+}
+
+BlockAssembler::BlockAssembler(const CChainParams& _chainparams, CTxMemPool& poolIn)
+    : pool(poolIn), chainparams(_chainparams), pindexPrev(NULL)
+{
+    // Largest block you're willing to create:
+    nBlockMaxSize = GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
     // Limit size to between 1K and MAX_BLOCK_SERIALIZED_SIZE-1K for sanity:
     nBlockMaxSize = std::max((unsigned int)1000, std::min((unsigned int)(MAX_BLOCK_SERIALIZED_SIZE-1000), nBlockMaxSize));
 
-    // Whether we need to account for byte usage (in addition to weight usage)
-    fNeedSizeAccounting = (nBlockMaxSize < MAX_BLOCK_SERIALIZED_SIZE-1000);
+    // How much of the block should be dedicated to high-priority transactions,
+    // included regardless of the fees they pay
+    nBlockPrioritySize = GetArg("-blockprioritysize", DEFAULT_BLOCK_PRIORITY_SIZE);
+    nBlockPrioritySize = std::min(nBlockMaxSize, nBlockPrioritySize);
+
+    nTxMaxCount = GetArg("-txmaxcount", DEFAULT_TX_MAX_COUNT);
+
+    fPrintPriority = GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
 }
 
 void BlockAssembler::resetBlock()
@@ -119,29 +97,70 @@ void BlockAssembler::resetBlock()
 
     // Reserve space for coinbase tx
     nBlockSize = 1000;
-    nBlockWeight = 4000;
-    nBlockSigOpsCost = 100;
-    fIncludeWitness = false;
+    nBlockSigOps = 100;
 
     // These counters do not include coinbase tx
     nBlockTx = 0;
     nFees = 0;
 
+    minPackageFeeRate = CFeeRate(std::numeric_limits<CAmount>::max());
+    fStale = false;
+
     lastFewTxs = 0;
     blockFinished = false;
 }
 
-CBlockTemplate* BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, const CSmartAddress &signingAddress)
+void BlockAssembler::FillBlock(int nHeightIn, int64_t nLockTimeCutoffIn)
 {
+    AssertLockHeld(pool.cs);
+
     resetBlock();
     pblocktemplate.reset(new CBlockTemplate());
+    pblock = &pblocktemplate->block;
+
+    nHeight = nHeightIn;
+    nLockTimeCutoff = nLockTimeCutoffIn;
+
+    // Add a placeholder for the coinbase tx as first transaction
+    CMutableTransaction coinbaseTx;
+    coinbaseTx.vin.resize(1);
+    coinbaseTx.vin[0].prevout.SetNull();
+    coinbaseTx.vout.resize(1);
+    pblock->vtx.push_back(coinbaseTx);
+    pblocktemplate->vTxFees.push_back(-1); // updated at end
+    pblocktemplate->vTxSigOpsCost.push_back(-1); // updated at end
+
+    nLastEntrySequence = pool.GetEntrySequence();
+    nLastTransactionsChanged = pool.GetTransactionsChanged();
+    addPriorityTxs();
+    addPackageTxs(0);
+
+    pblocktemplate->vTxFees[0] = -nFees;
+}
+
+CBlockTemplate* BlockAssembler::SelectTransactions(int nHeightIn, int64_t nLockTimeCutoffIn)
+{
+    LOCK(pool.cs);
+    FillBlock(nHeightIn, nLockTimeCutoffIn);
+    return pblocktemplate.release();
+}
+
+CBlockTemplate* BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, const CSmartAddress &signingAddress)
+{
+    LOCK2(cs_main, pool.cs);
+    pindexPrev = chainActive.Tip();
+    const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
+    const int64_t nTime = GetAdjustedTime();
+
+    int64_t nLockTimeCutoffNew = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+                                 ? nMedianTimePast
+                                 : nTime;
+
+    FillBlock(pindexPrev->nHeight + 1, nLockTimeCutoffNew);
 
-    if(!pblocktemplate.get())
-        return NULL;
-    CBlock *pblock = &pblocktemplate->block; // pointer for convenience
-    LOCK(cs_main);
-    CBlockIndex* pindexPrev = chainActive.Tip();
-    nHeight = pindexPrev->nHeight + 1;
+    nLastBlockTx = nBlockTx;
+    nLastBlockSize = nBlockSize;
+    LogPrintf("CreateNewBlock(): total size %u txs: %u fees: %ld sigops %d\n", nBlockSize, nBlockTx, nFees, nBlockSigOps);
 
     CMutableTransaction coinbaseTx;
     coinbaseTx.vin.resize(1);
@@ -164,625 +183,547 @@ CBlockTemplate* BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, co
     // Add SmartReward payments if there are any pending at the current block.
     SmartRewardPayments::FillPayments(coinbaseTx, nHeight, pindexPrev->GetBlockTime(), pblock->voutSmartRewards);
 
-    // Add coinbase tx as first transaction here. Will
-    pblock->vtx.push_back(coinbaseTx);
-    pblocktemplate->vTxFees.push_back(-1); // updated at end
-    pblocktemplate->vTxSigOpsCost.push_back(-1); // updated at end
+    // Now that we know the fees add them to the mining reward. None of the
+    // payouts above depend on them, so UpdateNewBlock only has to adjust
+    // this output when it adds transactions.
+    coinbaseTx.vout[0].nValue += nFees;
+    pblock->vtx[0] = coinbaseTx;
+
+    pblock->nVersion = CBlockHeader::CURRENT_VERSION;
+    // -regtest only: allow overriding block.nVersion with
+    // -blockversion=N to test forking scenarios
+    if (chainparams.MineBlocksOnDemand())
+        pblock->nVersion = GetArg("-blockversion", pblock->nVersion);
+
+    // Fill in header
+    pblock->hashPrevBlock  = pindexPrev->GetBlockHash();
+    pblock->nTime          = nTime;
+    UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev);
+    pblock->nBits          = GetNextWorkRequired(pindexPrev, pblock, chainparams.GetConsensus());
+    pblock->nNonce         = 0;
+    pblocktemplate->vTxSigOpsCost[0] = GetLegacySigOpCount(pblock->vtx[0]);
+
+    CValidationState state;
+    if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+        throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+    }
 
-    // Largest block you're willing to create:
-    unsigned int nBlockMaxSize = GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
-    // Limit to between 1K and MAX_BLOCK_SIZE-1K for sanity:
-    nBlockMaxSize = std::max((unsigned int)1000, std::min((unsigned int)(MAX_BLOCK_SERIALIZED_SIZE - 1000), nBlockMaxSize));
+    return pblocktemplate.release();
+}
 
-    // How much of the block should be dedicated to high-priority transactions,
-    // included regardless of the fees they pay
-    unsigned int nBlockPrioritySize = GetArg("-blockprioritysize", DEFAULT_BLOCK_PRIORITY_SIZE);
-    nBlockPrioritySize = std::min(nBlockMaxSize, nBlockPrioritySize);
+bool BlockAssembler::AddNewTransactions(CBlockTemplate* pblocktemplateIn)
+{
+    LOCK(pool.cs);
+
+    // Only the template this assembler filled last can be extended, and only
+    // as long as no transaction it looked at left the mempool or changed
+    if (pblocktemplateIn == NULL || pblock != &pblocktemplateIn->block)
+        return false;
+    if (pool.GetTransactionsChanged() != nLastTransactionsChanged || fStale)
+        return false;
+
+    uint64_t nSequenceFrom = nLastEntrySequence;
+    nLastEntrySequence = pool.GetEntrySequence();
+    if (nSequenceFrom == nLastEntrySequence)
+        return true;
+
+    // The template is owned by the caller again when we are done
+    pblocktemplate.reset(pblocktemplateIn);
+
+    uint64_t nBlockTxBefore = nBlockTx;
+    CAmount nFeesBefore = nFees;
+    addPackageTxs(nSequenceFrom);
+
+    if (nBlockTx != nBlockTxBefore) {
+        CMutableTransaction coinbaseTx(pblock->vtx[0]);
+        coinbaseTx.vout[0].nValue += nFees - nFeesBefore;
+        pblock->vtx[0] = coinbaseTx;
+        pblocktemplate->vTxFees[0] = -nFees;
+    }
+
+    pblocktemplate.release();
+    return !fStale;
+}
+
+bool BlockAssembler::UpdateNewBlock(CBlockTemplate* pblocktemplateIn)
+{
+    LOCK2(cs_main, pool.cs);
+
+    if (pindexPrev == NULL || pindexPrev != chainActive.Tip())
+        return false;
+
+    uint64_t nBlockTxBefore = nBlockTx;
+    if (!AddNewTransactions(pblocktemplateIn))
+        return false;
+    if (nBlockTx == nBlockTxBefore)
+        return true;
+
+    nLastBlockTx = nBlockTx;
+    nLastBlockSize = nBlockSize;
+    LogPrintf("UpdateNewBlock(): added %u txs, total size %u txs: %u fees: %ld sigops %d\n", nBlockTx - nBlockTxBefore, nBlockSize, nBlockTx, nFees, nBlockSigOps);
+
+    CValidationState state;
+    if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+        throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+    }
+
+    return true;
+}
+
+void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
+{
+    for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
+        // Only test txs not already in the block
+        if (inBlock.count(*iit)) {
+            testSet.erase(iit++);
+        }
+        else {
+            iit++;
+        }
+    }
+}
+
+bool BlockAssembler::TestPackage(uint64_t packageSize, int64_t packageSigOps, uint64_t packageCount)
+{
+    if (nBlockSize + packageSize >= nBlockMaxSize)
+        return false;
+    if (nBlockSigOps + packageSigOps >= MAX_BLOCK_SIGOPS_COST)
+        return false;
+    if (nTxMaxCount > 0 && nBlockTx + packageCount > nTxMaxCount)
+        return false;
+    return true;
+}
+
+// Perform transaction-level checks before adding to block:
+// - transaction finality (locktime)
+bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& package)
+{
+    BOOST_FOREACH (const CTxMemPool::txiter it, package) {
+        if (!IsFinalTx(it->GetTx(), nHeight, nLockTimeCutoff))
+            return false;
+    }
+    return true;
+}
+
+void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
+{
+    pblock->vtx.push_back(iter->GetTx());
+    pblocktemplate->vTxFees.push_back(iter->GetFee());
+    pblocktemplate->vTxSigOpsCost.push_back(iter->GetSigOpCount());
+    nBlockSize += iter->GetTxSize();
+    ++nBlockTx;
+    nBlockSigOps += iter->GetSigOpCount();
+    nFees += iter->GetFee();
+    inBlock.insert(iter);
+
+    if (fPrintPriority) {
+        double dPriority = iter->GetPriority(nHeight);
+        CAmount dummy;
+        pool.ApplyDeltas(iter->GetTx().GetHash(), dPriority, dummy);
+        LogPrintf("priority %.1f fee %s txid %s\n",
+                  dPriority,
+                  CFeeRate(iter->GetModifiedFee(), iter->GetTxSize()).ToString(),
+                  iter->GetTx().GetHash().ToString());
+    }
+}
+
+void BlockAssembler::UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded,
+        indexed_modified_transaction_set &mapModifiedTx)
+{
+    BOOST_FOREACH(const CTxMemPool::txiter it, alreadyAdded) {
+        CTxMemPool::setEntries descendants;
+        pool.CalculateDescendants(it, descendants);
+        // Insert all descendants (not yet in block) into the modified set
+        BOOST_FOREACH(CTxMemPool::txiter desc, descendants) {
+            if (alreadyAdded.count(desc))
+                continue;
+            modtxiter mit = mapModifiedTx.find(desc);
+            if (mit == mapModifiedTx.end()) {
+                CTxMemPoolModifiedEntry modEntry(desc);
+                modEntry.nCountWithAncestors -= 1;
+                modEntry.nSizeWithAncestors -= it->GetTxSize();
+                modEntry.nModFeesWithAncestors -= it->GetModifiedFee();
+                modEntry.nSigOpCountWithAncestors -= it->GetSigOpCount();
+                mapModifiedTx.insert(modEntry);
+            } else {
+                mapModifiedTx.modify(mit, update_for_parent_inclusion(it));
+            }
+        }
+    }
+}
+
+void BlockAssembler::UpdatePackagesForArrived(uint64_t nSequenceFrom, indexed_modified_transaction_set &mapModifiedTx)
+{
+    uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+    std::string dummy;
+    CTxMemPool::indexed_transaction_set::index<entry_sequence>::type::iterator sit = pool.mapTx.get<entry_sequence>().upper_bound(nSequenceFrom);
+    for (; sit != pool.mapTx.get<entry_sequence>().end(); ++sit) {
+        CTxMemPool::txiter it = pool.mapTx.project<0>(sit);
+        if (it->GetCountWithAncestors() == 1)
+            continue;
+        CTxMemPool::setEntries ancestors;
+        pool.CalculateMemPoolAncestors(*it, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+        CTxMemPoolModifiedEntry modEntry(it);
+        bool fModified = false;
+        BOOST_FOREACH(CTxMemPool::txiter ancestor, ancestors) {
+            if (inBlock.count(ancestor)) {
+                modEntry.nCountWithAncestors -= 1;
+                modEntry.nSizeWithAncestors -= ancestor->GetTxSize();
+                modEntry.nModFeesWithAncestors -= ancestor->GetModifiedFee();
+                modEntry.nSigOpCountWithAncestors -= ancestor->GetSigOpCount();
+                fModified = true;
+            }
+        }
+        if (fModified)
+            mapModifiedTx.insert(modEntry);
+    }
+}
+
+// Skip entries in mapTx that are already in a block or are present
+// in mapModifiedTx (which implies that the mapTx ancestor state is
+// stale due to ancestor inclusion in the block)
+// Also skip transactions that we've already failed to add. This can happen if
+// we consider a transaction in mapModifiedTx and it fails: we can then
+// potentially consider it again while walking mapTx.  It's currently
+// guaranteed to fail again, but as a belt-and-suspenders check we put it in
+// failedTx and avoid re-evaluation, since the re-evaluation would be using
+// cached size/sigops/fee values that are not actually correct.
+bool BlockAssembler::SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set &mapModifiedTx, CTxMemPool::setEntries &failedTx)
+{
+    assert (it != pool.mapTx.end());
+    if (mapModifiedTx.count(it) || inBlock.count(it) || failedTx.count(it))
+        return true;
+    return false;
+}
+
+void BlockAssembler::SortForBlock(const CTxMemPool::setEntries& package, CTxMemPool::txiter entry, std::vector<CTxMemPool::txiter>& sortedEntries)
+{
+    // Sort package by ancestor count
+    // If a transaction A depends on transaction B, then A's ancestor count
+    // must be greater than B's.  So this is sufficient to validly order the
+    // transactions for block inclusion.
+    sortedEntries.clear();
+    sortedEntries.insert(sortedEntries.begin(), package.begin(), package.end());
+    std::sort(sortedEntries.begin(), sortedEntries.end(), CompareTxIterByAncestorCount());
+}
+
+bool BlockAssembler::TestForBlock(CTxMemPool::txiter iter)
+{
+    if (nBlockSize + iter->GetTxSize() >= nBlockMaxSize) {
+        // If the block is so close to full that no more txs will fit
+        // or if we've tried more than 50 times to fill remaining space
+        // then flag that the block is finished
+        if (nBlockSize >  nBlockMaxSize - 100 || lastFewTxs > 50) {
+             blockFinished = true;
+             return false;
+        }
+        // Once we're within 1000 bytes of a full block, only look at 50 more txs
+        // to try to fill the remaining space.
+        if (nBlockSize > nBlockMaxSize - 1000) {
+            lastFewTxs++;
+        }
+        return false;
+    }
+
+    if (nBlockSigOps + iter->GetSigOpCount() >= MAX_BLOCK_SIGOPS_COST) {
+        // If the block has room for no more sig ops then
+        // flag that the block is finished
+        if (nBlockSigOps > MAX_BLOCK_SIGOPS_COST - 2) {
+            blockFinished = true;
+            return false;
+        }
+        // Otherwise attempt to find another tx with fewer sigops
+        // to put in the block.
+        return false;
+    }
+
+    if (nTxMaxCount > 0 && nBlockTx >= nTxMaxCount) {
+        blockFinished = true;
+        return false;
+    }
+
+    // Must check that lock times are still valid
+    // This can be removed once MTP is always enforced
+    // as long as reorgs keep the mempool consistent.
+    if (!IsFinalTx(iter->GetTx(), nHeight, nLockTimeCutoff))
+        return false;
+
+    return true;
+}
 
-    // Minimum block size you want to create; block will be filled with free transactions
-    // until there are no more or the block reaches this size:
-    unsigned int nBlockMinSize = GetArg("-blockminsize", 0);
-    nBlockMinSize = std::min(nBlockMaxSize, nBlockMinSize);
+bool BlockAssembler::isStillDependent(CTxMemPool::txiter iter)
+{
+    BOOST_FOREACH(CTxMemPool::txiter parent, pool.GetMemPoolParents(iter))
+    {
+        if (!inBlock.count(parent)) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    // Collect memory pool transactions into the block
-    CTxMemPool::setEntries inBlock;
-    CTxMemPool::setEntries waitSet;
+void BlockAssembler::addPriorityTxs()
+{
+    if (nBlockPrioritySize == 0) {
+        return;
+    }
 
     // This vector will be sorted into a priority queue:
-    vector<TxCoinAgePriority> vecPriority;
+    std::vector<TxCoinAgePriority> vecPriority;
     TxCoinAgePriorityCompare pricomparer;
     std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash> waitPriMap;
     typedef std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash>::iterator waitPriIter;
     double actualPriority = -1;
 
-    std::priority_queue<CTxMemPool::txiter, std::vector<CTxMemPool::txiter>, ScoreCompare> clearedTxs;
-    bool fPrintPriority = GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
-    uint64_t nBlockSize = 1000;
-    uint64_t nBlockTx = 0;
-    unsigned int nBlockSigOps = 100;
-    int lastFewTxs = 0;
-    CAmount nFees = 0;
-
+    vecPriority.reserve(pool.mapTx.size());
+    for (CTxMemPool::indexed_transaction_set::iterator mi = pool.mapTx.begin();
+         mi != pool.mapTx.end(); ++mi)
     {
-        LOCK(mempool.cs);
-        pblock->nTime = GetAdjustedTime();
-        const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
-
-        pblock->nVersion = CBlockHeader::CURRENT_VERSION;
-        // -regtest only: allow overriding block.nVersion with
-        // -blockversion=N to test forking scenarios
-        if (chainparams.MineBlocksOnDemand())
-            pblock->nVersion = GetArg("-blockversion", pblock->nVersion);
-
-        int64_t nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
-                                  ? nMedianTimePast
-                                  : pblock->GetBlockTime();
-
-        bool fPriorityBlock = nBlockPrioritySize > 0;
-        if (fPriorityBlock) {
-            vecPriority.reserve(mempool.mapTx.size());
-            for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin();
-                 mi != mempool.mapTx.end(); ++mi)
-            {
-                double dPriority = mi->GetPriority(nHeight);
-                CAmount dummy;
-                mempool.ApplyDeltas(mi->GetTx().GetHash(), dPriority, dummy);
-                vecPriority.push_back(TxCoinAgePriority(dPriority, mi));
-            }
-            std::make_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+        double dPriority = mi->GetPriority(nHeight);
+        CAmount dummy;
+        pool.ApplyDeltas(mi->GetTx().GetHash(), dPriority, dummy);
+        vecPriority.push_back(TxCoinAgePriority(dPriority, mi));
+    }
+    std::make_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+
+    CTxMemPool::txiter iter;
+    while (!vecPriority.empty() && !blockFinished) { // add a tx from priority queue to fill the blockprioritysize
+        iter = vecPriority.front().second;
+        actualPriority = vecPriority.front().first;
+        std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+        vecPriority.pop_back();
+
+        // If tx already in block, skip
+        if (inBlock.count(iter)) {
+            assert(false); // shouldn't happen for priority txs
+            continue;
         }
 
-        CTxMemPool::indexed_transaction_set::nth_index<3>::type::iterator mi = mempool.mapTx.get<3>().begin();
-        CTxMemPool::txiter iter;
-
-        while (mi != mempool.mapTx.get<3>().end() || !clearedTxs.empty())
-        {
-            bool priorityTx = false;
-            if (fPriorityBlock && !vecPriority.empty()) { // add a tx from priority queue to fill the blockprioritysize
-                priorityTx = true;
-                iter = vecPriority.front().second;
-                actualPriority = vecPriority.front().first;
-                std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-                vecPriority.pop_back();
-            }
-            else if (clearedTxs.empty()) { // add tx with next highest score
-                iter = mempool.mapTx.project<0>(mi);
-                mi++;
-            }
-            else {  // try to add a previously postponed child tx
-                iter = clearedTxs.top();
-                clearedTxs.pop();
-            }
+        // If tx is dependent on other mempool txs which haven't yet been included
+        // then put it in the waitSet
+        if (isStillDependent(iter)) {
+            waitPriMap.insert(std::make_pair(iter, actualPriority));
+            continue;
+        }
 
-            if (inBlock.count(iter)) {
-                LogPrintf("skip, due to exist!\n");
-                continue; // could have been added to the priorityBlock
-            }
+        // If this tx fits in the block add it, otherwise keep looping
+        if (TestForBlock(iter)) {
+            AddToBlock(iter);
 
-            const CTransaction& tx = iter->GetTx();
-            LogPrintf("Trying to add tx=%s\n", tx.GetHash().ToString());
+            // If now that this txs is added we've surpassed our desired priority size
+            // or have dropped below the AllowFreeThreshold, then we're done adding priority txs
+            if (nBlockSize >= nBlockPrioritySize || !AllowFree(actualPriority)) {
+                break;
+            }
 
-            bool fOrphan = false;
-            BOOST_FOREACH(CTxMemPool::txiter parent, mempool.GetMemPoolParents(iter))
+            // This tx was successfully added, so
+            // add transactions that depend on this one to the priority queue to try again
+            BOOST_FOREACH(CTxMemPool::txiter child, pool.GetMemPoolChildren(iter))
             {
-                if (!inBlock.count(parent)) {
-                    fOrphan = true;
-                    break;
+                waitPriIter wpiter = waitPriMap.find(child);
+                if (wpiter != waitPriMap.end()) {
+                    vecPriority.push_back(TxCoinAgePriority(wpiter->second,child));
+                    std::push_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+                    waitPriMap.erase(wpiter);
                 }
             }
-            if (fOrphan) {
-                if (priorityTx)
-                    waitPriMap.insert(std::make_pair(iter,actualPriority));
-                else waitSet.insert(iter);
-                LogPrintf("skip tx=%s, due to fOrphan=%s\n", tx.GetHash().ToString(), fOrphan);
-                continue;
-            }
+        }
+    }
+}
 
-            unsigned int nTxSize = iter->GetTxSize();
-            if (fPriorityBlock &&
-                (nBlockSize + nTxSize >= nBlockPrioritySize || !AllowFree(actualPriority))) {
-                fPriorityBlock = false;
-                waitPriMap.clear();
-            }
+// This transaction selection algorithm orders the mempool based
+// on feerate of a transaction including all unconfirmed ancestors.
+// Since we don't remove transactions from the mempool as we select them
+// for block inclusion, we need an alternate method of updating the feerate
+// of a transaction with its not-yet-selected ancestors as we go.
+// This is accomplished by walking the in-mempool descendants of selected
+// transactions and storing a temporary modified state in mapModifiedTxs.
+// Each time through the loop, we compare the best transaction in
+// mapModifiedTxs with the next transaction in the mempool to decide what
+// transaction package to work on next.
+//
+// When a block is extended, every transaction that was in the mempool when
+// it was filled has been looked at already and would fail again, so only the
+// ones that arrived after nSequenceFrom are considered. They are taken from
+// the entry_sequence index and sorted like the ancestor_score index, so their
+// packages are still evaluated in feerate order and stopping at the first one
+// below the min relay fee remains correct. A new package that doesn't fit but pays
+// more than the cheapest one in the block marks the block stale, since a new
+// template would be better.
+void BlockAssembler::addPackageTxs(uint64_t nSequenceFrom)
+{
+    // mapModifiedTx will store sorted packages after they are modified
+    // because some of their txs are already in the block
+    indexed_modified_transaction_set mapModifiedTx;
+    // Keep track of entries that failed inclusion, to avoid duplicate work
+    CTxMemPool::setEntries failedTx;
+
+    // Start by adding the transactions that depend on transactions in the
+    // block to mapModifiedTx, with their package reduced accordingly: the
+    // descendants of the priority transactions of a new block, or the new
+    // transactions of a block that is extended
+    if (!inBlock.empty()) {
+        if (nSequenceFrom == 0)
+            UpdatePackagesForAdded(inBlock, mapModifiedTx);
+        else
+            UpdatePackagesForArrived(nSequenceFrom, mapModifiedTx);
+    }
 
-            if (nBlockSize + nTxSize >= nBlockMaxSize) {
-                if (nBlockSize >  nBlockMaxSize - 100 || lastFewTxs > 50) {
-                    LogPrintf("tx=%s, stop due to size overweight", tx.GetHash().ToString());
-                    LogPrintf("nBlockSize=%s\n", nBlockSize);
-                    LogPrintf("nBlockMaxSize=%s\n", nBlockMaxSize);
-                    break;
-                }
-                // Once we're within 1000 bytes of a full block, only look at 50 more txs
-                // to try to fill the remaining space.
-                if (nBlockSize > nBlockMaxSize - 1000) {
-                    lastFewTxs++;
-                }
-                LogPrintf("skip tx=%s\n", tx.GetHash().ToString());
-                LogPrintf("nBlockSize=%s\n", nBlockSize);
-                LogPrintf("nBlockMaxSize=%s\n", nBlockMaxSize);
-                continue;
-            }
-            if (tx.IsCoinBase()) {
-                LogPrintf("skip tx=%s, coinbase tx\n", tx.GetHash().ToString());
-                continue;
-            }
+    // The transactions that arrived after nSequenceFrom, in ancestor feerate
+    // order. A new block walks the ancestor_score index instead.
+    const bool fArrivedOnly = nSequenceFrom > 0;
+    std::vector<CTxMemPool::txiter> vArrived;
+    if (fArrivedOnly) {
+        CTxMemPool::indexed_transaction_set::index<entry_sequence>::type::iterator sit = pool.mapTx.get<entry_sequence>().upper_bound(nSequenceFrom);
+        for (; sit != pool.mapTx.get<entry_sequence>().end(); ++sit)
+            vArrived.push_back(pool.mapTx.project<0>(sit));
+        std::sort(vArrived.begin(), vArrived.end(), CompareTxIterByAncestorFee());
+    }
+    std::vector<CTxMemPool::txiter>::const_iterator ai = vArrived.begin();
 
-            if (!IsFinalTx(tx, nHeight, nLockTimeCutoff)) {
-                LogPrintf("skip tx=%s, not IsFinalTx\n", tx.GetHash().ToString());
-                continue;
+    // Limit the number of attempts to add transactions to the block when it is
+    // close to full; this is just a simple heuristic to finish quickly if the
+    // mempool has a lot of entries.
+    const int64_t MAX_CONSECUTIVE_FAILURES = 1000;
+    int64_t nConsecutiveFailed = 0;
+
+    CTxMemPool::indexed_transaction_set::index<ancestor_score>::type::iterator mi = pool.mapTx.get<ancestor_score>().begin();
+    CTxMemPool::txiter iter;
+    while (true)
+    {
+        // The next transaction from mapTx, if there is one left
+        CTxMemPool::txiter mapTxIter = pool.mapTx.end();
+        if (fArrivedOnly) {
+            if (ai != vArrived.end())
+                mapTxIter = *ai;
+        } else if (mi != pool.mapTx.get<ancestor_score>().end()) {
+            mapTxIter = pool.mapTx.project<0>(mi);
+        }
+        if (mapTxIter == pool.mapTx.end() && mapModifiedTx.empty())
+            break;
+
+        // First try to find a new transaction in mapTx to evaluate.
+        if (mapTxIter != pool.mapTx.end() &&
+                SkipMapTxEntry(mapTxIter, mapModifiedTx, failedTx)) {
+            if (fArrivedOnly) ++ai; else ++mi;
+            continue;
+        }
+
+        // Now that mapTxIter is not stale, determine which transaction to
+        // evaluate: the next entry from mapTx, or the best from mapModifiedTx?
+        bool fUsingModified = false;
+
+        modtxscoreiter modit = mapModifiedTx.get<ancestor_score>().begin();
+        if (mapTxIter == pool.mapTx.end()) {
+            // We're out of entries in mapTx; use the entry from mapModifiedTx
+            iter = modit->iter;
+            fUsingModified = true;
+        } else {
+            // Try to compare the mapTx entry to the mapModifiedTx entry
+            iter = mapTxIter;
+            if (modit != mapModifiedTx.get<ancestor_score>().end() &&
+                    CompareModifiedEntry()(*modit, CTxMemPoolModifiedEntry(iter))) {
+                // The best entry in mapModifiedTx has higher score
+                // than the one from mapTx.
+                // Switch which transaction (package) to consider
+                iter = modit->iter;
+                fUsingModified = true;
+            } else {
+                // Either no entry in mapModifiedTx, or it's worse than mapTx.
+                // Move on in mapTx for the next loop iteration.
+                if (fArrivedOnly) ++ai; else ++mi;
             }
+        }
 
-            unsigned int nTxSigOps = iter->GetSigOpCount();
-            LogPrintf("nTxSigOps=%s\n", nTxSigOps);
-            LogPrintf("nBlockSigOps=%s\n", nBlockSigOps);
-            LogPrintf("MAX_BLOCK_SIGOPS_COST=%s\n", MAX_BLOCK_SIGOPS_COST);
-            if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS_COST) {
-                if (nBlockSigOps > MAX_BLOCK_SIGOPS_COST - 2) {
-                    LogPrintf("tx=%s, stop due to cross fee\n", tx.GetHash().ToString());
-                    break;
-                }
-                LogPrintf("skip tx=%s, nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS_COST\n", tx.GetHash().ToString());
-                continue;
+        // We skip mapTx entries that are inBlock, and mapModifiedTx shouldn't
+        // contain anything that is inBlock.
+        assert(!inBlock.count(iter));
+
+        uint64_t packageCount = iter->GetCountWithAncestors();
+        uint64_t packageSize = iter->GetSizeWithAncestors();
+        CAmount packageFees = iter->GetModFeesWithAncestors();
+        int64_t packageSigOps = iter->GetSigOpCountWithAncestors();
+        if (fUsingModified) {
+            packageCount = modit->nCountWithAncestors;
+            packageSize = modit->nSizeWithAncestors;
+            packageFees = modit->nModFeesWithAncestors;
+            packageSigOps = modit->nSigOpCountWithAncestors;
+        }
+
+        if (packageFees < ::minRelayTxFee.GetFee(packageSize)) {
+            // Everything else we might consider has a lower fee rate
+            return;
+        }
+
+        CFeeRate packageFeeRate(packageFees, packageSize);
+
+        if (!TestPackage(packageSize, packageSigOps, packageCount)) {
+            if (nSequenceFrom > 0 && packageFeeRate > minPackageFeeRate) {
+                // A new template would take this package instead of some
+                // of the ones in the block
+                fStale = true;
+                return;
             }
-            CAmount nTxFees = iter->GetFee();
-            // Added
-            pblock->vtx.push_back(tx);
-            pblocktemplate->vTxFees.push_back(nTxFees);
-            pblocktemplate->vTxSigOpsCost.push_back(nTxSigOps);
-            nBlockSize += nTxSize;
-            ++nBlockTx;
-            nBlockSigOps += nTxSigOps;
-            nFees += nTxFees;
-            LogPrintf("added to block=%s\n", tx.GetHash().ToString());
-            if (fPrintPriority)
-            {
-                double dPriority = iter->GetPriority(nHeight);
-                CAmount dummy;
-                mempool.ApplyDeltas(tx.GetHash(), dPriority, dummy);
-                LogPrintf("priority %.1f fee %s txid %s\n",
-                          dPriority , CFeeRate(iter->GetModifiedFee(), nTxSize).ToString(), tx.GetHash().ToString());
+
+            if (fUsingModified) {
+                // Since we always look at the best entry in mapModifiedTx,
+                // we must erase failed entries so that we can consider the
+                // next best entry on the next loop iteration
+                mapModifiedTx.get<ancestor_score>().erase(modit);
+                failedTx.insert(iter);
             }
 
-            inBlock.insert(iter);
+            ++nConsecutiveFailed;
 
-            // Add transactions that depend on this one to the priority queue
-            BOOST_FOREACH(CTxMemPool::txiter child, mempool.GetMemPoolChildren(iter))
-            {
-                if (fPriorityBlock) {
-                    waitPriIter wpiter = waitPriMap.find(child);
-                    if (wpiter != waitPriMap.end()) {
-                        vecPriority.push_back(TxCoinAgePriority(wpiter->second,child));
-                        std::push_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-                        waitPriMap.erase(wpiter);
-                    }
-                }
-                else {
-                    if (waitSet.count(child)) {
-                        clearedTxs.push(child);
-                        waitSet.erase(child);
-                    }
-                }
+            if (nConsecutiveFailed > MAX_CONSECUTIVE_FAILURES && nBlockSize > nBlockMaxSize - 1000) {
+                // Give up if we're close to full and haven't succeeded in a while
+                break;
             }
-
-            if(nBlockTx >= nTxMaxCount && nTxMaxCount > 0){
-                LogPrintf("skip tx=%s, over the max tx count set\n", tx.GetHash().ToString());
+            if (nTxMaxCount > 0 && nBlockTx >= nTxMaxCount) {
+                // Nothing fits anymore
                 break;
             }
+            continue;
         }
 
-        nLastBlockTx = nBlockTx;
-        nLastBlockSize = nBlockSize;
-        LogPrintf("CreateNewBlock(): total size %u txs: %u fees: %ld sigops %d\n", nBlockSize, nBlockTx, nFees, nBlockSigOps);
+        CTxMemPool::setEntries ancestors;
+        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        std::string dummy;
+        pool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
 
-        // Finally now that we know the fees add them to the mining reward!
-        pblock->vtx[0].vout[0].nValue += nFees;
+        onlyUnconfirmed(ancestors);
+        ancestors.insert(iter);
 
-        // Fill in header
-        pblock->hashPrevBlock  = pindexPrev->GetBlockHash();
-        UpdateTime(pblock, chainparams.GetConsensus(), pindexPrev);
-        pblock->nBits          = GetNextWorkRequired(pindexPrev, pblock, chainparams.GetConsensus());
-        pblock->nNonce         = 0;
-        pblocktemplate->vTxSigOpsCost[0] = GetLegacySigOpCount(pblock->vtx[0]);
-        pblocktemplate->vTxFees[0] = -nFees;
+        // Test if all tx's are Final
+        if (!TestPackageTransactions(ancestors)) {
+            if (fUsingModified) {
+                mapModifiedTx.get<ancestor_score>().erase(modit);
+                failedTx.insert(iter);
+            }
+            continue;
+        }
+
+        // This transaction will make it in; reset the failed counter.
+        nConsecutiveFailed = 0;
 
-        CValidationState state;
-        if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
-            throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+        // Package can be added. Sort the entries in a valid order.
+        std::vector<CTxMemPool::txiter> sortedEntries;
+        SortForBlock(ancestors, iter, sortedEntries);
+
+        for (size_t i=0; i<sortedEntries.size(); ++i) {
+            AddToBlock(sortedEntries[i]);
+            // Erase from the modified set, if present
+            mapModifiedTx.erase(sortedEntries[i]);
         }
+
+        if (packageFeeRate < minPackageFeeRate)
+            minPackageFeeRate = packageFeeRate;
+
+        // Update transactions that depend on each of these
+        UpdatePackagesForAdded(ancestors, mapModifiedTx);
     }
-    return pblocktemplate.release();
 }
 
-// bool BlockAssembler::isStillDependent(CTxMemPool::txiter iter)
-// {
-//     BOOST_FOREACH(CTxMemPool::txiter parent, mempool.GetMemPoolParents(iter))
-//     {
-//         if (!inBlock.count(parent)) {
-//             return true;
-//         }
-//     }
-//     return false;
-// }
-
-// void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
-// {
-//     for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
-//         // Only test txs not already in the block
-//         if (inBlock.count(*iit)) {
-//             testSet.erase(iit++);
-//         }
-//         else {
-//             iit++;
-//         }
-//     }
-// }
-
-// bool BlockAssembler::TestPackage(uint64_t packageSize, int64_t packageSigOpsCost)
-// {
-//     // TODO: switch to weight-based accounting for packages instead of vsize-based accounting.
-//     if (nBlockWeight + WITNESS_SCALE_FACTOR * packageSize >= nBlockMaxWeight)
-//         return false;
-//     if (nBlockSigOpsCost + packageSigOpsCost >= MAX_BLOCK_SIGOPS_COST)
-//         return false;
-//     return true;
-// }
-
-// // Perform transaction-level checks before adding to block:
-// // - transaction finality (locktime)
-// // - premature witness (in case segwit transactions are added to mempool before
-// //   segwit activation)
-// // - serialized size (in case -blockmaxsize is in use)
-// bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& package)
-// {
-//     uint64_t nPotentialBlockSize = nBlockSize; // only used with fNeedSizeAccounting
-//     BOOST_FOREACH (const CTxMemPool::txiter it, package) {
-//         if (!IsFinalTx(it->GetTx(), nHeight, nLockTimeCutoff))
-//             return false;
-//         if (!fIncludeWitness && !it->GetTx().wit.IsNull())
-//             return false;
-//         if (fNeedSizeAccounting) {
-//             uint64_t nTxSize = ::GetSerializeSize(it->GetTx(), SER_NETWORK, PROTOCOL_VERSION);
-//             if (nPotentialBlockSize + nTxSize >= nBlockMaxSize) {
-//                 return false;
-//             }
-//             nPotentialBlockSize += nTxSize;
-//         }
-//     }
-//     return true;
-// }
-
-// bool BlockAssembler::TestForBlock(CTxMemPool::txiter iter)
-// {
-//     if (nBlockWeight + iter->GetTxWeight() >= nBlockMaxWeight) {
-//         // If the block is so close to full that no more txs will fit
-//         // or if we've tried more than 50 times to fill remaining space
-//         // then flag that the block is finished
-//         if (nBlockWeight >  nBlockMaxWeight - 400 || lastFewTxs > 50) {
-//              blockFinished = true;
-//              return false;
-//         }
-//         // Once we're within 4000 weight of a full block, only look at 50 more txs
-//         // to try to fill the remaining space.
-//         if (nBlockWeight > nBlockMaxWeight - 4000) {
-//             lastFewTxs++;
-//         }
-//         return false;
-//     }
-
-//     if (fNeedSizeAccounting) {
-//         if (nBlockSize + ::GetSerializeSize(iter->GetTx(), SER_NETWORK, PROTOCOL_VERSION) >= nBlockMaxSize) {
-//             if (nBlockSize >  nBlockMaxSize - 100 || lastFewTxs > 50) {
-//                  blockFinished = true;
-//                  return false;
-//             }
-//             if (nBlockSize > nBlockMaxSize - 1000) {
-//                 lastFewTxs++;
-//             }
-//             return false;
-//         }
-//     }
-
-//     if (nBlockSigOpsCost + iter->GetSigOpCost() >= MAX_BLOCK_SIGOPS_COST) {
-//         // If the block has room for no more sig ops then
-//         // flag that the block is finished
-//         if (nBlockSigOpsCost > MAX_BLOCK_SIGOPS_COST - 8) {
-//             blockFinished = true;
-//             return false;
-//         }
-//         // Otherwise attempt to find another tx with fewer sigops
-//         // to put in the block.
-//         return false;
-//     }
-
-//     // Must check that lock times are still valid
-//     // This can be removed once MTP is always enforced
-//     // as long as reorgs keep the mempool consistent.
-//     if (!IsFinalTx(iter->GetTx(), nHeight, nLockTimeCutoff))
-//         return false;
-
-//     return true;
-// }
-
-// void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
-// {
-//     pblock->vtx.push_back(iter->GetTx());
-//     pblocktemplate->vTxFees.push_back(iter->GetFee());
-//     pblocktemplate->vTxSigOpsCost.push_back(iter->GetSigOpCost());
-//     if (fNeedSizeAccounting) {
-//         nBlockSize += ::GetSerializeSize(iter->GetTx(), SER_NETWORK, PROTOCOL_VERSION);
-//     }
-//     nBlockWeight += iter->GetTxWeight();
-//     ++nBlockTx;
-//     nBlockSigOpsCost += iter->GetSigOpCost();
-//     nFees += iter->GetFee();
-//     inBlock.insert(iter);
-
-//     bool fPrintPriority = GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
-//     if (fPrintPriority) {
-//         double dPriority = iter->GetPriority(nHeight);
-//         CAmount dummy;
-//         mempool.ApplyDeltas(iter->GetTx().GetHash(), dPriority, dummy);
-//         LogPrintf("priority %.1f fee %s txid %s\n",
-//                   dPriority,
-//                   CFeeRate(iter->GetModifiedFee(), iter->GetTxSize()).ToString(),
-//                   iter->GetTx().GetHash().ToString());
-//     }
-// }
-
-// void BlockAssembler::UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded,
-//         indexed_modified_transaction_set &mapModifiedTx)
-// {
-//     BOOST_FOREACH(const CTxMemPool::txiter it, alreadyAdded) {
-//         CTxMemPool::setEntries descendants;
-//         mempool.CalculateDescendants(it, descendants);
-//         // Insert all descendants (not yet in block) into the modified set
-//         BOOST_FOREACH(CTxMemPool::txiter desc, descendants) {
-//             if (alreadyAdded.count(desc))
-//                 continue;
-//             modtxiter mit = mapModifiedTx.find(desc);
-//             if (mit == mapModifiedTx.end()) {
-//                 CTxMemPoolModifiedEntry modEntry(desc);
-//                 modEntry.nSizeWithAncestors -= it->GetTxSize();
-//                 modEntry.nModFeesWithAncestors -= it->GetModifiedFee();
-//                 modEntry.nSigOpCostWithAncestors -= it->GetSigOpCost();
-//                 mapModifiedTx.insert(modEntry);
-//             } else {
-//                 mapModifiedTx.modify(mit, update_for_parent_inclusion(it));
-//             }
-//         }
-//     }
-// }
-
-// // Skip entries in mapTx that are already in a block or are present
-// // in mapModifiedTx (which implies that the mapTx ancestor state is
-// // stale due to ancestor inclusion in the block)
-// // Also skip transactions that we've already failed to add. This can happen if
-// // we consider a transaction in mapModifiedTx and it fails: we can then
-// // potentially consider it again while walking mapTx.  It's currently
-// // guaranteed to fail again, but as a belt-and-suspenders check we put it in
-// // failedTx and avoid re-evaluation, since the re-evaluation would be using
-// // cached size/sigops/fee values that are not actually correct.
-// bool BlockAssembler::SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set &mapModifiedTx, CTxMemPool::setEntries &failedTx)
-// {
-//     assert (it != mempool.mapTx.end());
-//     if (mapModifiedTx.count(it) || inBlock.count(it) || failedTx.count(it))
-//         return true;
-//     return false;
-// }
-
-// void BlockAssembler::SortForBlock(const CTxMemPool::setEntries& package, CTxMemPool::txiter entry, std::vector<CTxMemPool::txiter>& sortedEntries)
-// {
-//     // Sort package by ancestor count
-//     // If a transaction A depends on transaction B, then A's ancestor count
-//     // must be greater than B's.  So this is sufficient to validly order the
-//     // transactions for block inclusion.
-//     sortedEntries.clear();
-//     sortedEntries.insert(sortedEntries.begin(), package.begin(), package.end());
-//     std::sort(sortedEntries.begin(), sortedEntries.end(), CompareTxIterByAncestorCount());
-// }
-
-// // This transaction selection algorithm orders the mempool based
-// // on feerate of a transaction including all unconfirmed ancestors.
-// // Since we don't remove transactions from the mempool as we select them
-// // for block inclusion, we need an alternate method of updating the feerate
-// // of a transaction with its not-yet-selected ancestors as we go.
-// // This is accomplished by walking the in-mempool descendants of selected
-// // transactions and storing a temporary modified state in mapModifiedTxs.
-// // Each time through the loop, we compare the best transaction in
-// // mapModifiedTxs with the next transaction in the mempool to decide what
-// // transaction package to work on next.
-// void BlockAssembler::addPackageTxs()
-// {
-//     // mapModifiedTx will store sorted packages after they are modified
-//     // because some of their txs are already in the block
-//     indexed_modified_transaction_set mapModifiedTx;
-//     // Keep track of entries that failed inclusion, to avoid duplicate work
-//     CTxMemPool::setEntries failedTx;
-
-//     // Start by adding all descendants of previously added txs to mapModifiedTx
-//     // and modifying them for their already included ancestors
-//     UpdatePackagesForAdded(inBlock, mapModifiedTx);
-
-//     CTxMemPool::indexed_transaction_set::index<ancestor_score>::type::iterator mi = mempool.mapTx.get<ancestor_score>().begin();
-//     CTxMemPool::txiter iter;
-//     while (mi != mempool.mapTx.get<ancestor_score>().end() || !mapModifiedTx.empty())
-//     {
-//         // First try to find a new transaction in mapTx to evaluate.
-//         if (mi != mempool.mapTx.get<ancestor_score>().end() &&
-//                 SkipMapTxEntry(mempool.mapTx.project<0>(mi), mapModifiedTx, failedTx)) {
-//             ++mi;
-//             continue;
-//         }
-
-//         // Now that mi is not stale, determine which transaction to evaluate:
-//         // the next entry from mapTx, or the best from mapModifiedTx?
-//         bool fUsingModified = false;
-
-//         modtxscoreiter modit = mapModifiedTx.get<ancestor_score>().begin();
-//         if (mi == mempool.mapTx.get<ancestor_score>().end()) {
-//             // We're out of entries in mapTx; use the entry from mapModifiedTx
-//             iter = modit->iter;
-//             fUsingModified = true;
-//         } else {
-//             // Try to compare the mapTx entry to the mapModifiedTx entry
-//             iter = mempool.mapTx.project<0>(mi);
-//             if (modit != mapModifiedTx.get<ancestor_score>().end() &&
-//                     CompareModifiedEntry()(*modit, CTxMemPoolModifiedEntry(iter))) {
-//                 // The best entry in mapModifiedTx has higher score
-//                 // than the one from mapTx.
-//                 // Switch which transaction (package) to consider
-//                 iter = modit->iter;
-//                 fUsingModified = true;
-//             } else {
-//                 // Either no entry in mapModifiedTx, or it's worse than mapTx.
-//                 // Increment mi for the next loop iteration.
-//                 ++mi;
-//             }
-//         }
-
-//         // We skip mapTx entries that are inBlock, and mapModifiedTx shouldn't
-//         // contain anything that is inBlock.
-//         assert(!inBlock.count(iter));
-
-//         uint64_t packageSize = iter->GetSizeWithAncestors();
-//         CAmount packageFees = iter->GetModFeesWithAncestors();
-//         int64_t packageSigOpsCost = iter->GetSigOpCostWithAncestors();
-//         if (fUsingModified) {
-//             packageSize = modit->nSizeWithAncestors;
-//             packageFees = modit->nModFeesWithAncestors;
-//             packageSigOpsCost = modit->nSigOpCostWithAncestors;
-//         }
-
-//         if (packageFees < ::minRelayTxFee.GetFee(packageSize)) {
-//             // Everything else we might consider has a lower fee rate
-//             return;
-//         }
-
-//         if (!TestPackage(packageSize, packageSigOpsCost)) {
-//             if (fUsingModified) {
-//                 // Since we always look at the best entry in mapModifiedTx,
-//                 // we must erase failed entries so that we can consider the
-//                 // next best entry on the next loop iteration
-//                 mapModifiedTx.get<ancestor_score>().erase(modit);
-//                 failedTx.insert(iter);
-//             }
-//             continue;
-//         }
-
-//         CTxMemPool::setEntries ancestors;
-//         uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
-//         std::string dummy;
-//         mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
-
-//         onlyUnconfirmed(ancestors);
-//         ancestors.insert(iter);
-
-//         // Test if all tx's are Final
-//         if (!TestPackageTransactions(ancestors)) {
-//             if (fUsingModified) {
-//                 mapModifiedTx.get<ancestor_score>().erase(modit);
-//                 failedTx.insert(iter);
-//             }
-//             continue;
-//         }
-
-//         // Package can be added. Sort the entries in a valid order.
-//         vector<CTxMemPool::txiter> sortedEntries;
-//         SortForBlock(ancestors, iter, sortedEntries);
-
-//         for (size_t i=0; i<sortedEntries.size(); ++i) {
-//             AddToBlock(sortedEntries[i]);
-//             // Erase from the modified set, if present
-//             mapModifiedTx.erase(sortedEntries[i]);
-//         }
-
-//         // Update transactions that depend on each of these
-//         UpdatePackagesForAdded(ancestors, mapModifiedTx);
-//     }
-// }
-
-// void BlockAssembler::addPriorityTxs()
-// {
-//     // How much of the block should be dedicated to high-priority transactions,
-//     // included regardless of the fees they pay
-//     unsigned int nBlockPrioritySize = GetArg("-blockprioritysize", DEFAULT_BLOCK_PRIORITY_SIZE);
-//     nBlockPrioritySize = std::min(nBlockMaxSize, nBlockPrioritySize);
-
-//     if (nBlockPrioritySize == 0) {
-//         return;
-//     }
-
-//     bool fSizeAccounting = fNeedSizeAccounting;
-//     fNeedSizeAccounting = true;
-
-//     // This vector will be sorted into a priority queue:
-//     vector<TxCoinAgePriority> vecPriority;
-//     TxCoinAgePriorityCompare pricomparer;
-//     std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash> waitPriMap;
-//     typedef std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash>::iterator waitPriIter;
-//     double actualPriority = -1;
-
-//     vecPriority.reserve(mempool.mapTx.size());
-//     for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin();
-//          mi != mempool.mapTx.end(); ++mi)
-//     {
-//         double dPriority = mi->GetPriority(nHeight);
-//         CAmount dummy;
-//         mempool.ApplyDeltas(mi->GetTx().GetHash(), dPriority, dummy);
-//         vecPriority.push_back(TxCoinAgePriority(dPriority, mi));
-//     }
-//     std::make_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-
-//     CTxMemPool::txiter iter;
-//     while (!vecPriority.empty() && !blockFinished) { // add a tx from priority queue to fill the blockprioritysize
-//         iter = vecPriority.front().second;
-//         actualPriority = vecPriority.front().first;
-//         std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-//         vecPriority.pop_back();
-
-//         // If tx already in block, skip
-//         if (inBlock.count(iter)) {
-//             assert(false); // shouldn't happen for priority txs
-//             continue;
-//         }
-
-//         // cannot accept witness transactions into a non-witness block
-//         if (!fIncludeWitness && !iter->GetTx().wit.IsNull())
-//             continue;
-
-//         // If tx is dependent on other mempool txs which haven't yet been included
-//         // then put it in the waitSet
-//         if (isStillDependent(iter)) {
-//             waitPriMap.insert(std::make_pair(iter, actualPriority));
-//             continue;
-//         }
-
-//         // If this tx fits in the block add it, otherwise keep looping
-//         if (TestForBlock(iter)) {
-//             AddToBlock(iter);
-
-//             // If now that this txs is added we've surpassed our desired priority size
-//             // or have dropped below the AllowFreeThreshold, then we're done adding priority txs
-//             if (nBlockSize >= nBlockPrioritySize || !AllowFree(actualPriority)) {
-//                 break;
-//             }
-
-//             // This tx was successfully added, so
-//             // add transactions that depend on this one to the priority queue to try again
-//             BOOST_FOREACH(CTxMemPool::txiter child, mempool.GetMemPoolChildren(iter))
-//             {
-//                 waitPriIter wpiter = waitPriMap.find(child);
-//                 if (wpiter != waitPriMap.end()) {
-//                     vecPriority.push_back(TxCoinAgePriority(wpiter->second,child));
-//                     std::push_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
-//                     waitPriMap.erase(wpiter);
-//                 }
-//             }
-//         }
-//     }
-//     fNeedSizeAccounting = fSizeAccounting;
-// }
-
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
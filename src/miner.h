@@ -42,103 +42,121 @@ void GenerateBitcoins(bool fGenerate, int nThreads, const CChainParams& chainpar
 
 // Container for tracking updates to ancestor feerate as we include (parent)
 // transactions in a block
-// struct CTxMemPoolModifiedEntry {
-//     CTxMemPoolModifiedEntry(CTxMemPool::txiter entry)
-//     {
-//         iter = entry;
-//         nSizeWithAncestors = entry->GetSizeWithAncestors();
-//         nModFeesWithAncestors = entry->GetModFeesWithAncestors();
-//         nSigOpCostWithAncestors = entry->GetSigOpCostWithAncestors();
-//     }
-
-//     CTxMemPool::txiter iter;
-//     uint64_t nSizeWithAncestors;
-//     CAmount nModFeesWithAncestors;
-//     int64_t nSigOpCostWithAncestors;
-// };
+struct CTxMemPoolModifiedEntry {
+    CTxMemPoolModifiedEntry(CTxMemPool::txiter entry)
+    {
+        iter = entry;
+        nCountWithAncestors = entry->GetCountWithAncestors();
+        nSizeWithAncestors = entry->GetSizeWithAncestors();
+        nModFeesWithAncestors = entry->GetModFeesWithAncestors();
+        nSigOpCountWithAncestors = entry->GetSigOpCountWithAncestors();
+    }
+
+    CTxMemPool::txiter iter;
+    uint64_t nCountWithAncestors;
+    uint64_t nSizeWithAncestors;
+    CAmount nModFeesWithAncestors;
+    int64_t nSigOpCountWithAncestors;
+};
 
 /** Comparator for CTxMemPool::txiter objects.
  *  It simply compares the internal memory address of the CTxMemPoolEntry object
  *  pointed to. This means it has no meaning, and is only useful for using them
  *  as key in other indexes.
  */
-// struct CompareCTxMemPoolIter {
-//     bool operator()(const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) const
-//     {
-//         return &(*a) < &(*b);
-//     }
-// };
-
-// struct modifiedentry_iter {
-//     typedef CTxMemPool::txiter result_type;
-//     result_type operator() (const CTxMemPoolModifiedEntry &entry) const
-//     {
-//         return entry.iter;
-//     }
-// };
+struct CompareCTxMemPoolIter {
+    bool operator()(const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) const
+    {
+        return &(*a) < &(*b);
+    }
+};
+
+struct modifiedentry_iter {
+    typedef CTxMemPool::txiter result_type;
+    result_type operator() (const CTxMemPoolModifiedEntry &entry) const
+    {
+        return entry.iter;
+    }
+};
 
 // This matches the calculation in CompareTxMemPoolEntryByAncestorFee,
 // except operating on CTxMemPoolModifiedEntry.
-// TODO: refactor to avoid duplication of this logic.
-// struct CompareModifiedEntry {
-//     bool operator()(const CTxMemPoolModifiedEntry &a, const CTxMemPoolModifiedEntry &b)
-//     {
-//         double f1 = (double)a.nModFeesWithAncestors * b.nSizeWithAncestors;
-//         double f2 = (double)b.nModFeesWithAncestors * a.nSizeWithAncestors;
-//         if (f1 == f2) {
-//             return CTxMemPool::CompareIteratorByHash()(a.iter, b.iter);
-//         }
-//         return f1 > f2;
-//     }
-// };
+struct CompareModifiedEntry {
+    bool operator()(const CTxMemPoolModifiedEntry &a, const CTxMemPoolModifiedEntry &b) const
+    {
+        double f1 = (double)a.nModFeesWithAncestors * b.nSizeWithAncestors;
+        double f2 = (double)b.nModFeesWithAncestors * a.nSizeWithAncestors;
+        if (f1 == f2) {
+            return CTxMemPool::CompareIteratorByHash()(a.iter, b.iter);
+        }
+        return f1 > f2;
+    }
+};
+
+// Orders mapTx iterators like the ancestor_score index of the mempool.
+struct CompareTxIterByAncestorFee {
+    bool operator()(const CTxMemPool::txiter &a, const CTxMemPool::txiter &b) const
+    {
+        return CompareTxMemPoolEntryByAncestorFee()(*a, *b);
+    }
+};
 
 // A comparator that sorts transactions based on number of ancestors.
 // This is sufficient to sort an ancestor package in an order that is valid
 // to appear in a block.
-// struct CompareTxIterByAncestorCount {
-//     bool operator()(const CTxMemPool::txiter &a, const CTxMemPool::txiter &b)
-//     {
-//         if (a->GetCountWithAncestors() != b->GetCountWithAncestors())
-//             return a->GetCountWithAncestors() < b->GetCountWithAncestors();
-//         return CTxMemPool::CompareIteratorByHash()(a, b);
-//     }
-// };
-
-// typedef boost::multi_index_container<
-//     CTxMemPoolModifiedEntry,
-//     boost::multi_index::indexed_by<
-//         boost::multi_index::ordered_unique<
-//             modifiedentry_iter,
-//             CompareCTxMemPoolIter
-//         >,
-//         // sorted by modified ancestor fee rate
-//         boost::multi_index::ordered_non_unique<
-//             // Reuse same tag from CTxMemPool's similar index
-//             boost::multi_index::tag<ancestor_score>,
-//             boost::multi_index::identity<CTxMemPoolModifiedEntry>,
-//             CompareModifiedEntry
-//         >
-//     >
-// > indexed_modified_transaction_set;
-
-// typedef indexed_modified_transaction_set::nth_index<0>::type::iterator modtxiter;
-// typedef indexed_modified_transaction_set::index<ancestor_score>::type::iterator modtxscoreiter;
-
-// struct update_for_parent_inclusion
-// {
-//     update_for_parent_inclusion(CTxMemPool::txiter it) : iter(it) {}
-
-//     void operator() (CTxMemPoolModifiedEntry &e)
-//     {
-//         e.nModFeesWithAncestors -= iter->GetFee();
-//         e.nSizeWithAncestors -= iter->GetTxSize();
-//         e.nSigOpCostWithAncestors -= iter->GetSigOpCost();
-//     }
-
-//     CTxMemPool::txiter iter;
-// };
-
-/** Generate a new block, without valid proof-of-work */
+struct CompareTxIterByAncestorCount {
+    bool operator()(const CTxMemPool::txiter &a, const CTxMemPool::txiter &b) const
+    {
+        if (a->GetCountWithAncestors() != b->GetCountWithAncestors())
+            return a->GetCountWithAncestors() < b->GetCountWithAncestors();
+        return CTxMemPool::CompareIteratorByHash()(a, b);
+    }
+};
+
+typedef boost::multi_index_container<
+    CTxMemPoolModifiedEntry,
+    boost::multi_index::indexed_by<
+        boost::multi_index::ordered_unique<
+            modifiedentry_iter,
+            CompareCTxMemPoolIter
+        >,
+        // sorted by modified ancestor fee rate
+        boost::multi_index::ordered_non_unique<
+            // Reuse same tag from CTxMemPool's similar index
+            boost::multi_index::tag<ancestor_score>,
+            boost::multi_index::identity<CTxMemPoolModifiedEntry>,
+            CompareModifiedEntry
+        >
+    >
+> indexed_modified_transaction_set;
+
+typedef indexed_modified_transaction_set::nth_index<0>::type::iterator modtxiter;
+typedef indexed_modified_transaction_set::index<ancestor_score>::type::iterator modtxscoreiter;
+
+struct update_for_parent_inclusion
+{
+    update_for_parent_inclusion(CTxMemPool::txiter it) : iter(it) {}
+
+    void operator() (CTxMemPoolModifiedEntry &e)
+    {
+        e.nCountWithAncestors -= 1;
+        e.nModFeesWithAncestors -= iter->GetModifiedFee();
+        e.nSizeWithAncestors -= iter->GetTxSize();
+        e.nSigOpCountWithAncestors -= iter->GetSigOpCount();
+    }
+
+    CTxMemPool::txiter iter;
+};
+
+/** Generate a new block, without valid proof-of-work
+ *
+ *  The first -blockprioritysize bytes are filled by coin age priority, the
+ *  rest by the feerate of transaction packages, ie the transaction together
+ *  with its not yet included in-mempool ancestors. The assembler remembers
+ *  where it left off, so that UpdateNewBlock can add the packages that arrived
+ *  in the mempool since to the same template instead of selecting everything
+ *  again.
+ */
 class BlockAssembler
 {
 private:
@@ -147,16 +165,17 @@ private:
     // A convenience pointer that always refers to the CBlock in pblocktemplate
     CBlock* pblock;
 
+    // The mempool transactions are selected from
+    CTxMemPool& pool;
+
     // Configuration parameters for the block size
-    bool fIncludeWitness;
-    unsigned int nBlockMaxWeight, nBlockMaxSize, nTxMaxCount;
-    bool fNeedSizeAccounting;
+    unsigned int nBlockMaxSize, nBlockPrioritySize, nTxMaxCount;
+    bool fPrintPriority;
 
     // Information on the current status of the block
-    uint64_t nBlockWeight;
     uint64_t nBlockSize;
     uint64_t nBlockTx;
-    uint64_t nBlockSigOpsCost;
+    uint64_t nBlockSigOps;
     CAmount nFees;
     CTxMemPool::setEntries inBlock;
 
@@ -164,6 +183,16 @@ private:
     int nHeight;
     int64_t nLockTimeCutoff;
     const CChainParams& chainparams;
+    CBlockIndex* pindexPrev;
+
+    // Mempool state the block was last filled from, see UpdateNewBlock
+    uint64_t nLastEntrySequence;
+    unsigned int nLastTransactionsChanged;
+    // Lowest feerate of the packages in the block
+    CFeeRate minPackageFeeRate;
+    // Set when a package arrived that doesn't fit anymore but pays more than
+    // some in the block, a new template would take it instead
+    bool fStale;
 
     // Variables used for addPriorityTxs
     int lastFewTxs;
@@ -171,23 +200,42 @@ private:
 
 public:
     BlockAssembler(const CChainParams& chainparams);
+    BlockAssembler(const CChainParams& chainparams, CTxMemPool& poolIn);
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, const CSmartAddress &signingAddress);
+    /** Add the transactions that entered the mempool since the template
+     *  returned by the last CreateNewBlock was filled to it. Returns false,
+     *  leaving the template untouched, when it has to be created again
+     *  instead, eg after a new tip, after transactions left the mempool or
+     *  when a new package doesn't fit but pays more than one in the block. */
+    bool UpdateNewBlock(CBlockTemplate* pblocktemplateIn);
+
+    /** Only select the transactions of a template for a block at nHeightIn,
+     *  with an empty coinbase and without any chain context. */
+    CBlockTemplate* SelectTransactions(int nHeightIn, int64_t nLockTimeCutoffIn);
+    /** Add the transactions that entered the mempool since the template
+     *  returned by the last CreateNewBlock or SelectTransactions was filled,
+     *  and the coinbase value for their fees. Returns false like
+     *  UpdateNewBlock, but doesn't look at the chain. */
+    bool AddNewTransactions(CBlockTemplate* pblocktemplateIn);
 
 private:
     // utility functions
     /** Clear the block's state and prepare for assembling a new block */
     void resetBlock();
+    /** Start a template with an empty coinbase and fill it from the mempool */
+    void FillBlock(int nHeightIn, int64_t nLockTimeCutoffIn);
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
 
     // Methods for how to add transactions to a block.
     /** Add transactions based on tx "priority" */
     void addPriorityTxs();
-    /** Add transactions based on feerate including unconfirmed ancestors */
-    void addPackageTxs();
+    /** Add transactions based on feerate including unconfirmed ancestors,
+      * only looking at the ones added to the mempool after nSequenceFrom */
+    void addPackageTxs(uint64_t nSequenceFrom);
 
-    // helper function for addPriorityTxs
+    // helper functions for addPriorityTxs()
     /** Test if tx will still "fit" in the block */
     bool TestForBlock(CTxMemPool::txiter iter);
     /** Test if tx still has unconfirmed parents not yet in block */
@@ -197,20 +245,23 @@ private:
     /** Remove confirmed (inBlock) entries from given set */
     void onlyUnconfirmed(CTxMemPool::setEntries& testSet);
     /** Test if a new package would "fit" in the block */
-    bool TestPackage(uint64_t packageSize, int64_t packageSigOpsCost);
+    bool TestPackage(uint64_t packageSize, int64_t packageSigOps, uint64_t packageCount);
     /** Perform checks on each transaction in a package:
-      * locktime, premature-witness, serialized size (if necessary)
-      * These checks should always succeed, and they're here
+      * locktime
+      * This check should always succeed, and it's here
       * only as an extra check in case of suboptimal node configuration */
     bool TestPackageTransactions(const CTxMemPool::setEntries& package);
     /** Return true if given transaction from mapTx has already been evaluated,
       * or if the transaction's cached data in mapTx is incorrect. */
-    //bool SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set &mapModifiedTx, CTxMemPool::setEntries &failedTx);
+    bool SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set &mapModifiedTx, CTxMemPool::setEntries &failedTx);
     /** Sort the package in an order that is valid to appear in a block */
     void SortForBlock(const CTxMemPool::setEntries& package, CTxMemPool::txiter entry, std::vector<CTxMemPool::txiter>& sortedEntries);
     /** Add descendants of given transactions to mapModifiedTx with ancestor
       * state updated assuming given transactions are inBlock. */
-    //void UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx);
+    void UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx);
+    /** Add the entries that arrived after nSequenceFrom and have ancestors
+      * inBlock to mapModifiedTx, with the state of those ancestors removed. */
+    void UpdatePackagesForArrived(uint64_t nSequenceFrom, indexed_modified_transaction_set &mapModifiedTx);
 };
 
 /** Modify the extranonce in a block */
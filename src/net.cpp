@@ -659,11 +659,13 @@ void CNode::copyStats(CNodeStats &stats)
     {
         LOCK(cs_vSend);
         X(mapSendBytesPerMsgCmd);
+        X(mapSendHashTimePerMsgCmd);
         X(nSendBytes);
     }
     {
         LOCK(cs_vRecv);
         X(mapRecvBytesPerMsgCmd);
+        X(mapRecvHashTimePerMsgCmd);
         X(nRecvBytes);
     }
     X(fWhitelisted);
@@ -734,6 +736,10 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
             assert(i != mapRecvBytesPerMsgCmd.end());
             i->second += msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
 
+            // Finish the checksum here so the message handler only compares it
+            msg.GetMessageHash();
+            mapRecvHashTimePerMsgCmd[i->first] += msg.nHashTime;
+
             msg.nTime = nTimeMicros;
             complete = true;
         }
@@ -809,13 +815,27 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
         vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
     }
 
+    int64_t nTimeStart = GetTimeMicros();
     hasher.Write((const unsigned char*)pch, nCopy);
+    nHashTime += GetTimeMicros() - nTimeStart;
+
     memcpy(&vRecv[nDataPos], pch, nCopy);
     nDataPos += nCopy;
 
     return nCopy;
 }
 
+const uint256& CNetMessage::GetMessageHash() const
+{
+    assert(complete());
+    if (data_hash.IsNull()) {
+        int64_t nTimeStart = GetTimeMicros();
+        hasher.Finalize(data_hash.begin());
+        nHashTime += GetTimeMicros() - nTimeStart;
+    }
+    return data_hash;
+}
+
 
 // requires LOCK(cs_vSend)
 size_t CConnman::SocketSendData(CNode *pnode) const
@@ -2814,11 +2834,15 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     fPauseRecv = false;
     fPauseSend = false;
     nProcessQueueSize = 0;
+    nProcessMsgPreverified = 0;
     nPaymentMessagesInSync = 0;
 
-    BOOST_FOREACH(const std::string &msg, getAllNetMessageTypes())
+    BOOST_FOREACH(const std::string &msg, getAllNetMessageTypes()) {
         mapRecvBytesPerMsgCmd[msg] = 0;
+        mapRecvHashTimePerMsgCmd[msg] = 0;
+    }
     mapRecvBytesPerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = 0;
+    mapRecvHashTimePerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = 0;
 
     if (fLogIPs)
         LogPrint("net", "Added connection to %s peer=%d\n", addrName, id);
@@ -2890,19 +2914,21 @@ CDataStream CConnman::BeginMessage(CNode* pnode, int nVersion, int flags, const
     return {SER_NETWORK, (nVersion ? nVersion : pnode->GetSendVersion()) | flags, CMessageHeader(Params().MessageStart(), sCommand.c_str(), 0) };
 }
 
-void CConnman::EndMessage(CDataStream& strm)
+int64_t CConnman::EndMessage(CDataStream& strm)
 {
     // Set the size
     assert(strm.size () >= CMessageHeader::HEADER_SIZE);
     unsigned int nSize = strm.size() - CMessageHeader::HEADER_SIZE;
     WriteLE32((uint8_t*)&strm[CMessageHeader::MESSAGE_SIZE_OFFSET], nSize);
     // Set the checksum
+    int64_t nTimeStart = GetTimeMicros();
     uint256 hash = HashKeccak(strm.begin() + CMessageHeader::HEADER_SIZE, strm.end());
     memcpy((char*)&strm[CMessageHeader::CHECKSUM_OFFSET], hash.begin(), CMessageHeader::CHECKSUM_SIZE);
 
+    return GetTimeMicros() - nTimeStart;
 }
 
-void CConnman::PushMessage(CNode* pnode, CDataStream& strm, const std::string& sCommand)
+void CConnman::PushMessage(CNode* pnode, CDataStream& strm, const std::string& sCommand, int64_t nHashTime)
 {
     if(strm.empty())
         return;
@@ -2921,6 +2947,7 @@ void CConnman::PushMessage(CNode* pnode, CDataStream& strm, const std::string& s
 
         //log total amount of bytes per command
         pnode->mapSendBytesPerMsgCmd[sCommand] += strm.size();
+        pnode->mapSendHashTimePerMsgCmd[sCommand] += nHashTime;
         pnode->nSendSize += strm.size();
 
         if (pnode->nSendSize > nSendBufferMaxSize)
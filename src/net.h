@@ -199,8 +199,8 @@ public:
     {
         auto msg(BeginMessage(pnode, nVersion, flag, sCommand));
         ::SerializeMany(msg, msg.nType, msg.nVersion, std::forward<Args>(args)...);
-        EndMessage(msg);
-        PushMessage(pnode, msg, sCommand);
+        int64_t nHashTime = EndMessage(msg);
+        PushMessage(pnode, msg, sCommand, nHashTime);
     }
 
     template <typename... Args>
@@ -459,8 +459,8 @@ private:
 
     CDataStream BeginMessage(CNode* node, int nVersion, int flags, const std::string& sCommand);
 
-    void PushMessage(CNode* pnode, CDataStream& strm, const std::string& sCommand);
-    void EndMessage(CDataStream& strm);
+    void PushMessage(CNode* pnode, CDataStream& strm, const std::string& sCommand, int64_t nHashTime);
+    int64_t EndMessage(CDataStream& strm);
 
     // Network stats
     void RecordBytesRecv(uint64_t bytes);
@@ -643,6 +643,8 @@ public:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     uint64_t nRecvBytes;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    mapMsgCmdSize mapSendHashTimePerMsgCmd;
+    mapMsgCmdSize mapRecvHashTimePerMsgCmd;
     bool fWhitelisted;
     double dPingTime;
     double dPingWait;
@@ -656,7 +658,8 @@ public:
 
 class CNetMessage {
 private:
-    mutable CHash256 hasher;
+    // The payload checksum is computed while the data arrives, off the message handler thread
+    mutable CHashKeccak hasher;
     mutable uint256 data_hash;
 public:
     bool in_data;                   // parsing header (false) or data (true)
@@ -669,6 +672,7 @@ public:
     unsigned int nDataPos;
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
+    mutable int64_t nHashTime;      // time (in microseconds) spent hashing the payload
 
     CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
         hdrbuf.resize(24);
@@ -676,6 +680,7 @@ public:
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
+        nHashTime = 0;
     }
 
     bool complete() const
@@ -691,6 +696,8 @@ public:
         vRecv.SetVersion(nVersionIn);
     }
 
+    const uint256& GetMessageHash() const;
+
     int readHeader(const char *pch, unsigned int nBytes);
     int readData(const char *pch, unsigned int nBytes);
 };
@@ -715,6 +722,8 @@ public:
     CCriticalSection cs_vProcessMsg;
     std::list<CNetMessage> vProcessMsg;
     size_t nProcessQueueSize;
+    // Messages at the front of vProcessMsg whose signatures were checked in a batch, message handler thread only
+    size_t nProcessMsgPreverified;
 
     CCriticalSection cs_sendProcessing;
 
@@ -771,6 +780,9 @@ protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    // Time (in microseconds) spent on payload checksums per command
+    mapMsgCmdSize mapSendHashTimePerMsgCmd;
+    mapMsgCmdSize mapRecvHashTimePerMsgCmd;
 
 public:
     uint256 hashContinue;
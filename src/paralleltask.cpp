@@ -0,0 +1,91 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "paralleltask.h"
+
+#include "checkqueue.h"
+#include "sync.h"
+#include "util.h"
+#include "validation.h"
+
+// Tasks are coarse (one per range), don't let one worker take several of them
+static CCheckQueue<CParallelTask> paralleltaskqueue(1);
+// CCheckQueue supports a single master at a time
+static CCriticalSection cs_paralleltaskqueue;
+
+bool CParallelTask::operator()()
+{
+    try {
+        (*pfunc)();
+    } catch (...) {
+        boost::lock_guard<boost::mutex> lock(presult->mutex);
+        if (!presult->exception)
+            presult->exception = std::current_exception();
+        return false;
+    }
+    return true;
+}
+
+void ThreadParallelTask()
+{
+    RenameThread("smartcash-parallel");
+    paralleltaskqueue.Thread();
+}
+
+int GetParallelTaskThreads()
+{
+    return std::max(1, nScriptCheckThreads);
+}
+
+static void RunTasks(std::vector<CParallelTask>& vChecks, bool fParallel)
+{
+    if (!fParallel) {
+        BOOST_FOREACH(CParallelTask& check, vChecks)
+            if (!check())
+                break;
+        return;
+    }
+
+    CCheckQueueControl<CParallelTask> control(&paralleltaskqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+void RunParallelTasks(const std::vector<std::function<void()> >& vTasks, bool fWaitForQueue)
+{
+    CParallelTaskResult result;
+    std::vector<CParallelTask> vChecks;
+    vChecks.reserve(vTasks.size());
+    BOOST_FOREACH(const std::function<void()>& task, vTasks)
+        vChecks.push_back(CParallelTask(&task, &result));
+
+    if (!nScriptCheckThreads || vChecks.size() <= 1) {
+        RunTasks(vChecks, false);
+    } else if (fWaitForQueue) {
+        LOCK(cs_paralleltaskqueue);
+        RunTasks(vChecks, true);
+    } else {
+        TRY_LOCK(cs_paralleltaskqueue, lockQueue);
+        RunTasks(vChecks, lockQueue);
+    }
+
+    if (result.exception)
+        std::rethrow_exception(result.exception);
+}
+
+void ParallelForRanges(size_t nSize, int nParts, const std::function<void(size_t, size_t, int)>& func, bool fWaitForQueue)
+{
+    nParts = std::max(nParts, 1);
+    size_t nChunk = (nSize + nParts - 1) / nParts;
+
+    std::vector<std::function<void()> > vTasks;
+    vTasks.reserve(nParts);
+    for (int nPart = 0; nPart < nParts; ++nPart) {
+        size_t nBegin = std::min(nSize, nPart * nChunk);
+        size_t nEnd = std::min(nSize, nBegin + nChunk);
+        vTasks.push_back([&func, nBegin, nEnd, nPart] { func(nBegin, nEnd, nPart); });
+    }
+
+    RunParallelTasks(vTasks, fWaitForQueue);
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SMARTCASH_PARALLELTASK_H
+#define SMARTCASH_PARALLELTASK_H
+
+#include <exception>
+#include <functional>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+/** First exception thrown by any of the tasks of one RunParallelTasks call */
+struct CParallelTaskResult
+{
+    boost::mutex mutex;
+    std::exception_ptr exception;
+};
+
+/**
+ * Closure representing one task of a RunParallelTasks call, queued on the
+ * parallel task queue. Exceptions are caught and kept in the shared result
+ * so they can be rethrown on the calling thread.
+ */
+class CParallelTask
+{
+private:
+    const std::function<void()>* pfunc;
+    CParallelTaskResult* presult;
+
+public:
+    CParallelTask() : pfunc(NULL), presult(NULL) {}
+    CParallelTask(const std::function<void()>* pfuncIn, CParallelTaskResult* presultIn) : pfunc(pfuncIn), presult(presultIn) {}
+
+    bool operator()();
+
+    void swap(CParallelTask& check)
+    {
+        std::swap(pfunc, check.pfunc);
+        std::swap(presult, check.presult);
+    }
+};
+
+/** Worker thread of the parallel task queue, started with the script check threads */
+void ThreadParallelTask();
+
+/** Number of threads RunParallelTasks spreads its tasks over, including the caller */
+int GetParallelTaskThreads();
+
+/**
+ * Run all vTasks and return once they are done, the calling thread works on
+ * them too. Only one caller uses the queue at a time, if fWaitForQueue is
+ * false and the queue is busy the tasks run on the calling thread instead.
+ * If a task throws, the remaining ones may be skipped and the first exception
+ * is rethrown here.
+ */
+void RunParallelTasks(const std::vector<std::function<void()> >& vTasks, bool fWaitForQueue = true);
+
+/**
+ * Split [0, nSize) into nParts consecutive ranges and call func(nBegin, nEnd, nPart)
+ * for each of them with RunParallelTasks.
+ */
+void ParallelForRanges(size_t nSize, int nParts, const std::function<void(size_t, size_t, int)>& func, bool fWaitForQueue = true);
+
+#endif // SMARTCASH_PARALLELTASK_H
@@ -9,12 +9,32 @@
 #include "tinyformat.h"
 #include "utilstrencodings.h"
 #include "crypto/common.h"
+#include "crypto/keccak256.h"
 
 // uint256 CBlockHeader::GetHash() const
 // {
 //     return SerializeHash(*this);
 // }
 
+std::vector<uint256> ComputeBlockHeaderHashes(const std::vector<CBlockHeader>& headers)
+{
+    static_assert(CBlockHeader::HEADER_SIZE == KECCAK256_HEADER_SIZE, "unexpected block header size");
+
+    std::vector<uint256> vHashes(headers.size());
+
+    if (headers.empty())
+        return vHashes;
+
+    std::vector<unsigned char> vchHeaders(headers.size() * CBlockHeader::HEADER_SIZE);
+
+    for (size_t i = 0; i < headers.size(); i++)
+        memcpy(&vchHeaders[i * CBlockHeader::HEADER_SIZE], BEGIN(headers[i].nVersion), CBlockHeader::HEADER_SIZE);
+
+    Keccak256_80(vHashes[0].begin(), vchHeaders.data(), headers.size());
+
+    return vHashes;
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
@@ -24,6 +24,7 @@ class CBlockHeader
 public:
     // header
     static const int CURRENT_VERSION = 4;
+    static const size_t HEADER_SIZE = 80;
 
     int nVersion;
     uint256 hashPrevBlock;
@@ -166,6 +167,11 @@ public:
     }
 };
 
+/** Compute the hashes of a batch of headers with the multi-buffer Keccak
+ *  backend, in the order of the headers.
+ */
+std::vector<uint256> ComputeBlockHeaderHashes(const std::vector<CBlockHeader>& headers);
+
 /** Describes a place in the block chain to another node such that if the
  * other node doesn't have the same branch, it can find a recent common trunk.
  * The further back it is, the further before the fork it may be.
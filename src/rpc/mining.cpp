@@ -507,10 +507,17 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
     static CBlockTemplate* pblocktemplate;
+    // The assembler that filled pblocktemplate, it extends the template with
+    // new mempool transactions as long as the tip and the signing address
+    // stay the same
+    static std::unique_ptr<BlockAssembler> passembler;
+    static CSmartAddress signingAddressLast;
     if (pindexPrev != chainActive.Tip() ||
         (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
     {
-        // Clear pindexPrev so future calls make a new block, despite any failures from here on
+        // Keep the template to extend it, but clear pindexPrev so future calls
+        // make a new block, despite any failures from here on
+        bool fExtend = pblocktemplate && pindexPrev == chainActive.Tip() && signingAddress == signingAddressLast;
         pindexPrev = NULL;
 
         // Store the pindexBest used before CreateNewBlock, to avoid races
@@ -518,15 +525,30 @@ UniValue getblocktemplate(const UniValue& params, bool fHelp)
         CBlockIndex* pindexPrevNew = chainActive.Tip();
         nStart = GetTime();
 
-        // Create new block
-        if(pblocktemplate)
-        {
-            delete pblocktemplate;
-            pblocktemplate = NULL;
+        if (fExtend) {
+            try {
+                fExtend = passembler->UpdateNewBlock(pblocktemplate);
+            } catch (const std::runtime_error& e) {
+                // The template holds the transactions that failed validation,
+                // drop it and create a new one below
+                LogPrintf("getblocktemplate: %s\n", e.what());
+                fExtend = false;
+            }
+        }
+
+        if (!fExtend) {
+            // Create new block
+            if(pblocktemplate)
+            {
+                delete pblocktemplate;
+                pblocktemplate = NULL;
+            }
+            CScript scriptDummy = CScript() << OP_TRUE;
+            passembler.reset(new BlockAssembler(Params()));
+            pblocktemplate = passembler->CreateNewBlock(scriptDummy, signingAddress);
+            if (!pblocktemplate) throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
+            signingAddressLast = signingAddress;
         }
-        CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, signingAddress);
-        if (!pblocktemplate) throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
 
         // Need to update only after we know CreateNewBlock succeeded
         pindexPrev = pindexPrevNew;
@@ -5,12 +5,14 @@
 
 #include "base58.h"
 #include "clientversion.h"
+#include "indexbuilder.h"
 #include "init.h"
 #include "validation.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
 #include "timedata.h"
+#include "txdb.h"
 #include "util.h"
 #include "utilstrencodings.h"
 #include "warnings.h"
@@ -869,6 +871,7 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
             "{\n"
             "  \"balance\"  (string) The current balance in satoshis\n"
             "  \"received\"  (string) The total number of satoshis received (including change)\n"
+            "  \"height\"  (number) The block height the indexes are built up to\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"SwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
@@ -881,27 +884,28 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
+    if (!pindexbuilder)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Indexes not loaded");
 
     CAmount balance = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    // Sum the summaries of one block while the index builder moves on
+    LOCK(pindexbuilder->cs);
+
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressSummaryValue summary;
+        if (!GetAddressSummary((*it).first, (*it).second, summary)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += summary.balance;
+        received += summary.received;
     }
 
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("balance", balance));
     result.push_back(Pair("received", received));
+    result.push_back(Pair("height", pindexbuilder->GetBestHeight()));
 
     return result;
 
@@ -1039,17 +1043,62 @@ UniValue getspentinfo(const UniValue& params, bool fHelp)
 }
 
 
+/** Add the entries of an address list to a JSON array */
+static void AddressListToJSON(const std::vector<CAddressListEntry> &addressList, UniValue &result)
+{
+    for (std::vector<CAddressListEntry>::const_iterator it=addressList.begin(); it!=addressList.end(); it++) {
+
+        std::string address;
+        if (!getAddressFromIndex(it->type, it->hashBytes, address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        }
+
+        UniValue entry(UniValue::VOBJ);
+
+        entry.push_back(Pair("address", address));
+        entry.push_back(Pair("received", it->received));
+        entry.push_back(Pair("balance", it->balance));
+
+        result.push_back(entry);
+    }
+}
+
+/** Default and maximum number of addresses in one page of getaddresses */
+static const int DEFAULT_GETADDRESSES_PAGE_SIZE = 1000;
+static const int MAX_GETADDRESSES_PAGE_SIZE = 10000;
+
 UniValue getaddresses(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() > 2)
+    if (fHelp || params.size() > 4)
         throw runtime_error(
-            "getaddresses \"excludeZeroBalances\" \n"
-            "\nPrint a list of all addresses in the SmartCash blockchain.\n"
+            "getaddresses ( excludeZeroBalances blockHeight count \"cursor\" )\n"
+            "\nPrint a list of all addresses in the SmartCash blockchain sorted by balance.\n"
             "\nArguments:\n"
             "1. \"excludeZeroBalances\"  (bool, optional, default: true) If true, addresses with zero balance aren't included in the list. If false, they are.\n"
-            "1. \"blockHeight\"          (number, optional, default: current block height) The block height to generate the address list. 0 - blockHeight\n"
+            "2. \"blockHeight\"          (number, optional, default: -1) The block height to generate the address list. 0 - blockHeight\n"
+            "                          This scans the whole address index and returns the full list, -1 returns pages of the address balances\n"
+            "                          at the height the indexes are built up to.\n"
+            + strprintf("3. \"count\"                (number, optional, default: %d) The maximum number of addresses of the page, at most %d.\n"
+                        "                          Only with blockHeight -1.\n", DEFAULT_GETADDRESSES_PAGE_SIZE, MAX_GETADDRESSES_PAGE_SIZE) +
+            "4. \"cursor\"               (string, optional) The \"next\" cursor of the previous page to continue the list.\n"
+            "\nResult with blockHeight 0 or higher:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\"  (string) The address\n"
+            "    \"received\" (number) The total amount received by the address in satoshis\n"
+            "    \"balance\"  (number) The balance of the address in satoshis\n"
+            "  }, ...\n"
+            "]\n"
+            "\nResult with blockHeight -1:\n"
+            "{\n"
+            "  \"height\"     (number) The block height the address balances are at\n"
+            "  \"addresses\"  (array) The addresses of the page, see above\n"
+            "  \"next\"       (string) The cursor of the next page, missing on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresses", "true 100000")
+            + HelpExampleCli("getaddresses", "true -1 1000")
+            + HelpExampleCli("getaddresses", "true -1 1000 \"cursor\"")
             + HelpExampleRpc("getaddresses", "true")
         );
 
@@ -1057,32 +1106,77 @@ UniValue getaddresses(const UniValue& params, bool fHelp)
     int64_t nEndBlockHeight = params.size() > 1 ? params[1].get_int64() : -1;
     std::vector<CAddressListEntry> addressList;
 
-    if (!GetAddresses(addressList, nEndBlockHeight, fExcludeZeroBalances)) {
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Failed to load the address list.");
+    if (nEndBlockHeight >= 0) {
+
+        if (params.size() > 2)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Pages are only available with blockHeight -1");
+
+        if (!GetAddresses(addressList, nEndBlockHeight, fExcludeZeroBalances)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Failed to load the address list.");
+        }
+
+        std::sort(addressList.begin(), addressList.end(),
+            [](const CAddressListEntry & a, const CAddressListEntry & b) -> bool
+        {
+            return a.balance > b.balance;
+        });
+
+        UniValue result(UniValue::VARR);
+        AddressListToJSON(addressList, result);
+
+        return result;
     }
 
-    std::sort(addressList.begin(), addressList.end(),
-        [](const CAddressListEntry & a, const CAddressListEntry & b) -> bool
+    if (!pindexbuilder)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Indexes not loaded");
+
+    CAddressBalanceKey cursor;
+    std::unique_ptr<CDBSnapshot> snapshot;
+    int nHeight;
+
     {
-        return a.balance > b.balance;
-    });
+        // Read the balances of one block while the index builder moves on
+        LOCK(pindexbuilder->cs);
+        snapshot.reset(new CDBSnapshot(*pblocktree));
+        nHeight = pindexbuilder->GetBestHeight();
+    }
 
-    UniValue result(UniValue::VARR);
+    int nCount = params.size() > 2 ? params[2].get_int() : DEFAULT_GETADDRESSES_PAGE_SIZE;
 
-    for (std::vector<CAddressListEntry>::const_iterator it=addressList.begin(); it!=addressList.end(); it++) {
+    if (nCount <= 0 || nCount > MAX_GETADDRESSES_PAGE_SIZE)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("count must be between 1 and %d", MAX_GETADDRESSES_PAGE_SIZE));
 
-        std::string address;
-        if (!getAddressFromIndex(it->type, it->hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    if (params.size() > 3 && !params[3].get_str().empty()) {
+
+        std::string strCursor = params[3].get_str();
+
+        if (!IsHex(strCursor))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+
+        try {
+            CDataStream ssCursor(ParseHex(strCursor), SER_DISK, CLIENT_VERSION);
+            ssCursor >> cursor;
+        } catch (const std::exception&) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
         }
+    }
 
-        UniValue entry(UniValue::VOBJ);
+    UniValue result(UniValue::VOBJ);
+    UniValue addresses(UniValue::VARR);
 
-        entry.push_back(Pair("address", address));
-        entry.push_back(Pair("received", it->received));
-        entry.push_back(Pair("balance", it->balance));
+    if (!GetAddressBalances(addressList, cursor, nCount, fExcludeZeroBalances, snapshot.get())) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Failed to load the address list.");
+    }
 
-        result.push_back(entry);
+    result.push_back(Pair("height", nHeight));
+
+    AddressListToJSON(addressList, addresses);
+    result.push_back(Pair("addresses", addresses));
+
+    if (!cursor.IsNull()) {
+        CDataStream ssCursor(SER_DISK, CLIENT_VERSION);
+        ssCursor << cursor;
+        result.push_back(Pair("next", HexStr(ssCursor.begin(), ssCursor.end())));
     }
 
     return result;
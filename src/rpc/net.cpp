@@ -109,6 +109,14 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             "       \"addr\": n,             (numeric) The total bytes received aggregated by message type\n"
             "       ...\n"
             "    }\n"
+            "    \"hashtimesent_per_msg\": {\n"
+            "       \"addr\": n,             (numeric) The microseconds spent on payload checksums of sent messages by message type\n"
+            "       ...\n"
+            "    }\n"
+            "    \"hashtimerecv_per_msg\": {\n"
+            "       \"addr\": n,             (numeric) The microseconds spent on payload checksums of received messages by message type\n"
+            "       ...\n"
+            "    }\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -180,6 +188,20 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
         }
         obj.push_back(Pair("bytesrecv_per_msg", recvPerMsgCmd));
 
+        UniValue sendHashTimePerMsgCmd(UniValue::VOBJ);
+        BOOST_FOREACH(const mapMsgCmdSize::value_type &i, stats.mapSendHashTimePerMsgCmd) {
+            if (i.second > 0)
+                sendHashTimePerMsgCmd.push_back(Pair(i.first, i.second));
+        }
+        obj.push_back(Pair("hashtimesent_per_msg", sendHashTimePerMsgCmd));
+
+        UniValue recvHashTimePerMsgCmd(UniValue::VOBJ);
+        BOOST_FOREACH(const mapMsgCmdSize::value_type &i, stats.mapRecvHashTimePerMsgCmd) {
+            if (i.second > 0)
+                recvHashTimePerMsgCmd.push_back(Pair(i.first, i.second));
+        }
+        obj.push_back(Pair("hashtimerecv_per_msg", recvHashTimePerMsgCmd));
+
         ret.push_back(obj);
     }
 
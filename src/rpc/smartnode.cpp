@@ -189,7 +189,7 @@ UniValue smartnode(const UniValue& params, bool fHelp)
 
         int nCount;
         CSmartNodeWinners mnInfos;
-        mnodeman.GetNextSmartnodesInQueueForPayment(true, nCount, mnInfos);
+        mnodeman.GetNextSmartnodesInQueueForPayment(true, nCount, mnInfos, true);
 
         if (strMode == "qualify")
             return nCount;
@@ -615,8 +615,8 @@ UniValue smartnodelist(const UniValue& params, bool fHelp)
     if (strMode == "rank") {
         CSmartnodeMan::rank_pair_vec_t vSmartnodeRanks;
         mnodeman.GetSmartnodeRanks(vSmartnodeRanks);
-        BOOST_FOREACH(PAIRTYPE(int, CSmartnode)& s, vSmartnodeRanks) {
-            std::string strOutpoint = s.second.vin.prevout.ToStringShort();
+        BOOST_FOREACH(PAIRTYPE(int, COutPoint)& s, vSmartnodeRanks) {
+            std::string strOutpoint = s.second.ToStringShort();
             if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
             obj.push_back(Pair(strOutpoint, s.first));
         }
@@ -6,11 +6,13 @@
 #include "chain.h"
 #include "clientversion.h"
 #include "chainparams.h"
+#include "indexbuilder.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "validation.h"
 #include "smartnode/smartnodesync.h"
 #include "sapi/sapi.h"
+#include "sapi/sapi_cache.h"
 #include "sapi/sapi_validation.h"
 #include "streams.h"
 #include "sync.h"
@@ -91,6 +93,27 @@ static std::vector<evhttp_bound_socket *> boundSocketsSAPI;
 
 // Endpoint groups available for the SAPI
 static std::vector<SAPI::EndpointGroup*> endpointGroups;
+//! Periodic cleanup of the rate limited clients
+static struct event* eventLimitsCleanup = 0;
+
+/** Path component of the precompiled route table */
+struct CSAPIRouteNode
+{
+    struct Route
+    {
+        size_t nOrder;
+        const SAPI::Endpoint *endpoint;
+        // Position in the path and key of the path parameters
+        std::vector<std::pair<size_t, std::string>> vecParams;
+    };
+
+    std::map<std::string, CSAPIRouteNode> mapChildren;
+    std::unique_ptr<CSAPIRouteNode> paramChild;
+    std::vector<Route> vecRoutes;
+};
+
+//! Route table of all endpoints, by group prefix
+static std::map<std::string, CSAPIRouteNode> mapRoutes;
 
 std::vector<CSubNet> vecWhitelistedRange;
 
@@ -106,6 +129,91 @@ static void SplitPath(const std::string& str, std::vector<std::string>& parts,
     boost::split(parts, str, boost::is_any_of(delim));
 }
 
+/** Build the route table of all endpoint groups */
+static void SAPICompileRoutes()
+{
+    size_t nOrder = 0;
+
+    mapRoutes.clear();
+
+    for( auto group : endpointGroups ){
+
+        CSAPIRouteNode &groupNode = mapRoutes[group->prefix];
+
+        for( const SAPI::Endpoint &endpoint : group->endpoints ){
+
+            CSAPIRouteNode *node = &groupNode;
+            CSAPIRouteNode::Route route{nOrder++, &endpoint, {}};
+            std::vector<std::string> partsEndpoint;
+
+            // The root endpoint of the group /v1/<group> has no path components
+            if( !endpoint.path.empty() )
+                SplitPath(endpoint.path, partsEndpoint);
+
+            for( size_t i = 0; i < partsEndpoint.size(); i++ ){
+
+                const std::string &partStr = partsEndpoint[i];
+
+                // Check if a parameter is expected for this path component
+                if( partStr.size() >= 2 && partStr.front() == '{' && partStr.back() == '}' ){
+
+                    if( !node->paramChild )
+                        node->paramChild.reset(new CSAPIRouteNode());
+
+                    node = node->paramChild.get();
+                    route.vecParams.push_back(std::make_pair(i, partStr.substr(1, partStr.size() - 2)));
+                }else{
+                    node = &node->mapChildren[partStr];
+                }
+            }
+
+            node->vecRoutes.push_back(route);
+        }
+    }
+
+    LogPrint("sapi", "Compiled %d SAPI routes\n", nOrder);
+}
+
+static void SAPIMatchRoutes(const CSAPIRouteNode &node, const std::vector<std::string> &partsURI,
+                            size_t nPart, size_t nParts, std::vector<const CSAPIRouteNode::Route*> &vecMatches)
+{
+    if( nPart == nParts ){
+        for( const CSAPIRouteNode::Route &route : node.vecRoutes )
+            vecMatches.push_back(&route);
+        return;
+    }
+
+    auto it = node.mapChildren.find(partsURI[nPart]);
+
+    if( it != node.mapChildren.end() )
+        SAPIMatchRoutes(it->second, partsURI, nPart + 1, nParts, vecMatches);
+
+    if( node.paramChild )
+        SAPIMatchRoutes(*node.paramChild, partsURI, nPart + 1, nParts, vecMatches);
+}
+
+/** Collect the routes matching the path components, ordered like the endpoint declarations */
+static void SAPIMatchRoutes(const CSAPIRouteNode &groupNode, const std::vector<std::string> &partsURI,
+                            std::vector<const CSAPIRouteNode::Route*> &vecMatches)
+{
+    // Match /v1/<group>/<endpoint> and /v1/<group>/<endpoint>/
+    SAPIMatchRoutes(groupNode, partsURI, 0, partsURI.size(), vecMatches);
+
+    if( partsURI.size() && partsURI.back() == "" )
+        SAPIMatchRoutes(groupNode, partsURI, 0, partsURI.size() - 1, vecMatches);
+
+    std::sort(vecMatches.begin(), vecMatches.end(),
+              [](const CSAPIRouteNode::Route *a, const CSAPIRouteNode::Route *b) -> bool {
+        return a->nOrder < b->nOrder;
+    });
+}
+
+/** Callback of the periodic rate limit cleanup */
+static void sapi_limits_cleanup_cb(evutil_socket_t, short, void*)
+{
+    SAPI::Limits::CheckAndRemove();
+}
+
 /** Check if a network address is allowed to access the HTTP server */
 static bool ClientAllowed(const CNetAddr& netaddr)
 {
@@ -149,23 +257,22 @@ static void sapi_request_cb(struct evhttp_request* req, void* arg)
 
     if( !fWhitelisted ){
 
-        SAPI::Limits::Client * client = SAPI::Limits::GetClient(peer);
-
-        client->Request();
+        int64_t nTime = GetTimeMillis();
+        SAPI::Limits::Client client = SAPI::Limits::Request(peer, nTime);
 
         // Check the rate limiting for this peer
-        if( client->IsRequestLimited() ){
+        if( client.IsRequestLimited(nTime) ){
             sapiStatistics.request(peer, CSAPIStatistics::Blocked);
             SAPI::Result error(SAPI::RequestRateLimitExceeded,
-                               strprintf("Too many Requests. Requests locked for %d seconds.", 10 + client->GetRequestLockSeconds()));
+                               strprintf("Too many Requests. Requests locked for %d seconds.", client.GetRequestLockSeconds(nTime)));
             SAPI::Error(hreq.get(), HTTPStatus::FORBIDDEN, error);
             return;
         }
 
-        if( client->IsRessourceLimited() ){
+        if( client.IsRessourceLimited(nTime) ){
             sapiStatistics.request(peer, CSAPIStatistics::Blocked);
             SAPI::Result error(SAPI::RessourceRateLimitExceeded,
-                               strprintf("Too many Requests. Ressources locked for %d seconds.", 10 + client->GetRessourceLockSeconds()));
+                               strprintf("Too many Requests. Ressources locked for %d seconds.", client.GetRessourceLockSeconds(nTime)));
             SAPI::Error(hreq.get(), HTTPStatus::FORBIDDEN, error);
             return;
         }
@@ -199,78 +306,28 @@ static void sapi_request_cb(struct evhttp_request* req, void* arg)
     }
 
     std::vector<std::string> partsURI;
-    std::map<SAPI::Endpoint*, std::map<std::string, std::string>> mapPathMatch;
+    std::vector<const CSAPIRouteNode::Route*> vecMatches;
 
     SplitPath(strURI.substr(1), partsURI);
 
     std::string pathGroup = partsURI.front();
 
     // Get a subvector without the path group
-    partsURI = std::vector<std::string>( partsURI.begin() + 1, partsURI.end() );
-
-    for( auto group : endpointGroups ){
-
-        if( group->prefix != pathGroup )
-            continue;
-
-        for( SAPI::Endpoint &endpoint : group->endpoints ){
-
-            std::vector<std::string> partsEndpoint;
-            SplitPath(endpoint.path, partsEndpoint);
-
-            if( partsEndpoint.size() == 1 && partsEndpoint.back() == "" ){
-                // If the endpoint is the root one for the group /v1/<group>
-
-                // Match /v1/<group>/<endpoint> and /v1/<group>/<endpoint>/
-                if( !partsURI.size() || ( partsURI.size() == 1 && partsURI.back() == "" ) )
-                    mapPathMatch.insert(std::make_pair(&endpoint, std::map<std::string, std::string>()));
-
-            // Match /v1/<group>/<endpoint> and /v1/<group>/<endpoint>/
-            // For any other possible matching endpoints /v1/<group>/../..
-            }else if( ( partsURI.size() == partsEndpoint.size() + 1 && partsURI.back() == "" ) ||
-                        partsURI.size() == partsEndpoint.size() ){
-
-                bool fMatch = true;
-                std::map<std::string, std::string> mapPathParams;
-
-                for( size_t i = 0; i < partsURI.size(); i++ ){
-
-                    bool fParam = false;
-                    std::string partStr = i < partsEndpoint.size() ? partsEndpoint.at(i) : "";
-                    std::string &uriPartStr = partsURI.at(i);
+    partsURI.erase(partsURI.begin());
 
-                    // Check if a parameter is expected for this path component
-                    if( partStr.front() == '{' && partStr.back() == '}' )
-                        fParam = true;
+    auto group = mapRoutes.find(pathGroup);
 
-                    if( uriPartStr != partStr && !fParam ){
-                        fMatch = false;
-                        break;
-                    }else if( fParam ){
-
-                        // Filter the param key of the path part
-                        partStr = std::string(partStr.begin() + 1, partStr.end() - 1 );
-
-                        // Add the potential path parameter
-                        mapPathParams.insert(std::make_pair(partStr, uriPartStr));
-                    }
-                }
-
-                if( fMatch )
-                    mapPathMatch.insert(std::make_pair(&endpoint, mapPathParams));
-
-            }
-        }
-    }
+    if( group != mapRoutes.end() )
+        SAPIMatchRoutes(group->second, partsURI, vecMatches);
 
-    if( mapPathMatch.size() && hreq->GetRequestMethod() == HTTPRequest::OPTIONS){
+    if( vecMatches.size() && hreq->GetRequestMethod() == HTTPRequest::OPTIONS){
 
         sapiStatistics.request(peer, CSAPIStatistics::Valid);
 
         std::string strMethods = RequestMethodString(HTTPRequest::OPTIONS);
 
-        for( auto match : mapPathMatch ){
-            strMethods += ", " + RequestMethodString(match.first->method);
+        for( auto match : vecMatches ){
+            strMethods += ", " + RequestMethodString(match->endpoint->method);
         }
 
         // For options requests just answer with the allowed methods for this endpoint.
@@ -281,18 +338,23 @@ static void sapi_request_cb(struct evhttp_request* req, void* arg)
         return;
     }
 
-    auto fullMatch = std::find_if(mapPathMatch.begin(), mapPathMatch.end(),
-                                  [method](const std::pair<const SAPI::Endpoint *,
-                                  std::map<std::string, std::string>> &entry) -> bool{
-        return method == entry.first->method;
+    auto fullMatch = std::find_if(vecMatches.begin(), vecMatches.end(),
+                                  [method](const CSAPIRouteNode::Route *route) -> bool{
+        return method == route->endpoint->method;
     });
 
     // Dispatch to worker thread
-    if (fullMatch != mapPathMatch.end()) {
+    if (fullMatch != vecMatches.end()) {
 
         sapiStatistics.request(peer, CSAPIStatistics::Valid);
 
-        std::unique_ptr<SAPIWorkItem> item(new SAPIWorkItem(std::move(hreq), fullMatch->second, fullMatch->first, SAPIExecuteEndpoint));
+        const CSAPIRouteNode::Route *route = *fullMatch;
+        std::map<std::string, std::string> mapPathParams;
+
+        for( const auto &param : route->vecParams )
+            mapPathParams.insert(std::make_pair(param.second, partsURI.at(param.first)));
+
+        std::unique_ptr<SAPIWorkItem> item(new SAPIWorkItem(std::move(hreq), mapPathParams, route->endpoint, SAPIExecuteEndpoint));
         assert(workQueue);
         if (workQueue->Enqueue(item.get()))
             item.release(); /* if true, queue took ownership */
@@ -304,9 +366,6 @@ static void sapi_request_cb(struct evhttp_request* req, void* arg)
         sapiStatistics.request(peer, CSAPIStatistics::Invalid);
         SAPI::Error(hreq.get(), HTTPStatus::NOT_FOUND, "Invalid endpoint: " + strURI + " with method: " + RequestMethodString(hreq->GetRequestMethod()) + " See: IP:8080/v1/client/help");
     }
-
-    // Clean up rate limits
-    SAPI::Limits::CheckAndRemove();
 }
 
 /** Callback to reject SAPI requests after shutdown. */
@@ -434,6 +493,26 @@ bool InitSAPIServer()
         return false;
     }
 
+    endpointGroups = {
+        &clientEndpoints,
+        &statisticsEndpoints,
+        &blockchainEndpoints,
+        &addressEndpoints,
+        &transactionEndpoints,
+        &smartnodeEndpoints,
+        &smartrewardsEndpoints,
+        &termrewardsEndpoints
+    };
+
+    SAPICompileRoutes();
+
+    // Remove idle clients from the rate limits periodically instead of per request
+    struct timeval tvCleanup;
+    tvCleanup.tv_sec = SAPI::Limits::nClientCleanupIntervalMs / 1000;
+    tvCleanup.tv_usec = 0;
+    eventLimitsCleanup = event_new(base, -1, EV_PERSIST, sapi_limits_cleanup_cb, NULL);
+    event_add(eventLimitsCleanup, &tvCleanup);
+
     LogPrint("sapi", "Initialized SAPI server\n");
     int workQueueDepth = std::max((long)GetArg("-sapiworkqueue", DEFAULT_SAPI_WORKQUEUE), 1L);
     LogPrintf("SAPI: creating work queue of depth %d\n", workQueueDepth);
@@ -469,6 +548,9 @@ void InterruptSAPIServer()
         // Reject requests on current connections
         evhttp_set_gencb(eventSAPI, sapi_reject_request_cb, NULL);
     }
+    // Let the event loop exit once the pending requests are answered
+    if (eventLimitsCleanup)
+        event_del(eventLimitsCleanup);
     if (workQueue)
         workQueue->Interrupt();
 }
@@ -499,6 +581,10 @@ void StopSAPIServer()
             threadSAPI.join();
         }
     }
+    if (eventLimitsCleanup) {
+        event_free(eventLimitsCleanup);
+        eventLimitsCleanup = 0;
+    }
     if (eventSAPI) {
         evhttp_free(eventSAPI);
         eventSAPI = 0;
@@ -585,16 +671,10 @@ bool StartSAPI()
     SAPI::versionSubPath = strprintf("/v%d", SAPI_VERSION_MAJOR);
     SAPI::versionString = strprintf("%d.%d", SAPI_VERSION_MAJOR, SAPI_VERSION_MINOR);
 
-    endpointGroups = {
-        &clientEndpoints,
-        &statisticsEndpoints,
-        &blockchainEndpoints,
-        &addressEndpoints,
-        &transactionEndpoints,
-        &smartnodeEndpoints,
-        &smartrewardsEndpoints,
-        &termrewardsEndpoints
-    };
+    int64_t nCacheSize = std::max(GetArg("-sapicachesize", DEFAULT_SAPI_CACHE_SIZE), (int64_t)0);
+    int64_t nCacheDepth = std::max(GetArg("-sapicachedepth", DEFAULT_SAPI_CACHE_DEPTH), (int64_t)0);
+    sapiCache.SetLimits(nCacheSize * 1024 * 1024, nCacheDepth);
+    RegisterValidationInterface(&sapiCache);
 
     return true;
 }
@@ -606,7 +686,8 @@ void InterruptSAPI()
 
 void StopSAPI()
 {
-    // Nothing to do here yet.
+    UnregisterValidationInterface(&sapiCache);
+    sapiCache.Clear();
 }
 
 static bool SAPIValidateBody(HTTPRequest *req, const SAPI::Endpoint *endpoint, UniValue &bodyParameter)
@@ -698,6 +779,9 @@ void SAPI::AddDefaultHeaders(HTTPRequest* req)
     req->WriteHeader("Client-Version", strClientVersion);
     req->WriteHeader("SAPI-Version", SAPI::versionString);
     req->WriteHeader("Access-Control-Allow-Origin", "*");
+    // The indexes are built behind the chain tip, let clients see how far
+    if (pindexbuilder)
+        req->WriteHeader("Index-Height", strprintf("%d", pindexbuilder->GetBestHeight()));
 }
 
 bool SAPI::Error(HTTPRequest* req, HTTPStatus::Codes status, const std::vector<SAPI::Result> &errors)
@@ -768,6 +852,9 @@ CSAPIStatistics::CSAPIStatistics()
     nMaxRequestsPerHour = 0;
     nMaxClientsPerHour = 0;
 
+    nCacheHits = 0;
+    nCacheMisses = 0;
+
     init();
 }
 
@@ -844,6 +931,16 @@ void CSAPIStatistics::request(CNetAddr &address, RequestType type)
 
 }
 
+void CSAPIStatistics::cacheRequest(bool fHit)
+{
+    LOCK(cs_requests);
+
+    if( fHit )
+        ++nCacheHits;
+    else
+        ++nCacheMisses;
+}
+
 void CSAPIStatistics::reset()
 {
     vecRestarts.push_back(GetTime());
@@ -871,6 +968,13 @@ UniValue CSAPIStatistics::ToUniValue()
     obj.pushKV("maxRequestsPerHour", GetMaxRequestsPerHour() );
     obj.pushKV("maxClientsPerHour", GetMaxClientsPerHour() );
 
+    UniValue cache(UniValue::VOBJ);
+    cache.pushKV("hits", GetCacheHits());
+    cache.pushKV("misses", GetCacheMisses());
+    cache.pushKV("entries", static_cast<uint64_t>(sapiCache.GetCount()));
+    cache.pushKV("size", static_cast<uint64_t>(sapiCache.GetSize()));
+    obj.pushKV("cache", cache);
+
     int nIndex = nLastHour;
 
     for( int i=0;i<nCountLastHours;i++){
@@ -73,6 +73,7 @@ enum Codes{
     /* address errors */
     NoDepositAvailble = 4000,
     NoUtxosAvailble,
+    InvalidCursor,
     /* transaction errors */
     TxDecodeFailed = 5000,
     TxNotSpecified,
@@ -114,6 +115,7 @@ namespace Keys{
     const std::string protocol = "protocol";
     const std::string status = "status";
     const std::string direction = "direction";
+    const std::string cursor = "cursor";
 }
 
 namespace Validation{
@@ -256,16 +258,17 @@ namespace Limits {
 
     const int64_t nRequestsPerInterval = 100;
     const int64_t nRequestIntervalMs = 1000;
-    const int64_t nClientRemovalMs = 1 * 1000;
+    const int64_t nRequestLockMs = 10 * 1000;
+    const int64_t nClientRemovalMs = 60 * 1000;
+    const int64_t nClientCleanupIntervalMs = 30 * 1000;
+    const size_t nClientShards = 16;
 
+    /** Token bucket of a single client, only accessed with its shard locked. */
     class Client{
 
-        CCriticalSection cs;
-
         double nRemainingRequests;
         int64_t nLastRequestTime;
 
-        int64_t nThrottling;
         int64_t nRequestsLimitUnlock;
         int64_t nRessourcesLimitUnlock;
 
@@ -274,20 +277,21 @@ namespace Limits {
         Client() {
             nRemainingRequests = nRequestsPerInterval;
             nLastRequestTime = 0;
-            nThrottling = -1;
             nRequestsLimitUnlock = -1;
             nRessourcesLimitUnlock = -1;
         }
-        void Request();
-        bool IsRequestLimited();
-        bool IsRessourceLimited();
-        bool IsLimited();
-        int64_t GetRequestLockSeconds();
-        int64_t GetRessourceLockSeconds();
-        bool CheckAndRemove();
+        void Request(int64_t nTime);
+        bool IsRequestLimited(int64_t nTime) const;
+        bool IsRessourceLimited(int64_t nTime) const;
+        bool IsLimited(int64_t nTime) const;
+        int64_t GetRequestLockSeconds(int64_t nTime) const;
+        int64_t GetRessourceLockSeconds(int64_t nTime) const;
+        bool CheckAndRemove(int64_t nTime) const;
     };
 
-    Client *GetClient( const CService &peer );
+    /** Count a request of the peer and return a snapshot of its limits afterwards. */
+    Client Request(const CNetAddr &peer, int64_t nTime);
+    /** Drop the clients which are idle and not limited anymore. */
     void CheckAndRemove();
 }
 
@@ -352,8 +356,6 @@ void WriteReply(HTTPRequest *req, const std::string &str);
 
 bool CheckWarmup(HTTPRequest* req);
 
-SAPI::Limits::Client *GetClientLimiter(const CService &peer);
-
 int64_t GetStartTime();
 
 }
@@ -456,6 +458,10 @@ class CSAPIStatistics
     uint64_t nMaxRequestsPerHour;
     uint64_t nMaxClientsPerHour;
 
+    // Response cache usage since the start, not stored in the flat db.
+    uint64_t nCacheHits;
+    uint64_t nCacheMisses;
+
     std::set<CNetAddr> setCurrentClients;
     std::vector<CSAPIRequestCount> vecRequests;
 
@@ -490,6 +496,7 @@ public:
 
     void init();
     void request(CNetAddr& address, RequestType type);
+    void cacheRequest(bool fHit);
     void reset();
 
     int GetCurrentHour();
@@ -502,6 +509,9 @@ public:
     uint64_t GetMaxRequestsPerHour(){ return nMaxRequestsPerHour; }
     uint64_t GetMaxClientsPerHour(){ return nMaxClientsPerHour; }
 
+    uint64_t GetCacheHits(){ return nCacheHits; }
+    uint64_t GetCacheMisses(){ return nCacheMisses; }
+
     UniValue ToUniValue();
     std::string ToString() const;
 
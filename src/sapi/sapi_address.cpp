@@ -7,6 +7,7 @@
 
 #include <algorithm>
 #include "base58.h"
+#include "clientversion.h"
 #include "rpc/client.h"
 #include "sapi_validation.h"
 #include "sapi/sapi_address.h"
@@ -48,51 +49,11 @@ bool spendingSort(std::pair<CAddressIndexKey, CAmount> a,
 }
 
 
-bool IsTimeLocked(HTTPRequest* req, int blockHeight, const uint256 &txhash, const CSmartAddress &address, bool &locked) {
-    // Get block
-    CBlock block;
-    CBlockIndex* pBlockindex = chainActive[blockHeight];
-    if (!ReadBlockFromDisk(block, pBlockindex, Params().GetConsensus())) {
-        return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk.");
-    }
-
-    // Find TX inside the block
-    auto tx = std::find_if(block.vtx.begin(), block.vtx.end(), [&txhash] (const CTransaction &t) {
-        return txhash == t.GetHash();
-    });
-
-    if (tx == block.vtx.end()) {
-        return SAPI::Error(req, SAPI::TxNotFound, "Can't find Tx ID in block");
-    }
-
-    // Find output based on the address
-    auto vout = std::find_if(tx->vout.begin(), tx->vout.end(), [&address] (const CTxOut &output) {
-        CTxDestination addr;
-        if (!ExtractDestination(output.scriptPubKey, addr)) {
-            return false;
-        }
-        return CSmartAddress(addr) == address;
-    });
-
-    locked = false;
-
-    // If no output script matched destination address, just don't consider it locked
-    if (vout == tx->vout.end()) {
-        return true;
-    }
-
-    uint32_t nLockTime = vout->GetLockTime();
-    if (nLockTime) {
-        int nCurrentHeight = chainActive.Height();
-        int64_t nCurrentTime = chainActive.Tip() ? chainActive.Tip()->GetMedianTimePast() : GetTime();
-        if ((nLockTime < LOCKTIME_THRESHOLD && nCurrentHeight < nLockTime ) ||
-            (nLockTime >= LOCKTIME_THRESHOLD && nCurrentTime < nLockTime )) {
-            // Time locked transaction that has not expired yet
-            locked = true;
-        }
-    }
-
-    return true;
+static void GetLockTimeReference(int &nHeight, int64_t &nTime)
+{
+    LOCK(cs_main);
+    nHeight = chainActive.Height();
+    nTime = chainActive.Tip() ? chainActive.Tip()->GetMedianTimePast() : GetTime();
 }
 
 
@@ -134,8 +95,9 @@ SAPI::EndpointGroup addressEndpoints = {
             "unspent", HTTPRequest::POST, UniValue::VOBJ, address_utxos,
             {
                 SAPI::BodyParameter(SAPI::Keys::address,        new SAPI::Validation::SmartCashAddress()),
-                SAPI::BodyParameter(SAPI::Keys::pageNumber,     new SAPI::Validation::IntRange(1,INT_MAX)),
-                SAPI::BodyParameter(SAPI::Keys::pageSize,       new SAPI::Validation::IntRange(1,1000))
+                SAPI::BodyParameter(SAPI::Keys::pageNumber,     new SAPI::Validation::IntRange(1,INT_MAX), true),
+                SAPI::BodyParameter(SAPI::Keys::pageSize,       new SAPI::Validation::IntRange(1,1000)),
+                SAPI::BodyParameter(SAPI::Keys::cursor,         new SAPI::Validation::HexString(), true)
             }
         },
         {
@@ -160,10 +122,11 @@ SAPI::EndpointGroup addressEndpoints = {
             "transactions", HTTPRequest::POST, UniValue::VOBJ, address_transactions,
             {
                 SAPI::BodyParameter(SAPI::Keys::address,     new SAPI::Validation::SmartCashAddress()),
-                SAPI::BodyParameter(SAPI::Keys::pageNumber,  new SAPI::Validation::IntRange(1,INT_MAX)),
+                SAPI::BodyParameter(SAPI::Keys::pageNumber,  new SAPI::Validation::IntRange(1,INT_MAX), true),
                 SAPI::BodyParameter(SAPI::Keys::pageSize,    new SAPI::Validation::IntRange(1,100)),
                 SAPI::BodyParameter(SAPI::Keys::ascending,   new SAPI::Validation::Bool(), true),
-                SAPI::BodyParameter(SAPI::Keys::direction,   new SAPI::Validation::TxDirection(), true)
+                SAPI::BodyParameter(SAPI::Keys::direction,   new SAPI::Validation::TxDirection(), true),
+                SAPI::BodyParameter(SAPI::Keys::cursor,      new SAPI::Validation::HexString(), true)
             }
         }
     }
@@ -192,40 +155,32 @@ static bool GetAddressesBalances(HTTPRequest* req,
             continue;
         }
 
-        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        CAddressSummaryValue summary;
 
-        if (!GetAddressIndex(hashBytes, type, addressIndex)) {
+        if (!GetAddressSummary(hashBytes, type, summary)) {
             code = SAPI::AddressNotFound;
             std::string message = "No information available for " + addrStr;
             errors.push_back(SAPI::Result(code, message));
             continue;
         }
 
-        CAmount balance = 0;
-        CAmount locked = 0;
-        CAmount received = 0;
-        CAmount unconfirmed = 0;
-
-        for (const auto &addr : addressIndex) {
-            const auto &key = addr.first;
-            const auto &value = addr.second;
+        int nLockHeight;
+        int64_t nLockTime;
+        GetLockTimeReference(nLockHeight, nLockTime);
 
-            // Figure out if utxo is spendable (i.e. not time locked)
-            bool fLocked = false;
-            if (!IsTimeLocked(req, key.blockHeight, key.txhash, address, fLocked)) {
-                return false;
-            }
-
-            if (fLocked) {
-                locked += value;
-            }
+        CAmount locked = 0;
 
-            if (value > 0) {
-                received += value;
-            }
-            balance += value;
+        if (!GetAddressLocked(hashBytes, type, nLockHeight, nLockTime, locked)) {
+            code = SAPI::AddressNotFound;
+            std::string message = "No information available for " + addrStr;
+            errors.push_back(SAPI::Result(code, message));
+            continue;
         }
 
+        CAmount balance = summary.balance;
+        CAmount received = summary.received;
+        CAmount unconfirmed = 0;
+
         std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > mempoolDelta;
         std::vector<std::pair<uint160,int>> vecAddresses = {std::make_pair(hashBytes,type)};
         if (mempool.getAddressIndex(vecAddresses, mempoolDelta)) {
@@ -263,9 +218,44 @@ static bool GetAddressesBalances(HTTPRequest* req,
     return true;
 }
 
+/** The cursor of a page is the position of its first transaction */
+static std::string EncodeTxCursor(const CAddressIndexIteratorTxKey &key)
+{
+    CDataStream ssCursor(SER_DISK, CLIENT_VERSION);
+    ssCursor << key;
+    return HexStr(ssCursor.begin(), ssCursor.end());
+}
+
+static bool DecodeTxCursor(const std::string &strCursor, const CBitcoinAddress& address, CAddressIndexIteratorTxKey &key)
+{
+    uint160 hashBytes;
+    int type = 0;
+
+    if (!address.GetIndexKey(hashBytes, type))
+        return false;
+
+    try {
+        CDataStream ssCursor(ParseHex(strCursor), SER_DISK, CLIENT_VERSION);
+        ssCursor >> key;
+        if (!ssCursor.empty())
+            return false;
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    // Don't allow to continue with the transactions of another address
+    return key.type == static_cast<unsigned int>(type) && key.hashBytes == hashBytes;
+}
+
+/**
+ * Read a page of the transactions of an address, at the start transaction if it isn't null or at pageNum otherwise.
+ * pageNum is legacy paging, it walks all transactions of the previous pages. The "next" cursor of a reply continues
+ * without that.
+ */
 static bool GetAddressesTransactions(HTTPRequest* req, std::string addrStr,
     std::vector<std::tuple<uint256, int, CAmount>> &addressTxs, int64_t pageNum, int64_t pageSize,
-    bool ascending, int64_t &totalNumTxs)
+    bool ascending, int64_t &totalNumTxs,
+    const CAddressIndexIteratorTxKey &start = CAddressIndexIteratorTxKey(), CAddressIndexIteratorTxKey *pnext = NULL)
 {
     addressTxs.clear();
 
@@ -277,42 +267,39 @@ static bool GetAddressesTransactions(HTTPRequest* req, std::string addrStr,
         return SAPI::Error(req, SAPI::InvalidSmartCashAddress, "Invalid address: " + addrStr);
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount>> addressIndex;
+    CAddressSummaryValue summary;
 
-    if (!GetAddressIndex(hashBytes, type, addressIndex)) {
+    if (!GetAddressSummary(hashBytes, type, summary)) {
         return SAPI::Error(req, SAPI::AddressNotFound, "No information available for " + addrStr);
     }
 
-    if (!ascending) {
-        // Reverse index from newest to oldest transactions
-        std::reverse(addressIndex.begin(), addressIndex.end());
+    totalNumTxs = summary.nTxCount;
+
+    if (!totalNumTxs || pageSize < 1)
+        return true;
+
+    int nTxOffset = -1;
+
+    if (start.IsNull()) {
+
+        if (pageNum < 1)
+            return true;
+
+        // Only walk the index entries of the requested page
+        nTxOffset = static_cast<int>((pageNum - 1) * pageSize);
+
+        if (nTxOffset >= totalNumTxs)
+            return true;
     }
 
-    totalNumTxs = 0;
-    int nIndexOffset = static_cast<int>((pageNum - 1) * pageSize);
-    auto tx = addressIndex.begin();
-    while (tx != addressIndex.end()) {
-        // If we have multiple entries for the same tx, add up all amounts
-        auto found = std::find_if(addressTxs.begin(), addressTxs.end(),
-            [&tx] (const std::tuple<uint256, int, CAmount> &t) {
-                return std::get<0>(t) == tx->first.txhash;
-        });
-
-        if (found == addressTxs.end()) {
-            if ((std::distance(addressIndex.begin(), tx) >= nIndexOffset) && static_cast<int64_t>(addressTxs.size()) < pageSize) {
-                addressTxs.emplace_back(tx->first.txhash, tx->first.blockHeight, tx->second);
-            }
-            totalNumTxs++;
-        } else {
-            std::get<2>(*found) += tx->second;
-        }
-        tx++;
+    if (!GetAddressTransactions(hashBytes, type, addressTxs, start, nTxOffset, static_cast<int>(pageSize), !ascending, pnext)) {
+        return SAPI::Error(req, SAPI::AddressNotFound, "No information available for " + addrStr);
     }
 
     return true;
 }
 
-static bool GetUTXOCount(HTTPRequest* req, const CBitcoinAddress& address, int &count, CAddressUnspentKey &lastIndex){
+static bool GetUTXOSummary(HTTPRequest* req, const CBitcoinAddress& address, CAddressUnspentSummaryValue &summary, CAddressUnspentKey &lastIndex){
 
     uint160 hashBytes;
     int type = 0;
@@ -321,13 +308,42 @@ static bool GetUTXOCount(HTTPRequest* req, const CBitcoinAddress& address, int &
         return Error(req, SAPI::InvalidSmartCashAddress, "Invalid address");
     }
 
-    if (!GetAddressUnspentCount(hashBytes, type, count, lastIndex)) {
+    if (!GetAddressUnspentSummary(hashBytes, type, summary, lastIndex)) {
         return Error(req, SAPI::AddressNotFound, "No information available for address");
     }
 
     return true;
 }
 
+/** The cursor of a page is the key of its first output */
+static std::string EncodeUTXOCursor(const CAddressUnspentKey &key)
+{
+    CDataStream ssCursor(SER_DISK, CLIENT_VERSION);
+    ssCursor << key;
+    return HexStr(ssCursor.begin(), ssCursor.end());
+}
+
+static bool DecodeUTXOCursor(const std::string &strCursor, const CBitcoinAddress& address, CAddressUnspentKey &key)
+{
+    uint160 hashBytes;
+    int type = 0;
+
+    if (!address.GetIndexKey(hashBytes, type))
+        return false;
+
+    try {
+        CDataStream ssCursor(ParseHex(strCursor), SER_DISK, CLIENT_VERSION);
+        ssCursor >> key;
+        if (!ssCursor.empty())
+            return false;
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    // Don't allow to continue with the outputs of another address
+    return key.type == static_cast<unsigned int>(type) && key.hashBytes == hashBytes;
+}
+
 static bool GetUTXOs(HTTPRequest* req, const CBitcoinAddress& address, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& utxos,
                      const CAddressUnspentKey &start = CAddressUnspentKey(),
                      int offset = -1, int limit = -1, bool reverse = false){
@@ -556,40 +572,61 @@ static bool address_utxos(HTTPRequest* req, const std::map<std::string, std::str
     nTime0 = GetTimeMicros();
 
     std::string addrStr = bodyParameter[SAPI::Keys::address].get_str();
-    int64_t nPageNumber = bodyParameter[SAPI::Keys::pageNumber].get_int64();
+    bool fCursor = bodyParameter.exists(SAPI::Keys::cursor);
+    int64_t nPageNumber = bodyParameter.exists(SAPI::Keys::pageNumber) ? bodyParameter[SAPI::Keys::pageNumber].get_int64() : 1;
     int64_t nPageSize = bodyParameter[SAPI::Keys::pageSize].get_int64();
     bool fAsc = bodyParameter.exists(SAPI::Keys::ascending) ? bodyParameter[SAPI::Keys::ascending].get_bool() : false;
 
     CSmartAddress address(addrStr);
     CScript addrScript = address.GetScript();
 
-    CAddressUnspentKey lastIndex;
-    int nUtxoCount = 0;
+    CAddressUnspentKey lastIndex, start, next;
+    CAddressUnspentSummaryValue unspentSummary;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
-    if( !GetUTXOCount(req, address, nUtxoCount, lastIndex ) ){
+    if( !GetUTXOSummary(req, address, unspentSummary, lastIndex ) ){
         return false;
     }
 
-    if (!nUtxoCount)
+    if (unspentSummary.IsNull())
         return SAPI::Error(req, SAPI::NoUtxosAvailble, "No unspent outputs available.");
 
     nTime1 = GetTimeMicros();
 
-    int nPages = nUtxoCount / nPageSize;
+    int64_t nUtxoCount = unspentSummary.nCount;
+    int64_t nPages = nUtxoCount / nPageSize;
     if( nUtxoCount % nPageSize ) nPages++;
 
-    if (nPageNumber > nPages)
-        return SAPI::Error(req, SAPI::PageOutOfRange, strprintf("Page number out of range: 1 - %d", nPages));
+    int nIndexOffset = -1;
 
-    int nIndexOffset = static_cast<int>(( nPageNumber - 1 ) * nPageSize);
-    int nLimit = static_cast<int>( (nUtxoCount % nPageSize) && nPageNumber == nPages ? (nUtxoCount % nPageSize) : nPageSize);
+    if (fCursor) {
+        // Continue directly at the key of the cursor, no need to skip the previous pages
+        if (!DecodeUTXOCursor(bodyParameter[SAPI::Keys::cursor].get_str(), address, start))
+            return SAPI::Error(req, SAPI::InvalidCursor, "Invalid cursor.");
+    } else {
 
-    if (!GetUTXOs(req, address, unspentOutputs, fAsc ? CAddressUnspentKey() : lastIndex, nIndexOffset , nLimit, !fAsc))
+        if (nPageNumber > nPages)
+            return SAPI::Error(req, SAPI::PageOutOfRange, strprintf("Page number out of range: 1 - %d", nPages));
+
+        nIndexOffset = static_cast<int>(( nPageNumber - 1 ) * nPageSize);
+        start = fAsc ? CAddressUnspentKey() : lastIndex;
+    }
+
+    // Read one output more than requested, it is the start of the next page
+    if (!GetUTXOs(req, address, unspentOutputs, start, nIndexOffset, static_cast<int>(nPageSize + 1), !fAsc))
         return false;
 
+    if (static_cast<int64_t>(unspentOutputs.size()) > nPageSize) {
+        next = unspentOutputs.back().first;
+        unspentOutputs.pop_back();
+    }
+
     nTime2 = GetTimeMicros();
 
+    int nLockHeight;
+    int64_t nLockTime;
+    GetLockTimeReference(nLockHeight, nLockTime);
+
     UniValue arrUtxos(UniValue::VARR);
 
     for (const auto &unspentOutput : unspentOutputs) {
@@ -604,10 +641,7 @@ static bool address_utxos(HTTPRequest* req, const std::map<std::string, std::str
         bool fInMempool = mempool.getSpentIndex(spentKey, spentInfo);
 
         // Figure out if utxo is spendable (i.e. not time locked)
-        bool fLocked = true;
-        if (!IsTimeLocked(req, key.nBlockHeight, key.txhash, address, fLocked)) {
-            return false;
-        }
+        bool fLocked = value.IsLocked(nLockHeight, nLockTime);
 
         output.pushKV("txid", key.txhash.GetHex());
         output.pushKV("index", static_cast<int>(key.index));
@@ -625,7 +659,11 @@ static bool address_utxos(HTTPRequest* req, const std::map<std::string, std::str
 
     obj.pushKV("count", nUtxoCount);
     obj.pushKV("pages", nPages);
-    obj.pushKV("page", nPageNumber);
+    if (!fCursor)
+        obj.pushKV("page", nPageNumber);
+    if (!next.IsNull())
+        obj.pushKV("next", EncodeUTXOCursor(next));
+    obj.pushKV("amount", UniValueFromAmount(unspentSummary.satoshis));
     obj.pushKV("blockHeight", chainActive.Height());
     obj.pushKV(SAPI::Keys::address, addrStr);
     obj.pushKV("script", HexStr(addrScript.begin(), addrScript.end()));
@@ -661,19 +699,25 @@ static bool address_utxos_amount(HTTPRequest* req, const std::map<std::string, s
     bool fInstantPay = bodyParameter.exists(SAPI::Keys::instantpay) ? bodyParameter[SAPI::Keys::instantpay].get_bool() : false;
 
     CSmartAddress address(addrStr);
-    CAddressUnspentKey lastIndex;
-    int nUtxoCount = 0;
+    CAddressUnspentKey lastIndex, start;
+    CAddressUnspentSummaryValue unspentSummary;
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
 
-    if( !GetUTXOCount(req, address, nUtxoCount, lastIndex ) ){
+    if( !GetUTXOSummary(req, address, unspentSummary, lastIndex ) ){
         return false;
     }
 
-    if (!nUtxoCount)
+    if (unspentSummary.IsNull())
         return SAPI::Error(req, SAPI::NoUtxosAvailble, "No unspent outputs available");
 
+    // Not even all outputs together can pay the amount
+    if (unspentSummary.satoshis < expectedAmount)
+        return SAPI::Error(req, SAPI::BalanceInsufficient, "Requested amount exceeds balance");
+
     nTime1 = GetTimeMicros();
 
+    int nUtxoCount = static_cast<int>(unspentSummary.nCount);
+
     bool fTimedOut = false;
     int nPages = nUtxoCount / nUtxosSlice;
     if( nUtxoCount % nUtxosSlice ) nPages++;
@@ -682,29 +726,38 @@ static bool address_utxos_amount(HTTPRequest* req, const std::map<std::string, s
 
     int64_t nHeight = chainActive.Height();
 
+    int nLockHeight;
+    int64_t nLockTime;
+    GetLockTimeReference(nLockHeight, nLockTime);
+
     CUnspentSolution currentSolution, bestSolution;
 
-    do{
+    // Only the first slice gets skipped to, the next ones continue at the
+    // key behind the previous slice and wrap around at the last one.
+    int nIndexOffset = nPageStart * nUtxosSlice;
 
-        int nIndexOffset = static_cast<int>( (nPageCurrent % nPages) * nUtxosSlice);
-        int nLimit = static_cast<int>( (nUtxoCount % nUtxosSlice) &&
-                                       (nPageCurrent % nPages) == nPages - 1 ? (nUtxoCount % nUtxosSlice) :
-                                                                    nUtxosSlice);
+    do{
 
         if( !fRandom && GetTimeMicros() - nTime0 > nMatchTimeoutMicros )
             break;
 
-        if( !GetUTXOs(req, address, unspentOutputs, CAddressUnspentKey(), nIndexOffset , nLimit) )
+        size_t nRead = unspentOutputs.size();
+
+        if( !GetUTXOs(req, address, unspentOutputs, start, nIndexOffset, nUtxosSlice + 1) )
             return false;
 
+        nIndexOffset = -1;
+
+        if( unspentOutputs.size() - nRead > static_cast<size_t>(nUtxosSlice) ){
+            start = unspentOutputs.back().first;
+            unspentOutputs.pop_back();
+        }else{
+            start.SetNull();
+        }
+
         // Filter out utxos that are currently time-locked
         for (auto it = unspentOutputs.begin(); it != unspentOutputs.end();) {
-            bool locked = false;
-            if (!IsTimeLocked(req, it->first.nBlockHeight, it->first.txhash, address, locked)) {
-                return false;
-            }
-
-            if (locked) {
+            if (it->second.IsLocked(nLockHeight, nLockTime)) {
                 it = unspentOutputs.erase(it);
             } else {
                 ++it;
@@ -894,7 +947,8 @@ static bool address_transaction(HTTPRequest* req, const std::map<std::string, st
 static bool address_transactions(HTTPRequest* req, const std::map<std::string, std::string> &mapPathParams, const UniValue &bodyParameter)
 {
     std::string addrStr = bodyParameter[SAPI::Keys::address].get_str();
-    int64_t nPageNumber = bodyParameter[SAPI::Keys::pageNumber].get_int64();
+    bool fCursor = bodyParameter.exists(SAPI::Keys::cursor);
+    int64_t nPageNumber = bodyParameter.exists(SAPI::Keys::pageNumber) ? bodyParameter[SAPI::Keys::pageNumber].get_int64() : 1;
     int64_t nPageSize = bodyParameter[SAPI::Keys::pageSize].get_int64();
     bool fAsc = bodyParameter.exists(SAPI::Keys::ascending) ? bodyParameter[SAPI::Keys::ascending].get_bool() : false;
     std::string direction = bodyParameter.exists(SAPI::Keys::direction)
@@ -904,9 +958,15 @@ static bool address_transactions(HTTPRequest* req, const std::map<std::string, s
  //       return SAPI::Error(req, HTTPStatus::BAD_REQUEST, "No SmartCash address specified. Use /address/transactions/<smartcash_address>");
 
 //    std::string addrStr = mapPathParams.at("address");
+    CAddressIndexIteratorTxKey start, next;
+
+    // Continue directly at the transaction of the cursor, no need to skip the previous pages
+    if (fCursor && !DecodeTxCursor(bodyParameter[SAPI::Keys::cursor].get_str(), CBitcoinAddress(addrStr), start))
+        return SAPI::Error(req, SAPI::InvalidCursor, "Invalid cursor.");
+
     std::vector<std::tuple<uint256, int, CAmount>> vecResult;
     int64_t totalNumTxs;
-    if( !GetAddressesTransactions(req, addrStr, vecResult, nPageNumber, nPageSize, fAsc, totalNumTxs) )
+    if( !GetAddressesTransactions(req, addrStr, vecResult, nPageNumber, nPageSize, fAsc, totalNumTxs, start, &next) )
         return false;
     if (totalNumTxs < 1)
         return SAPI::Error(req, SAPI::PageOutOfRange, "No transactions available for this address.");
@@ -914,7 +974,7 @@ static bool address_transactions(HTTPRequest* req, const std::map<std::string, s
     int nPages = totalNumTxs / nPageSize;
     if (totalNumTxs % nPageSize || (totalNumTxs < nPageSize) ) nPages++;
 
-    if (nPageNumber > nPages)
+    if (!fCursor && nPageNumber > nPages)
         return SAPI::Error(req, SAPI::PageOutOfRange, strprintf("Page number out of range: 1 - %d.", nPages));
 
     UniValue transactions(UniValue::VARR);
@@ -957,7 +1017,10 @@ static bool address_transactions(HTTPRequest* req, const std::map<std::string, s
     UniValue response(UniValue::VOBJ);
     response.pushKV("count", totalNumTxs);
     response.pushKV("pages", nPages);
-    response.pushKV("page", nPageNumber);
+    if (!fCursor)
+        response.pushKV("page", nPageNumber);
+    if (!next.IsNull())
+        response.pushKV("next", EncodeTxCursor(next));
 
     response.pushKV("data", transactions);
 
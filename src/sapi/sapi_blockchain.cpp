@@ -4,6 +4,7 @@
 
 #include "core_io.h"
 #include "sapi.h"
+#include "sapi_cache.h"
 #include "consensus/validation.h"
 #include "smartnode/instantx.h"
 #include "validation.h"
@@ -42,50 +43,28 @@ SAPI::EndpointGroup blockchainEndpoints = {
     }
 };
 
-static bool GetBlockInfo(HTTPRequest* req, CBlockIndex *blockindex, const CBlock &block, UniValue &blockObj)
+/** Add the fields of a transaction which depend on the position of its block in the chain */
+static void AddTransactionChainInfo(const uint256 &nHash, UniValue &txObj)
 {
-    blockObj.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
-    int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    blockObj.push_back(Pair("confirmations", confirmations));
-    blockObj.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
-    blockObj.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    blockObj.push_back(Pair("weight", (int)::GetBlockWeight(block)));
-    blockObj.push_back(Pair("height", blockindex->nHeight));
-    blockObj.push_back(Pair("version", block.nVersion));
-    blockObj.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
-    blockObj.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-
-    UniValue txs(UniValue::VARR);
-    BOOST_FOREACH(const CTransaction&tx, block.vtx)
-    {
-        UniValue txObj(UniValue::VOBJ);
-        if (!GetTransactionInfo(req, tx.GetHash(), tx, txObj, false))
-            return false;
-
-        txs.push_back(txObj);
+    if (!nHash.IsNull()) {
+        txObj.pushKV("blockhash", nHash.GetHex());
+        BlockMap::iterator mi = mapBlockIndex.find(nHash);
+        if (mi != mapBlockIndex.end() && (*mi).second) {
+            CBlockIndex* pindex = (*mi).second;
+            if (chainActive.Contains(pindex)) {
+                txObj.pushKV("height", pindex->nHeight);
+                txObj.pushKV("confirmations", 1 + chainActive.Height() - pindex->nHeight);
+                txObj.pushKV("time", pindex->GetBlockTime());
+            } else {
+                txObj.pushKV("height", -1);
+                txObj.pushKV("confirmations", 0);
+            }
+        }
     }
-
-    blockObj.push_back(Pair("tx", txs));
-    blockObj.push_back(Pair("time", block.GetBlockTime()));
-    blockObj.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
-    blockObj.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    blockObj.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    blockObj.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    blockObj.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
-
-    if (blockindex->pprev)
-        blockObj.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
-    if (pnext)
-        blockObj.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
-
-    return true;
 }
 
-bool GetTransactionInfo(HTTPRequest* req, uint256 nHash, const CTransaction &tx, UniValue &txObj, bool showHex)
+/** Build the fields of a transaction which are fixed by its hash */
+static bool GetTransactionData(HTTPRequest* req, const CTransaction &tx, UniValue &txObj, bool showHex)
 {
     if (showHex) {
       string strHex = EncodeHexTx(tx, SERIALIZE_TRANSACTION_NO_WITNESS);
@@ -137,22 +116,142 @@ bool GetTransactionInfo(HTTPRequest* req, uint256 nHash, const CTransaction &tx,
     }
     txObj.pushKV("vout", vout);
 
-    if (!nHash.IsNull()) {
-        txObj.pushKV("blockhash", nHash.GetHex());
-        BlockMap::iterator mi = mapBlockIndex.find(nHash);
-        if (mi != mapBlockIndex.end() && (*mi).second) {
-            CBlockIndex* pindex = (*mi).second;
-            if (chainActive.Contains(pindex)) {
-                txObj.pushKV("height", pindex->nHeight);
-                txObj.pushKV("confirmations", 1 + chainActive.Height() - pindex->nHeight);
-                txObj.pushKV("time", pindex->GetBlockTime());
-            } else {
-                txObj.pushKV("height", -1);
-                txObj.pushKV("confirmations", 0);
-            }
-        }
+    return true;
+}
+
+/** Get the transaction fields fixed by its hash, from the response cache if possible */
+static bool GetCachedTransactionData(HTTPRequest* req, const CTransaction &tx, UniValue &txObj)
+{
+    std::string strKey = CSAPIResponseCache::Key("tx", tx.GetHash());
+
+    if (sapiCache.Get(strKey, txObj))
+        return true;
+
+    txObj = UniValue(UniValue::VOBJ);
+
+    if (!GetTransactionData(req, tx, txObj, false))
+        return false;
+
+    sapiCache.Put(strKey, txObj);
+
+    return true;
+}
+
+/**
+ * Get the data of a block which needs to be read from disk: its sizes and
+ * transactions without their chain position. Served from the response cache
+ * if possible.
+ */
+static bool GetBlockData(HTTPRequest* req, CBlockIndex *blockindex, UniValue &blockData)
+{
+    std::string strKey = CSAPIResponseCache::Key("block", blockindex->GetBlockHash());
+
+    if (sapiCache.Get(strKey, blockData))
+        return true;
+
+    CBlock block;
+
+    if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
+        return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data).");
+
+    if(!ReadBlockFromDisk(block, blockindex, Params().GetConsensus()))
+        return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk.");
+
+    UniValue txs(UniValue::VARR);
+    BOOST_FOREACH(const CTransaction&tx, block.vtx)
+    {
+        UniValue txObj(UniValue::VOBJ);
+        if (!GetCachedTransactionData(req, tx, txObj))
+            return false;
+
+        txs.push_back(txObj);
     }
 
+    blockData = UniValue(UniValue::VOBJ);
+    blockData.pushKV("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+    blockData.pushKV("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+    blockData.pushKV("weight", (int)::GetBlockWeight(block));
+    blockData.pushKV("tx", txs);
+
+    sapiCache.Put(strKey, blockData, blockindex->nHeight);
+
+    return true;
+}
+
+/** Add the block fields in front of the transactions */
+static void AddBlockHeaderInfo(CBlockIndex *blockindex, const UniValue &blockData, UniValue &blockObj)
+{
+    blockObj.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
+    int confirmations = -1;
+    // Only report confirmations if the block is on the main chain
+    if (chainActive.Contains(blockindex))
+        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    blockObj.push_back(Pair("confirmations", confirmations));
+    blockObj.push_back(Pair("strippedsize", blockData["strippedsize"]));
+    blockObj.push_back(Pair("size", blockData["size"]));
+    blockObj.push_back(Pair("weight", blockData["weight"]));
+    blockObj.push_back(Pair("height", blockindex->nHeight));
+    blockObj.push_back(Pair("version", blockindex->nVersion));
+    blockObj.push_back(Pair("versionHex", strprintf("%08x", blockindex->nVersion)));
+    blockObj.push_back(Pair("merkleroot", blockindex->hashMerkleRoot.GetHex()));
+}
+
+/** Add the block fields behind the transactions */
+static void AddBlockChainInfo(CBlockIndex *blockindex, UniValue &blockObj)
+{
+    blockObj.push_back(Pair("time", blockindex->GetBlockTime()));
+    blockObj.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
+    blockObj.push_back(Pair("nonce", (uint64_t)blockindex->nNonce));
+    blockObj.push_back(Pair("bits", strprintf("%08x", blockindex->nBits)));
+    blockObj.push_back(Pair("difficulty", GetDifficulty(blockindex)));
+    blockObj.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+
+    if (blockindex->pprev)
+        blockObj.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
+    CBlockIndex *pnext = chainActive.Next(blockindex);
+    if (pnext)
+        blockObj.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+}
+
+static bool GetBlockInfo(HTTPRequest* req, CBlockIndex *blockindex, UniValue &blockObj)
+{
+    UniValue blockData;
+    if (!GetBlockData(req, blockindex, blockData))
+        return false;
+
+    AddBlockHeaderInfo(blockindex, blockData, blockObj);
+
+    const UniValue &txData = blockData["tx"];
+
+    UniValue txs(UniValue::VARR);
+    for (size_t i = 0; i < txData.size(); i++)
+    {
+        UniValue txObj(txData[i]);
+        AddTransactionChainInfo(uint256S(txData[i]["txid"].get_str()), txObj);
+        txs.push_back(txObj);
+    }
+
+    blockObj.push_back(Pair("tx", txs));
+
+    AddBlockChainInfo(blockindex, blockObj);
+
+    return true;
+}
+
+bool GetTransactionInfo(HTTPRequest* req, uint256 nHash, const CTransaction &tx, UniValue &txObj, bool showHex)
+{
+    if (showHex) {
+        if (!GetTransactionData(req, tx, txObj, true))
+            return false;
+    } else {
+        UniValue txData;
+        if (!GetCachedTransactionData(req, tx, txData))
+            return false;
+        txObj.pushKVs(txData);
+    }
+
+    AddTransactionChainInfo(nHash, txObj);
+
     return true;
 }
 
@@ -217,17 +316,10 @@ static bool blockchain_block(HTTPRequest* req, const std::map<std::string, std::
     if (mapBlockIndex.count(hash) == 0)
         return SAPI::Error(req, SAPI::BlockNotFound, "Block not found");
 
-    CBlock block;
     CBlockIndex* blockindex = mapBlockIndex[hash];
 
-    if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
-        return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data)");
-
-    if(!ReadBlockFromDisk(block, blockindex, Params().GetConsensus()))
-        return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk");
-
     UniValue result(UniValue::VOBJ);
-    if (!GetBlockInfo(req, blockindex, block, result))
+    if (!GetBlockInfo(req, blockindex, result))
         return false;
 
     SAPI::WriteReply(req, result);
@@ -265,16 +357,15 @@ static bool blockchain_block_transactions(HTTPRequest* req, const std::map<std::
 
     LOCK(cs_main);
 
-    CBlock block;
     CBlockIndex* blockindex = mapBlockIndex[nHash];
 
-    if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
-        return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data).");
+    UniValue blockData;
+    if (!GetBlockData(req, blockindex, blockData))
+        return false;
 
-    if(!ReadBlockFromDisk(block, blockindex, Params().GetConsensus()))
-        return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk.");
+    const UniValue &txData = blockData["tx"];
 
-    int nTxCount = block.vtx.size();
+    int nTxCount = txData.size();
     int nPages = nTxCount / nPageSize;
     if( nTxCount % nPageSize ) nPages++;
 
@@ -283,55 +374,29 @@ static bool blockchain_block_transactions(HTTPRequest* req, const std::map<std::
 
 
     UniValue result(UniValue::VOBJ);
-    result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
-    int confirmations = -1;
-    // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
-    result.push_back(Pair("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(Pair("weight", (int)::GetBlockWeight(block)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
-    result.push_back(Pair("versionHex", strprintf("%08x", block.nVersion)));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
+    AddBlockHeaderInfo(blockindex, blockData, result);
 
     UniValue txs(UniValue::VARR);
 
-    int nIndexOffset = static_cast<int>(( nPageNumber - 1 ) * nPageSize);
-    auto tx = block.vtx.begin() + nIndexOffset;
+    int nIndex = static_cast<int>(( nPageNumber - 1 ) * nPageSize);
 
-    while(tx != block.vtx.end() && static_cast<int64_t>(txs.size()) < nPageSize )
+    while(nIndex < nTxCount && static_cast<int64_t>(txs.size()) < nPageSize )
     {
-        UniValue txObj(UniValue::VOBJ);
-        if (!GetTransactionInfo(req, nHash, *tx, txObj, false)) {
-            return false;
-        }
+        UniValue txObj(txData[nIndex]);
+        AddTransactionChainInfo(nHash, txObj);
         txs.push_back(txObj);
-        ++tx;
+        ++nIndex;
     }
 
     UniValue transactions(UniValue::VOBJ);
 
-    transactions.pushKV("count",static_cast<int64_t>(block.vtx.size()));
+    transactions.pushKV("count",static_cast<int64_t>(nTxCount));
     transactions.pushKV("pages", nPages);
     transactions.pushKV("page", nPageNumber);
     transactions.pushKV("data", txs);
 
     result.push_back(Pair("transactions", transactions));
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
-    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
-
-    if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
-    if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+    AddBlockChainInfo(blockindex, result);
 
     SAPI::WriteReply(req, result);
 
@@ -361,17 +426,10 @@ bool blockchain_blocks_latest(HTTPRequest* req, const std::map<std::string, std:
     }
 
     for (int i = 0; i < count; i++) {
-        CBlock block;
         CBlockIndex* blockindex = chainActive[currentHeight - i];
 
-        if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
-            return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data).");
-
-        if(!ReadBlockFromDisk(block, blockindex, Params().GetConsensus()))
-            return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk.");
-
         UniValue blockInfo(UniValue::VOBJ);
-        if (!GetBlockInfo(req, blockindex, block, blockInfo))
+        if (!GetBlockInfo(req, blockindex, blockInfo))
             return false;
 
         response.push_back(blockInfo);
@@ -424,17 +482,10 @@ bool blockchain_blocks_range(HTTPRequest* req, const std::map<std::string, std::
     to = to > chainActive.Height() ? chainActive.Height() : to;
 
     for (int i = to; i >= from; i--) {
-        CBlock block;
         CBlockIndex* blockindex = chainActive[i];
 
-        if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
-            return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data).");
-
-        if(!ReadBlockFromDisk(block, blockindex, Params().GetConsensus()))
-            return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk.");
-
         UniValue blockInfo(UniValue::VOBJ);
-        if (!GetBlockInfo(req, blockindex, block, blockInfo))
+        if (!GetBlockInfo(req, blockindex, blockInfo))
             return false;
 
         response.push_back(blockInfo);
@@ -465,22 +516,18 @@ bool blockchain_transactions_latest(HTTPRequest* req, const std::map<std::string
     int64_t nHeight = chainActive.Height();
     int64_t numTxs = count;
 
-    while (numTxs) {
-        CBlock block;
+    while (numTxs && nHeight >= 0) {
         CBlockIndex* blockindex = chainActive[nHeight];
 
-        if (fHavePruned && !(blockindex->nStatus & BLOCK_HAVE_DATA) && blockindex->nTx > 0)
-            return SAPI::Error(req, SAPI::BlockNotFound, "Block not available (pruned data).");
+        UniValue blockData;
+        if (!GetBlockData(req, blockindex, blockData))
+            return false;
 
-        if (!ReadBlockFromDisk(block, blockindex, Params().GetConsensus()))
-            return SAPI::Error(req, SAPI::BlockNotFound, "Can't read block from disk.");
+        const UniValue &txData = blockData["tx"];
 
-        auto tx = block.vtx.begin();
-        while (tx != block.vtx.end() && numTxs) {
-            UniValue txObj(UniValue::VOBJ);
-            if (!GetTransactionInfo(req, blockindex->GetBlockHash(), *tx, txObj, false)) {
-                return false;
-            }
+        for (size_t i = 0; i < txData.size() && numTxs; i++) {
+            UniValue txObj(txData[i]);
+            AddTransactionChainInfo(blockindex->GetBlockHash(), txObj);
             response.push_back(txObj);
             numTxs--;
         }
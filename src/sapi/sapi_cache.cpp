@@ -0,0 +1,140 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "sapi/sapi_cache.h"
+#include "sapi/sapi.h"
+#include "chain.h"
+#include "util.h"
+
+CSAPIResponseCache sapiCache;
+
+CSAPIResponseCache::CSAPIResponseCache() :
+    nMaxSize(DEFAULT_SAPI_CACHE_SIZE * 1024 * 1024),
+    nSize(0),
+    nDepth(DEFAULT_SAPI_CACHE_DEPTH),
+    nTipHeight(-1)
+{}
+
+std::string CSAPIResponseCache::Key(const std::string &strEndpoint, const uint256 &hash, const std::string &strParams)
+{
+    return strEndpoint + "/" + hash.GetHex() + "/" + strParams;
+}
+
+void CSAPIResponseCache::SetLimits(size_t nMaxSizeIn, int nDepthIn)
+{
+    LOCK(cs);
+
+    nMaxSize = nMaxSizeIn;
+    nDepth = nDepthIn;
+
+    while( nSize > nMaxSize && !listEntries.empty() )
+        Erase(std::prev(listEntries.end()));
+}
+
+void CSAPIResponseCache::Erase(entry_it it)
+{
+    nSize -= it->strKey.size() + it->strValue.size();
+    mapEntries.erase(it->strKey);
+    listEntries.erase(it);
+}
+
+bool CSAPIResponseCache::Get(const std::string &strKey, UniValue &value)
+{
+    bool fHit = false;
+    std::string strValue;
+
+    {
+        LOCK(cs);
+
+        auto it = mapEntries.find(strKey);
+
+        if( it != mapEntries.end() ){
+            // Move it to the front of the LRU list
+            listEntries.splice(listEntries.begin(), listEntries, it->second);
+            strValue = it->second->strValue;
+            fHit = true;
+        }
+    }
+
+    if( fHit && !value.read(strValue) ){
+        LogPrintf("CSAPIResponseCache::Get -- failed to parse the entry %s\n", strKey);
+        fHit = false;
+    }
+
+    sapiStatistics.cacheRequest(fHit);
+
+    return fHit;
+}
+
+void CSAPIResponseCache::Put(const std::string &strKey, const UniValue &value, int nHeight)
+{
+    std::string strValue = value.write();
+    size_t nEntrySize = strKey.size() + strValue.size();
+
+    LOCK(cs);
+
+    if( !nMaxSize || nEntrySize > nMaxSize )
+        return;
+
+    auto it = mapEntries.find(strKey);
+
+    if( it != mapEntries.end() )
+        Erase(it->second);
+
+    listEntries.push_front(Entry{strKey, std::move(strValue), nHeight});
+    mapEntries.insert(std::make_pair(strKey, listEntries.begin()));
+    nSize += nEntrySize;
+
+    while( nSize > nMaxSize )
+        Erase(std::prev(listEntries.end()));
+}
+
+void CSAPIResponseCache::Clear()
+{
+    LOCK(cs);
+
+    listEntries.clear();
+    mapEntries.clear();
+    nSize = 0;
+}
+
+size_t CSAPIResponseCache::GetSize() const
+{
+    LOCK(cs);
+    return nSize;
+}
+
+size_t CSAPIResponseCache::GetCount() const
+{
+    LOCK(cs);
+    return listEntries.size();
+}
+
+void CSAPIResponseCache::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    LOCK(cs);
+
+    // Reorg, drop the entries of the disconnected blocks and the ones which
+    // didn't reach the confirmation depth yet.
+    if( nTipHeight >= 0 && ( !pindexFork || pindexFork->nHeight < nTipHeight ) ){
+
+        int nKeepHeight = std::min(pindexFork ? pindexFork->nHeight : -1, nTipHeight - nDepth);
+        size_t nRemoved = 0;
+
+        auto it = listEntries.begin();
+
+        while( it != listEntries.end() ){
+            if( it->nHeight > nKeepHeight ){
+                Erase(it++);
+                ++nRemoved;
+            }else{
+                ++it;
+            }
+        }
+
+        LogPrint("sapi", "CSAPIResponseCache::UpdatedBlockTip -- reorg at height %d, removed %d entries\n", nKeepHeight, nRemoved);
+    }
+
+    nTipHeight = pindexNew ? pindexNew->nHeight : -1;
+}
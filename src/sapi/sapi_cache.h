@@ -0,0 +1,77 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SMARTCASH_SAPI_CACHE_H
+#define SMARTCASH_SAPI_CACHE_H
+
+#include "sync.h"
+#include "uint256.h"
+#include "validationinterface.h"
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include <univalue.h>
+
+class CSAPIResponseCache;
+
+extern CSAPIResponseCache sapiCache;
+
+static const int DEFAULT_SAPI_CACHE_SIZE = 32;
+static const int DEFAULT_SAPI_CACHE_DEPTH = 6;
+
+/**
+ * Size bounded LRU cache for the JSON the SAPI builds from block and
+ * transaction data on disk. Entries are keyed by (endpoint, hash, params) and
+ * only hold data which is fixed by the hash, the chain position dependent
+ * fields like confirmations are added when a response is written. Values are
+ * kept serialized, which also makes their size known.
+ */
+class CSAPIResponseCache : public CValidationInterface
+{
+    struct Entry
+    {
+        std::string strKey;
+        // The JSON of the value, its size is the size of the entry
+        std::string strValue;
+        // Height of the block the entry was built for, -1 if it doesn't belong to one
+        int nHeight;
+    };
+
+    typedef std::list<Entry>::iterator entry_it;
+
+    mutable CCriticalSection cs;
+
+    std::list<Entry> listEntries;
+    std::unordered_map<std::string, entry_it> mapEntries;
+
+    size_t nMaxSize;
+    size_t nSize;
+    // Entries of blocks with less confirmations are dropped on reorgs
+    int nDepth;
+    int nTipHeight;
+
+    void Erase(entry_it it);
+
+public:
+
+    CSAPIResponseCache();
+
+    static std::string Key(const std::string &strEndpoint, const uint256 &hash, const std::string &strParams = std::string());
+
+    void SetLimits(size_t nMaxSizeIn, int nDepthIn);
+
+    bool Get(const std::string &strKey, UniValue &value);
+    void Put(const std::string &strKey, const UniValue &value, int nHeight = -1);
+    void Clear();
+
+    size_t GetSize() const;
+    size_t GetCount() const;
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+};
+
+#endif // SMARTCASH_SAPI_CACHE_H
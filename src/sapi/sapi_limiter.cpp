@@ -6,154 +6,118 @@
 #include "netbase.h"
 #include "util.h"
 
-CCriticalSection cs_clients;
-static std::map<std::string, SAPI::Limits::Client*> mapClients;
+// The clients are spread over nClientShards maps by the hash of their binary
+// address so that concurrent requests of different clients rarely contend.
+struct CSAPIClientShard {
+    CCriticalSection cs;
+    std::map<CNetAddr, SAPI::Limits::Client> mapClients;
+};
 
-//static std::vector<int> vecThrottling = {
-//    1,1,1,1,5,5,5,5,50,120,6000
-//};
+static CSAPIClientShard clientShards[SAPI::Limits::nClientShards];
 
-SAPI::Limits::Client *SAPI::Limits::GetClient(const CService &peer)
+static CSAPIClientShard &GetClientShard(const CNetAddr &peer)
 {
-    SAPI::Limits::Client *client;
-    std::string strIp = peer.ToStringIP(false);
-
-    LOCK(cs_clients);
-
-    auto it = mapClients.find(strIp);
-
-    if( it == mapClients.end() ){
-        client = new SAPI::Limits::Client();
-        mapClients.insert(std::make_pair(strIp, client));
-    }else{
-        client = it->second;
-    }
-
-    return client;
+    return clientShards[peer.GetHash() % SAPI::Limits::nClientShards];
 }
 
-void SAPI::Limits::CheckAndRemove()
+SAPI::Limits::Client SAPI::Limits::Request(const CNetAddr &peer, int64_t nTime)
 {
-    LOCK(cs_clients);
+    CSAPIClientShard &shard = GetClientShard(peer);
 
-    LogPrintf("SAPI::Limits::CheckAndRemove() - Clients %d\n", mapClients.size());
+    LOCK(shard.cs);
 
-    auto it = mapClients.begin();
+    SAPI::Limits::Client &client = shard.mapClients[peer];
 
-    while( it != mapClients.end() ){
-        if( it->second->CheckAndRemove() ){
-            LogPrintf("SAPI::Limits::CheckAndRemove() - Remove %s\n", it->first);
-            delete it->second;
-            it = mapClients.erase(it);
-        }else{
-            ++it;
-        }
-    }
+    client.Request(nTime);
+
+    return client;
 }
 
-void SAPI::Limits::Client::Request()
+void SAPI::Limits::CheckAndRemove()
 {
-    LOCK(cs);
-
     int64_t nTime = GetTimeMillis();
-    int64_t nTimePassed = nTime - nLastRequestTime;
-
-//    IsRequestLimited();
-
-    if ( nTimePassed < (10 * nRequestIntervalMs) ){
-        ++nThrottling;
-        --nRemainingRequests;
-        if ((nThrottling > 2 * nRequestsPerInterval) && (nTime > nRequestsLimitUnlock)) {
-            nRequestsLimitUnlock = nTime + nRequestIntervalMs;
-            LogPrintf("SAPI Throttled Wait %d Seconds (Requests %d)\n", (10 * nRequestIntervalMs + nRequestsLimitUnlock -nTime)/1000, nThrottling);
-        } else if (nThrottling > 2 * nRequestsPerInterval) {
-            nRequestsLimitUnlock = nRequestsLimitUnlock + nRequestIntervalMs;
-            LogPrintf("SAPI Throttled Wait %d Seconds (Requests %d)\n", (10 * nRequestIntervalMs + nRequestsLimitUnlock -nTime)/1000, nThrottling);
-        }
-    } else if ( (nTime > nRequestsLimitUnlock) || (nTimePassed > 60 * nRequestIntervalMs) ){
-        nThrottling = 1;
-        nRequestsLimitUnlock = -1;
-        nRemainingRequests = nRequestsPerInterval;
-    }
+    size_t nClients = 0, nRemoved = 0;
 
+    for( CSAPIClientShard &shard : clientShards ){
 
-/*    nRemainingRequests = (static_cast<double>(nTimePassed * nRequestsPerInterval) / nRequestIntervalMs) - 1.0;
+        LOCK(shard.cs);
 
-    if( nRemainingRequests > nRequestsPerInterval )
-            nRemainingRequests = nRequestsPerInterval;
-
-    LogPrintf("nRemaining before: %f\n", nRemainingRequests);
-
-    if(nRemainingRequests <= 0){
-
-        if( nThrottling < static_cast<int64_t>(vecThrottling.size() - 1) )
-            ++nThrottling;
+        auto it = shard.mapClients.begin();
 
-        int64_t nThrottlingTime = vecThrottling.at(nThrottling);
-
-        nRequestsLimitUnlock = nTime + nThrottlingTime * 100;
-        nRemainingRequests = nRequestIntervalMs;
+        while( it != shard.mapClients.end() ){
+            if( it->second.CheckAndRemove(nTime) ){
+                it = shard.mapClients.erase(it);
+                ++nRemoved;
+            }else{
+                ++it;
+            }
+        }
 
+        nClients += shard.mapClients.size();
     }
 
-    LogPrintf("nRemaining after: %f, throttling %d\n", nRemainingRequests, nThrottling);
-*/
-    nLastRequestTime = nTime;
+    LogPrint("sapi", "SAPI::Limits::CheckAndRemove() - Clients %d, removed %d\n", nClients, nRemoved);
 }
 
-bool SAPI::Limits::Client::IsRequestLimited()
+void SAPI::Limits::Client::Request(int64_t nTime)
 {
+    // Refill the bucket for the time passed since the last request.
+    if( nLastRequestTime > 0 && nTime > nLastRequestTime ){
+        nRemainingRequests += static_cast<double>((nTime - nLastRequestTime) * nRequestsPerInterval) / nRequestIntervalMs;
+        if( nRemainingRequests > nRequestsPerInterval )
+            nRemainingRequests = nRequestsPerInterval;
+    }
 
-    LOCK(cs);
+    nLastRequestTime = nTime;
 
-    if( nRequestsLimitUnlock < 0 )
-        return false;
+    if( IsRequestLimited(nTime) )
+        return;
 
-    int64_t nTime = GetTimeMillis();
+    nRequestsLimitUnlock = -1;
 
-    if( nTime > nRequestsLimitUnlock ){
-        nRequestsLimitUnlock = -1;
-        nThrottling = -1;
-        return false;
+    if( nRemainingRequests < 1 ){
+        nRequestsLimitUnlock = nTime + nRequestLockMs;
+        LogPrint("sapi", "SAPI Throttled Wait %d Seconds\n", nRequestLockMs / 1000);
+        return;
     }
 
-    LogPrintf("Request limited: %d Seconds\n", (nRequestsLimitUnlock - nTime)/1000);
+    nRemainingRequests -= 1;
+}
 
-    return true;
+bool SAPI::Limits::Client::IsRequestLimited(int64_t nTime) const
+{
+    return nRequestsLimitUnlock >= 0 && nTime < nRequestsLimitUnlock;
 }
 
-bool SAPI::Limits::Client::IsRessourceLimited()
+bool SAPI::Limits::Client::IsRessourceLimited(int64_t nTime) const
 {
     return false;
 }
 
-bool SAPI::Limits::Client::IsLimited()
+bool SAPI::Limits::Client::IsLimited(int64_t nTime) const
 {
-    return IsRequestLimited() || IsRessourceLimited();
+    return IsRequestLimited(nTime) || IsRessourceLimited(nTime);
 }
 
-int64_t SAPI::Limits::Client::GetRequestLockSeconds()
+int64_t SAPI::Limits::Client::GetRequestLockSeconds(int64_t nTime) const
 {
-    if( nRequestsLimitUnlock < 0)
+    if( !IsRequestLimited(nTime) )
         return 0;
 
-    return (nRequestsLimitUnlock - GetTimeMillis()) / 1000;
+    return (nRequestsLimitUnlock - nTime + 999) / 1000;
 }
 
-int64_t SAPI::Limits::Client::GetRessourceLockSeconds()
+int64_t SAPI::Limits::Client::GetRessourceLockSeconds(int64_t nTime) const
 {
-    if( nRessourcesLimitUnlock < 0)
+    if( nRessourcesLimitUnlock < 0 || nTime >= nRessourcesLimitUnlock )
         return 0;
 
-    return (nRessourcesLimitUnlock - GetTimeMillis()) / 1000;
+    return (nRessourcesLimitUnlock - nTime + 999) / 1000;
 }
 
-bool SAPI::Limits::Client::CheckAndRemove()
+bool SAPI::Limits::Client::CheckAndRemove(int64_t nTime) const
 {
     // If the client is not limited and was not active for nClientRemovalMs
     // we want to remove it from the list.
-    if( !IsLimited() && ( GetTimeMillis() - nLastRequestTime ) > nClientRemovalMs )
-        return true;
-
-    return false;
+    return !IsLimited(nTime) && ( nTime - nLastRequestTime ) > nClientRemovalMs;
 }
@@ -387,6 +387,8 @@ std::string SAPI::Validation::ResultMessage(SAPI::Codes value)
         return "No deposits available";
     case NoUtxosAvailble:
         return "No unspent outpouts available";
+    case InvalidCursor:
+        return "Invalid page cursor";
     case TxDecodeFailed:
         return "Transaction decode failed";
     case TxNotSpecified:
@@ -330,7 +330,14 @@ bool SmartMining::Validate(const CBlock &block, CBlockIndex *pindex, CValidation
                                 REJECT_INVALID, "bad-cb-payee");
     }
 
-    if( SmartRewardPayments::Validate(block,pindex->nHeight, smartReward) != SmartRewardPayments::Valid ){
+    SmartRewardPayments::Result rewardResult = SmartRewardPayments::Validate(block, pindex, smartReward);
+    if( rewardResult == SmartRewardPayments::CoreError ){
+        // A local failure, the block must neither be accepted nor marked invalid
+        AbortNode("SmartMining::Validate - failed to read the previous smartreward payout blocks");
+        return state.Error("failed to read the previous smartreward payout blocks");
+    }
+
+    if( rewardResult != SmartRewardPayments::Valid ){
          LogPrintf("SmartMining::Validate - Invalid smartreward payment %s\n", block.vtx[0].ToString());
         return state.DoS(100, false, REJECT_INVALID_SMARTREWARD_PAYMENTS,
                      "CTransaction::CheckTransaction() : SmartReward payment list is invalid");
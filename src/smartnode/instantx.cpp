@@ -337,6 +337,11 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman&
     uint256 txHash = vote.GetTxHash();
     uint256 voteHash = vote.GetHash();
 
+    // recover the signing key before cs_main is taken, IsValid is served from the signature cache
+    std::vector<CHashSignatureCheck> vChecks;
+    vote.AddSignatureCheck(vChecks);
+    CHashSigner::VerifyHashes(vChecks);
+
     LOCK(cs_main);
 
     if(!vote.IsValid(pfrom, connman)) {
@@ -831,6 +836,16 @@ bool CInstantSend::GetTxLockRequest(const uint256& txHash, CTxLockRequest& txLoc
     return true;
 }
 
+void CInstantSend::GetTxLockRequests(std::function<bool(const uint256& txHash)> cond, std::vector<CTransactionRef>& vtxRet)
+{
+    LOCK(cs_instantsend);
+
+    for (const auto& pair : mapTxLockCandidates) {
+        if (pair.second.txLockRequest && cond(pair.first))
+            vtxRet.push_back(MakeTransactionRef(pair.second.txLockRequest));
+    }
+}
+
 bool CInstantSend::GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet)
 {
     LOCK(cs_instantsend);
@@ -1122,10 +1137,15 @@ uint256 CTxLockVote::GetHash() const
     return ss.GetHash();
 }
 
+std::string CTxLockVote::GetSignatureMessage() const
+{
+    return txHash.ToString() + outpoint.ToStringShort();
+}
+
 bool CTxLockVote::CheckSignature() const
 {
     std::string strError;
-    std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
+    std::string strMessage = GetSignatureMessage();
 
     smartnode_info_t infoMn;
 
@@ -1142,10 +1162,19 @@ bool CTxLockVote::CheckSignature() const
     return true;
 }
 
+void CTxLockVote::AddSignatureCheck(std::vector<CHashSignatureCheck>& vChecks) const
+{
+    smartnode_info_t infoMn;
+
+    if(!mnodeman.GetSmartnodeInfo(outpointSmartnode, infoMn)) return;
+
+    vChecks.push_back(CHashSignatureCheck(CMessageSigner::GetMessageHash(GetSignatureMessage()), infoMn.pubKeySmartnode.GetID(), vchSmartnodeSignature));
+}
+
 bool CTxLockVote::Sign()
 {
     std::string strError;
-    std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
+    std::string strMessage = GetSignatureMessage();
 
     if(!CMessageSigner::SignMessage(strMessage, vchSmartnodeSignature, activeSmartnode.keySmartnode)) {
         LogPrintf("CTxLockVote::Sign -- SignMessage() failed\n");
@@ -10,6 +10,9 @@
 #include "primitives/transaction.h"
 #include "txdb.h"
 
+#include <functional>
+
+class CHashSignatureCheck;
 class CTxLockVote;
 class COutPointLock;
 class CTxLockRequest;
@@ -103,6 +106,8 @@ public:
     void RejectLockRequest(const CTxLockRequest& txLockRequest);
     bool HasTxLockRequest(const uint256& txHash);
     bool GetTxLockRequest(const uint256& txHash, CTxLockRequest& txLockRequestRet);
+    // transactions of the lock candidates we know the request of, only the ones cond selects get copied
+    void GetTxLockRequests(std::function<bool(const uint256& txHash)> cond, std::vector<CTransactionRef>& vtxRet);
 
     bool GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet);
 
@@ -201,8 +206,11 @@ public:
     bool IsTimedOut() const;
     bool IsFailed() const;
 
+    std::string GetSignatureMessage() const;
     bool Sign();
     bool CheckSignature() const;
+    /// Queue the check of the signature if the smartnode is known, see CHashSigner::VerifyHashes
+    void AddSignatureCheck(std::vector<CHashSignatureCheck>& vChecks) const;
 
     void Relay(CConnman& connman) const;
 };
@@ -67,7 +67,11 @@ bool CSmartnode::UpdateFromNewBroadcast(CSmartnodeBroadcast& mnb, CConnman& conn
     pubKeySmartnode = mnb.pubKeySmartnode;
     sigTime = mnb.sigTime;
     vchSig = mnb.vchSig;
-    nProtocolVersion = mnb.nProtocolVersion;
+    if(nProtocolVersion != mnb.nProtocolVersion) {
+        // the protocol version decides which rank tables a smartnode is part of
+        nProtocolVersion = mnb.nProtocolVersion;
+        mnodeman.BumpListGeneration();
+    }
     addr = mnb.addr;
     nPoSeBanScore = 0;
     nPoSeBanHeight = 0;
@@ -129,6 +133,15 @@ CSmartnode::CollateralStatus CSmartnode::CheckCollateral(const COutPoint& outpoi
     return COLLATERAL_OK;
 }
 
+void CSmartnode::SetActiveState(int nState)
+{
+    bool fEnabledPrev = IsEnabled();
+    nActiveState = nState;
+    if(IsEnabled() != fEnabledPrev) {
+        mnodeman.BumpListGeneration();
+    }
+}
+
 void CSmartnode::Check(bool fForce)
 {
     AssertLockHeld(cs_main);
@@ -149,7 +162,7 @@ void CSmartnode::Check(bool fForce)
         nHeight = chainActive.Height();
         CollateralStatus err = CheckCollateral(vin.prevout, nHeight);
         if (err == COLLATERAL_UTXO_NOT_FOUND) {
-            nActiveState = SMARTNODE_OUTPOINT_SPENT;
+            SetActiveState(SMARTNODE_OUTPOINT_SPENT);
             LogPrint("smartnode", "CSmartnode::Check -- Failed to find Smartnode UTXO, smartnode=%s\n", vin.prevout.ToStringShort());
             return;
         }
@@ -163,7 +176,7 @@ void CSmartnode::Check(bool fForce)
         LogPrintf("CSmartnode::Check -- Smartnode %s is unbanned and back in list now\n", vin.prevout.ToStringShort());
         DecreasePoSeBanScore();
     } else if(nPoSeBanScore >= SMARTNODE_POSE_BAN_MAX_SCORE) {
-        nActiveState = SMARTNODE_POSE_BAN;
+        SetActiveState(SMARTNODE_POSE_BAN);
         // ban for the whole payment cycle
         nPoSeBanHeight = nHeight + mnodeman.size();
         LogPrintf("CSmartnode::Check -- Smartnode %s is banned till block %d now\n", vin.prevout.ToStringShort(), nPoSeBanHeight);
@@ -179,7 +192,7 @@ void CSmartnode::Check(bool fForce)
                    (fOurSmartnode && nProtocolVersion < PROTOCOL_VERSION);
 
     if(fRequireUpdate) {
-        nActiveState = SMARTNODE_UPDATE_REQUIRED;
+        SetActiveState(SMARTNODE_UPDATE_REQUIRED);
         if(nActiveStatePrev != nActiveState) {
             LogPrint("smartnode", "CSmartnode::Check -- Smartnode %s is in %s state now\n", vin.prevout.ToStringShort(), GetStateString());
         }
@@ -201,7 +214,7 @@ void CSmartnode::Check(bool fForce)
     if(!fWaitForPing || fOurSmartnode) {
 
         if(!IsPingedWithin(SMARTNODE_NEW_START_REQUIRED_SECONDS)) {
-            nActiveState = SMARTNODE_NEW_START_REQUIRED;
+            SetActiveState(SMARTNODE_NEW_START_REQUIRED);
             if(nActiveStatePrev != nActiveState) {
                 LogPrint("smartnode", "CSmartnode::Check -- Smartnode %s is in %s state now\n", vin.prevout.ToStringShort(), GetStateString());
             }
@@ -210,7 +223,7 @@ void CSmartnode::Check(bool fForce)
 
 
         if(!IsPingedWithin(SMARTNODE_EXPIRATION_SECONDS)) {
-            nActiveState = SMARTNODE_EXPIRED;
+            SetActiveState(SMARTNODE_EXPIRED);
             if(nActiveStatePrev != nActiveState) {
                 LogPrint("smartnode", "CSmartnode::Check -- Smartnode %s is in %s state now\n", vin.prevout.ToStringShort(), GetStateString());
             }
@@ -219,14 +232,14 @@ void CSmartnode::Check(bool fForce)
     }
 
     if(lastPing.sigTime - sigTime < SMARTNODE_MIN_MNP_SECONDS) {
-        nActiveState = SMARTNODE_PRE_ENABLED;
+        SetActiveState(SMARTNODE_PRE_ENABLED);
         if(nActiveStatePrev != nActiveState) {
             LogPrint("smartnode", "CSmartnode::Check -- Smartnode %s is in %s state now\n", vin.prevout.ToStringShort(), GetStateString());
         }
         return;
     }
 
-    nActiveState = SMARTNODE_ENABLED; // OK
+    SetActiveState(SMARTNODE_ENABLED); // OK
     if(nActiveStatePrev != nActiveState) {
         LogPrint("smartnode", "CSmartnode::Check -- Smartnode %s is in %s state now\n", vin.prevout.ToStringShort(), GetStateString());
     }
@@ -602,6 +615,13 @@ bool CSmartnodeBroadcast::CheckOutpoint(int& nDos)
     return true;
 }
 
+std::string CSmartnodeBroadcast::GetSignatureMessage() const
+{
+    return addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
+            pubKeyCollateralAddress.GetID().ToString() + pubKeySmartnode.GetID().ToString() +
+            boost::lexical_cast<std::string>(nProtocolVersion);
+}
+
 bool CSmartnodeBroadcast::Sign(const CKey& keyCollateralAddress)
 {
     std::string strError;
@@ -609,9 +629,7 @@ bool CSmartnodeBroadcast::Sign(const CKey& keyCollateralAddress)
 
     sigTime = GetAdjustedTime();
 
-    strMessage = addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
-                    pubKeyCollateralAddress.GetID().ToString() + pubKeySmartnode.GetID().ToString() +
-                    boost::lexical_cast<std::string>(nProtocolVersion);
+    strMessage = GetSignatureMessage();
 
     if(!CMessageSigner::SignMessage(strMessage, vchSig, keyCollateralAddress)) {
         LogPrintf("CSmartnodeBroadcast::Sign -- SignMessage() failed\n");
@@ -632,9 +650,7 @@ bool CSmartnodeBroadcast::CheckSignature(int& nDos)
     std::string strError = "";
     nDos = 0;
 
-    strMessage = addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
-                    pubKeyCollateralAddress.GetID().ToString() + pubKeySmartnode.GetID().ToString() +
-                    boost::lexical_cast<std::string>(nProtocolVersion);
+    strMessage = GetSignatureMessage();
 
     LogPrint("smartnode", "CSmartnodeBroadcast::CheckSignature -- strMessage: %s  pubKeyCollateralAddress address: %s  sig: %s\n", strMessage, CBitcoinAddress(pubKeyCollateralAddress.GetID()).ToString(), EncodeBase64(&vchSig[0], vchSig.size()));
 
@@ -647,6 +663,12 @@ bool CSmartnodeBroadcast::CheckSignature(int& nDos)
     return true;
 }
 
+void CSmartnodeBroadcast::AddSignatureChecks(std::vector<CHashSignatureCheck>& vChecks) const
+{
+    vChecks.push_back(CHashSignatureCheck(CMessageSigner::GetMessageHash(GetSignatureMessage()), pubKeyCollateralAddress.GetID(), vchSig));
+    lastPing.AddSignatureCheck(pubKeySmartnode, vChecks);
+}
+
 void CSmartnodeBroadcast::Relay(CConnman& connman)
 {
     // Do not relay until fully synced
@@ -669,6 +691,11 @@ CSmartnodePing::CSmartnodePing(const COutPoint& outpoint)
     sigTime = GetAdjustedTime();
 }
 
+std::string CSmartnodePing::GetSignatureMessage() const
+{
+    return CTxIn(outpoint).ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+}
+
 bool CSmartnodePing::Sign(const CKey& keySmartnode, const CPubKey& pubKeySmartnode)
 {
     std::string strError;
@@ -676,7 +703,7 @@ bool CSmartnodePing::Sign(const CKey& keySmartnode, const CPubKey& pubKeySmartno
 
     // TODO: add sentinel data
     sigTime = GetAdjustedTime();
-    std::string strMessage = CTxIn(outpoint).ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+    std::string strMessage = GetSignatureMessage();
 
     if(!CMessageSigner::SignMessage(strMessage, vchSig, keySmartnode)) {
         LogPrintf("CSmartnodePing::Sign -- SignMessage() failed\n");
@@ -694,7 +721,7 @@ bool CSmartnodePing::Sign(const CKey& keySmartnode, const CPubKey& pubKeySmartno
 bool CSmartnodePing::CheckSignature(CPubKey& pubKeySmartnode, int &nDos)
 {
     // TODO: add sentinel data
-    std::string strMessage = CTxIn(outpoint).ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+    std::string strMessage = GetSignatureMessage();
     std::string strError = "";
     nDos = 0;
 
@@ -706,6 +733,12 @@ bool CSmartnodePing::CheckSignature(CPubKey& pubKeySmartnode, int &nDos)
     return true;
 }
 
+void CSmartnodePing::AddSignatureCheck(const CPubKey& pubKeySmartnode, std::vector<CHashSignatureCheck>& vChecks) const
+{
+    if (vchSig.empty()) return;
+    vChecks.push_back(CHashSignatureCheck(CMessageSigner::GetMessageHash(GetSignatureMessage()), pubKeySmartnode.GetID(), vchSig));
+}
+
 bool CSmartnodePing::SimpleCheck(int& nDos)
 {
     // don't ban by default
@@ -910,6 +943,17 @@ void CSmartnode::FlagGovernanceItemsAsDirty()
     }
 }
 
+std::string CSmartnodeVerification::GetSignatureMessage1(const uint256& blockHash) const
+{
+    return strprintf("%s%d%s", addr.ToString(false), nonce, blockHash.ToString());
+}
+
+std::string CSmartnodeVerification::GetSignatureMessage2(const uint256& blockHash) const
+{
+    return strprintf("%s%d%s%s%s", addr.ToString(false), nonce, blockHash.ToString(),
+                     vin1.prevout.ToStringShort(), vin2.prevout.ToStringShort());
+}
+
 void ThreadSmartnode(CConnman& connman)
 {
     static bool fOneThread;
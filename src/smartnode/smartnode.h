@@ -12,6 +12,7 @@
 class CSmartnode;
 class CSmartnodeBroadcast;
 class CConnman;
+class CHashSignatureCheck;
 
 static const int SMARTNODE_CHECK_SECONDS               = 10;
 static const int SMARTNODE_MIN_MNB_SECONDS             = 5 * 60; //BROADCAST_TIME
@@ -85,8 +86,10 @@ public:
 
     bool IsExpired() const { return GetAdjustedTime() - sigTime > SMARTNODE_NEW_START_REQUIRED_SECONDS; }
 
+    std::string GetSignatureMessage() const;
     bool Sign(const CKey& keySmartnode, const CPubKey& pubKeySmartnode);
     bool CheckSignature(CPubKey& pubKeySmartnode, int &nDos);
+    void AddSignatureCheck(const CPubKey& pubKeySmartnode, std::vector<CHashSignatureCheck>& vChecks) const;
     bool SimpleCheck(int& nDos);
     bool CheckAndUpdate(CSmartnode* pmn, bool fFromNewBroadcast, int& nDos, CConnman& connman);
     void Relay(CConnman& connman);
@@ -219,6 +222,8 @@ public:
     static CollateralStatus CheckCollateral(const COutPoint& outpoint, int nHeight);
     static CollateralStatus CheckCollateral(const COutPoint& outpoint, int& nHeightRet, int nHeight);
     void Check(bool fForce = false);
+    /// Set the active state, the smartnode list changes when the node gets enabled or disabled
+    void SetActiveState(int nState);
 
     bool IsBroadcastedWithin(int nSeconds) { return GetAdjustedTime() - sigTime < nSeconds; }
 
@@ -357,8 +362,11 @@ public:
     bool Update(CSmartnode* pmn, int& nDos, CConnman& connman);
     bool CheckOutpoint(int& nDos);
 
+    std::string GetSignatureMessage() const;
     bool Sign(const CKey& keyCollateralAddress);
     bool CheckSignature(int& nDos);
+    /// Queue the checks of the broadcast and ping signatures, see CHashSigner::VerifyHashes
+    void AddSignatureChecks(std::vector<CHashSignatureCheck>& vChecks) const;
     void Relay(CConnman& connman);
 };
 
@@ -405,6 +413,10 @@ public:
         return ss.GetHash();
     }
 
+    /// The message signed by the verified smartnode, and by the verifying one for a broadcast
+    std::string GetSignatureMessage1(const uint256& blockHash) const;
+    std::string GetSignatureMessage2(const uint256& blockHash) const;
+
     void Relay() const
     {
         CInv inv(MSG_SMARTNODE_VERIFY, GetHash());
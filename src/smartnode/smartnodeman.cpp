@@ -18,15 +18,6 @@ CSmartnodeMan mnodeman;
 
 const std::string CSmartnodeMan::SERIALIZATION_VERSION_STRING = "CSmartnodeMan-Version-4";
 
-struct CompareLastPaidBlock
-{
-    bool operator()(const std::pair<int, CSmartnode*>& t1,
-                    const std::pair<int, CSmartnode*>& t2) const
-    {
-        return (t1.first != t2.first) ? (t1.first < t2.first) : (t1.second->vin < t2.second->vin);
-    }
-};
-
 struct CompareScoreMN
 {
     bool operator()(const std::pair<arith_uint256, CSmartnode*>& t1,
@@ -46,15 +37,6 @@ struct CompareByAddr
     }
 };
 
-struct CompareRankPair
-{
-    bool operator()(const CSmartnodeMan::rank_pair_t& t1,
-                    const CSmartnodeMan::rank_pair_t& t2) const
-    {
-        return t1.first < t2.first;
-    }
-};
-
 CSmartnodeMan::CSmartnodeMan()
 : cs(),
   mapSmartnodes(),
@@ -69,6 +51,11 @@ CSmartnodeMan::CSmartnodeMan()
   fSmartnodesRemoved(false),
   vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  mapRankTables(RANK_CACHE_SIZE),
+  nListGeneration(0),
+  setLastPaidQueue(),
+  mapCollateralHeights(),
+  pindexCollateralTip(NULL),
   mapSeenSmartnodeBroadcast(),
   mapSeenSmartnodePing(),
   nDsqCount(0)
@@ -80,6 +67,8 @@ bool CSmartnodeMan::Add(CSmartnode &mn)
     if (Has(mn.vin.prevout)) return false;
     LogPrint("smartnode", "CSmartnodeMan::Add -- Adding new Smartnode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
     mapSmartnodes[mn.vin.prevout] = mn;
+    BumpListGeneration();
+    setLastPaidQueue.insert(std::make_pair(mn.GetLastPaidBlock(), mn.vin.prevout));
     fSmartnodesAdded = true;
     return true;
 }
@@ -199,7 +188,10 @@ void CSmartnodeMan::CheckAndRemove(CConnman& connman)
 
                 // and finally remove it from the list
                 it->second.FlagGovernanceItemsAsDirty();
+                setLastPaidQueue.erase(std::make_pair(it->second.GetLastPaidBlock(), it->first));
+                mapCollateralHeights.erase(it->first);
                 mapSmartnodes.erase(it++);
+                BumpListGeneration();
                 fSmartnodesRemoved = true;
             } else {
                 bool fAsk = (nAskForMnbRecovery > 0) &&
@@ -217,10 +209,12 @@ void CSmartnodeMan::CheckAndRemove(CConnman& connman)
                     bool fAskedForMnbRecovery = false;
                     // ask first MNB_RECOVERY_QUORUM_TOTAL smartnodes we can connect to and we haven't asked recently
                     for(int i = 0; setRequested.size() < MNB_RECOVERY_QUORUM_TOTAL && i < (int)vecSmartnodeRanks.size(); i++) {
+                        CSmartnode* pmnRanked = Find(vecSmartnodeRanks[i].second);
+                        if(!pmnRanked) continue;
                         // avoid banning
-                        if(mWeAskedForSmartnodeListEntry.count(it->first) && mWeAskedForSmartnodeListEntry[it->first].count(vecSmartnodeRanks[i].second.addr)) continue;
+                        if(mWeAskedForSmartnodeListEntry.count(it->first) && mWeAskedForSmartnodeListEntry[it->first].count(pmnRanked->addr)) continue;
                         // didn't ask recently, ok to ask now
-                        CService addr = vecSmartnodeRanks[i].second.addr;
+                        CService addr = pmnRanked->addr;
                         setRequested.insert(addr);
                         listScheduledMnbRequestConnections.push_back(std::make_pair(addr, hash));
                         fAskedForMnbRecovery = true;
@@ -355,6 +349,10 @@ void CSmartnodeMan::Clear()
 {
     LOCK(cs);
     mapSmartnodes.clear();
+    mapRankTables.Clear();
+    BumpListGeneration();
+    setLastPaidQueue.clear();
+    mapCollateralHeights.clear();
     mAskedUsForSmartnodeList.clear();
     mWeAskedForSmartnodeList.clear();
     mWeAskedForSmartnodeListEntry.clear();
@@ -517,15 +515,25 @@ bool CSmartnodeMan::Has(const COutPoint& outpoint)
     return mapSmartnodes.find(outpoint) != mapSmartnodes.end();
 }
 
+bool CSmartnodeMan::HasAddress(const CNetAddr& addr)
+{
+    LOCK(cs);
+    for (auto& mnpair : mapSmartnodes) {
+        if ((CNetAddr)mnpair.second.addr == addr && mnpair.second.IsEnabled())
+            return true;
+    }
+    return false;
+}
+
 //
 // Deterministically select the oldest/best smartnode to pay on the network
 //
-bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(bool fFilterSigTime, int& nCountRet, CSmartNodeWinners& mnInfoRet)
+bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(bool fFilterSigTime, int& nCountRet, CSmartNodeWinners& mnInfoRet, bool fCountAll)
 {
-    return GetNextSmartnodesInQueueForPayment(nCachedBlockHeight, fFilterSigTime, nCountRet, mnInfoRet);
+    return GetNextSmartnodesInQueueForPayment(nCachedBlockHeight, fFilterSigTime, nCountRet, mnInfoRet, fCountAll);
 }
 
-bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCountRet, CSmartNodeWinners& mnInfoRet)
+bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCountRet, CSmartNodeWinners& mnInfoRet, bool fCountAll)
 {
     mnInfoRet.clear();
     nCountRet = 0;
@@ -538,10 +546,8 @@ bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fF
     // Need LOCK2 here to ensure consistent locking order because the GetBlockHash call below locks cs_main
     LOCK2(cs_main,cs);
 
-    std::vector<std::pair<int, CSmartnode*> > vecSmartnodeLastPaid;
-
     /*
-        Make a vector with all of the last paid times
+        Walk the smartnodes from the oldest to the newest last paid block
     */
 
     // If we are not yet at the multipayment height use legacy metrics.
@@ -551,33 +557,71 @@ bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fF
     if( !nPayoutsPerBlock ) nPayoutsPerBlock = 1;
 
     int nMnCount = CountSmartnodes();
+    int nMinConfirmations = int(nMnCount / ( double( nPayoutsPerBlock ) / nPayoutInterval ) );
+    int64_t nMaxSigTime = GetAdjustedTime() - int(nMnCount * 55 /  ( double( nPayoutsPerBlock ) / nPayoutInterval ) );
 
-    for (auto& mnpair : mapSmartnodes) {
-        if(!mnpair.second.IsValidForPayment()) continue;
+    //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
+    std::set<CScript> setScheduled;
+    mnpayments.GetScheduledPayees(nBlockHeight, setScheduled);
 
-        //check protocol version
-        if(mnpair.second.nProtocolVersion < mnpayments.GetMinSmartnodePaymentsProto()) continue;
+    if (setLastPaidQueue.size() != mapSmartnodes.size()) {
+        RebuildLastPaidQueue();
+    }
 
-        //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
-        if(mnpayments.IsScheduled(mnpair.second, nBlockHeight)) continue;
+    // Only the oldest tenth of the network gets scored below, at least one node
+    int nTenthNetwork = nMnCount/10;
+    int nCandidates = std::max(nTenthNetwork, 1);
+
+    // candidates in payment order, flagged when they are old enough to pass the sigTime filter
+    std::vector<std::pair<CSmartnode*, bool> > vecSmartnodeLastPaid;
+    int nCountFiltered = 0;
+
+    for (int nPass = 0; nPass < 2; ++nPass) {
+        bool fStale = false;
+        vecSmartnodeLastPaid.clear();
+        nCountFiltered = 0;
+
+        for (const auto& entry : setLastPaidQueue) {
+            CSmartnode* pmn = Find(entry.second);
+            if (!pmn || pmn->GetLastPaidBlock() != entry.first) {
+                fStale = true;
+                break;
+            }
 
-        //it's too new, wait for a cycle
-        if(fFilterSigTime && mnpair.second.sigTime + int(nMnCount * 55 /  ( double( nPayoutsPerBlock ) / nPayoutInterval ) ) > GetAdjustedTime()) continue;
+            if(!pmn->IsValidForPayment()) continue;
 
-        //make sure it has at least as many confirmations as the smartnode cycle time
-        if(GetUTXOConfirmations(mnpair.first) < int(nMnCount / ( double( nPayoutsPerBlock ) / nPayoutInterval ) ) ) continue;
+            //check protocol version
+            if(pmn->nProtocolVersion < mnpayments.GetMinSmartnodePaymentsProto()) continue;
 
-        vecSmartnodeLastPaid.push_back(std::make_pair(mnpair.second.GetLastPaidBlock(), &mnpair.second));
-    }
+            if(setScheduled.count(GetScriptForDestination(pmn->pubKeyCollateralAddress.GetID()))) continue;
 
-    nCountRet = (int)vecSmartnodeLastPaid.size();
+            //make sure it has at least as many confirmations as the smartnode cycle time
+            if(GetCollateralConfirmations(entry.second) < nMinConfirmations) continue;
 
-    //when the network is in the process of upgrading, don't penalize nodes that recently restarted
-    if(fFilterSigTime && nCountRet < nMnCount/3)
-        return GetNextSmartnodesInQueueForPayment(nBlockHeight, false, nCountRet, mnInfoRet);
+            //it's too new, wait for a cycle
+            bool fSigTimeOk = pmn->sigTime <= nMaxSigTime;
+            if (fSigTimeOk) ++nCountFiltered;
+
+            vecSmartnodeLastPaid.push_back(std::make_pair(pmn, fSigTimeOk));
+
+            if (fCountAll) continue;
+
+            // Stop once the rest of the queue can't change the scored candidates. Without the
+            // sigTime filter these are the first ones. With it, nCountFiltered has to reach the
+            // share that turns the filter on (it only grows) and enough candidates must pass it.
+            if (!fFilterSigTime && (int)vecSmartnodeLastPaid.size() >= nCandidates) break;
+            if (fFilterSigTime && nCountFiltered >= nMnCount/3 && nCountFiltered >= nCandidates) break;
+        }
+
+        if (!fStale) break;
+
+        LogPrint("smartnode", "CSmartnodeMan::GetNextSmartnodesInQueueForPayment -- payment queue out of date, rebuilding\n");
+        RebuildLastPaidQueue();
+    }
 
-    // Sort them low to high
-    sort(vecSmartnodeLastPaid.begin(), vecSmartnodeLastPaid.end(), CompareLastPaidBlock());
+    //when the network is in the process of upgrading, don't penalize nodes that recently restarted
+    bool fFilter = fFilterSigTime && nCountFiltered >= nMnCount/3;
+    nCountRet = fFilter ? nCountFiltered : (int)vecSmartnodeLastPaid.size();
 
     uint256 blockHash;
     if(!GetBlockHash(blockHash, nBlockHeight - 101)) {
@@ -588,14 +632,14 @@ bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fF
     //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
     //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
     //  -- (chance per block * chances before IsScheduled will fire)
-    int nTenthNetwork = nMnCount/10;
     int nCountTenth = 0;
 
     std::vector<std::pair<arith_uint256, CSmartnode*>> vecTopTenthScores;
 
     for (const auto& s : vecSmartnodeLastPaid) {
-        arith_uint256 nScore = s.second->CalculateScore(blockHash);
-        vecTopTenthScores.push_back(std::make_pair(nScore,s.second));
+        if(fFilter && !s.second) continue;
+        arith_uint256 nScore = s.first->CalculateScore(blockHash);
+        vecTopTenthScores.push_back(std::make_pair(nScore,s.first));
         nCountTenth++;
         if(nCountTenth >= nTenthNetwork) break;
     }
@@ -617,6 +661,34 @@ bool CSmartnodeMan::GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fF
     return false;
 }
 
+void CSmartnodeMan::RebuildLastPaidQueue()
+{
+    AssertLockHeld(cs);
+
+    setLastPaidQueue.clear();
+    for (auto& mnpair : mapSmartnodes) {
+        setLastPaidQueue.insert(std::make_pair(mnpair.second.GetLastPaidBlock(), mnpair.first));
+    }
+}
+
+int CSmartnodeMan::GetCollateralConfirmations(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs);
+
+    if (!chainActive.Tip()) return -1;
+
+    std::map<COutPoint, int>::iterator it = mapCollateralHeights.find(outpoint);
+    if (it == mapCollateralHeights.end()) {
+        // -1 means UTXO is yet unknown or already spent, don't cache it
+        int nHeight = GetUTXOHeight(outpoint);
+        if (nHeight < 0) return -1;
+        it = mapCollateralHeights.insert(std::make_pair(outpoint, nHeight)).first;
+    }
+
+    return chainActive.Height() - it->second + 1;
+}
+
 bool CSmartnodeMan::GetSmartnodeScores(const uint256& nBlockHash, CSmartnodeMan::score_pair_vec_t& vecSmartnodeScoresRet, int nMinProtocol)
 {
     vecSmartnodeScoresRet.clear();
@@ -640,6 +712,53 @@ bool CSmartnodeMan::GetSmartnodeScores(const uint256& nBlockHash, CSmartnodeMan:
     return !vecSmartnodeScoresRet.empty();
 }
 
+CSmartnodeMan::rank_table_ptr_t CSmartnodeMan::GetRankTable(int nBlockHeight, int nMinProtocol)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs);
+
+    // make sure we know about this block
+    uint256 nBlockHash = uint256();
+    if (!GetBlockHash(nBlockHash, nBlockHeight)) {
+        LogPrintf("CSmartnodeMan::%s -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", __func__, nBlockHeight);
+        return nullptr;
+    }
+
+    std::pair<uint256, int> key = std::make_pair(nBlockHash, nMinProtocol);
+
+    rank_table_ptr_t pCached;
+    if (mapRankTables.Get(key, pCached) && pCached->nListGeneration == nListGeneration) {
+        mapRankTables.Touch(key);
+        return pCached;
+    }
+
+    // smartnode checks may bump the generation while we score, take it first
+    uint64_t nGeneration = nListGeneration;
+
+    score_pair_vec_t vecSmartnodeScores;
+    if (!GetSmartnodeScores(nBlockHash, vecSmartnodeScores, nMinProtocol))
+        return nullptr;
+
+    std::shared_ptr<CSmartnodeRankTable> pTable = std::make_shared<CSmartnodeRankTable>();
+    pTable->nListGeneration = nGeneration;
+    pTable->vecScores.reserve(vecSmartnodeScores.size());
+    pTable->vecRanks.reserve(vecSmartnodeScores.size());
+    pTable->mapRanks.reserve(vecSmartnodeScores.size());
+
+    int nRank = 0;
+    for (auto& scorePair : vecSmartnodeScores) {
+        int nRankEntry = scorePair.second->IsEnabled() ? ++nRank : MNPAYMENTS_NO_RANK;
+        pTable->vecScores.push_back(std::make_pair(scorePair.first, scorePair.second->vin.prevout));
+        pTable->vecRanks.push_back(nRankEntry);
+        pTable->mapRanks.emplace(scorePair.second->vin.prevout, nRankEntry);
+    }
+
+    mapRankTables.Erase(key);
+    mapRankTables.Insert(key, pTable);
+
+    return pTable;
+}
+
 bool CSmartnodeMan::GetSmartnodeRank(const COutPoint& outpoint, int& nRankRet, int nBlockHeight, int nMinProtocol)
 {
     nRankRet = -1;
@@ -647,16 +766,16 @@ bool CSmartnodeMan::GetSmartnodeRank(const COutPoint& outpoint, int& nRankRet, i
     if (!smartnodeSync.IsSmartnodeListSynced())
         return false;
 
-    CSmartnodeMan::rank_pair_vec_t vecSmartnodeRanks;
-    if (!GetSmartnodeRanks(vecSmartnodeRanks, nBlockHeight, nMinProtocol))
+    LOCK2(cs_main, cs);
+
+    rank_table_ptr_t pTable = GetRankTable(nBlockHeight, nMinProtocol);
+    if (!pTable)
         return false;
 
-    auto hasRank = std::find_if(vecSmartnodeRanks.begin(), vecSmartnodeRanks.end(), [outpoint](const CSmartnodeMan::rank_pair_t &rankPair) -> bool {
-        return outpoint == rankPair.second.vin.prevout;
-    });
+    auto hasRank = pTable->mapRanks.find(outpoint);
 
-    if( hasRank != vecSmartnodeRanks.end() ){
-        nRankRet = hasRank->first;
+    if( hasRank != pTable->mapRanks.end() ){
+        nRankRet = hasRank->second;
         return true;
     }
 
@@ -672,29 +791,22 @@ bool CSmartnodeMan::GetSmartnodeRanks(CSmartnodeMan::rank_pair_vec_t& vecSmartno
 
     LOCK2(cs_main, cs);
 
-    // make sure we know about this block
-    uint256 nBlockHash = uint256();
-    if (!GetBlockHash(nBlockHash, nBlockHeight)) {
-        LogPrintf("CSmartnodeMan::%s -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", __func__, nBlockHeight);
+    rank_table_ptr_t pTable = GetRankTable(nBlockHeight, nMinProtocol);
+    if (!pTable)
         return false;
-    }
-
-    score_pair_vec_t vecSmartnodeScores;
-    if (!GetSmartnodeScores(nBlockHash, vecSmartnodeScores, nMinProtocol))
-        return false;
-
-    int nRank = 0;
-    for (auto& scorePair : vecSmartnodeScores) {
 
-        if( scorePair.second->IsEnabled() ){
-            nRank++;
-            vecSmartnodeRanksRet.push_back(std::make_pair(nRank, *scorePair.second));
-        }else{
-            vecSmartnodeRanksRet.push_back(std::make_pair(MNPAYMENTS_NO_RANK, *scorePair.second));
+    // Ranked smartnodes are already in rank order, the unranked ones follow.
+    vecSmartnodeRanksRet.reserve(pTable->vecScores.size());
+    for (size_t i = 0; i < pTable->vecScores.size(); ++i) {
+        if (pTable->vecRanks[i] != MNPAYMENTS_NO_RANK) {
+            vecSmartnodeRanksRet.push_back(std::make_pair(pTable->vecRanks[i], pTable->vecScores[i].second));
+        }
+    }
+    for (size_t i = 0; i < pTable->vecScores.size(); ++i) {
+        if (pTable->vecRanks[i] == MNPAYMENTS_NO_RANK) {
+            vecSmartnodeRanksRet.push_back(std::make_pair(MNPAYMENTS_NO_RANK, pTable->vecScores[i].second));
         }
     }
-
-    std::sort(vecSmartnodeRanksRet.begin(), vecSmartnodeRanksRet.end(), CompareRankPair());
 
     return true;
 }
@@ -803,6 +915,11 @@ void CSmartnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
 
         int nDos = 0;
 
+        // recover the signing keys before cs_main is taken, the checks below are served from the signature cache
+        std::vector<CHashSignatureCheck> vChecks;
+        mnb.AddSignatureChecks(vChecks);
+        CHashSigner::VerifyHashes(vChecks);
+
         if (CheckMnbAndUpdateSmartnodeList(pfrom, mnb, nDos, connman)) {
             // use announced Smartnode as a peer
             connman.AddNewAddress(CAddress(mnb.addr, NODE_NETWORK), pfrom->addr, 2*60*60);
@@ -827,6 +944,11 @@ void CSmartnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
 
         LogPrint("smartnode", "MNPING -- Smartnode ping, smartnode=%s\n", mnp.outpoint.ToStringShort());
 
+        // recover the signing key before cs_main is taken, CheckAndUpdate is served from the signature cache
+        std::vector<CHashSignatureCheck> vChecks;
+        AddPingSignatureCheck(mnp, vChecks);
+        CHashSigner::VerifyHashes(vChecks);
+
         // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
         LOCK2(cs_main, cs);
 
@@ -882,12 +1004,19 @@ void CSmartnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
 
     } else if (strCommand == NetMsgType::MNVERIFY) { // Smartnode Verify
 
-        // Need LOCK2 here to ensure consistent locking order because the all functions below call GetBlockHash which locks cs_main
-        LOCK2(cs_main, cs);
-
         CSmartnodeVerification mnv;
         vRecv >> mnv;
 
+        // recover the signing keys of a broadcast before cs_main is taken, ProcessVerifyBroadcast is served from the signature cache
+        if (!mnv.vchSig1.empty() && !mnv.vchSig2.empty() && smartnodeSync.IsSmartnodeListSynced()) {
+            std::vector<CHashSignatureCheck> vChecks;
+            AddVerifyBroadcastSignatureChecks(mnv, vChecks);
+            CHashSigner::VerifyHashes(vChecks);
+        }
+
+        // Need LOCK2 here to ensure consistent locking order because the all functions below call GetBlockHash which locks cs_main
+        LOCK2(cs_main, cs);
+
         pfrom->setAskFor.erase(mnv.GetHash());
 
         if(!smartnodeSync.IsSmartnodeListSynced()) return;
@@ -995,14 +1124,14 @@ void CSmartnodeMan::DoFullVerificationStep(CConnman& connman)
     int nRanksTotal = (int)vecSmartnodeRanks.size();
 
     // send verify requests only if we are in top MAX_POSE_RANK
-    std::vector<std::pair<int, CSmartnode> >::iterator it = vecSmartnodeRanks.begin();
+    rank_pair_vec_t::iterator it = vecSmartnodeRanks.begin();
     while(it != vecSmartnodeRanks.end()) {
         if(it->first > MAX_POSE_RANK) {
             LogPrint("smartnode", "CSmartnodeMan::DoFullVerificationStep -- Must be in top %d to send verify request\n",
                         (int)MAX_POSE_RANK);
             return;
         }
-        if(it->second.vin.prevout == activeSmartnode.outpoint) {
+        if(it->second == activeSmartnode.outpoint) {
             nMyRank = it->first;
             LogPrint("smartnode", "CSmartnodeMan::DoFullVerificationStep -- Found self at rank %d/%d, verifying up to %d smartnodes\n",
                         nMyRank, nRanksTotal, (int)MAX_POSE_CONNECTIONS);
@@ -1028,20 +1157,23 @@ void CSmartnodeMan::DoFullVerificationStep(CConnman& connman)
 
     it = vecSmartnodeRanks.begin() + nOffset;
     while(it != vecSmartnodeRanks.end()) {
-        if(it->second.IsPoSeVerified() || it->second.IsPoSeBanned()) {
-            LogPrint("smartnode", "CSmartnodeMan::DoFullVerificationStep -- Already %s%s%s smartnode %s address %s, skipping...\n",
-                        it->second.IsPoSeVerified() ? "verified" : "",
-                        it->second.IsPoSeVerified() && it->second.IsPoSeBanned() ? " and " : "",
-                        it->second.IsPoSeBanned() ? "banned" : "",
-                        it->second.vin.prevout.ToStringShort(), it->second.addr.ToString());
+        CSmartnode* pmn = Find(it->second);
+        if(!pmn || pmn->IsPoSeVerified() || pmn->IsPoSeBanned()) {
+            if(pmn) {
+                LogPrint("smartnode", "CSmartnodeMan::DoFullVerificationStep -- Already %s%s%s smartnode %s address %s, skipping...\n",
+                            pmn->IsPoSeVerified() ? "verified" : "",
+                            pmn->IsPoSeVerified() && pmn->IsPoSeBanned() ? " and " : "",
+                            pmn->IsPoSeBanned() ? "banned" : "",
+                            it->second.ToStringShort(), pmn->addr.ToString());
+            }
             nOffset += MAX_POSE_CONNECTIONS;
             if(nOffset >= (int)vecSmartnodeRanks.size()) break;
             it += MAX_POSE_CONNECTIONS;
             continue;
         }
         LogPrint("smartnode", "CSmartnodeMan::DoFullVerificationStep -- Verifying smartnode %s rank %d/%d address %s\n",
-                    it->second.vin.prevout.ToStringShort(), it->first, nRanksTotal, it->second.addr.ToString());
-        if(SendVerifyRequest(CAddress(it->second.addr, NODE_NETWORK), vSortedByAddr, connman)) {
+                    it->second.ToStringShort(), it->first, nRanksTotal, pmn->addr.ToString());
+        if(SendVerifyRequest(CAddress(pmn->addr, NODE_NETWORK), vSortedByAddr, connman)) {
             nCount++;
             if(nCount >= MAX_POSE_CONNECTIONS) break;
         }
@@ -1311,6 +1443,31 @@ void CSmartnodeMan::ProcessVerifyReply(CNode* pnode, CSmartnodeVerification& mnv
     }
 }
 
+void CSmartnodeMan::AddPingSignatureCheck(const CSmartnodePing& mnp, std::vector<CHashSignatureCheck>& vChecks)
+{
+    LOCK(cs);
+    CSmartnode* pmn = Find(mnp.outpoint);
+    if(pmn) mnp.AddSignatureCheck(pmn->pubKeySmartnode, vChecks);
+}
+
+void CSmartnodeMan::AddVerifyBroadcastSignatureChecks(const CSmartnodeVerification& mnv, std::vector<CHashSignatureCheck>& vChecks)
+{
+    uint256 blockHash;
+    if(!GetBlockHash(blockHash, mnv.nBlockHeight)) return;
+
+    LOCK(cs);
+
+    // already processed, ProcessVerifyBroadcast won't look at the signatures again
+    if(mapSeenSmartnodeVerification.count(mnv.GetHash())) return;
+
+    CSmartnode* pmn1 = Find(mnv.vin1.prevout);
+    CSmartnode* pmn2 = Find(mnv.vin2.prevout);
+    if(!pmn1 || !pmn2) return;
+
+    vChecks.push_back(CHashSignatureCheck(CMessageSigner::GetMessageHash(mnv.GetSignatureMessage1(blockHash)), pmn1->pubKeySmartnode.GetID(), mnv.vchSig1));
+    vChecks.push_back(CHashSignatureCheck(CMessageSigner::GetMessageHash(mnv.GetSignatureMessage2(blockHash)), pmn2->pubKeySmartnode.GetID(), mnv.vchSig2));
+}
+
 void CSmartnodeMan::ProcessVerifyBroadcast(CNode* pnode, const CSmartnodeVerification& mnv)
 {
     AssertLockHeld(cs_main);
@@ -1363,9 +1520,8 @@ void CSmartnodeMan::ProcessVerifyBroadcast(CNode* pnode, const CSmartnodeVerific
     {
         LOCK(cs);
 
-        std::string strMessage1 = strprintf("%s%d%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString());
-        std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(false), mnv.nonce, blockHash.ToString(),
-                                mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
+        std::string strMessage1 = mnv.GetSignatureMessage1(blockHash);
+        std::string strMessage2 = mnv.GetSignatureMessage2(blockHash);
 
         CSmartnode* pmn1 = Find(mnv.vin1.prevout);
         if(!pmn1) {
@@ -1595,7 +1751,12 @@ void CSmartnodeMan::UpdateLastPaid(const CBlockIndex* pindex)
     //                         nCachedBlockHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
 
     for (auto& mnpair: mapSmartnodes) {
+        int nLastPaidBlock = mnpair.second.GetLastPaidBlock();
         mnpair.second.UpdateLastPaid(pindex, nMaxBlocksToScanBack);
+        if (mnpair.second.GetLastPaidBlock() != nLastPaidBlock) {
+            setLastPaidQueue.erase(std::make_pair(nLastPaidBlock, mnpair.first));
+            setLastPaidQueue.insert(std::make_pair(mnpair.second.GetLastPaidBlock(), mnpair.first));
+        }
     }
 
     IsFirstRun = false;
@@ -1679,6 +1840,15 @@ void CSmartnodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
     nCachedBlockHeight = pindex->nHeight;
     LogPrint("smartnode", "CSmartnodeMan::UpdatedBlockTip -- nCachedBlockHeight=%d\n", nCachedBlockHeight);
 
+    {
+        LOCK(cs);
+        // collateral heights may be gone after a reorg
+        if (pindex->pprev != pindexCollateralTip) {
+            mapCollateralHeights.clear();
+        }
+        pindexCollateralTip = pindex;
+    }
+
     CheckSameAddr();
 
     if(fSmartNode) {
@@ -1687,6 +1857,20 @@ void CSmartnodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
     }
 }
 
+void CSmartnodeMan::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
+{
+    // only transactions in a connected block spend collaterals
+    if (!pblock || tx.IsCoinBase()) return;
+
+    LOCK(cs);
+
+    if (mapCollateralHeights.empty()) return;
+
+    for (const auto& txin : tx.vin) {
+        mapCollateralHeights.erase(txin.prevout);
+    }
+}
+
 void CSmartnodeMan::NotifySmartnodeUpdates(CConnman& connman)
 {
     // Avoid double locking
@@ -6,8 +6,12 @@
 #define SMARTNODEMAN_H
 
 #include "smartnode.h"
+#include "../cachemap.h"
 #include "../sync.h"
 
+#include <atomic>
+#include <memory>
+
 using namespace std;
 
 class CSmartnodeMan;
@@ -16,15 +20,30 @@ struct CSmartNodeWinners;
 
 extern CSmartnodeMan mnodeman;
 
+/// Smartnode ranks for one block hash and minimum protocol version
+struct CSmartnodeRankTable
+{
+    /// Scores of the considered smartnodes, best first
+    std::vector<std::pair<arith_uint256, COutPoint> > vecScores;
+    /// Ranks in the order of vecScores
+    std::vector<int> vecRanks;
+    /// Rank lookup by outpoint
+    std::unordered_map<COutPoint, int, SaltedOutpointHasher> mapRanks;
+    /// List generation the table was built at, it is stale once the list changed
+    uint64_t nListGeneration;
+};
+
 class CSmartnodeMan
 {
 public:
     typedef std::pair<arith_uint256, CSmartnode*> score_pair_t;
     typedef std::vector<score_pair_t> score_pair_vec_t;
-    typedef std::pair<int, CSmartnode> rank_pair_t;
+    typedef std::pair<int, COutPoint> rank_pair_t;
     typedef std::vector<rank_pair_t> rank_pair_vec_t;
 
 private:
+    typedef std::shared_ptr<const CSmartnodeRankTable> rank_table_ptr_t;
+
     static const std::string SERIALIZATION_VERSION_STRING;
 
     static const int DSEG_UPDATE_SECONDS        = 3 * 60 * 60;
@@ -42,6 +61,8 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    static const int RANK_CACHE_SIZE                = 32;
+
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
@@ -77,11 +98,30 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    // most recently used rank tables by block hash and minimum protocol version
+    CacheMap<std::pair<uint256, int>, rank_table_ptr_t> mapRankTables;
+    // bumped whenever smartnode ranks may change: a node is added or removed, its enabled
+    // state or protocol version changes or its collateral confirmation block changes
+    std::atomic<uint64_t> nListGeneration;
+
+    // smartnodes ordered by last paid block and collateral outpoint
+    std::set<std::pair<int, COutPoint> > setLastPaidQueue;
+    // confirmed collateral heights, valid as long as the chain only grows from pindexCollateralTip,
+    // spent collaterals are dropped as their blocks connect
+    std::map<COutPoint, int> mapCollateralHeights;
+    const CBlockIndex* pindexCollateralTip;
+
     friend class CSmartnodeSync;
     /// Find an entry
     CSmartnode* Find(const COutPoint& outpoint);
 
     bool GetSmartnodeScores(const uint256& nBlockHash, score_pair_vec_t& vecSmartnodeScoresRet, int nMinProtocol = 0);
+    /// Return the cached rank table of a block height or build it, requires cs_main and cs
+    rank_table_ptr_t GetRankTable(int nBlockHeight, int nMinProtocol);
+    /// Rebuild the payment queue from the current last paid blocks, requires cs
+    void RebuildLastPaidQueue();
+    /// Return the confirmations of a smartnode's collateral or -1 if unknown, requires cs_main and cs
+    int GetCollateralConfirmations(const COutPoint& outpoint);
 
 public:
     // Keep track of all broadcasts I've seen
@@ -119,6 +159,9 @@ public:
 
         READWRITE(mapSeenSmartnodeBroadcast);
         READWRITE(mapSeenSmartnodePing);
+        if(ser_action.ForRead()) {
+            BumpListGeneration();
+        }
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
         }
@@ -167,15 +210,18 @@ public:
     /// Versions of Find that are safe to use from outside the class
     bool Get(const COutPoint& outpoint, CSmartnode& smartnodeRet);
     bool Has(const COutPoint& outpoint);
+    /// Whether an enabled smartnode runs on this address, any port
+    bool HasAddress(const CNetAddr& addr);
 
     bool GetSmartnodeInfo(const COutPoint& outpoint, smartnode_info_t& mnInfoRet);
     bool GetSmartnodeInfo(const CPubKey& pubKeySmartnode, smartnode_info_t& mnInfoRet);
     bool GetSmartnodeInfo(const CScript& payee, smartnode_info_t& mnInfoRet);
 
-    /// Find an entry in the smartnode list that is next to be paid
-    bool GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCountRet, CSmartNodeWinners& mnInfoRet);
+    /// Find an entry in the smartnode list that is next to be paid, the payment queue is only walked
+    /// up to the candidates it needs unless fCountAll is set, nCountRet is complete only with fCountAll
+    bool GetNextSmartnodesInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCountRet, CSmartNodeWinners& mnInfoRet, bool fCountAll = false);
     /// Same as above but use current block height
-    bool GetNextSmartnodesInQueueForPayment(bool fFilterSigTime, int& nCountRet, CSmartNodeWinners& mnInfoRet);
+    bool GetNextSmartnodesInQueueForPayment(bool fFilterSigTime, int& nCountRet, CSmartNodeWinners& mnInfoRet, bool fCountAll = false);
 
     /// Find a random entry
     std::map<COutPoint, CSmartnode> GetFullSmartnodeMap() { return mapSmartnodes; }
@@ -196,6 +242,10 @@ public:
     void SendVerifyReply(CNode* pnode, CSmartnodeVerification& mnv, CConnman& connman);
     void ProcessVerifyReply(CNode* pnode, CSmartnodeVerification& mnv);
     void ProcessVerifyBroadcast(CNode* pnode, const CSmartnodeVerification& mnv);
+    /// Queue the check of the signature of a ping from a known smartnode, see CHashSigner::VerifyHashes
+    void AddPingSignatureCheck(const CSmartnodePing& mnp, std::vector<CHashSignatureCheck>& vChecks);
+    /// Queue the checks of the signatures of a verification broadcast, see CHashSigner::VerifyHashes
+    void AddVerifyBroadcastSignatureChecks(const CSmartnodeVerification& mnv, std::vector<CHashSignatureCheck>& vChecks);
 
     /// Return the number of (unique) Smartnodes
     int size() { return mapSmartnodes.size(); }
@@ -210,6 +260,9 @@ public:
 
     void UpdateLastPaid(const CBlockIndex* pindex);
 
+    /// Invalidate the cached rank tables, called whenever the smartnode list changes
+    void BumpListGeneration() { ++nListGeneration; }
+
     void AddDirtyGovernanceObjectHash(const uint256& nHash)
     {
         LOCK(cs);
@@ -235,6 +288,8 @@ public:
     void SetSmartnodeLastPing(const COutPoint& outpoint, const CSmartnodePing& mnp);
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
+    /// Forget the cached collateral heights of the outputs a connected transaction spends
+    void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
 
     /**
      * Called to notify CSmartVotingManager that the smartnode index has been updated.
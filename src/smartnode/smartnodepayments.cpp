@@ -514,6 +514,26 @@ bool CSmartnodePayments::IsScheduled(CSmartnode& mn, int nNotBlockHeight)
     return false;
 }
 
+void CSmartnodePayments::GetScheduledPayees(int nNotBlockHeight, std::set<CScript>& setPayeesRet)
+{
+    LOCK(cs_mapSmartnodeBlocks);
+
+    setPayeesRet.clear();
+
+    if(!smartnodeSync.IsSmartnodeListSynced()) return;
+
+    CScriptVector payees;
+    int interval = SmartNodePayments::PayoutInterval(nCachedBlockHeight);
+
+    for(int64_t h = nCachedBlockHeight; h <= nCachedBlockHeight + MNPAYMENTS_FUTURE_VOTES + interval - 1; h++){
+        interval = SmartNodePayments::PayoutInterval(h);
+        if(h == nNotBlockHeight) continue;
+        if(mapSmartnodeBlocks.count(h) && mapSmartnodeBlocks[h].GetBestPayees(payees)) {
+            setPayeesRet.insert(payees.begin(), payees.end());
+        }
+    }
+}
+
 bool CSmartnodePayments::AddOrUpdatePaymentVote(const CSmartnodePaymentVote& vote)
 {
     uint256 blockHash = uint256();
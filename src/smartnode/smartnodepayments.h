@@ -241,6 +241,8 @@ public:
     bool GetBlockPayees(int nBlockHeight, CScriptVector& payees);
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight, CAmount expectedNodeReward);
     bool IsScheduled(CSmartnode& mn, int nNotBlockHeight);
+    /// Collect the payees voted for the upcoming blocks except nNotBlockHeight
+    void GetScheduledPayees(int nNotBlockHeight, std::set<CScript>& setPayeesRet);
 
     bool UpdateLastVote(const CSmartnodePaymentVote& vote);
 
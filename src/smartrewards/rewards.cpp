@@ -5,6 +5,7 @@
 #include "smartrewards/rewards.h"
 #include "consensus/consensus.h"
 #include "init.h"
+#include "paralleltask.h"
 #include "rewards.h"
 #include "script/standard.h"
 #include "smarthive/hive.h"
@@ -16,10 +17,11 @@
 
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/range/irange.hpp>
-#include <boost/thread.hpp>
 
 #define REWARDS_MAX_CACHE        400000000UL     // 400MB
 #define SUPER_REWARDS_MIN_BALANCE_1_3 (999999 * COIN) // Reduce by 1 to allow for activation fee
+#define REWARDS_PARALLEL_MIN_ITEMS 10000
+#define REWARDS_PARALLEL_MIN_UPDATES 1000
 
 CSmartRewards* prewards = NULL;
 
@@ -47,6 +49,16 @@ struct ComparePaymentPrtList {
     }
 };
 
+// Number of threads used for nItems of round evaluation work, -par threads for large sets.
+static int GetRewardsThreads(size_t nItems)
+{
+    if (nItems < REWARDS_PARALLEL_MIN_ITEMS) {
+        return 1;
+    }
+
+    return GetParallelTaskThreads();
+}
+
 // Estimate or return the current block height.
 int GetBlockHeight(const CBlockIndex* index)
 {
@@ -164,19 +176,10 @@ void CSmartRewards::EvaluateRound(CSmartRewardRound &next)
     pResult->round.UpdatePayoutParameter();
 
     CAmount nReward;
-    CSmartRewardEntryMap tmpEntries;
-    pdb->ReadRewardEntries(tmpEntries);
-
-    for( auto itDb = tmpEntries.begin(); itDb != tmpEntries.end(); ++itDb){
+    CSmartRewardEntryStore* pEntries = cache.GetEntries();
 
-        auto itCache = cache.GetEntries()->find(itDb->first);
-
-        if( itCache == cache.GetEntries()->end() ){
-            cache.AddEntry(itDb->second);
-        }else{
-            delete itDb->second;
-        }
-    }
+    // All entries get touched below, they all need to be written with the next sync.
+    pEntries->MarkAllDirty();
 
     if( round->number >= nFirst_1_3_Round ) {
         int64_t nTime = GetTime();
@@ -187,52 +190,93 @@ void CSmartRewards::EvaluateRound(CSmartRewardRound &next)
         int64_t nStartHeight = next.startBlockHeight;
         while( nStartHeight <= next.endBlockHeight) next.rewards += GetBlockValue(nStartHeight++, 0, nTime) * dBlockReward;
 
-        // Compute payouts for current ending round
-        auto entry = cache.GetEntries()->begin();
-        while(entry != cache.GetEntries()->end() ) {
-            nReward = entry->second->IsEligible() ? CAmount(entry->second->balanceEligible * round->percent) : 0;
-            pResult->results.push_back(new CSmartRewardResultEntry(entry->second, nReward));
-            if( nReward ){
-                pResult->payouts.push_back(pResult->results.back());
-            }
-//            if (round->number < Params().GetConsensus().nRewardsFirst_2_0_Round/* || entry->second->fActivated*/ ) {
-                // Reset outgoing transaction with every cycle.
-                entry->second->disqualifyingTx.SetNull();
-                entry->second->fDisqualifyingTx = false;
-
-                // Reset SmartNode payment tx with every cycle in case a node was shut down during the cycle.
-                entry->second->smartnodePaymentTx.SetNull();
-                entry->second->fSmartnodePaymentTx = false;
-  //          }
-            // Reset the vote proof tx 2 cycles before the first 1.3 round.
-            ++entry;
+        int64_t nTimeStart = GetTimeMicros();
+
+        // Compute payouts for current ending round. Each thread processes a range of
+        // store slots, the ranges get joined in slot order afterwards.
+        size_t nSlots = pEntries->SlotCount();
+        int nThreads = GetRewardsThreads(nSlots);
+        std::vector<CSmartRewardResultEntryPtrList> vecResults(nThreads);
+        std::vector<CSmartRewardResultEntryPtrList> vecPayouts(nThreads);
+        double dPercent = round->percent;
+
+        ParallelForRanges(nSlots, nThreads, [&](size_t nBegin, size_t nEnd, int nPart) {
+            pEntries->ForEach(nBegin, nEnd, [&](CSmartRewardEntry& entry) {
+                CAmount nReward = entry.IsEligible() ? CAmount(entry.balanceEligible * dPercent) : 0;
+                vecResults[nPart].push_back(new CSmartRewardResultEntry(&entry, nReward));
+                if( nReward ){
+                    vecPayouts[nPart].push_back(vecResults[nPart].back());
+                }
+//                if (round->number < Params().GetConsensus().nRewardsFirst_2_0_Round/* || entry.fActivated*/ ) {
+                    // Reset outgoing transaction with every cycle.
+                    entry.disqualifyingTx.SetNull();
+                    entry.fDisqualifyingTx = false;
+
+                    // Reset SmartNode payment tx with every cycle in case a node was shut down during the cycle.
+                    entry.smartnodePaymentTx.SetNull();
+                    entry.fSmartnodePaymentTx = false;
+  //              }
+                // Reset the vote proof tx 2 cycles before the first 1.3 round.
+            });
+        });
+
+        pResult->results.reserve(pEntries->Size());
+        for (int nPart = 0; nPart < nThreads; ++nPart) {
+            pResult->results.insert(pResult->results.end(), vecResults[nPart].begin(), vecResults[nPart].end());
+            pResult->payouts.insert(pResult->payouts.end(), vecPayouts[nPart].begin(), vecPayouts[nPart].end());
         }
 
+        int64_t nTimeResults = GetTimeMicros();
+
         if( pResult->payouts.size() ){
             uint256 blockHash;
             if(!GetBlockHash(blockHash, pResult->round.startBlockHeight)) {
                 throw std::runtime_error(strprintf("CSmartRewards::EvaluateRound -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", round->startBlockHeight));
             }
 
-            std::vector<std::pair<arith_uint256, CSmartRewardResultEntry*>> vecScores;
             // Since we use payouts stretched out over a week better to have some "random" sort here
             // based on a score calculated with the round start's blockhash.
-            CSmartRewardResultEntryPtrList::iterator it = pResult->payouts.begin();
+            size_t nPayouts = pResult->payouts.size();
+            std::vector<std::pair<arith_uint256, CSmartRewardResultEntry*>> vecScores(nPayouts);
 
-            while( it != pResult->payouts.end() ){
-                arith_uint256 nScore = (*it)->CalculateScore(blockHash);
-                vecScores.push_back(std::make_pair(nScore,*it));
-                ++it;
-            }
+            nThreads = GetRewardsThreads(nPayouts);
 
-            std::sort(vecScores.begin(), vecScores.end(), CompareRewardScore());
+            // Score and sort consecutive partitions in parallel and merge them afterwards.
+            // Scores are hashes over the unique entry ids, so the order is strict and
+            // the result the same as sorting the whole list at once.
+            ParallelForRanges(nPayouts, nThreads, [&](size_t nBegin, size_t nEnd, int nPart) {
+                for (size_t i = nBegin; i < nEnd; ++i) {
+                    vecScores[i] = std::make_pair(pResult->payouts[i]->CalculateScore(blockHash), pResult->payouts[i]);
+                }
+                std::sort(vecScores.begin() + nBegin, vecScores.begin() + nEnd, CompareRewardScore());
+            });
+
+            int64_t nTimeScores = GetTimeMicros();
+
+            size_t nChunk = (nPayouts + nThreads - 1) / nThreads;
+            for (size_t nWidth = nChunk; nWidth < nPayouts; nWidth *= 2) {
+                for (size_t nBegin = 0; nBegin + nWidth < nPayouts; nBegin += 2 * nWidth) {
+                    std::inplace_merge(vecScores.begin() + nBegin,
+                                       vecScores.begin() + nBegin + nWidth,
+                                       vecScores.begin() + std::min(nPayouts, nBegin + 2 * nWidth),
+                                       CompareRewardScore());
+                }
+            }
 
             pResult->payouts.clear();
 
             for(auto s : vecScores)
                 pResult->payouts.push_back(s.second);
+
+            LogPrint("smartrewards-block", "CSmartRewards::EvaluateRound - Scored %d payouts with %d threads in %.2fms, merged in %.2fms\n",
+                     nPayouts, nThreads, (nTimeScores - nTimeResults) * 0.001, (GetTimeMicros() - nTimeScores) * 0.001);
         }
 
+        LogPrint("smartrewards-block", "CSmartRewards::EvaluateRound - Round %d results for %d entries in %.2fms\n",
+                 round->number, pResult->results.size(), (nTimeResults - nTimeStart) * 0.001);
+
+        int64_t nTimeEligible = GetTimeMicros();
+
         // Look for entries eligible to the next round
         std::list<CSmartAddress> eligibleAddresses;
         next.eligibleSmart = 0;
@@ -240,54 +284,54 @@ void CSmartRewards::EvaluateRound(CSmartRewardRound &next)
 //        next.disqualifiedEntries = 0;
 //        next.disqualifiedSmart = 0;
 
-        entry = cache.GetEntries()->begin();
-        while(entry != cache.GetEntries()->end() ) {
-            if( entry->second->balance >= nMinBalance && !SmartHive::IsHive(entry->second->id) && 
-            !entry->second->fSmartnodePaymentTx && !entry->second->fDisqualifyingTx && entry->second->fActivated ) {
-                entry->second->balanceEligible = entry->second->balance;
-                next.eligibleSmart += entry->second->balanceEligible;
+        pEntries->ForEach([&](CSmartRewardEntry& entry) {
+            if( entry.balance >= nMinBalance && !SmartHive::IsHive(entry.id) && 
+            !entry.fSmartnodePaymentTx && !entry.fDisqualifyingTx && entry.fActivated ) {
+                entry.balanceEligible = entry.balance;
+                next.eligibleSmart += entry.balanceEligible;
                 ++next.eligibleEntries;
-                eligibleAddresses.push_back(entry->first);
+                eligibleAddresses.push_back(entry.id);
             } else {
-                entry->second->balanceEligible = 0;
+                entry.balanceEligible = 0;
             }
-            entry->second->balanceAtStart = entry->second->balance;
-            ++entry;
-        }
+            entry.balanceAtStart = entry.balance;
+        });
 
         // Check back all the 4 previous rounds for adding weighted balance if applicable
         if (next.number - 1 >= nFirst_1_3_Round && !eligibleAddresses.empty()) {
             int roundNumber = next.number - 1;
             while ((roundNumber >= nFirst_1_3_Round) && (roundNumber >= next.number - 4)) {
                 CSmartRewardResultEntryList results;
+                std::unordered_map<CSmartAddress, const CSmartRewardResultEntry*, CSmartAddressHasher> mapResults;
                 if (roundNumber == round->number) {
-                    // Need to convert pointers list into objects list
-                    results.reserve(pResult->results.size());
-                    std::for_each(pResult->results.begin(), pResult->results.end(),
-                            [&results] (const CSmartRewardResultEntry *e) {
-                          results.push_back(*e);
-                    });
+                    mapResults.reserve(pResult->results.size());
+                    for (const CSmartRewardResultEntry* e : pResult->results) {
+                        mapResults.emplace(e->entry.id, e);
+                    }
                 } else {
                     if (!GetRewardRoundResults(roundNumber, results)) {
                         break;
                     }
+                    mapResults.reserve(results.size());
+                    for (const CSmartRewardResultEntry& e : results) {
+                        mapResults.emplace(e.entry.id, &e);
+                    }
                 }
 
                 // Iterate over all still eligible addresses
                 auto address = eligibleAddresses.begin();
                 while (address != eligibleAddresses.end()) {
                     // Look for address in the round results
-                    auto addressResult = std::find_if(results.begin(), results.end(),
-                        [&address](const CSmartRewardResultEntry& e) -> bool {
-                            return *address == e.entry.id;
-                    });
+                    auto itResult = mapResults.find(*address);
 
                     // If address was not in last round result => remove from list
-                    if (addressResult == results.end()) {
+                    if (itResult == mapResults.end()) {
                         address = eligibleAddresses.erase(address);
                         continue;
                     }
 
+                    const CSmartRewardResultEntry* addressResult = itResult->second;
+
                     // If the address balance was not eligible => remove from list
                     if (!addressResult->entry.balanceEligible) {
                         address = eligibleAddresses.erase(address);
@@ -295,7 +339,7 @@ void CSmartRewards::EvaluateRound(CSmartRewardRound &next)
                     }
 
                     // Calculate bonus based on current round eligibility
-                    auto &cacheEntry = cache.GetEntries()->at(*address);
+                    CSmartRewardEntry* cacheEntry = pEntries->Find(*address, false);
                     if (roundNumber == next.number - 1) {
                         if (addressResult->entry.balance > SUPER_REWARDS_MIN_BALANCE_1_3) {
                             next.eligibleSmart += addressResult->entry.balance;
@@ -330,6 +374,9 @@ void CSmartRewards::EvaluateRound(CSmartRewardRound &next)
             }
         }
 
+        LogPrint("smartrewards-block", "CSmartRewards::EvaluateRound - Round %d eligibility for %d entries in %.2fms\n",
+                 next.number, next.eligibleEntries, (GetTimeMicros() - nTimeEligible) * 0.001);
+
         if( pResult->round.number ){
             cache.AddFinishedRound(pResult->round);
         }
@@ -338,48 +385,46 @@ void CSmartRewards::EvaluateRound(CSmartRewardRound &next)
         cache.SetCurrentRound(next);
 
     } else if( round->number && ( round->number < nFirst_1_3_Round )){
-        auto entry = cache.GetEntries()->begin();
-        while(entry != cache.GetEntries()->end() ) {
-
-            nReward = entry->second->balanceEligible > 0 && !entry->second->fDisqualifyingTx ? CAmount(entry->second->balanceEligible * round->percent) : 0;
+        pResult->results.reserve(pEntries->Size());
+        pEntries->ForEach([&](CSmartRewardEntry& entry) {
+            nReward = entry.balanceEligible > 0 && !entry.fDisqualifyingTx ? CAmount(entry.balanceEligible * round->percent) : 0;
 
-            pResult->results.push_back(new CSmartRewardResultEntry(entry->second, nReward));
+            pResult->results.push_back(new CSmartRewardResultEntry(&entry, nReward));
 
             if( nReward ){
                 pResult->payouts.push_back(pResult->results.back());
             }
 
-            entry->second->balanceAtStart = entry->second->balance;
+            entry.balanceAtStart = entry.balance;
 
-            if( entry->second->balance >= nMinBalance && !SmartHive::IsHive(entry->second->id) ){
-                entry->second->balanceEligible = entry->second->balance;
+            if( entry.balance >= nMinBalance && !SmartHive::IsHive(entry.id) ){
+                entry.balanceEligible = entry.balance;
             }else{
-                entry->second->balanceEligible = 0;
+                entry.balanceEligible = 0;
             }
 
             // Reset outgoing transaction with every cycle.
-            entry->second->disqualifyingTx.SetNull();
-            entry->second->fDisqualifyingTx = false;
+            entry.disqualifyingTx.SetNull();
+            entry.fDisqualifyingTx = false;
 
             // Reset SmartNode payment tx with every cycle in case a node was shut down during the cycle.
-            entry->second->smartnodePaymentTx.SetNull();
-            entry->second->fSmartnodePaymentTx = false;
+            entry.smartnodePaymentTx.SetNull();
+            entry.fSmartnodePaymentTx = false;
 
-            if( entry->second->balanceEligible ){
+            if( entry.balanceEligible ){
                 ++next.eligibleEntries;
-                next.eligibleSmart += entry->second->balanceEligible;
+                next.eligibleSmart += entry.balanceEligible;
             }
 
             // Reset activations and reset eligible before 1.3 round starts.
             if( next.number == (nFirst_1_3_Round) ){
-                entry->second->activationTx.SetNull();
-                entry->second->fActivated = false;
-                entry->second->bonusLevel = CSmartRewardEntry::NotEligible;
+                entry.activationTx.SetNull();
+                entry.fActivated = false;
+                entry.bonusLevel = CSmartRewardEntry::NotEligible;
                 next.eligibleEntries = 0;
                 next.eligibleSmart = 0;
             }
-            ++entry;
-        }
+        });
 
         if( pResult->payouts.size() ){
             // Sort it to make sure the slices are the same network wide.
@@ -444,30 +489,18 @@ bool CSmartRewards::GetRewardEntry(const CSmartAddress& id, CSmartRewardEntry*&
 {
     LOCK(cs_rewardscache);
 
-    // Return the entry if its already in cache.
-    auto it = cache.GetEntries()->find(id);
-
-    if (it != cache.GetEntries()->end()) {
-        entry = it->second;
-        return true;
-    }
-
-    entry = new CSmartRewardEntry(id);
+    // All entries are held in memory, the database is only written.
+    entry = cache.GetEntries()->Find(id, true);
 
-    // Return the entry if its already in db.
-    if (pdb->ReadRewardEntry(id, *entry)) {
-        cache.AddEntry(entry);
+    if (entry) {
         return true;
     }
 
     if (fCreate) {
-        cache.AddEntry(entry);
+        entry = cache.GetEntries()->Insert(CSmartRewardEntry(id));
         return true;
     }
 
-    delete entry;
-    entry = nullptr;
-
     return false;
 }
 
@@ -503,12 +536,6 @@ bool CSmartRewards::GetTermRewardEntry(const std::pair<CSmartAddress, uint256>&
     return false;
 }
 
-bool CSmartRewards::GetRewardEntries(CSmartRewardEntryMap& entries)
-{
-    LOCK(cs_rewardsdb);
-    return pdb->ReadRewardEntries(entries);
-}
-
 bool CSmartRewards::GetTermRewardsEntries(CTermRewardEntryMap& entries)
 {
     LOCK(cs_rewardsdb);
@@ -520,7 +547,7 @@ bool CSmartRewards::SyncCached()
     LOCK2(cs_rewardscache, cs_rewardsdb);
 
     int nTimeStart = GetTimeMicros();
-    int nEntriesPre = cache.GetEntries()->size();
+    int nEntriesPre = cache.GetEntries()->DirtySize();
     int nSizePre = cache.EstimatedSize();
 
     bool ret = pdb->SyncCached(cache);
@@ -529,10 +556,10 @@ bool CSmartRewards::SyncCached()
 
     int nTimeDone = GetTimeMicros();
 
-    int nEntriesPost = cache.GetEntries()->size();
+    int nEntriesPost = cache.GetEntries()->DirtySize();
     int nSizePost = cache.EstimatedSize();
 
-    LogPrint("smartrewards-bench", "CSmartRewards::SyncCached size before/after %dMB/%dMB, entries before/after %d/%d, time %.2fms", nSizePre / 1000000, nSizePost / 1000000, nEntriesPre, nEntriesPost, (nTimeDone - nTimeStart) * 0.001);
+    LogPrint("smartrewards-bench", "CSmartRewards::SyncCached size before/after %dMB/%dMB, modified entries before/after %d/%d, entries %d, time %.2fms\n", nSizePre / 1000000, nSizePost / 1000000, nEntriesPre, nEntriesPost, cache.GetEntries()->Size(), (nTimeDone - nTimeStart) * 0.001);
 
     return ret;
 }
@@ -575,6 +602,14 @@ CSmartRewards::CSmartRewards(CSmartRewardsDB* prewardsdb) : pdb(prewardsdb)
 
     cache.Load(block, round, rounds);
 
+    int64_t nTimeStart = GetTimeMicros();
+
+    if (!pdb->ReadRewardEntries(*cache.GetEntries())) {
+        throw std::runtime_error("CSmartRewards::CSmartRewards -- ERROR: Failed to read the reward entries");
+    }
+
+    LogPrintf("CSmartRewards::CSmartRewards Loaded %d reward entries in %.2fms\n", cache.GetEntries()->Size(), (GetTimeMicros() - nTimeStart) * 0.001);
+
     CSmartRewardsRoundResult* pResult = new CSmartRewardsRoundResult();
 
     if (round.number > 1) {
@@ -625,22 +660,63 @@ const CSmartRewardRoundMap* CSmartRewards::GetRewardRounds()
     return cache.GetRounds();
 }
 
-void CSmartRewards::ProcessInput(const CTransaction& tx, const CTxOut& in, int txHeight, uint16_t nCurrentRound, CSmartRewardsUpdateResult& result)
+void CSmartRewards::ProcessUpdates(CBlockIndex* pIndex, const std::vector<CSmartRewardsUpdate>& vUpdates, uint16_t nCurrentRound, CSmartRewardsUpdateResult& result)
 {
-    uint16_t nFirst_1_3_Round = Params().GetConsensus().nRewardsFirst_1_3_Round;
-    CSmartRewardEntry* rEntry = nullptr;
-    CSmartAddress id;
+    if (vUpdates.empty()) return;
 
-    if (!ExtractDestination(in.scriptPubKey, id)) {
-        LogPrint("smartrewards-tx", "CSmartRewards::ProcessInput - Could't parse CSmartAddress: %s\n", in.ToString());
-        return;
+    // The script and pubkey work of the updates doesn't need the cache, do it in parallel first.
+    std::vector<CSmartRewardsUpdateKey> vKeys(vUpdates.size());
+    int nThreads = vUpdates.size() < REWARDS_PARALLEL_MIN_UPDATES ? 1 : GetParallelTaskThreads();
+
+    ParallelForRanges(vUpdates.size(), nThreads, [&](size_t nBegin, size_t nEnd, int nPart) {
+        for (size_t i = nBegin; i < nEnd; ++i) {
+            vKeys[i].fValid = ExtractDestination(vUpdates[i].txOut.scriptPubKey, vKeys[i].id);
+            vKeys[i].fActivationTx = vUpdates[i].pTx->IsActivationTx();
+        }
+    });
+
+    // Take the cache lock once for the whole block and look up every address only once.
+    LOCK(cs_rewardscache);
+
+    std::unordered_map<CSmartAddress, CSmartRewardEntry*, CSmartAddressHasher> mapEntries;
+    for (const CSmartRewardsUpdateKey& key : vKeys) {
+        if (key.fValid && !mapEntries.count(key.id)) {
+            CSmartRewardEntry* rEntry = nullptr;
+            GetRewardEntry(key.id, rEntry, false);
+            mapEntries.emplace(key.id, rEntry);
+        }
     }
 
-    if (!GetRewardEntry(id, rEntry, false)) {
-        return;
+    // Later updates of an address depend on the state left by the earlier ones, apply them in block order.
+    for (size_t i = 0; i < vUpdates.size(); ++i) {
+        const CSmartRewardsUpdate& update = vUpdates[i];
+        const CSmartRewardsUpdateKey& key = vKeys[i];
+
+        if (!key.fValid) {
+            LogPrint("smartrewards-tx", "CSmartRewards::ProcessUpdates - Could't parse CSmartAddress: %s\n", update.txOut.ToString());
+            continue;
+        }
+
+        CSmartRewardEntry*& rEntry = mapEntries[key.id];
+
+        if (update.fInput) {
+            if (rEntry) {
+                ProcessInput(*update.pTx, update.txOut, update.nHeight, key.fActivationTx, rEntry, nCurrentRound, result);
+            }
+        } else {
+            if (!rEntry) {
+                GetRewardEntry(key.id, rEntry, true);
+            }
+            ProcessOutput(*update.pTx, update.txOut, key.id, key.fActivationTx, rEntry, nCurrentRound, pIndex->nHeight, pIndex->nTime, result);
+        }
     }
+}
+
+void CSmartRewards::ProcessInput(const CTransaction& tx, const CTxOut& in, int txHeight, bool fActivationTx, CSmartRewardEntry* rEntry, uint16_t nCurrentRound, CSmartRewardsUpdateResult& result)
+{
+    uint16_t nFirst_1_3_Round = Params().GetConsensus().nRewardsFirst_1_3_Round;
 
-    if (nCurrentRound >= nFirst_1_3_Round && tx.IsActivationTx() && !rEntry->fActivated) {
+    if (nCurrentRound >= nFirst_1_3_Round && fActivationTx && !rEntry->fActivated) {
 //    if ( (txHeight >= HF_V1_3_HEIGHT && MainNet() || txHeight >= TESTNET_V1_3_HEIGHT && TestNet()) && tx.IsActivationTx() && !rEntry->fActivated) {// 1761600
         if (!rEntry->fActivated) {   //checking2
         rEntry->activationTx = tx.GetHash();
@@ -659,7 +735,7 @@ void CSmartRewards::ProcessInput(const CTransaction& tx, const CTxOut& in, int t
 //    }
 
 //    if ( (txHeight >= HF_V1_3_HEIGHT && MainNet() || txHeight >= TESTNET_V1_3_HEIGHT && TestNet())
-    if ( nCurrentRound >= nFirst_1_3_Round && !tx.IsActivationTx() && !rEntry->fDisqualifyingTx) {
+    if ( nCurrentRound >= nFirst_1_3_Round && !fActivationTx && !rEntry->fDisqualifyingTx) {
         if( rEntry->IsEligible() ){
             result.disqualifiedEntries++;
             result.disqualifiedSmart += rEntry->balanceEligible;
@@ -669,7 +745,7 @@ void CSmartRewards::ProcessInput(const CTransaction& tx, const CTxOut& in, int t
     }
 
 //    if ( (txHeight >= HF_V1_3_HEIGHT && MainNet() || txHeight >= TESTNET_V1_3_HEIGHT && TestNet())
-    if (nCurrentRound >= nFirst_1_3_Round && rEntry->fActivated && !tx.IsActivationTx()) {
+    if (nCurrentRound >= nFirst_1_3_Round && rEntry->fActivated && !fActivationTx) {
 //        if ( txHeight >= HF_V2_0_HEIGHT && MainNet() || txHeight >= TESTNET_V2_0_HEIGHT && TestNet() ) { rEntry->activationTx.SetNull();
 //        } else { rEntry->activationTx = tx.GetHash(); }
         rEntry->activationTx.SetNull();
@@ -695,116 +771,107 @@ void CSmartRewards::ProcessInput(const CTransaction& tx, const CTxOut& in, int t
     }
 }
 
-void CSmartRewards::ProcessOutput(const CTransaction& tx, const CTxOut& out, uint16_t nCurrentRound, int nHeight,
-    unsigned int nTime, CSmartRewardsUpdateResult& result)
+void CSmartRewards::ProcessOutput(const CTransaction& tx, const CTxOut& out, const CSmartAddress& id, bool fActivationTx, CSmartRewardEntry* rEntry,
+    uint16_t nCurrentRound, int nHeight, unsigned int nTime, CSmartRewardsUpdateResult& result)
 {
-    CSmartRewardEntry* rEntry = nullptr;
     CTermRewardEntry* rTermEntry = nullptr;
-    CSmartAddress id;
 
-    if (!ExtractDestination(out.scriptPubKey, id)) {
-        LogPrint("smartrewards-tx", "CSmartRewards::ProcessOutput - Could't parse CSmartAddress: %s\n", out.ToString());
-        return;
-    } else {
-        if (GetRewardEntry(id, rEntry, true)) {
 //            if ( tx.IsActivationTx() && (nHeight >= HF_V1_3_HEIGHT && MainNet() || nHeight >= TESTNET_V1_3_HEIGHT && TestNet())
-            if (tx.IsActivationTx() && Is_1_3(nCurrentRound) && !SmartHive::IsHive(rEntry->id)) {
-                if (!rEntry->fActivated) {
-                    rEntry->activationTx = tx.GetHash();
-                    rEntry->fActivated = true;
-                    rEntry->bonusLevel = CSmartRewardEntry::NoBonus;
+    if (fActivationTx && Is_1_3(nCurrentRound) && !SmartHive::IsHive(rEntry->id)) {
+        if (!rEntry->fActivated) {
+            rEntry->activationTx = tx.GetHash();
+            rEntry->fActivated = true;
+            rEntry->bonusLevel = CSmartRewardEntry::NoBonus;
 //                    if (nCurrentRound >= Params().GetConsensus().nRewardsFirst_2_0_Round ) {
 //Might now want this.
 /*                   if ( (nHeight >= HF_V2_0_HEIGHT && MainNet() || nHeight >= TESTNET_V2_0_HEIGHT && TestNet()) ) {
 		        // Reset outgoing transaction.
-                        rEntry->disqualifyingTx.SetNull();
-                        rEntry->fDisqualifyingTx = false;
-                        // Reset SmartNode payment.
-                        rEntry->smartnodePaymentTx.SetNull();
-                        rEntry->fSmartnodePaymentTx = false;
-                    }
+                rEntry->disqualifyingTx.SetNull();
+                rEntry->fDisqualifyingTx = false;
+                // Reset SmartNode payment.
+                rEntry->smartnodePaymentTx.SetNull();
+                rEntry->fSmartnodePaymentTx = false;
+            }
 */
-                    if ( rEntry->IsEligible()/* && rEntry->balance > 999*/) {
-                       result.qualifiedEntries++;
-                       result.qualifiedSmart += rEntry->balanceEligible;
-                    }
-                }
+            if ( rEntry->IsEligible()/* && rEntry->balance > 999*/) {
+               result.qualifiedEntries++;
+               result.qualifiedSmart += rEntry->balanceEligible;
             }
         }
+    }
 
-        // Disable SmartRewards from locked outputs to allow payimg based on TermRewards
-        if (!out.GetLockTime() || nHeight < HF_V2_0_HEIGHT && MainNet() || nHeight < TESTNET_V2_0_HEIGHT && TestNet() ) {
+    // Disable SmartRewards from locked outputs to allow payimg based on TermRewards
+    if (!out.GetLockTime() || nHeight < HF_V2_0_HEIGHT && MainNet() || nHeight < TESTNET_V2_0_HEIGHT && TestNet() ) {
  //               ((nCurrentRound < Params().GetConsensus().nRewardsFirst_2_0_Round) && MainNet()) ||
  //               ((nCurrentRound < 20) && TestNet())) {  //Round 46 ends 1860599 10/24 (activates around 11/28)
-            rEntry->balance += out.nValue;
-        } else if ( (out.nValue >= 1000000 * COIN) && nHeight >= HF_V2_0_HEIGHT && MainNet() ||
-                  (out.nValue >= 1000 * COIN) && nHeight >= TESTNET_V2_0_HEIGHT && TestNet() ){
+        rEntry->balance += out.nValue;
+    } else if ( (out.nValue >= 1000000 * COIN) && nHeight >= HF_V2_0_HEIGHT && MainNet() ||
+              (out.nValue >= 1000 * COIN) && nHeight >= TESTNET_V2_0_HEIGHT && TestNet() ){
 // } else if (nCurrentRound >= Params().GetConsensus().nRewardsFirst_2_0_Round) && MainNet() ) {
-           if ( (out.GetLockTime() > (nTime + 31556952 - 17200)) && (out.GetLockTime() < (nTime + 31556952 + 17200)) ) { // 1year within 2 days
-               if (GetTermRewardEntry({id, tx.GetHash()}, rTermEntry, true)) {
-                   rTermEntry->level = CTermRewardEntry::OneYear;
-                   rTermEntry->percent = 35;
-                   rTermEntry->expires = out.GetLockTime();
-                   rTermEntry->balance = out.nValue;
-               }
-               LogPrintf("CSmartRewards::ProcessOutput: Output qualifies for %s TermRewards\n", rTermEntry->GetLevel());
-           } else if ( (out.GetLockTime() > (nTime + 63113904 - 17200)) && (out.GetLockTime() < (nTime + 63113904 + 17200)) ) { // 2 years within 2 days
-               if (GetTermRewardEntry({id, tx.GetHash()}, rTermEntry, true)) {
-                   rTermEntry->level = CTermRewardEntry::TwoYears;
-                   rTermEntry->percent = 40;
-                   rTermEntry->expires = out.GetLockTime();
-                   rTermEntry->balance = out.nValue;
-               }
-               LogPrintf("CSmartRewards::ProcessOutput: Output qualifies for %s TermRewards\n", rTermEntry->GetLevel());
-           } else if ( (out.GetLockTime() > (nTime + 94670856 - 17200)) && (out.GetLockTime() < (nTime + 94670856 + 17200)) ) { // 3 years within 2 days
-               if (GetTermRewardEntry({id, tx.GetHash()}, rTermEntry, true)) {
-                   rTermEntry->level = CTermRewardEntry::ThreeYears;
-                   rTermEntry->percent = 45;
-                   rTermEntry->expires = out.GetLockTime();
-                   rTermEntry->balance = out.nValue;
-               }
-               LogPrintf("CSmartRewards::ProcessOutput: Output qualifies for %s TermRewards\n", rTermEntry->GetLevel());
-           } else if ( (out.GetLockTime() > (nTime + 473354280 - 17200)) && (out.GetLockTime() < (nTime + 473354280 + 17200)) ) { // 15 years within 2 days
-               if (GetTermRewardEntry({id, tx.GetHash()}, rTermEntry, true)) {
-                   rTermEntry->level = CTermRewardEntry::FifteenYears;
-                   rTermEntry->percent = 50;
-                   rTermEntry->expires = out.GetLockTime();
-                   rTermEntry->balance = out.nValue;
-               }
-               LogPrintf("CSmartRewards::ProcessOutput: Output qualifies for %s SmartRetire\n", rTermEntry->GetLevel());
+       if ( (out.GetLockTime() > (nTime + 31556952 - 17200)) && (out.GetLockTime() < (nTime + 31556952 + 17200)) ) { // 1year within 2 days
+           if (GetTermRewardEntry({id, tx.GetHash()}, rTermEntry, true)) {
+               rTermEntry->level = CTermRewardEntry::OneYear;
+               rTermEntry->percent = 35;
+               rTermEntry->expires = out.GetLockTime();
+               rTermEntry->balance = out.nValue;
            }
-        }
+           LogPrintf("CSmartRewards::ProcessOutput: Output qualifies for %s TermRewards\n", rTermEntry->GetLevel());
+       } else if ( (out.GetLockTime() > (nTime + 63113904 - 17200)) && (out.GetLockTime() < (nTime + 63113904 + 17200)) ) { // 2 years within 2 days
+           if (GetTermRewardEntry({id, tx.GetHash()}, rTermEntry, true)) {
+               rTermEntry->level = CTermRewardEntry::TwoYears;
+               rTermEntry->percent = 40;
+               rTermEntry->expires = out.GetLockTime();
+               rTermEntry->balance = out.nValue;
+           }
+           LogPrintf("CSmartRewards::ProcessOutput: Output qualifies for %s TermRewards\n", rTermEntry->GetLevel());
+       } else if ( (out.GetLockTime() > (nTime + 94670856 - 17200)) && (out.GetLockTime() < (nTime + 94670856 + 17200)) ) { // 3 years within 2 days
+           if (GetTermRewardEntry({id, tx.GetHash()}, rTermEntry, true)) {
+               rTermEntry->level = CTermRewardEntry::ThreeYears;
+               rTermEntry->percent = 45;
+               rTermEntry->expires = out.GetLockTime();
+               rTermEntry->balance = out.nValue;
+           }
+           LogPrintf("CSmartRewards::ProcessOutput: Output qualifies for %s TermRewards\n", rTermEntry->GetLevel());
+       } else if ( (out.GetLockTime() > (nTime + 473354280 - 17200)) && (out.GetLockTime() < (nTime + 473354280 + 17200)) ) { // 15 years within 2 days
+           if (GetTermRewardEntry({id, tx.GetHash()}, rTermEntry, true)) {
+               rTermEntry->level = CTermRewardEntry::FifteenYears;
+               rTermEntry->percent = 50;
+               rTermEntry->expires = out.GetLockTime();
+               rTermEntry->balance = out.nValue;
+           }
+           LogPrintf("CSmartRewards::ProcessOutput: Output qualifies for %s SmartRetire\n", rTermEntry->GetLevel());
+       }
+    }
 
 //        if ( (nHeight >= HF_V1_3_HEIGHT && MainNet() || nHeight >= TESTNET_V1_3_HEIGHT && TestNet() ) 
-        if (Is_1_3(nCurrentRound) && tx.IsCoinBase()) {
-            int nInterval = SmartNodePayments::PayoutInterval(nHeight);
-            int nPayoutsPerBlock = SmartNodePayments::PayoutsPerBlock(nHeight);
-            // Just to avoid potential zero divisions
-            nPayoutsPerBlock = std::max(1, nPayoutsPerBlock);
-
-            CAmount nNodeReward = SmartNodePayments::Payment(nHeight) / nPayoutsPerBlock;
-            // If we have an interval check if this is a node payout block
-            if (nInterval && !(nHeight % nInterval)) {
-                   // If the amount matches and the entry is not yet marked as node do it
-                if (abs(out.nValue - nNodeReward) < 2) {
-                    if (!rEntry->fSmartnodePaymentTx) {
-                        // If it is currently eligible adjust the round's results
-                        if (rEntry->IsEligible() ) {
-                            ++result.disqualifiedEntries;
-                            result.disqualifiedSmart += rEntry->balanceEligible;
+    if (Is_1_3(nCurrentRound) && tx.IsCoinBase()) {
+        int nInterval = SmartNodePayments::PayoutInterval(nHeight);
+        int nPayoutsPerBlock = SmartNodePayments::PayoutsPerBlock(nHeight);
+        // Just to avoid potential zero divisions
+        nPayoutsPerBlock = std::max(1, nPayoutsPerBlock);
+
+        CAmount nNodeReward = SmartNodePayments::Payment(nHeight) / nPayoutsPerBlock;
+        // If we have an interval check if this is a node payout block
+        if (nInterval && !(nHeight % nInterval)) {
+               // If the amount matches and the entry is not yet marked as node do it
+            if (abs(out.nValue - nNodeReward) < 2) {
+                if (!rEntry->fSmartnodePaymentTx) {
+                    // If it is currently eligible adjust the round's results
+                    if (rEntry->IsEligible() ) {
+                        ++result.disqualifiedEntries;
+                        result.disqualifiedSmart += rEntry->balanceEligible;
 //         if (nHeight < HF_V2_0_HEIGHT && MainNet() || nHeight < TESTNET_V2_0_HEIGHT && TestNet() ) { rEntry->activationTx.SetNull();
 //         } else { rEntry->activationTx = tx.GetHash(); }
-                            rEntry->activationTx.SetNull();
-                            rEntry->fActivated = false;
-                            rEntry->bonusLevel = CSmartRewardEntry::NotEligible;
+                        rEntry->activationTx.SetNull();
+                        rEntry->fActivated = false;
+                        rEntry->bonusLevel = CSmartRewardEntry::NotEligible;
 //                            if (nCurrentRound < Params().GetConsensus().nRewardsFirst_2_0_Round ) {
 //                                rEntry->disqualifyingTx = tx.GetHash();
 //                                rEntry->fDisqualifyingTx = true;
 //                            }
-                        }
-                        rEntry->smartnodePaymentTx = tx.GetHash();
-                        rEntry->fSmartnodePaymentTx = true;
                     }
+                    rEntry->smartnodePaymentTx = tx.GetHash();
+                    rEntry->fSmartnodePaymentTx = true;
                 }
             }
         }
@@ -1175,21 +1242,10 @@ bool CSmartRewards::CommitUndoBlock(CBlockIndex* pIndex, const CSmartRewardsUpda
             return false;
         }
 
-        cache.SetUndoResult(undoResult);
-
-        // Load all entries into the cache
-        CSmartRewardEntryMap tmpEntries;
-        pdb->ReadRewardEntries(tmpEntries);
-
-        for (auto itDb = tmpEntries.begin(); itDb != tmpEntries.end(); ++itDb) {
-            auto itCache = cache.GetEntries()->find(itDb->first);
+        // Bring the entries back to their state at the end of the recovered round.
+        cache.GetEntries()->Restore(undoResult->results);
 
-            if (itCache == cache.GetEntries()->end()) {
-                cache.AddEntry(itDb->second);
-            } else {
-                delete itDb->second;
-            }
-        }
+        cache.SetUndoResult(undoResult);
     }
 
     UpdatePercentage();
@@ -1210,10 +1266,6 @@ CSmartRewardsCache::~CSmartRewardsCache()
 {
     LOCK(cs_rewardscache);
 
-    for (std::pair<CSmartAddress, CSmartRewardEntry*> it : entries) {
-        delete it.second;
-    }
-
     if (result) {
         result->Clear();
         delete result;
@@ -1224,12 +1276,12 @@ CSmartRewardsCache::~CSmartRewardsCache()
     rounds.clear();
     addTransactions.clear();
     removeTransactions.clear();
-    entries.clear();
+    entries.Clear();
 }
 
 unsigned long CSmartRewardsCache::EstimatedSize()
 {
-    unsigned long nEntriesSize = entries.size() * (sizeof(CSmartAddress) + sizeof(CSmartRewardEntry));
+    unsigned long nEntriesSize = entries.DirtySize() * (sizeof(CSmartAddress) + sizeof(CSmartRewardEntry));
     unsigned long nRoundsSize = (rounds.size() + 1) * sizeof(CSmartRewardRound);
     unsigned long nTransactionsSize = (addTransactions.size() + removeTransactions.size()) * (sizeof(uint256) + sizeof(CSmartRewardTransaction));
     unsigned long nBlockSize = sizeof(CSmartRewardBlock);
@@ -1248,13 +1300,16 @@ bool CSmartRewardsCache::NeedsSync()
     LOCK(cs_rewardscache);
     return (result != nullptr && !result->fSynced) ||
            (undoResults != nullptr && !undoResults->fSynced) ||
-           EstimatedSize() > REWARDS_MAX_CACHE || entries.size() > nCacheRewardEntries;
+           EstimatedSize() > REWARDS_MAX_CACHE || entries.DirtySize() > nCacheRewardEntries;
 }
 
 void CSmartRewardsCache::Clear()
 {
     LOCK(cs_rewardscache);
 
+    // Entries restored from an undone round were written even without balance.
+    entries.Synced(undoResults == nullptr || undoResults->fSynced);
+
     if (result) {
         result->fSynced = true;
     }
@@ -1263,11 +1318,6 @@ void CSmartRewardsCache::Clear()
         undoResults->fSynced = true;
     }
 
-    for (auto it = entries.cbegin(); it != entries.cend(); it++) {
-        delete it->second;
-    }
-
-    entries.clear();
     addTransactions.clear();
     removeTransactions.clear();
 }
@@ -1427,12 +1477,6 @@ void CSmartRewardsCache::RemoveTransaction(const CSmartRewardTransaction& transa
     }
 }
 
-void CSmartRewardsCache::AddEntry(CSmartRewardEntry* entry)
-{
-    LOCK(cs_rewardscache);
-    entries[entry->id] = entry;
-}
-
 void CSmartRewardsCache::AddTermRewardEntry(CTermRewardEntry *entry)
 {
     LOCK(cs_rewardscache);
@@ -65,6 +65,28 @@ struct CSmartRewardsUpdateResult {
     bool IsValid() const { return block.IsValid(); }
 };
 
+/** An input or output of a block which updates the rewards entries */
+struct CSmartRewardsUpdate {
+    const CTransaction* pTx;
+    CTxOut txOut;
+    // Height of the spent coin for inputs
+    int nHeight;
+    bool fInput;
+
+    CSmartRewardsUpdate() : pTx(nullptr), nHeight(0), fInput(false) {}
+    CSmartRewardsUpdate(const CTransaction* pTxIn, const CTxOut& txOutIn, int nHeightIn, bool fInputIn) :
+        pTx(pTxIn), txOut(txOutIn), nHeight(nHeightIn), fInput(fInputIn) {}
+};
+
+/** Address and activation state of a CSmartRewardsUpdate, extracted without the cache lock */
+struct CSmartRewardsUpdateKey {
+    CSmartAddress id;
+    bool fValid;
+    bool fActivationTx;
+
+    CSmartRewardsUpdateKey() : fValid(false), fActivationTx(false) {}
+};
+
 struct CSmartRewardsRoundResult {
     CSmartRewardRound round;
     CSmartRewardResultEntryPtrList results;
@@ -85,7 +107,7 @@ class CSmartRewardsCache
     CSmartRewardRoundMap rounds;
     CSmartRewardTransactionMap addTransactions;
     CSmartRewardTransactionMap removeTransactions;
-    CSmartRewardEntryMap entries;
+    CSmartRewardEntryStore entries;
     CTermRewardEntryMap termRewardEntries;
     CSmartRewardsRoundResult* result;
     CSmartRewardsRoundResult* undoResults;
@@ -118,7 +140,8 @@ public:
     const CSmartRewardRoundMap* GetRounds() const { return &rounds; }
     const CSmartRewardTransactionMap* GetAddedTransactions() const { return &addTransactions; }
     const CSmartRewardTransactionMap* GetRemovedTransactions() const { return &removeTransactions; }
-    const CSmartRewardEntryMap* GetEntries() const { return &entries; }
+    const CSmartRewardEntryStore* GetEntries() const { return &entries; }
+    CSmartRewardEntryStore* GetEntries() { return &entries; }
     const CTermRewardEntryMap* GetTermRewardsEntries() const { return &termRewardEntries; }
     const CSmartRewardsRoundResult* GetLastRoundResult() const { return result; }
     const CSmartRewardsRoundResult* GetUndoResult() const { return undoResults; }
@@ -127,7 +150,6 @@ public:
     void RemoveFinishedRound(const int& nNumber);
     void AddTransaction(const CSmartRewardTransaction& transaction);
     void RemoveTransaction(const CSmartRewardTransaction& transaction);
-    void AddEntry(CSmartRewardEntry* entry);
     void AddTermRewardEntry(CTermRewardEntry *entry);
 };
 
@@ -142,7 +164,6 @@ class CSmartRewards
     void UpdatePercentage();
 
     bool ReadRewardEntry(const CSmartAddress& id, CSmartRewardEntry& entry);
-    bool GetRewardEntries(CSmartRewardEntryMap& entries);
 
 public:
     CSmartRewards(CSmartRewardsDB* prewardsdb);
@@ -166,8 +187,13 @@ public:
     bool Update(CBlockIndex* pindexNew, const CChainParams& chainparams, const int nCurrentRound, CSmartRewardsUpdateResult& result);
     bool UpdateRound(const CSmartRewardRound& round);
 
-    void ProcessInput(const CTransaction& tx, const CTxOut& in, int txHeight, uint16_t nCurrentRound, CSmartRewardsUpdateResult& result);
-    void ProcessOutput(const CTransaction& tx, const CTxOut& out, uint16_t nCurrentRound, int nHeight, unsigned int nTime, CSmartRewardsUpdateResult& result);
+    void ProcessInput(const CTransaction& tx, const CTxOut& in, int txHeight, bool fActivationTx, CSmartRewardEntry* rEntry, uint16_t nCurrentRound, CSmartRewardsUpdateResult& result);
+    void ProcessOutput(const CTransaction& tx, const CTxOut& out, const CSmartAddress& id, bool fActivationTx, CSmartRewardEntry* rEntry,
+                       uint16_t nCurrentRound, int nHeight, unsigned int nTime, CSmartRewardsUpdateResult& result);
+    /** Apply the inputs and outputs of a block. The addresses and activation checks are extracted
+     *  in parallel, then every address is looked up once and the updates are applied in block order
+     *  under a single cache lock, since later updates depend on the entry state left by earlier ones. */
+    void ProcessUpdates(CBlockIndex* pIndex, const std::vector<CSmartRewardsUpdate>& vUpdates, uint16_t nCurrentRound, CSmartRewardsUpdateResult& result);
 
     void UndoInput(const CTransaction& tx, const CTxOut& in, int txHeight, uint16_t nCurrentRound, CSmartRewardsUpdateResult& result);
     void UndoOutput(const CTransaction& tx, const CTxOut& out, int txHeight, uint16_t nCurrentRound, CSmartRewardsUpdateResult& result);
@@ -43,7 +43,7 @@ size_t CTermRewardDbKeyHasher::operator()(const CTermRewardDbKey& k) const {
     return seed;
 }
 
-CSmartRewardsDB::CSmartRewardsDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "rewards", nCacheSize, fMemory, fWipe)
+CSmartRewardsDB::CSmartRewardsDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "rewards", nCacheSize, fMemory, fWipe, false, REWARDS_DB_OPTIONS.FromArgs("rewards"))
 {
     if (!Exists(DB_VERSION)) {
         Write(DB_VERSION, REWARDS_DB_VERSION);
@@ -142,55 +142,26 @@ bool CSmartRewardsDB::SyncCached(const CSmartRewardsCache& cache)
 {
     CDBBatch batch(*this);
 
-    if (cache.GetUndoResult() != nullptr && !cache.GetUndoResult()->fSynced) {
-        CSmartRewardResultEntryPtrList tmpResults = cache.GetUndoResult()->results;
+    // Entries get restored from the snapshot when a round is undone, write them
+    // as they are. Otherwise drop entries without balance.
+    bool fUndo = cache.GetUndoResult() != nullptr && !cache.GetUndoResult()->fSynced;
+    const CSmartRewardEntryStore* pEntries = cache.GetEntries();
 
-        auto entry = cache.GetEntries()->begin();
-
-        while (entry != cache.GetEntries()->end()) {
-            CSmartAddress searchAddress = entry->second->id;
-
-            auto it = std::find_if(tmpResults.begin(),
-                tmpResults.end(),
-                [searchAddress](const CSmartRewardResultEntry* rEntry) -> bool {
-                    return rEntry->entry.id == searchAddress;
-                });
-
-            if (it == tmpResults.end()) {
-                batch.Erase(make_pair(DB_REWARD_ENTRY, entry->first));
-            } else {
-                CSmartRewardEntry rewardEntry = (*it)->entry;
-
-//                std::cout << rewardEntry.ToString() << std::endl;
-
-                batch.Write(make_pair(DB_REWARD_ENTRY, rewardEntry.id), rewardEntry);
-                batch.Erase(make_pair(DB_ROUND_SNAPSHOT, make_pair(cache.GetUndoResult()->round.number, rewardEntry.id)));
-                tmpResults.erase(it);
-            }
-
-            ++entry;
-        }
-
-        auto it = tmpResults.begin();
-
-        while (it != tmpResults.end()) {
-            batch.Write(make_pair(DB_REWARD_ENTRY, (*it)->entry.id), (*it)->entry);
-            batch.Erase(make_pair(DB_ROUND_SNAPSHOT, make_pair(cache.GetUndoResult()->round.number, (*it)->entry.id)));
-
-            ++it;
+    pEntries->ForEachDirty([&](const CSmartRewardEntry& entry) {
+        if (!fUndo && entry.balance <= 0) {
+            batch.Erase(make_pair(DB_REWARD_ENTRY, entry.id));
+        } else {
+            batch.Write(make_pair(DB_REWARD_ENTRY, entry.id), entry);
         }
+    });
 
-    } else {
-        auto entry = cache.GetEntries()->begin();
-
-        while (entry != cache.GetEntries()->end()) {
-            if (entry->second->balance <= 0) {
-                batch.Erase(make_pair(DB_REWARD_ENTRY, entry->first));
-            } else {
-                batch.Write(make_pair(DB_REWARD_ENTRY, entry->first), *entry->second);
-            }
+    for (const CSmartAddress& id : pEntries->GetErased()) {
+        batch.Erase(make_pair(DB_REWARD_ENTRY, id));
+    }
 
-            ++entry;
+    if (fUndo) {
+        for (const CSmartRewardResultEntry* s : cache.GetUndoResult()->results) {
+            batch.Erase(make_pair(DB_ROUND_SNAPSHOT, make_pair(cache.GetUndoResult()->round.number, s->entry.id)));
         }
     }
 
@@ -237,7 +208,7 @@ bool CSmartRewardsDB::SyncCached(const CSmartRewardsCache& cache)
     return WriteBatch(batch, true);
 }
 
-bool CSmartRewardsDB::ReadRewardEntries(CSmartRewardEntryMap& entries)
+bool CSmartRewardsDB::ReadRewardEntries(CSmartRewardEntryStore& entries)
 {
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
@@ -249,7 +220,7 @@ bool CSmartRewardsDB::ReadRewardEntries(CSmartRewardEntryMap& entries)
         if (pcursor->GetKey(key) && key.first == DB_REWARD_ENTRY) {
             CSmartRewardEntry entry;
             if (pcursor->GetValue(entry)) {
-                entries.insert(std::make_pair(entry.id, new CSmartRewardEntry(entry)));
+                entries.Load(entry);
                 pcursor->Next();
             } else {
                 return error("failed to get reward entry");
@@ -443,6 +414,140 @@ bool CSmartRewardEntry::IsEligible()
     return fActivated && !fSmartnodePaymentTx && balanceEligible > 0 && !fDisqualifyingTx;
 }
 
+void CSmartRewardEntryStore::SetDirty(uint32_t nSlot)
+{
+    if (!vecDirty[nSlot]) {
+        vecDirty[nSlot] = true;
+        vecDirtySlots.push_back(nSlot);
+    }
+}
+
+void CSmartRewardEntryStore::Release(uint32_t nSlot)
+{
+    mapSlots.erase(vecEntries[nSlot].id);
+    vecEntries[nSlot] = CSmartRewardEntry();
+    vecUsed[nSlot] = false;
+    vecFreeSlots.push_back(nSlot);
+}
+
+CSmartRewardEntry* CSmartRewardEntryStore::Find(const CSmartAddress& id, bool fDirty)
+{
+    auto it = mapSlots.find(id);
+
+    if (it == mapSlots.end()) {
+        return nullptr;
+    }
+
+    if (fDirty) {
+        SetDirty(it->second);
+    }
+
+    return &vecEntries[it->second];
+}
+
+CSmartRewardEntry* CSmartRewardEntryStore::Load(const CSmartRewardEntry& entry)
+{
+    auto it = mapSlots.find(entry.id);
+
+    if (it != mapSlots.end()) {
+        vecEntries[it->second] = entry;
+        return &vecEntries[it->second];
+    }
+
+    uint32_t nSlot;
+
+    if (!vecFreeSlots.empty()) {
+        nSlot = vecFreeSlots.back();
+        vecFreeSlots.pop_back();
+        vecEntries[nSlot] = entry;
+        vecUsed[nSlot] = true;
+    } else {
+        nSlot = vecEntries.size();
+        vecEntries.push_back(entry);
+        vecUsed.push_back(true);
+        vecDirty.push_back(false);
+    }
+
+    mapSlots.emplace(entry.id, nSlot);
+
+    return &vecEntries[nSlot];
+}
+
+CSmartRewardEntry* CSmartRewardEntryStore::Insert(const CSmartRewardEntry& entry)
+{
+    CSmartRewardEntry* pEntry = Load(entry);
+    SetDirty(mapSlots[entry.id]);
+    return pEntry;
+}
+
+void CSmartRewardEntryStore::MarkAllDirty()
+{
+    for (uint32_t nSlot = 0; nSlot < vecEntries.size(); ++nSlot) {
+        if (vecUsed[nSlot]) {
+            SetDirty(nSlot);
+        }
+    }
+}
+
+void CSmartRewardEntryStore::Restore(const CSmartRewardResultEntryPtrList& results)
+{
+    std::unordered_map<CSmartAddress, const CSmartRewardEntry*, CSmartAddressHasher> mapResults;
+    mapResults.reserve(results.size());
+
+    for (const CSmartRewardResultEntry* result : results) {
+        mapResults.emplace(result->entry.id, &result->entry);
+    }
+
+    for (uint32_t nSlot = 0; nSlot < vecEntries.size(); ++nSlot) {
+        if (!vecUsed[nSlot]) {
+            continue;
+        }
+
+        auto it = mapResults.find(vecEntries[nSlot].id);
+
+        if (it == mapResults.end()) {
+            vecErased.push_back(vecEntries[nSlot].id);
+            Release(nSlot);
+        } else {
+            vecEntries[nSlot] = *it->second;
+            SetDirty(nSlot);
+            mapResults.erase(it);
+        }
+    }
+
+    // Keep the snapshot order for entries which were not in memory.
+    for (const CSmartRewardResultEntry* result : results) {
+        if (mapResults.count(result->entry.id)) {
+            Insert(result->entry);
+        }
+    }
+}
+
+void CSmartRewardEntryStore::Synced(bool fReleaseEmpty)
+{
+    for (uint32_t nSlot : vecDirtySlots) {
+        vecDirty[nSlot] = false;
+
+        if (fReleaseEmpty && vecUsed[nSlot] && vecEntries[nSlot].balance <= 0) {
+            Release(nSlot);
+        }
+    }
+
+    vecDirtySlots.clear();
+    vecErased.clear();
+}
+
+void CSmartRewardEntryStore::Clear()
+{
+    vecEntries.clear();
+    vecUsed.clear();
+    vecDirty.clear();
+    vecDirtySlots.clear();
+    vecFreeSlots.clear();
+    vecErased.clear();
+    mapSlots.clear();
+}
+
 string CSmartRewardBlock::ToString() const
 {
     std::stringstream s;
@@ -5,6 +5,7 @@
 #ifndef REWARDSDB_H
 #define REWARDSDB_H
 
+#include <deque>
 #include <unordered_map>
 
 #include "dbwrapper.h"
@@ -22,6 +23,8 @@ static constexpr int REWARDS_DB_PEAK_USAGE_FACTOR = 2;
 static const int64_t nRewardsDefaultDbCache = 80;
 //! max. -rewardsdbcache (MiB)
 static const int64_t nRewardsMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
+//! LevelDB tuning of the rewards DB, it is mostly read in full rounds
+static const CDBOptions REWARDS_DB_OPTIONS(10, 32, 16 * 1024, false);
 
 class CSmartRewardBlock;
 class CSmartRewardEntry;
@@ -30,6 +33,7 @@ class CSmartRewardRound;
 class CSmartRewardResultEntry;
 class CSmartRewardTransaction;
 class CSmartRewardsCache;
+class CSmartRewardEntryStore;
 
 typedef std::vector<CSmartRewardBlock> CSmartRewardBlockList;
 typedef std::vector<CSmartRewardEntry> CSmartRewardEntryList;
@@ -47,7 +51,6 @@ struct CTermRewardDbKeyHasher {
 };
 
 typedef std::map<uint256, CSmartRewardTransaction> CSmartRewardTransactionMap;
-typedef std::unordered_map<CSmartAddress, CSmartRewardEntry*, CSmartAddressHasher> CSmartRewardEntryMap;
 typedef std::unordered_map<CTermRewardDbKey, CTermRewardEntry*, CTermRewardDbKeyHasher> CTermRewardEntryMap;
 
 class CSmartRewardTransaction
@@ -280,6 +283,87 @@ public:
     bool IsEligible();
 };
 
+/** In-memory table of all reward entries.
+ *
+ * Entries are kept in a chunked pool so the pointers handed out by
+ * CSmartRewards::GetRewardEntry stay valid while the table grows. An index
+ * keyed by address maps to the pool slots, released slots are reused and only
+ * the slots modified since the last write-back are flushed to the database.
+ * Entries are stored whole rather than split into per-field arrays: round
+ * evaluation copies every entry into its result anyway, and block updates
+ * work on CSmartRewardEntry pointers.
+ */
+class CSmartRewardEntryStore
+{
+    std::deque<CSmartRewardEntry> vecEntries;
+    std::vector<bool> vecUsed;
+    std::vector<bool> vecDirty;
+    std::vector<uint32_t> vecDirtySlots;
+    std::vector<uint32_t> vecFreeSlots;
+    std::vector<CSmartAddress> vecErased;
+    std::unordered_map<CSmartAddress, uint32_t, CSmartAddressHasher> mapSlots;
+
+    void SetDirty(uint32_t nSlot);
+    void Release(uint32_t nSlot);
+
+public:
+    CSmartRewardEntryStore() {}
+
+    size_t Size() const { return mapSlots.size(); }
+    size_t DirtySize() const { return vecDirtySlots.size() + vecErased.size(); }
+
+    /** Return the entry of id or nullptr, mark it as modified if fDirty is set. */
+    CSmartRewardEntry* Find(const CSmartAddress& id, bool fDirty);
+    /** Add an entry read from the database. */
+    CSmartRewardEntry* Load(const CSmartRewardEntry& entry);
+    /** Add a new entry which needs to be written with the next sync. */
+    CSmartRewardEntry* Insert(const CSmartRewardEntry& entry);
+
+    size_t SlotCount() const { return vecEntries.size(); }
+
+    /** Call func for every entry in the slots [nBegin, nEnd) in slot order.
+     *  Disjoint ranges can be processed concurrently. */
+    template <typename Callable>
+    void ForEach(size_t nBegin, size_t nEnd, Callable func)
+    {
+        for (size_t nSlot = nBegin; nSlot < nEnd; ++nSlot) {
+            if (vecUsed[nSlot]) {
+                func(vecEntries[nSlot]);
+            }
+        }
+    }
+
+    /** Call func for every entry in slot order. */
+    template <typename Callable>
+    void ForEach(Callable func)
+    {
+        ForEach(0, vecEntries.size(), func);
+    }
+
+    void MarkAllDirty();
+    /** Replace the table's content with the entries of a round snapshot. */
+    void Restore(const CSmartRewardResultEntryPtrList& results);
+
+    /** Call func for every entry modified since the last write-back. */
+    template <typename Callable>
+    void ForEachDirty(Callable func) const
+    {
+        for (uint32_t nSlot : vecDirtySlots) {
+            if (vecUsed[nSlot]) {
+                func(vecEntries[nSlot]);
+            }
+        }
+    }
+
+    const std::vector<CSmartAddress>& GetErased() const { return vecErased; }
+
+    /** Reset the modification tracking after a successful write-back. Entries
+     *  without balance were erased from the database and get released if
+     *  fReleaseEmpty is set. */
+    void Synced(bool fReleaseEmpty);
+    void Clear();
+};
+
 class CSmartRewardResultEntry
 {
 
@@ -399,7 +483,7 @@ public:
     bool ReadCurrentRound(CSmartRewardRound &round);
 
     bool ReadRewardEntry(const CSmartAddress &id, CSmartRewardEntry &entry);
-    bool ReadRewardEntries(CSmartRewardEntryMap &entries);
+    bool ReadRewardEntries(CSmartRewardEntryStore &entries);
     bool ReadTermRewardEntry(const std::pair<CSmartAddress, uint256 >&id, CTermRewardEntry &entry);
     bool ReadTermRewardEntries(CTermRewardEntryMap& entries);
 
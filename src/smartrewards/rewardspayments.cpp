@@ -13,8 +13,10 @@
 #include "ui_interface.h"
 #include "init.h"
 #include "smartnode/spork.h"
+#include "random.h"
 
 #include <stdint.h>
+#include <unordered_map>
 
 CSmartRewardResultEntryPtrList SmartRewardPayments::GetPayments(const CSmartRewardsRoundResult *pResult, const int64_t nPayoutDelay, const int nHeight, int64_t blockTime, SmartRewardPayments::Result &result)
 {
@@ -132,8 +134,162 @@ void SmartRewardPayments::FillPayments(CMutableTransaction &coinbaseTx, int nHei
 }
 
 
-SmartRewardPayments::Result SmartRewardPayments::Validate(const CBlock& block, int nHeight, CAmount &smartReward)
+namespace {
+
+struct CScriptHasher
+{
+    const uint64_t k0, k1;
+
+    CScriptHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+    size_t operator()(const CScript& script) const {
+        return CSipHasher(k0, k1).Write(script.empty() ? nullptr : &script[0], script.size()).Finalize();
+    }
+};
+
+/** Index of the payouts of the last round result by script along with the
+ *  payout blocks they were found in. The paid state is derived from the
+ *  blocks connected on top of the validated block's parent so it can be
+ *  rewound on reorgs and rebuilt from disk after a restart. */
+class CSmartRewardPayoutIndex
+{
+    const CSmartRewardsRoundResult* pResult;
+    uint16_t nRound;
+    std::unordered_map<CScript, uint32_t, CScriptHasher> mapPayouts;
+    std::vector<bool> vecPaid;
+    std::map<int, std::vector<uint32_t> > mapPaidAt;
+    size_t nRemaining;
+
+public:
+    CSmartRewardPayoutIndex() : pResult(nullptr), nRound(0), nRemaining(0) {}
+
+    /** Rebuild the index if pResultIn is not the indexed round result. */
+    void Update(const CSmartRewardsRoundResult* pResultIn)
+    {
+        if (pResult == pResultIn && nRound == pResultIn->round.number && vecPaid.size() == pResultIn->payouts.size()) {
+            return;
+        }
+
+        pResult = pResultIn;
+        nRound = pResultIn->round.number;
+        mapPayouts.clear();
+        mapPayouts.reserve(pResult->payouts.size());
+        for (size_t i = 0; i < pResult->payouts.size(); ++i) {
+            mapPayouts.emplace(pResult->payouts[i]->entry.id.GetScript(), i);
+        }
+        vecPaid.assign(pResult->payouts.size(), false);
+        mapPaidAt.clear();
+        nRemaining = pResult->payouts.size();
+    }
+
+    /** Forget the payouts found at nHeight or above. */
+    void Rewind(int nHeight)
+    {
+        auto it = mapPaidAt.lower_bound(nHeight);
+        while (it != mapPaidAt.end()) {
+            for (uint32_t nIndex : it->second) {
+                vecPaid[nIndex] = false;
+                ++nRemaining;
+            }
+            it = mapPaidAt.erase(it);
+        }
+    }
+
+    /** Check if all payout blocks of the round below nHeight have been seen. */
+    bool HasHistory(int nHeight) const
+    {
+        int64_t nFirst = pResult->round.endBlockHeight + Params().GetConsensus().nRewardsPayoutStartDelay;
+        size_t nExpected = nHeight > nFirst ? (nHeight - nFirst - 1) / pResult->round.nBlockInterval + 1 : 0;
+        return mapPaidAt.size() == nExpected;
+    }
+
+    void Reset()
+    {
+        Rewind(0);
+    }
+
+    /** Look up the unpaid payout matching txout, return nullptr if there is none. */
+    CSmartRewardResultEntry* Find(const CTxOut& txout, int& nIndexRet) const
+    {
+        auto it = mapPayouts.find(txout.scriptPubKey);
+        if (it == mapPayouts.end() || vecPaid[it->second]) return nullptr;
+
+        CSmartRewardResultEntry* payout = pResult->payouts[it->second];
+        if (abs(payout->reward - txout.nValue) > (float)txout.nValue / 100.0f) {
+            LogPrintf("ValidateRewardPayments -- Payee %s Diff %0.3f MaxDiff %0.3f Paid %0.3f Expected %0.3f\n",
+                payout->entry.id.ToString(),abs(payout->reward - txout.nValue)/100000000,
+                ((float)payout->reward / 10000000000.0f),txout.nValue/100000000,payout->reward/100000000);
+        }
+        if (abs(payout->reward - txout.nValue) > (float)payout->reward / 100.0f) return nullptr;
+
+        nIndexRet = it->second;
+        return payout;
+    }
+
+    void AddBlock(int nHeight) { mapPaidAt[nHeight]; }
+
+    void SetPaid(int nIndex, int nHeight)
+    {
+        vecPaid[nIndex] = true;
+        mapPaidAt[nHeight].push_back(nIndex);
+        --nRemaining;
+    }
+
+    size_t Remaining() const { return nRemaining; }
+};
+
+CSmartRewardPayoutIndex payoutIndex;
+
+int GetRewardBlockOffset(const CTransaction& txCoinbase, const CSmartRewardsRoundResult* pResult, int nHeight)
 {
+    return (nHeight == pResult->round.GetLastRoundBlock()) ?
+        (txCoinbase.vout.size() - (pResult->round.GetPayeeCount() % pResult->round.nBlockPayees)) :
+        (txCoinbase.vout.size() - pResult->round.nBlockPayees);
+}
+
+/** Mark the payouts of the previous payout blocks of the round as paid by
+ *  reading them from disk. Returns false if one of them can't be read. */
+bool ReplayRewardBlocks(const CSmartRewardsRoundResult* pResult, const CBlockIndex* pindexPrev, int nHeight)
+{
+    int64_t nFirst = pResult->round.endBlockHeight + Params().GetConsensus().nRewardsPayoutStartDelay;
+
+    payoutIndex.Reset();
+
+    for (int64_t h = nFirst; h < nHeight; h += pResult->round.nBlockInterval) {
+        const CBlockIndex* pindex = pindexPrev ? pindexPrev->GetAncestor(h) : nullptr;
+        CBlock block;
+
+        payoutIndex.AddBlock(h);
+
+        if (!pindex || !ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            // Drop the partial state, the next check of the round replays again
+            payoutIndex.Reset();
+            return error("ValidateRewardPayments -- failed to read rewardblock at height %d", h);
+        }
+
+        const CTransaction &txCoinbase = block.vtx[0];
+        int nOffset = std::max(0, GetRewardBlockOffset(txCoinbase, pResult, h));
+        int nIndex;
+
+        for (auto txout = txCoinbase.vout.begin() + nOffset; txout != txCoinbase.vout.end(); ++txout) {
+            if (payoutIndex.Find(*txout, nIndex)) {
+                payoutIndex.SetPaid(nIndex, h);
+            }
+        }
+    }
+
+    LogPrint("smartrewards", "ValidateRewardPayments -- replayed round %d rewardblocks up to height %d, %d payouts remaining\n",
+             pResult->round.number, nHeight, payoutIndex.Remaining());
+
+    return true;
+}
+
+}
+
+SmartRewardPayments::Result SmartRewardPayments::Validate(const CBlock& block, const CBlockIndex* pindex, CAmount &smartReward)
+{
+    int nHeight = pindex->nHeight;
+
     // Necessary to make the transition from 90030 to 90031 SmartRewards change
     if (nHeight == 1783799) {
       smartReward = 109307197536547;
@@ -161,50 +317,44 @@ SmartRewardPayments::Result SmartRewardPayments::Validate(const CBlock& block, i
     CSmartRewardResultEntryPtrList rewards =  SmartRewardPayments::GetPaymentsForBlock(nHeight, block.GetBlockTime(), result);
     if (result == SmartRewardPayments::Valid && rewards.size()) {
         const CTransaction &txCoinbase = block.vtx[0];
-        static CSmartRewardResultEntryPtrList remainingPayouts;
-        int64_t nPayoutDelay = Params().GetConsensus().nRewardsPayoutStartDelay;
         const CSmartRewardsRoundResult *pResult = prewards->GetLastRoundResult();
 
-        // If first payee block, build a list of all expected payouts
-        if (nHeight == (pResult->round.endBlockHeight + nPayoutDelay)) {
-            remainingPayouts.reserve(pResult->payouts.size());
-            std::copy(pResult->payouts.begin(), pResult->payouts.end(), std::back_inserter(remainingPayouts));
+        // Drop what was found at this height or above, i.e. in disconnected
+        // blocks or an earlier check of this block, and recover the previous
+        // payout blocks of the round if they were not validated in this session.
+        payoutIndex.Update(pResult);
+        payoutIndex.Rewind(nHeight);
+        // Without the earlier payout blocks of the round payouts could be
+        // paid twice or go missing unnoticed, don't decide on the block then.
+        if (!payoutIndex.HasHistory(nHeight) && !ReplayRewardBlocks(pResult, pindex->pprev, nHeight)) {
+            return SmartRewardPayments::CoreError;
         }
+        payoutIndex.AddBlock(nHeight);
 
-        int nOffset = (nHeight == pResult->round.GetLastRoundBlock()) ?
-            (txCoinbase.vout.size() - (pResult->round.GetPayeeCount() % pResult->round.nBlockPayees)) :
-            (txCoinbase.vout.size() - pResult->round.nBlockPayees);
+        int nOffset = GetRewardBlockOffset(txCoinbase, pResult, nHeight);
 
         LogPrintf("ValidateRewardPayments -- found rewardblock at height %d with %d payees\n",
                 nHeight, txCoinbase.vout.size() - nOffset);
 
         for (auto txout = txCoinbase.vout.begin() + nOffset; txout != txCoinbase.vout.end(); ++txout) {
-            auto payoutIt = std::find_if(remainingPayouts.begin(), remainingPayouts.end(),
-                    [&txout] (CSmartRewardResultEntry *payout) {
-                if ( (payout->entry.id.GetScript() == txout->scriptPubKey)
-                        && (abs(payout->reward - txout->nValue) > (float)txout->nValue / 100.0f) ) {
-                    LogPrintf("ValidateRewardPayments -- Payee %s Diff %0.3f MaxDiff %0.3f Paid %0.3f Expected %0.3f\n",
-                        payout->entry.id.ToString(),abs(payout->reward - txout->nValue)/100000000,
-                        ((float)payout->reward / 10000000000.0f),txout->nValue/100000000,payout->reward/100000000);
-                }
-                return (payout->entry.id.GetScript() == txout->scriptPubKey)
-                    && (abs(payout->reward - txout->nValue) <= (float)payout->reward / 100.0f);
-            });
+            int nIndex;
 
-            if (payoutIt == remainingPayouts.end() && !fLiteMode) {
+            if (payoutIndex.Find(*txout, nIndex)) {
+                smartReward += txout->nValue;
+                payoutIndex.SetPaid(nIndex, nHeight);
+            } else if (!fLiteMode) {
                 LogPrintf("ValidateRewardPayments -- could not find block payee in payouts list\n");
                 result = SmartRewardPayments::InvalidRewardList;
                 LogPrintf("ValidateRewardPayments -- Payee %s\n",txout->ToString());
             } else {
                 smartReward += txout->nValue;
-                remainingPayouts.erase(payoutIt);
             }
         }
 
         // If last payee block, make sure all expected payouts have been found in blocks
-        if ((nHeight == pResult->round.GetLastRoundBlock()) && (remainingPayouts.size() > 0)) {
-            LogPrintf("ValidateRewardPayments -- missing payments, expected %d but got\n",
-                    pResult->round.GetPayeeCount(), pResult->round.GetPayeeCount() - remainingPayouts.size());
+        if ((nHeight == pResult->round.GetLastRoundBlock()) && (payoutIndex.Remaining() > 0)) {
+            LogPrintf("ValidateRewardPayments -- missing payments, expected %d but got %d\n",
+                    pResult->round.GetPayeeCount(), pResult->round.GetPayeeCount() - payoutIndex.Remaining());
             result = SmartRewardPayments::InvalidRewardList;
         }
     } else if (fLiteMode || result == SmartRewardPayments::NoRewardBlock) {
@@ -27,7 +27,7 @@ typedef enum{
 
 CSmartRewardResultEntryPtrList GetPayments(const CSmartRewardsRoundResult *pResult, const int64_t nPayoutDelay, const int nHeight, int64_t blockTime, SmartRewardPayments::Result &result);
 CSmartRewardResultEntryPtrList GetPaymentsForBlock(const int nHeight, int64_t blockTime, SmartRewardPayments::Result &result);
-SmartRewardPayments::Result Validate(const CBlock& block, const int nHeight, CAmount& smartReward);
+SmartRewardPayments::Result Validate(const CBlock& block, const CBlockIndex* pindex, CAmount& smartReward);
 void FillPayments(CMutableTransaction& txNew, int nHeight, int64_t prevBlockTime, std::vector<CTxOut>& voutSmartRewards);
 
 }
@@ -396,6 +396,7 @@ void CSmartVotingManager::UpdateCachesAndClean()
             nTimeExpired = std::numeric_limits<int64_t>::max();
 
             mapErasedProposals.insert(std::make_pair(nHash, nTimeExpired));
+            RemoveProposalVoteKeys(nHash);
             mapProposals.erase(it++);
         } else {
 
@@ -12,6 +12,7 @@
 #include "univalue.h"
 #include "smartvoting/exceptions.h"
 #include "smartvoting/proposal.h"
+#include "smartvoting/votevalidation.h"
 #include "net.h"
 
 
@@ -173,6 +174,9 @@ public:
         LOCK(cs);
 
         LogPrint("proposal", "SmartVoting manager was cleared\n");
+        for (const auto& it : mapProposals) {
+            RemoveProposalVoteKeys(it.first);
+        }
         mapProposals.clear();
         mapErasedProposals.clear();
         cmapVoteToProposal.Clear();
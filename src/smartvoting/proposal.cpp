@@ -409,6 +409,7 @@ bool CProposal::ProcessVote(CNode* pfrom,
     voteInstanceRef = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
     fileVotes.AddVote(vote);
     InvalidateVoteCache();
+    AddProposalVoteKey(GetHash(), vote.GetVoteKey());
     return true;
 }
 
@@ -426,6 +427,8 @@ void CProposal::ClearVoteKeyVotes()
 //            ++it;
 //        }
     }
+
+    RemoveProposalVoteKeys(GetHash());
 }
 
 void CProposal::UpdateLocalValidity()
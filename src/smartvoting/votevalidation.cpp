@@ -4,8 +4,8 @@
 
 #include "votevalidation.h"
 
+#include "indexbuilder.h"
 #include "init.h"
-#include "smartnode/smartnodesync.h"
 #include "smartvoting/manager.h"
 #include "spentindex.h"
 #include "validation.h"
@@ -15,149 +15,92 @@
 static CCriticalSection cs;
 
 static std::map<CVoteKey, CVotingPower> mapActiveVoteKeys;
-
-bool GetBalanceDelta(const CSmartAddress &address, int nStartBlock, int nEndBlock, CAmount &delta);
-
-void ThreadSmartVoting()
+// Active vote keys by the address index key of their voting address
+static std::map<std::pair<unsigned int, uint160>, std::set<CVoteKey> > mapAddressVoteKeys;
+// Vote keys with votes on each proposal
+static std::map<uint256, std::set<CVoteKey> > mapProposalVoteKeys;
+// Voting keys of the wallet
+static std::set<CVoteKey> setWalletVoteKeys;
+// Number of proposals voted on plus one if the wallet holds the key, keys are tracked while it's not zero
+static std::map<CVoteKey, int> mapVoteKeyRefs;
+
+static void AddActiveVoteKey(const CVoteKey &voteKey);
+static void RemoveActiveVoteKey(std::map<CVoteKey, CVotingPower>::iterator it);
+
+static void AddWalletVoteKey(const CKeyID &keyId)
 {
-    static bool fOneThread;
-    if(fOneThread) return;
-    fOneThread = true;
-
-    // We don't need to calculate any voting power in litemode.
-    if( fLiteMode ) return;
-
-    // Make this thread recognisable as the SmartVoting thread
-    RenameThread("smartvoting");
-
-    // Check if we have some unparsed votekey registrations every block
-    int nLastChecked = 0;
+    CVoteKey voteKey(keyId);
 
-    while (true)
     {
-        MilliSleep(1000);
-
-        if( ShutdownRequested() ) return;
-
-        if(smartnodeSync.IsBlockchainSynced() ) {
-
-            int nHeight = chainActive.Height();
-
-            if( nHeight == nLastChecked ) continue;
-
-            nLastChecked = nHeight;
-
-            std::set<CVoteKey> setActiveKeys;
-
-            // Update votekeys active from proposals
-            if( smartnodeSync.IsSynced() ){
-
-                std::vector<const CProposal*> vecProposals = smartVoting.GetAllNewerThan(0);
-
-                for( auto proposal : vecProposals ){
-                    proposal->GetActiveVoteKeys(setActiveKeys);
-                }
-
-                for( auto it : setActiveKeys ){
-                    AddActiveVoteKey(it);
-                }
-
-            }
-
-            if( pwalletMain ){
-
-                // Add votekeys available in the wallet to the validation
-                // and update the meta data of the votekeys if necessary
-
-                std::set<CKeyID> setWalletKeyIds;
-
-                {
-                    LOCK(pwalletMain->cs_wallet);
-                    pwalletMain->GetVotingKeys(setWalletKeyIds);
-                }
-
-                for( auto keyId : setWalletKeyIds ){
-
-                    CVoteKey voteKey(keyId);
-                    CVoteKeyValue value;
-
-                    if( IsRegisteredForVoting(voteKey) ){
-
-                        if( !setActiveKeys.count(voteKey) )
-                            setActiveKeys.insert(voteKey);
+        LOCK(cs);
+        if( !setWalletVoteKeys.insert(voteKey).second ) return;
+        ++mapVoteKeyRefs[voteKey];
+    }
 
-                        AddActiveVoteKey(voteKey);
-                    }
-                }
+    AddActiveVoteKey(voteKey);
+}
 
-            }
+CVotingPowerTracker::CVotingPowerTracker()
+{
+    // Start with the votes of the proposals loaded from disk and the keys of the wallet,
+    // the proposal and wallet events keep the set up to date afterwards.
+    for( auto proposal : smartVoting.GetAllNewerThan(0) ){
 
-            LOCK(cs);
+        std::set<CVoteKey> setVoteKeys;
+        proposal->GetActiveVoteKeys(setVoteKeys);
 
-            for (auto it = mapActiveVoteKeys.begin(); it != mapActiveVoteKeys.end();){
+        for( const auto& voteKey : setVoteKeys ){
+            AddProposalVoteKey(proposal->GetHash(), voteKey);
+        }
+    }
 
-                // Check if the address we validate is not longer active
-                if( setActiveKeys.size() && !setActiveKeys.count(it->first) ){
-                    it = mapActiveVoteKeys.erase(it);
-                    continue;
-                }
+    if( pwalletMain ){
 
-                int nStart = 0;
+        std::set<CKeyID> setWalletKeyIds;
 
-                if( it->second.IsValid() ){
+        {
+            LOCK(pwalletMain->cs_wallet);
+            pwalletMain->GetVotingKeys(setWalletKeyIds);
+            connWalletVotingKey = pwalletMain->NotifyVotingKeyAdded.connect(&AddWalletVoteKey);
+        }
 
-                    if( it->second.nBlockHeight < nHeight ){
-                        nStart = it->second.nBlockHeight + 1;
-                    }else{
-                        ++it;
-                        continue;
-                    }
+        for( auto keyId : setWalletKeyIds ){
+            AddWalletVoteKey(keyId);
+        }
+    }
+}
 
-                }
+void CVotingPowerTracker::AddressIndexUpdated(const CBlockIndex *pindex, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vecDeltas, bool fConnected)
+{
+    LOCK(cs);
 
-                if( nHeight < nValidationConfirmations ){
-                    ++it;
-                    continue;
-                }
+    if( mapActiveVoteKeys.empty() ) return;
 
-                if( ( nHeight - nStart ) < nValidationConfirmations ){
-                    ++it;
-                    continue;
-                }
+    // Keys added after the block got indexed read their balance with it already
+    auto fPending = [&](const CVotingPower &votingPower){
+        return votingPower.IsValid() && ( fConnected ? votingPower.nBlockHeight < pindex->nHeight :
+                                                       votingPower.nBlockHeight >= pindex->nHeight );
+    };
 
-                CAmount nDelta = 0;
+    for( const auto& delta : vecDeltas ){
 
-                if( GetBalanceDelta(it->second.address, nStart, nHeight, nDelta) ){
-                    it->second.nPower += nDelta;
-                    it->second.nBlockHeight = nHeight;
-                }
+        auto itAddress = mapAddressVoteKeys.find(std::make_pair(delta.first.type, delta.first.hashBytes));
 
-                ++it;
+        if( itAddress == mapAddressVoteKeys.end() ) continue;
 
+        for( const auto& voteKey : itAddress->second ){
+            auto it = mapActiveVoteKeys.find(voteKey);
+            if( it != mapActiveVoteKeys.end() && fPending(it->second) ){
+                it->second.nPower += fConnected ? delta.second : -delta.second;
             }
         }
     }
-}
 
-bool GetBalanceDelta(const CSmartAddress &address, int nStartBlock, int nEndBlock, CAmount &delta)
-{
-    uint160 hashBytes;
-    int type = 0;
+    int nHeight = fConnected ? pindex->nHeight : pindex->nHeight - 1;
 
-    if (!address.GetIndexKey(hashBytes, type)) {
-        return false;
+    for( auto& it : mapActiveVoteKeys ){
+        if( fPending(it.second) ) it.second.nBlockHeight = nHeight;
     }
-
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    if ( !GetAddressIndex(hashBytes, type, addressIndex, nStartBlock, nEndBlock) ) {
-        return false;
-    }
-
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++)
-        delta += it->second;
-
-    return true;
 }
 
 void GetVotingPower(const CVoteKey &voteKey, CVotingPower &votingPower)
@@ -189,13 +132,90 @@ int64_t GetVotingPower(const CVoteKey &voteKey)
     return 0;
 }
 
-void AddActiveVoteKey(const CVoteKey &voteKey)
+static void AddActiveVoteKey(const CVoteKey &voteKey)
+{
+    if( !pindexbuilder ) return;
+
+    // Hold the index builder lock so the balance and the height of the indexes
+    // match, AddressIndexUpdated skips the blocks the balance contains already
+    LOCK2(pindexbuilder->cs, cs);
+
+    // Unregistered keys are looked up again with each new reference
+    if( !mapVoteKeyRefs.count(voteKey) || mapActiveVoteKeys.count(voteKey) ) return;
+
+    CVoteKeyValue voteKeyValue;
+    if( !GetVoteKeyValue(voteKey, voteKeyValue) ) return;
+
+    CVotingPower votingPower(voteKeyValue.voteAddress);
+    uint160 hashBytes;
+    int type = 0;
+
+    if( voteKeyValue.voteAddress.GetIndexKey(hashBytes, type) ){
+
+        CAddressSummaryValue summary;
+
+        int nIndexHeight = pindexbuilder->GetBestHeight();
+
+        if( nIndexHeight >= 0 && GetAddressSummary(hashBytes, type, summary) ){
+            votingPower.nPower = summary.balance;
+            votingPower.nBlockHeight = nIndexHeight;
+        }
+
+        mapAddressVoteKeys[std::make_pair((unsigned int)type, hashBytes)].insert(voteKey);
+    }
+
+    mapActiveVoteKeys.insert(std::make_pair(voteKey, votingPower));
+}
+
+void AddProposalVoteKey(const uint256 &nProposalHash, const CVoteKey &voteKey)
+{
+    if( fLiteMode ) return;
+
+    {
+        LOCK(cs);
+        if( !mapProposalVoteKeys[nProposalHash].insert(voteKey).second ) return;
+        ++mapVoteKeyRefs[voteKey];
+    }
+
+    AddActiveVoteKey(voteKey);
+}
+
+void RemoveProposalVoteKeys(const uint256 &nProposalHash)
 {
     LOCK(cs);
 
-    if( !mapActiveVoteKeys.count(voteKey) ){
-        CVoteKeyValue voteKeyValue;
-        if(GetVoteKeyValue(voteKey, voteKeyValue) )
-            mapActiveVoteKeys.insert(std::make_pair(voteKey, CVotingPower(voteKeyValue.voteAddress)));
+    auto itProposal = mapProposalVoteKeys.find(nProposalHash);
+    if( itProposal == mapProposalVoteKeys.end() ) return;
+
+    for( const auto& voteKey : itProposal->second ){
+
+        auto itRefs = mapVoteKeyRefs.find(voteKey);
+        if( itRefs == mapVoteKeyRefs.end() || --itRefs->second > 0 ) continue;
+
+        mapVoteKeyRefs.erase(itRefs);
+
+        // Stop tracking the keys which are no longer active
+        auto it = mapActiveVoteKeys.find(voteKey);
+        if( it != mapActiveVoteKeys.end() ) RemoveActiveVoteKey(it);
     }
+
+    mapProposalVoteKeys.erase(itProposal);
+}
+
+static void RemoveActiveVoteKey(std::map<CVoteKey, CVotingPower>::iterator it)
+{
+    AssertLockHeld(cs);
+
+    uint160 hashBytes;
+    int type = 0;
+
+    if( it->second.address.GetIndexKey(hashBytes, type) ){
+        auto itAddress = mapAddressVoteKeys.find(std::make_pair((unsigned int)type, hashBytes));
+        if( itAddress != mapAddressVoteKeys.end() ){
+            itAddress->second.erase(it->first);
+            if( itAddress->second.empty() ) mapAddressVoteKeys.erase(itAddress);
+        }
+    }
+
+    mapActiveVoteKeys.erase(it);
 }
@@ -13,9 +13,8 @@
 #include "serialize.h"
 #include "streams.h"
 #include "uint256.h"
+#include "validationinterface.h"
 
-// Update all vote's voting power every nValidationConfirmations blocks
-static const int nValidationConfirmations = 6;
 // Check unparsed registrations every x seconds and remove them after n tries
 static const int nRegistrationCheckInterval = 2;
 static const int nRegistrationCheckMaxTries = 40;
@@ -36,8 +35,28 @@ struct CVotingPower{
     }
 };
 
-void ThreadSmartVoting();
-void AddActiveVoteKey(const CVoteKey &voteKey);
+/** Keeps the voting power of the active vote keys up to date with the
+ *  address index changes of connected and disconnected blocks. The active
+ *  keys are the registered keys voting on a proposal and the registered
+ *  voting keys of the wallet, they are added and removed by the proposal
+ *  and wallet events. */
+class CVotingPowerTracker : public CValidationInterface
+{
+    boost::signals2::scoped_connection connWalletVotingKey;
+
+public:
+    CVotingPowerTracker();
+    virtual ~CVotingPowerTracker() = default;
+
+protected:
+    // CValidationInterface
+    void AddressIndexUpdated(const CBlockIndex *pindex, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vecDeltas, bool fConnected) override;
+};
+
+/** Track the voting power of voteKey while nProposalHash has a vote from it */
+void AddProposalVoteKey(const uint256 &nProposalHash, const CVoteKey &voteKey);
+/** Release the vote keys of a removed proposal */
+void RemoveProposalVoteKeys(const uint256 &nProposalHash);
 void GetVotingPower(const CVoteKey &voteKey, CVotingPower &votingPower);
 int64_t GetVotingPower(const CVoteKey &voteKey);
 
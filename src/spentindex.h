@@ -9,8 +9,17 @@
 #include "uint256.h"
 #include "amount.h"
 #include "script/script.h"
+#include "primitives/transaction.h"
 #include "smarthive/hive.h"
 
+/** Check whether an output lock time has not expired yet at the given chain height and median time. */
+inline bool IsLockTimeActive(uint32_t nLockTime, int nHeight, int64_t nTime)
+{
+    if (!nLockTime)
+        return false;
+    return nLockTime < LOCKTIME_THRESHOLD ? nHeight < (int64_t)nLockTime : nTime < (int64_t)nLockTime;
+}
+
 struct CSpentIndexKey {
     uint256 txid;
     unsigned int outputIndex;
@@ -214,6 +223,17 @@ struct CAddressUnspentKey {
                a.txhash == b.txhash &&
                a.index == b.index;
     }
+
+    // Orders keys in memory only. It isn't the order of the keys in the
+    // database, index is serialized little-endian there.
+    friend bool operator<(const CAddressUnspentKey& a, const CAddressUnspentKey& b)
+    {
+        if (a.type != b.type) return a.type < b.type;
+        if (a.hashBytes != b.hashBytes) return a.hashBytes < b.hashBytes;
+        if (a.nBlockHeight != b.nBlockHeight) return a.nBlockHeight < b.nBlockHeight;
+        if (a.txhash != b.txhash) return a.txhash < b.txhash;
+        return a.index < b.index;
+    }
 };
 
 struct CAddressUnspentValue {
@@ -245,6 +265,15 @@ struct CAddressUnspentValue {
     bool IsNull() const {
         return (satoshis == -1);
     }
+
+    // The lock time is encoded in the stored script, no block read required
+    uint32_t GetLockTime() const {
+        return CTxOut(satoshis, script).GetLockTime();
+    }
+
+    bool IsLocked(int nHeight, int64_t nTime) const {
+        return IsLockTimeActive(GetLockTime(), nHeight, nTime);
+    }
 };
 
 struct CAddressIndexKey {
@@ -342,6 +371,11 @@ struct CAddressIndexIteratorKey {
         type = 0;
         hashBytes.SetNull();
     }
+
+    friend bool operator<(const CAddressIndexIteratorKey& a, const CAddressIndexIteratorKey& b)
+    {
+        return a.type == b.type ? a.hashBytes < b.hashBytes : a.type < b.type;
+    }
 };
 
 struct CAddressIndexIteratorHeightKey {
@@ -382,6 +416,54 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+/** Position of a transaction in the address index, the cursor of transaction pages */
+struct CAddressIndexIteratorTxKey {
+    unsigned int type;
+    uint160 hashBytes;
+    int blockHeight;
+    unsigned int txindex;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 29;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s, nType, nVersion);
+        ser_writedata32be(s, blockHeight);
+        ser_writedata32be(s, txindex);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        type = ser_readdata8(s);
+        hashBytes.Unserialize(s, nType, nVersion);
+        blockHeight = ser_readdata32be(s);
+        txindex = ser_readdata32be(s);
+    }
+
+    CAddressIndexIteratorTxKey(unsigned int addressType, uint160 addressHash, int height, unsigned int blockindex) {
+        type = addressType;
+        hashBytes = addressHash;
+        blockHeight = height;
+        txindex = blockindex;
+    }
+
+    CAddressIndexIteratorTxKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        type = 0;
+        hashBytes.SetNull();
+        blockHeight = 0;
+        txindex = 0;
+    }
+
+    bool IsNull() const {
+        return hashBytes.IsNull();
+    }
+};
+
 struct CAddressListEntry {
     unsigned int type;
     uint160 hashBytes;
@@ -409,6 +491,215 @@ struct CAddressListEntry {
     bool IsNull(){ return hashBytes.IsNull(); }
 };
 
+/** Key of the address balance index, iterating it yields the addresses sorted by descending balance */
+struct CAddressBalanceKey {
+    static const uint64_t BALANCE_SIGN_BIT = 0x8000000000000000ULL;
+
+    CAmount balance;
+    unsigned int type;
+    uint160 hashBytes;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 29;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        // Sign bit flipped so that the balances sort as signed numbers,
+        // inverted so that higher balances sort first
+        ser_writedata64be(s, ~((uint64_t)balance ^ BALANCE_SIGN_BIT));
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s, nType, nVersion);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        balance = (CAmount)(~ser_readdata64be(s) ^ BALANCE_SIGN_BIT);
+        type = ser_readdata8(s);
+        hashBytes.Unserialize(s, nType, nVersion);
+    }
+
+    CAddressBalanceKey(CAmount nBalance, unsigned int addressType, uint160 addressHash) {
+        balance = nBalance;
+        type = addressType;
+        hashBytes = addressHash;
+    }
+
+    CAddressBalanceKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        type = 0;
+        hashBytes.SetNull();
+    }
+
+    bool IsNull() const {
+        return hashBytes.IsNull();
+    }
+
+    friend bool operator==(const CAddressBalanceKey& a, const CAddressBalanceKey& b) {
+        return a.balance == b.balance && a.type == b.type && a.hashBytes == b.hashBytes;
+    }
+};
+
+struct CAddressSummaryValue {
+    CAmount balance;
+    CAmount received;
+    int64_t nTxCount;
+    int nFirstHeight;
+    int nLastHeight;
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(nTxCount);
+        READWRITE(nFirstHeight);
+        READWRITE(nLastHeight);
+    }
+
+    CAddressSummaryValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        nTxCount = 0;
+        nFirstHeight = -1;
+        nLastHeight = -1;
+    }
+
+    bool IsNull() const {
+        return nTxCount == 0;
+    }
+};
+
+/** Key of the lock index, the unspent outputs with a lock time of an address sorted by lock time */
+struct CAddressLockKey {
+    unsigned int type;
+    uint160 hashBytes;
+    uint32_t nLockTime;
+    uint256 txhash;
+    size_t index;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 61;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s, nType, nVersion);
+        ser_writedata32be(s, nLockTime);
+        txhash.Serialize(s, nType, nVersion);
+        ser_writedata32(s, index);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        type = ser_readdata8(s);
+        hashBytes.Unserialize(s, nType, nVersion);
+        nLockTime = ser_readdata32be(s);
+        txhash.Unserialize(s, nType, nVersion);
+        index = ser_readdata32(s);
+    }
+
+    CAddressLockKey(unsigned int addressType, uint160 addressHash, uint32_t lockTime, uint256 txid, size_t indexValue) {
+        type = addressType;
+        hashBytes = addressHash;
+        nLockTime = lockTime;
+        txhash = txid;
+        index = indexValue;
+    }
+
+    CAddressLockKey(const CAddressUnspentKey &unspentKey, uint32_t lockTime) {
+        type = unspentKey.type;
+        hashBytes = unspentKey.hashBytes;
+        nLockTime = lockTime;
+        txhash = unspentKey.txhash;
+        index = unspentKey.index;
+    }
+
+    CAddressLockKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        type = 0;
+        hashBytes.SetNull();
+        nLockTime = 0;
+        txhash.SetNull();
+        index = 0;
+    }
+};
+
+/** Seek key of the lock index, positions at the first lock of an address not below a lock time */
+struct CAddressLockIteratorKey {
+    unsigned int type;
+    uint160 hashBytes;
+    uint32_t nLockTime;
+
+    size_t GetSerializeSize(int nType, int nVersion) const {
+        return 25;
+    }
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const {
+        ser_writedata8(s, type);
+        hashBytes.Serialize(s, nType, nVersion);
+        ser_writedata32be(s, nLockTime);
+    }
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion) {
+        type = ser_readdata8(s);
+        hashBytes.Unserialize(s, nType, nVersion);
+        nLockTime = ser_readdata32be(s);
+    }
+
+    CAddressLockIteratorKey(unsigned int addressType, uint160 addressHash, uint32_t lockTime) {
+        type = addressType;
+        hashBytes = addressHash;
+        nLockTime = lockTime;
+    }
+
+    CAddressLockIteratorKey() {
+        SetNull();
+    }
+
+    void SetNull() {
+        type = 0;
+        hashBytes.SetNull();
+        nLockTime = 0;
+    }
+};
+
+/** Number and sum of the unspent outputs of an address */
+struct CAddressUnspentSummaryValue {
+    int64_t nCount;
+    CAmount satoshis;
+
+    ADD_SERIALIZE_METHODS
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nCount);
+        READWRITE(satoshis);
+    }
+
+    CAddressUnspentSummaryValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        nCount = 0;
+        satoshis = 0;
+    }
+
+    bool IsNull() const {
+        return nCount == 0;
+    }
+};
+
 struct CDepositIndexKey {
     unsigned int type;
     uint160 hashBytes;
@@ -813,5 +1104,14 @@ struct CInstantPayIndexIteratorTimeKey {
     }
 };
 
+/** The entries a block adds to or removes from the address, spent, deposit and timestamp indexes */
+struct CIndexBlockEntries {
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+    std::vector<std::pair<CDepositIndexKey, CDepositValue> > depositIndex;
+    std::vector<CTimestampIndexKey> timestampIndex;
+};
+
 
 #endif // BITCOIN_SPENTINDEX_H
@@ -3,12 +3,14 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "crypto/aes.h"
+#include "crypto/keccak256.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "hash.h"
 #include "random.h"
 #include "utilstrencodings.h"
 #include "test/test_bitcoin.h"
@@ -439,4 +441,27 @@ BOOST_AUTO_TEST_CASE(aes_cbc_testvectors) {
                   "b2eb05e2c39be9fcda6c19078c6a9d1b3f461796d6b0d6b2e0c2a72b4d80e644");
 }
 
+BOOST_AUTO_TEST_CASE(keccak256_tests) {
+    Keccak256AutoDetect();
+
+    // Compare the portable implementation against sph_keccak256 around the rate boundary
+    std::vector<unsigned char> in(300);
+    for (size_t i = 0; i < in.size(); i++)
+        in[i] = insecure_rand();
+    for (size_t len = 0; len < in.size(); len++) {
+        uint256 hash;
+        Keccak256(hash.begin(), in.data(), len);
+        BOOST_CHECK(hash == HashKeccak(in.begin(), in.begin() + len));
+    }
+
+    // The multi-buffer header hashing must match too, including the remainder
+    std::vector<uint256> hashes(7);
+    std::vector<unsigned char> headers(hashes.size() * KECCAK256_HEADER_SIZE);
+    for (size_t i = 0; i < headers.size(); i++)
+        headers[i] = insecure_rand();
+    Keccak256_80(hashes[0].begin(), headers.data(), hashes.size());
+    for (size_t i = 0; i < hashes.size(); i++)
+        BOOST_CHECK(hashes[i] == HashKeccak(headers.begin() + i * KECCAK256_HEADER_SIZE, headers.begin() + (i + 1) * KECCAK256_HEADER_SIZE));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -115,6 +115,14 @@ BOOST_AUTO_TEST_CASE(merkle_test)
             BOOST_CHECK((newRoot == uint256()) == (ntx == 0));
             BOOST_CHECK(oldMutated == newMutated);
             BOOST_CHECK(newMutated == !!mutate);
+            // The constant-space computation must agree with the level-by-level one.
+            std::vector<uint256> leaves;
+            for (const CTransaction& tx : block.vtx) {
+                leaves.push_back(tx.GetHash());
+            }
+            bool constantSpaceMutated = false;
+            BOOST_CHECK(ComputeMerkleRootConstantSpace(leaves, &constantSpaceMutated) == newRoot);
+            BOOST_CHECK(constantSpaceMutated == newMutated);
             // If no mutation was done (once for every ntx value), try up to 16 branches.
             if (mutate == 0) {
                 for (int loop = 0; loop < std::min(ntx, 16); loop++) {
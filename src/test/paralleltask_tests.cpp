@@ -0,0 +1,64 @@
+// Copyright (c) 2017 - 2020 - The SmartCash Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "paralleltask.h"
+
+#include "test/test_bitcoin.h"
+
+#include <stdexcept>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(paralleltask_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(paralleltask_ranges)
+{
+    // Boost.Test checks are not thread safe, the tasks only record what they saw
+    std::vector<int> vParts(1000, -1);
+    std::vector<int> vVisits(vParts.size(), 0);
+
+    // Every index gets visited exactly once, by the part it belongs to
+    for (int nParts = 1; nParts <= 5; ++nParts) {
+        ParallelForRanges(vParts.size(), nParts, [&](size_t nBegin, size_t nEnd, int nPart) {
+            for (size_t i = nBegin; i < nEnd; ++i) {
+                vParts[i] = nPart;
+                ++vVisits[i];
+            }
+        });
+        for (size_t i = 0; i < vParts.size(); ++i) {
+            BOOST_CHECK_EQUAL(vVisits[i], 1);
+            BOOST_CHECK(vParts[i] >= 0 && vParts[i] < nParts);
+            BOOST_CHECK(i == 0 || vParts[i] >= vParts[i - 1]);
+            vVisits[i] = 0;
+        }
+    }
+
+    // No items leaves every range empty
+    std::vector<int> vSizes(3, -1);
+    ParallelForRanges(0, vSizes.size(), [&](size_t nBegin, size_t nEnd, int nPart) {
+        vSizes[nPart] = nEnd - nBegin;
+    });
+    for (size_t i = 0; i < vSizes.size(); ++i)
+        BOOST_CHECK_EQUAL(vSizes[i], 0);
+}
+
+BOOST_AUTO_TEST_CASE(paralleltask_exception)
+{
+    // A throwing task must not take down its worker thread, the caller gets the exception
+    BOOST_CHECK_THROW(ParallelForRanges(100, 4, [&](size_t nBegin, size_t nEnd, int nPart) {
+        if (nPart == 2)
+            throw std::runtime_error("task failed");
+    }), std::runtime_error);
+
+    // The queue is usable again afterwards
+    std::vector<std::function<void()> > vTasks;
+    std::vector<int> vDone(8, 0);
+    for (size_t i = 0; i < vDone.size(); ++i)
+        vTasks.push_back([&vDone, i] { vDone[i] = 1; });
+    RunParallelTasks(vTasks);
+    for (size_t i = 0; i < vDone.size(); ++i)
+        BOOST_CHECK_EQUAL(vDone[i], 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,15 +2,24 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "arith_uint256.h"
 #include "chain.h"
 #include "chainparams.h"
+#include "crypto/common.h"
 #include "pow.h"
 #include "random.h"
 #include "util.h"
+#include "utilstrencodings.h"
 #include "test/test_bitcoin.h"
 
+#include "data/retarget_headers.json.h"
+
 #include <boost/test/unit_test.hpp>
 
+#include <univalue.h>
+
+extern UniValue read_json(const std::string& jsondata);
+
 using namespace std;
 
 BOOST_FIXTURE_TEST_SUITE(pow_tests, BasicTestingSetup)
@@ -95,4 +104,105 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+/* Deterministic block spacing, fast, warped back, regular and slow blocks */
+static int64_t RetargetTestSpacing(uint64_t& nState, int nMode)
+{
+    nState ^= nState << 13; nState ^= nState >> 7; nState ^= nState << 17;
+    uint64_t r = nState % 100;
+    nState ^= nState << 13; nState ^= nState >> 7; nState ^= nState << 17;
+    if (nMode == 1) return 1 + nState % 3;
+    if (nMode == 2) return 2000 + nState % 5000;
+    if (r < 20) return nState % 10;
+    if (r < 25) return -(int64_t)(nState % 120);
+    if (r < 90) return 30 + nState % 60;
+    return 200 + nState % 3000;
+}
+
+/* The retarget has to match the results of the bignum implementation it replaced */
+BOOST_AUTO_TEST_CASE(retarget_bignum_equivalence)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    struct {
+        uint64_t nSeed;
+        unsigned int nStartBits;
+        int nMode;
+        uint32_t nPastBlocksMin;
+        uint32_t nPastBlocksMax;
+        unsigned int nLastBits;
+        uint64_t nChecksum;
+    } vChains[] = {
+        {1, 0x1e0ffff0, 0, 2, 785, 0x1e0fffff, 0x6a1797033506fcb1ULL},
+        {2, 0x1b0404cb, 0, 2, 785, 0x1e0fffff, 0x49996b5124e0e1a3ULL},
+        {3, 0x1e0ffff0, 0, 0, 10, 0x1e023a69, 0x16a9b1e23fa3d1c7ULL},
+        // Blocks of 1 to 3 seconds take the target down to 0 at height 400, as the bignums did
+        {4, 0x1e0ffff0, 1, 2, 785, 0x00000000, 0x2ca5571be3659fe4ULL},
+        {5, 0x207fffff, 2, 2, 785, 0x1e0fffff, 0x811176eb0189b858ULL},
+        {6, 0x1d00ffff, 2, 0, 10, 0x1e0fffff, 0xac9e849010012c8bULL},
+    };
+
+    for (const auto& chain : vChains) {
+        // The second pass gives the blocks a hash and goes through the retarget cache
+        for (int nPass = 0; nPass < 2; nPass++) {
+            uint64_t nState = chain.nSeed;
+            uint64_t nChecksum = 0;
+            std::vector<CBlockIndex> blocks(3000);
+            std::vector<uint256> hashes(blocks.size());
+
+            for (size_t i = 0; i < blocks.size(); i++) {
+                blocks[i].pprev = i ? &blocks[i - 1] : NULL;
+                blocks[i].nHeight = i;
+                blocks[i].nTime = i ? blocks[i - 1].nTime + RetargetTestSpacing(nState, chain.nMode) : 1500000000;
+                if (nPass) {
+                    hashes[i] = ArithToUint256(arith_uint256(chain.nSeed * 100000 + i + 1));
+                    blocks[i].phashBlock = &hashes[i];
+                }
+                blocks[i].nBits = i ? BorisRidiculouslyNamedDifficultyFunction(&blocks[i - 1], 55, chain.nPastBlocksMin, chain.nPastBlocksMax) : chain.nStartBits;
+                nChecksum = nChecksum * 1000003 ^ blocks[i].nBits;
+            }
+
+            BOOST_CHECK_EQUAL(blocks.back().nBits, chain.nLastBits);
+            BOOST_CHECK_EQUAL(nChecksum, chain.nChecksum);
+            BOOST_CHECK_EQUAL(BorisRidiculouslyNamedDifficultyFunction(&blocks[blocks.size() - 2], 55, chain.nPastBlocksMin, chain.nPastBlocksMax), chain.nLastBits);
+        }
+    }
+}
+
+/* Replays the synthetic headers of data/retarget_headers.json through the mainnet retarget rules.
+ * Their times are generated and their bits come from the old bignum retarget code, so this pins
+ * the new code to the old one at mainnet heights. It is no replay of the real mainnet chain. */
+BOOST_AUTO_TEST_CASE(retarget_header_replay)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = Params().GetConsensus();
+
+    UniValue tests = read_json(std::string(json_tests::retarget_headers, json_tests::retarget_headers + sizeof(json_tests::retarget_headers)));
+    std::vector<CBlockIndex> blocks;
+    blocks.reserve(tests.size());
+
+    for (unsigned int idx = 0; idx < tests.size(); idx++) {
+        UniValue test = tests[idx];
+        std::string strTest = test.write();
+        if (test.size() < 3) // Allow for extra stuff (useful for comments)
+        {
+            BOOST_CHECK_MESSAGE(test.size() == 1, "Bad test: " << strTest);
+            continue;
+        }
+
+        CBlockIndex block;
+        block.pprev = blocks.empty() ? NULL : &blocks.back();
+        block.nHeight = test[0].get_int();
+        block.nTime = test[1].get_int64();
+        block.nBits = ReadBE32(ParseHex(test[2].get_str()).data());
+        BOOST_CHECK_MESSAGE(!block.pprev || block.nHeight == block.pprev->nHeight + 1, "Bad test: " << strTest);
+        blocks.push_back(block);
+
+        // The first headers are the averaging window of the later ones
+        if (blocks.size() > 786) {
+            BOOST_CHECK_MESSAGE(GetNextWorkRequired(block.pprev, NULL, params) == block.nBits, "Retarget mismatch: " << strTest);
+        }
+    }
+    BOOST_CHECK(blocks.size() > 786);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -12,13 +12,17 @@
 #include "key.h"
 #include "validation.h"
 #include "miner.h"
+#include "net_processing.h"
+#include "paralleltask.h"
 #include "pubkey.h"
 #include "random.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
 #include "rpc/server.h"
-#include "rpc/register.h"
+#include "smarthive/hive.h"
+#include "smarthive/hivepayments.h"
+#include "smartrewards/rewards.h"
 
 #include "test/testutil.h"
 
@@ -26,6 +30,8 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/thread.hpp>
 
+FastRandomContext insecure_rand_ctx(true);
+
 extern bool fPrintToConsole;
 extern void noui_connect();
 
@@ -48,9 +54,6 @@ BasicTestingSetup::~BasicTestingSetup()
 TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(chainName)
 {
     const CChainParams& chainparams = Params();
-        // Ideally we'd move all the RPC tests to the functional testing framework
-        // instead of unit tests, but for now we need these here.
-        RegisterAllCoreRPCCommands(tableRPC);
         ClearDatadirCache();
         pathTemp = GetTempPath() / strprintf("test_bitcoin_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
         boost::filesystem::create_directories(pathTemp);
@@ -59,6 +62,10 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         pblocktree = new CBlockTreeDB(1 << 20, true);
         pcoinsdbview = new CCoinsViewDB(1 << 23, true);
         pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+        prewards = new CSmartRewards(new CSmartRewardsDB(1 << 20, true));
+        // Block templates and connected blocks need the hive payout rules
+        SmartHive::Init();
+        SmartHivePayments::Init();
         InitBlockIndex(chainparams);
         {
             CValidationState state;
@@ -68,6 +75,8 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         nScriptCheckThreads = 3;
         for (int i=0; i < nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        for (int i=0; i < nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadParallelTask);
         RegisterNodeSignals(GetNodeSignals());
 }
 
@@ -77,6 +86,8 @@ TestingSetup::~TestingSetup()
         threadGroup.interrupt_all();
         threadGroup.join_all();
         UnloadBlockIndex();
+        delete prewards;
+        prewards = NULL;
         delete pcoinsTip;
         delete pcoinsdbview;
         delete pblocktree;
@@ -104,7 +115,7 @@ CBlock
 TestChain100Setup::CreateAndProcessBlock(const std::vector<CMutableTransaction>& txns, const CScript& scriptPubKey)
 {
     const CChainParams& chainparams = Params();
-    CBlockTemplate *pblocktemplate = BlockAssembler(chainparams).CreateNewBlock(scriptPubKey);
+    CBlockTemplate *pblocktemplate = BlockAssembler(chainparams).CreateNewBlock(scriptPubKey, CSmartAddress());
     CBlock& block = pblocktemplate->block;
 
     // Replace mempool-selected txns with just coinbase plus passed-in txns:
@@ -115,10 +126,9 @@ TestChain100Setup::CreateAndProcessBlock(const std::vector<CMutableTransaction>&
     unsigned int extraNonce = 0;
     IncrementExtraNonce(&block, chainActive.Tip(), extraNonce);
 
-    while (!CheckProofOfWork(block.GetHash(), block.nBits, chainparams.GetConsensus())) ++block.nNonce;
+    while (!CheckProofOfWork(chainActive.Height() + 1, block.GetHash(), block.nBits, chainparams.GetConsensus())) ++block.nNonce;
 
-    CValidationState state;
-    ProcessNewBlock(state, chainparams, NULL, &block, true, NULL, false);
+    ProcessNewBlock(chainparams, &block, true, NULL, NULL);
 
     CBlock result = block;
     delete pblocktemplate;
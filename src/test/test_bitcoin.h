@@ -8,12 +8,25 @@
 #include "chainparamsbase.h"
 #include "key.h"
 #include "pubkey.h"
+#include "random.h"
 #include "txdb.h"
 #include "txmempool.h"
 
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 
+extern FastRandomContext insecure_rand_ctx;
+
+static inline void seed_insecure_rand(bool fDeterministic = false)
+{
+    insecure_rand_ctx = FastRandomContext(fDeterministic);
+}
+
+static inline uint32_t insecure_rand(void)
+{
+    return insecure_rand_ctx.rand32();
+}
+
 /** Basic testing setup.
  * This just configures logging and chain parameters.
  */
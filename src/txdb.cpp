@@ -12,6 +12,9 @@
 #include "ui_interface.h"
 #include "init.h"
 
+#include <algorithm>
+#include <limits>
+#include <set>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -24,6 +27,10 @@ static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSUNSPENTSUMMARYINDEX = 'U';
+static const char DB_ADDRESSSUMMARYINDEX = 'A';
+static const char DB_ADDRESSBALANCEINDEX = 'W';
+static const char DB_ADDRESSLOCKINDEX = 'L';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_DEPOSITINDEX = 'd';
@@ -36,6 +43,7 @@ static const char DB_VOTE_MAP_KEY_TO_ADDRESS = 'V';
 static const char DB_INSTANTPAY_INDEX = 'i';
 
 static const char DB_BEST_BLOCK = 'B';
+static const char DB_INDEXES_BEST_BLOCK = 'X';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
@@ -64,7 +72,7 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, CHAINSTATE_DB_OPTIONS.FromArgs("chainstate"))
 {
 }
 
@@ -113,7 +121,7 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, BLOCKTREE_DB_OPTIONS.FromArgs("index")) {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -217,58 +225,28 @@ bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     return Read(make_pair(DB_SPENTINDEX, key), value);
 }
 
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
-        }
-    }
-    return WriteBatch(batch);
-}
+bool CBlockTreeDB::ReadAddressUnspentSummary(uint160 addressHash, int type, CAddressUnspentSummaryValue &summary, CAddressUnspentKey &lastIndex) {
 
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
-        }
-    }
-    return WriteBatch(batch);
-}
+    lastIndex.SetNull();
+    summary.SetNull();
 
-bool CBlockTreeDB::ReadAddressUnspentIndexCount(uint160 addressHash, int type, int &nCount, CAddressUnspentKey &lastIndex) {
+    if (!Read(make_pair(DB_ADDRESSUNSPENTSUMMARYINDEX, CAddressIndexIteratorKey(type, addressHash)), summary) || summary.IsNull())
+        return true;
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    // Seek behind the last possible output of the address and step back
+    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorHeightKey(type, addressHash, std::numeric_limits<int>::max())));
 
-    lastIndex.SetNull();
-    nCount = 0;
+    if (pcursor->Valid())
+        pcursor->Prev();
+    else
+        pcursor->SeekToLast();
 
     std::pair<char,CAddressUnspentKey> key;
-
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            ++nCount;
-            pcursor->Next();
-        } else if( nCount ) {
-
-            pcursor->Prev();
-
-            if(pcursor->Valid() && pcursor->GetKey(key))
-                lastIndex = key.second;
-
-            break;
-        }else{
-            break;
-        }
-    }
+    if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX &&
+        key.second.type == static_cast<unsigned int>(type) && key.second.hashBytes == addressHash)
+        lastIndex = key.second;
 
     return true;
 }
@@ -314,20 +292,6 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
     return true;
 }
 
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
-}
-
 
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
@@ -364,6 +328,542 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
 }
 
 
+bool CBlockTreeDB::ReadAddressTransactions(uint160 addressHash, int type,
+                                           std::vector<std::tuple<uint256, int, CAmount> > &addressTxs,
+                                           const CAddressIndexIteratorTxKey &start, int offset, int limit, bool reverse,
+                                           CAddressIndexIteratorTxKey *pnext) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    int nOffsetCount = 0;
+
+    addressTxs.clear();
+
+    if (pnext)
+        pnext->SetNull();
+
+    if (reverse) {
+        // Position on the first entry behind the start transaction and step back from there
+        if (start.IsNull())
+            pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, std::numeric_limits<int>::max())));
+        else
+            pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorTxKey(type, addressHash, start.blockHeight, start.txindex + 1)));
+
+        if (pcursor->Valid())
+            pcursor->Prev();
+        else
+            pcursor->SeekToLast();
+    } else if (!start.IsNull()) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorTxKey(type, addressHash, start.blockHeight, start.txindex)));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+
+    uint256 lastTx;
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX ||
+            key.second.type != (unsigned int)type || key.second.hashBytes != addressHash)
+            break;
+
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address index value");
+
+        // Entries of the same transaction are adjacent in the index, merge them
+        // into one and count distinct transactions for the offset and the limit.
+        if (lastTx.IsNull() || key.second.txhash != lastTx) {
+
+            if (limit > 0 && static_cast<int>(addressTxs.size()) == limit) {
+                if (pnext)
+                    *pnext = CAddressIndexIteratorTxKey(type, addressHash, key.second.blockHeight, key.second.txindex);
+                break;
+            }
+
+            lastTx = key.second.txhash;
+
+            if (offset < 0 || ++nOffsetCount > offset)
+                addressTxs.emplace_back(key.second.txhash, key.second.blockHeight, nValue);
+
+        } else if (!addressTxs.empty() && std::get<0>(addressTxs.back()) == lastTx) {
+            std::get<2>(addressTxs.back()) += nValue;
+        }
+
+        if (reverse) pcursor->Prev();
+        else         pcursor->Next();
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressSummary(uint160 addressHash, int type, CAddressSummaryValue &summary) {
+    summary.SetNull();
+    return Read(make_pair(DB_ADDRESSSUMMARYINDEX, CAddressIndexIteratorKey(type, addressHash)), summary);
+}
+
+bool CBlockTreeDB::UpdateAddressSummaryIndex(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fUndo) {
+
+    // Group the block's entries by address, they are applied to one summary read each
+    std::map<std::pair<unsigned int, uint160>, std::vector<const std::pair<CAddressIndexKey, CAmount>*> > mapEntries;
+
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        mapEntries[std::make_pair(it->first.type, it->first.hashBytes)].push_back(&(*it));
+
+    for (const auto &address : mapEntries) {
+
+        CAddressIndexIteratorKey summaryKey(address.first.first, address.first.second);
+        CAddressSummaryValue summary;
+        std::set<uint256> setTxes;
+        int nHeight = address.second.front()->first.blockHeight;
+
+        if (Read(make_pair(DB_ADDRESSSUMMARYINDEX, summaryKey), summary))
+            batch.Erase(make_pair(DB_ADDRESSBALANCEINDEX, CAddressBalanceKey(summary.balance, summaryKey.type, summaryKey.hashBytes)));
+        else
+            summary.SetNull();
+
+        for (const auto *entry : address.second) {
+            const CAmount nValue = fUndo ? -entry->second : entry->second;
+
+            summary.balance += nValue;
+
+            if (entry->second > 0)
+                summary.received += nValue;
+
+            setTxes.insert(entry->first.txhash);
+        }
+
+        if (!fUndo) {
+
+            summary.nTxCount += setTxes.size();
+
+            if (summary.nFirstHeight == -1)
+                summary.nFirstHeight = nHeight;
+
+            summary.nLastHeight = nHeight;
+
+        } else {
+
+            summary.nTxCount -= setTxes.size();
+
+            if (summary.nTxCount <= 0) {
+                batch.Erase(make_pair(DB_ADDRESSSUMMARYINDEX, summaryKey));
+                continue;
+            }
+
+            // The entry right before the block's height is the previous activity, no
+            // matter if the block's entries are already erased from the address index.
+            boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+            pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(summaryKey.type, summaryKey.hashBytes, nHeight)));
+
+            if (pcursor->Valid()) {
+                pcursor->Prev();
+
+                std::pair<char,CAddressIndexKey> key;
+                if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX &&
+                    key.second.type == summaryKey.type && key.second.hashBytes == summaryKey.hashBytes)
+                    summary.nLastHeight = key.second.blockHeight;
+            }
+        }
+
+        batch.Write(make_pair(DB_ADDRESSSUMMARYINDEX, summaryKey), summary);
+        batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, CAddressBalanceKey(summary.balance, summaryKey.type, summaryKey.hashBytes)), summary.received);
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::UpdateAddressUnspentSummaryIndex(CDBBatch &batch, const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect) {
+
+    // The outputs of the batch which are not in the database yet. A block
+    // can create and spend the same output.
+    std::map<CAddressUnspentKey, CAddressUnspentValue> mapOutputs;
+    std::map<CAddressIndexIteratorKey, CAddressUnspentSummaryValue> mapSummaries;
+
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+
+        const CAddressUnspentKey &unspentKey = it->first;
+        CAddressIndexIteratorKey summaryKey(unspentKey.type, unspentKey.hashBytes);
+
+        std::map<CAddressIndexIteratorKey, CAddressUnspentSummaryValue>::iterator itSummary = mapSummaries.find(summaryKey);
+        if (itSummary == mapSummaries.end()) {
+            CAddressUnspentSummaryValue summary;
+            Read(make_pair(DB_ADDRESSUNSPENTSUMMARYINDEX, summaryKey), summary);
+            itSummary = mapSummaries.insert(std::make_pair(summaryKey, summary)).first;
+        }
+
+        CAddressUnspentValue previous;
+        std::map<CAddressUnspentKey, CAddressUnspentValue>::iterator itOutput = mapOutputs.find(unspentKey);
+        if (itOutput != mapOutputs.end())
+            previous = itOutput->second;
+        else
+            Read(make_pair(DB_ADDRESSUNSPENTINDEX, unspentKey), previous);
+
+        CAddressUnspentSummaryValue &summary = itSummary->second;
+
+        // Locks are kept for unspent outputs only, spending an output drops its lock
+        if (!previous.IsNull()) {
+            --summary.nCount;
+            summary.satoshis -= previous.satoshis;
+
+            uint32_t nLockTime = previous.GetLockTime();
+            if (nLockTime)
+                batch.Erase(make_pair(DB_ADDRESSLOCKINDEX, CAddressLockKey(unspentKey, nLockTime)));
+        }
+
+        if (!it->second.IsNull()) {
+            ++summary.nCount;
+            summary.satoshis += it->second.satoshis;
+
+            uint32_t nLockTime = it->second.GetLockTime();
+            if (nLockTime)
+                batch.Write(make_pair(DB_ADDRESSLOCKINDEX, CAddressLockKey(unspentKey, nLockTime)), it->second.satoshis);
+        }
+
+        mapOutputs[unspentKey] = it->second;
+    }
+
+    for (std::map<CAddressIndexIteratorKey, CAddressUnspentSummaryValue>::const_iterator it=mapSummaries.begin(); it!=mapSummaries.end(); it++) {
+        if (it->second.nCount < 0)
+            return error("%s: negative unspent output count", __func__);
+
+        if (it->second.IsNull())
+            batch.Erase(make_pair(DB_ADDRESSUNSPENTSUMMARYINDEX, it->first));
+        else
+            batch.Write(make_pair(DB_ADDRESSUNSPENTSUMMARYINDEX, it->first), it->second);
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::BuildAddressSummaryIndex() {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+    int nAddresses = 0;
+
+    LogPrintf("Building address summary index...\n");
+
+    pcursor->Seek(DB_ADDRESSINDEX);
+
+    CAddressIndexKey currentKey;
+    CAddressSummaryValue summary;
+    uint256 lastTx;
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSINDEX)
+            break;
+
+        if (currentKey.IsNull() || key.second.type != currentKey.type || key.second.hashBytes != currentKey.hashBytes) {
+
+            if (!currentKey.IsNull()) {
+                batch.Write(make_pair(DB_ADDRESSSUMMARYINDEX, CAddressIndexIteratorKey(currentKey.type, currentKey.hashBytes)), summary);
+                batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, CAddressBalanceKey(summary.balance, currentKey.type, currentKey.hashBytes)), summary.received);
+                ++nAddresses;
+            }
+
+            currentKey = key.second;
+            summary.SetNull();
+            lastTx.SetNull();
+        }
+
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address index value");
+
+        summary.balance += nValue;
+
+        if (nValue > 0)
+            summary.received += nValue;
+
+        // Entries of the same transaction are adjacent in the index
+        if (key.second.txhash != lastTx) {
+            ++summary.nTxCount;
+            lastTx = key.second.txhash;
+        }
+
+        if (summary.nFirstHeight == -1)
+            summary.nFirstHeight = key.second.blockHeight;
+
+        summary.nLastHeight = key.second.blockHeight;
+
+        if (batch.SizeEstimate() > 16 * 1024 * 1024) {
+            if (!WriteBatch(batch))
+                return error("failed to write address summary batch");
+            batch.Clear();
+        }
+
+        pcursor->Next();
+    }
+
+    if (!currentKey.IsNull()) {
+        batch.Write(make_pair(DB_ADDRESSSUMMARYINDEX, CAddressIndexIteratorKey(currentKey.type, currentKey.hashBytes)), summary);
+        batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, CAddressBalanceKey(summary.balance, currentKey.type, currentKey.hashBytes)), summary.received);
+        ++nAddresses;
+    }
+
+    if (!WriteBatch(batch))
+        return error("failed to write address summary batch");
+
+    LogPrintf("Built address summaries for %d addresses\n", nAddresses);
+
+    return true;
+}
+
+/** Erase all entries stored with the given prefix, K is the type of their keys */
+template <typename K>
+static bool EraseIndex(CDBWrapper &db, char prefix) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    CDBBatch batch(db);
+
+    pcursor->Seek(prefix);
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, K> key;
+        if (!pcursor->GetKey(key) || key.first != prefix)
+            break;
+
+        batch.Erase(key);
+
+        if (batch.SizeEstimate() > 16 * 1024 * 1024) {
+            if (!db.WriteBatch(batch))
+                return error("%s: failed to write batch", __func__);
+            batch.Clear();
+        }
+
+        pcursor->Next();
+    }
+
+    return db.WriteBatch(batch);
+}
+
+bool CBlockTreeDB::BuildAddressBalanceIndex() {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+    int nAddresses = 0;
+
+    LogPrintf("Building address balance index...\n");
+
+    // Drop the entries of an earlier build
+    if (!EraseIndex<CAddressBalanceKey>(*this, DB_ADDRESSBALANCEINDEX))
+        return error("failed to erase the address balance index");
+
+    pcursor->Seek(DB_ADDRESSSUMMARYINDEX);
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexIteratorKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSSUMMARYINDEX)
+            break;
+
+        CAddressSummaryValue summary;
+        if (!pcursor->GetValue(summary))
+            return error("failed to get address summary value");
+
+        batch.Write(make_pair(DB_ADDRESSBALANCEINDEX, CAddressBalanceKey(summary.balance, key.second.type, key.second.hashBytes)), summary.received);
+        ++nAddresses;
+
+        if (batch.SizeEstimate() > 16 * 1024 * 1024) {
+            if (!WriteBatch(batch))
+                return error("failed to write address balance batch");
+            batch.Clear();
+        }
+
+        pcursor->Next();
+    }
+
+    if (!WriteBatch(batch))
+        return error("failed to write address balance batch");
+
+    LogPrintf("Built address balances for %d addresses\n", nAddresses);
+
+    return true;
+}
+
+bool CBlockTreeDB::BuildAddressUnspentSummaryIndex() {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+    CAddressIndexIteratorKey currentKey;
+    CAddressUnspentSummaryValue summary;
+    int nAddresses = 0;
+
+    LogPrintf("Building address unspent summary index...\n");
+
+    pcursor->Seek(DB_ADDRESSUNSPENTINDEX);
+
+    while (true) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressUnspentKey> key;
+        bool fValid = pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX;
+
+        // Write the summary of the previous address when a new one starts
+        if (!summary.IsNull() && (!fValid || key.second.type != currentKey.type || key.second.hashBytes != currentKey.hashBytes)) {
+            batch.Write(make_pair(DB_ADDRESSUNSPENTSUMMARYINDEX, currentKey), summary);
+            summary.SetNull();
+            ++nAddresses;
+
+            if (batch.SizeEstimate() > 16 * 1024 * 1024) {
+                if (!WriteBatch(batch))
+                    return error("failed to write address unspent summary batch");
+                batch.Clear();
+            }
+        }
+
+        if (!fValid)
+            break;
+
+        CAddressUnspentValue unspentValue;
+        if (!pcursor->GetValue(unspentValue))
+            return error("failed to get address unspent value");
+
+        currentKey = CAddressIndexIteratorKey(key.second.type, key.second.hashBytes);
+        ++summary.nCount;
+        summary.satoshis += unspentValue.satoshis;
+
+        pcursor->Next();
+    }
+
+    if (!WriteBatch(batch))
+        return error("failed to write address unspent summary batch");
+
+    LogPrintf("Built unspent summaries for %d addresses\n", nAddresses);
+
+    return true;
+}
+
+bool CBlockTreeDB::BuildAddressLockIndex() {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    CDBBatch batch(*this);
+    int nLocks = 0;
+
+    LogPrintf("Building address lock index...\n");
+
+    pcursor->Seek(DB_ADDRESSUNSPENTINDEX);
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressUnspentKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX)
+            break;
+
+        CAddressUnspentValue unspentValue;
+        if (!pcursor->GetValue(unspentValue))
+            return error("failed to get address unspent value");
+
+        uint32_t nLockTime = unspentValue.GetLockTime();
+
+        if (nLockTime) {
+            batch.Write(make_pair(DB_ADDRESSLOCKINDEX, CAddressLockKey(key.second, nLockTime)), unspentValue.satoshis);
+            ++nLocks;
+
+            if (batch.SizeEstimate() > 16 * 1024 * 1024) {
+                if (!WriteBatch(batch))
+                    return error("failed to write address lock batch");
+                batch.Clear();
+            }
+        }
+
+        pcursor->Next();
+    }
+
+    if (!WriteBatch(batch))
+        return error("failed to write address lock batch");
+
+    LogPrintf("Built address lock index with %d locked outputs\n", nLocks);
+
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressLocked(uint160 addressHash, int type, int nHeight, int64_t nTime, CAmount &nLocked) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    nLocked = 0;
+
+    // Height locks sort before time locks, only the ones above the reference
+    // height and time are still active and get read.
+    uint32_t nHeightFrom = (uint32_t)std::max(nHeight + 1, 1);
+    uint32_t nTimeFrom = (uint32_t)std::min<int64_t>(std::max<int64_t>(nTime + 1, LOCKTIME_THRESHOLD), std::numeric_limits<uint32_t>::max());
+
+    pcursor->Seek(make_pair(DB_ADDRESSLOCKINDEX, CAddressLockIteratorKey(type, addressHash, nHeightFrom)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressLockKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSLOCKINDEX ||
+            key.second.type != (unsigned int)type || key.second.hashBytes != addressHash)
+            break;
+
+        if (key.second.nLockTime >= LOCKTIME_THRESHOLD && key.second.nLockTime < nTimeFrom) {
+            pcursor->Seek(make_pair(DB_ADDRESSLOCKINDEX, CAddressLockIteratorKey(type, addressHash, nTimeFrom)));
+            continue;
+        }
+
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address lock value");
+
+        nLocked += nValue;
+
+        pcursor->Next();
+    }
+
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressBalances(std::vector<CAddressListEntry> &addressList, CAddressBalanceKey &cursor, int limit, bool excludeZeroBalances, const CDBSnapshot *snapshot) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(snapshot ? snapshot->NewIterator() : NewIterator());
+
+    if (cursor.IsNull())
+        pcursor->Seek(DB_ADDRESSBALANCEINDEX);
+    else
+        pcursor->Seek(make_pair(DB_ADDRESSBALANCEINDEX, cursor));
+
+    CAddressBalanceKey start = cursor;
+    cursor.SetNull();
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressBalanceKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSBALANCEINDEX)
+            break;
+
+        // The entries are sorted by balance, only zero and negative balances follow
+        if (excludeZeroBalances && key.second.balance <= 0)
+            break;
+
+        // The cursor points to the last entry of the previous page
+        if (!start.IsNull() && key.second == start) {
+            pcursor->Next();
+            continue;
+        }
+
+        if (limit > 0 && (int)addressList.size() == limit) {
+            const CAddressListEntry &last = addressList.back();
+            cursor = CAddressBalanceKey(last.balance, last.type, last.hashBytes);
+            break;
+        }
+
+        CAmount received;
+        if (!pcursor->GetValue(received))
+            return error("failed to get address balance value");
+
+        addressList.push_back(CAddressListEntry(key.second.type, key.second.hashBytes, received, key.second.balance));
+
+        pcursor->Next();
+    }
+
+    return true;
+}
+
 bool CBlockTreeDB::ReadAddresses(std::vector<CAddressListEntry> &addressList, int nEndHeight, bool excludeZeroBalances) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
@@ -428,12 +928,6 @@ bool CBlockTreeDB::ReadAddresses(std::vector<CAddressListEntry> &addressList, in
     return true;
 }
 
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
-    CDBBatch batch(*this);
-    batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
-}
-
 bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
@@ -474,20 +968,6 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &timestamp, uint256 &bl
     return false;
 }
 
-bool CBlockTreeDB::WriteDepositIndex(const std::vector<std::pair<CDepositIndexKey, CDepositValue > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CDepositIndexKey, CDepositValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(make_pair(DB_DEPOSITINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::EraseDepositIndex(const std::vector<std::pair<CDepositIndexKey, CDepositValue > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CDepositIndexKey, CDepositValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(make_pair(DB_DEPOSITINDEX, it->first));
-    return WriteBatch(batch);
-}
-
 bool CBlockTreeDB::ReadDepositIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CDepositIndexKey, CDepositValue> > &depositIndex,
                                     int start, int offset, int limit, bool reverse) {
@@ -569,6 +1049,90 @@ bool CBlockTreeDB::ReadDepositIndexCount(uint160 addressHash, int type,
     return true;
 }
 
+bool CBlockTreeDB::WriteIndexes(const CIndexBlockEntries &entries, bool fUndo, const uint256 &hashBestBlock) {
+
+    // Everything goes into one batch together with the indexes best block so
+    // the indexes never end up with a partially applied block.
+    CDBBatch batch(*this);
+
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=entries.addressIndex.begin(); it!=entries.addressIndex.end(); it++) {
+        if (fUndo) {
+            batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
+        }
+    }
+
+    if (!UpdateAddressSummaryIndex(batch, entries.addressIndex, fUndo))
+        return false;
+
+    if (!UpdateAddressUnspentSummaryIndex(batch, entries.addressUnspentIndex))
+        return false;
+
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=entries.addressUnspentIndex.begin(); it!=entries.addressUnspentIndex.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+        }
+    }
+
+    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=entries.spentIndex.begin(); it!=entries.spentIndex.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
+        }
+    }
+
+    for (std::vector<std::pair<CDepositIndexKey, CDepositValue> >::const_iterator it=entries.depositIndex.begin(); it!=entries.depositIndex.end(); it++) {
+        if (fUndo) {
+            batch.Erase(make_pair(DB_DEPOSITINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_DEPOSITINDEX, it->first), it->second);
+        }
+    }
+
+    for (std::vector<CTimestampIndexKey>::const_iterator it=entries.timestampIndex.begin(); it!=entries.timestampIndex.end(); it++) {
+        if (fUndo) {
+            batch.Erase(make_pair(DB_TIMESTAMPINDEX, *it));
+        } else {
+            batch.Write(make_pair(DB_TIMESTAMPINDEX, *it), 0);
+        }
+    }
+
+    batch.Write(DB_INDEXES_BEST_BLOCK, hashBestBlock);
+
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadIndexesBestBlock(uint256 &hashBestBlock) {
+    return Read(DB_INDEXES_BEST_BLOCK, hashBestBlock);
+}
+
+bool CBlockTreeDB::WriteIndexesBestBlock(const uint256 &hashBestBlock) {
+    return Write(DB_INDEXES_BEST_BLOCK, hashBestBlock);
+}
+
+bool CBlockTreeDB::EraseIndexes() {
+
+    LogPrintf("Erasing address, spent, deposit and timestamp indexes...\n");
+
+    if (!EraseIndex<CAddressIndexKey>(*this, DB_ADDRESSINDEX) ||
+        !EraseIndex<CAddressUnspentKey>(*this, DB_ADDRESSUNSPENTINDEX) ||
+        !EraseIndex<CAddressIndexIteratorKey>(*this, DB_ADDRESSUNSPENTSUMMARYINDEX) ||
+        !EraseIndex<CAddressIndexIteratorKey>(*this, DB_ADDRESSSUMMARYINDEX) ||
+        !EraseIndex<CAddressBalanceKey>(*this, DB_ADDRESSBALANCEINDEX) ||
+        !EraseIndex<CAddressLockKey>(*this, DB_ADDRESSLOCKINDEX) ||
+        !EraseIndex<CTimestampIndexKey>(*this, DB_TIMESTAMPINDEX) ||
+        !EraseIndex<CSpentIndexKey>(*this, DB_SPENTINDEX) ||
+        !EraseIndex<CDepositIndexKey>(*this, DB_DEPOSITINDEX))
+        return false;
+
+    // A null best block lets the indexes get built from the genesis block
+    return WriteIndexesBestBlock(uint256());
+}
+
 bool CBlockTreeDB::WriteInstantPayLocks(std::map<CInstantPayIndexKey, CInstantPayValue> &mapLocks)
 {
     CDBBatch batch(*this);
@@ -13,6 +13,7 @@
 
 #include <map>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -41,6 +42,12 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! LevelDB tuning of the chainstate, mostly point lookups of small coin entries
+static const CDBOptions CHAINSTATE_DB_OPTIONS(10, 64, 4 * 1024, false);
+//! LevelDB tuning of the block tree DB, point lookups of the tx and spent
+//! indexes need small blocks, the range scans of the address and deposit
+//! indexes many open files
+static const CDBOptions BLOCKTREE_DB_OPTIONS(10, 96, 4 * 1024, false);
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -116,6 +123,8 @@ public:
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
+    bool UpdateAddressSummaryIndex(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fUndo);
+    bool UpdateAddressUnspentSummaryIndex(CDBBatch &batch, const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
 public:
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &fileinfo);
@@ -125,24 +134,39 @@ public:
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
-    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
-    bool ReadAddressUnspentIndexCount(uint160 addressHash, int type, int &nCount, CAddressUnspentKey &lastIndex);
+    /** Read the number and sum of the unspent outputs of an address without iterating them, and the key of its last one */
+    bool ReadAddressUnspentSummary(uint160 addressHash, int type, CAddressUnspentSummaryValue &summary, CAddressUnspentKey &lastIndex);
+    /** Read up to limit unspent outputs of an address, starting at the output start if it isn't null.
+     *  A positive offset skips that many outputs first by walking them, it is kept for the legacy
+     *  page numbers only, continue at a start key for pages in O(page) */
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
                                  std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
                                  const CAddressUnspentKey &start = CAddressUnspentKey(),
                                  int offset = -1, int limit = -1, bool reverse = false);
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    /** Read up to limit transactions of an address, starting at the transaction start if it isn't null.
+     *  pnext is set to the position of the following transaction if there are more. A positive offset
+     *  skips that many transactions first by walking them, it is kept for the legacy page numbers only,
+     *  continue at pnext for pages in O(page) */
+    bool ReadAddressTransactions(uint160 addressHash, int type,
+                                 std::vector<std::tuple<uint256, int, CAmount> > &addressTxs,
+                                 const CAddressIndexIteratorTxKey &start = CAddressIndexIteratorTxKey(),
+                                 int offset = -1, int limit = -1, bool reverse = false,
+                                 CAddressIndexIteratorTxKey *pnext = NULL);
+    bool ReadAddressSummary(uint160 addressHash, int type, CAddressSummaryValue &summary);
+    bool BuildAddressSummaryIndex();
+    bool BuildAddressBalanceIndex();
+    bool BuildAddressUnspentSummaryIndex();
+    bool BuildAddressLockIndex();
+    /** Sum the unspent outputs of an address whose lock time is still active at the given height and time */
+    bool ReadAddressLocked(uint160 addressHash, int type, int nHeight, int64_t nTime, CAmount &nLocked);
     bool ReadAddresses(std::vector<CAddressListEntry> &addressList, int nEndHeight, bool excludeZeroBalances);
-    bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
+    /** Read up to limit (all if <= 0) addresses by descending balance, starting behind cursor. cursor is set to the last one if there are more */
+    bool ReadAddressBalances(std::vector<CAddressListEntry> &addressList, CAddressBalanceKey &cursor, int limit, bool excludeZeroBalances, const CDBSnapshot *snapshot = NULL);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool ReadTimestampIndex(const unsigned int &timestamp, uint256 &blockHash);
-    bool WriteDepositIndex(const std::vector<std::pair<CDepositIndexKey, CDepositValue> > &vect);
-    bool EraseDepositIndex(const std::vector<std::pair<CDepositIndexKey, CDepositValue> > &vect);
     bool ReadDepositIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CDepositIndexKey, CDepositValue> > &depositIndex,
                           int start = 0, int offset = 0, int limit = 0, bool reverse = false);
@@ -150,6 +174,12 @@ public:
                                         int &count,
                                         int &firstTime, int &lastTime,
                                         int start, int end);
+    /** Apply the index entries of a connected (or with fUndo disconnected) block and move the indexes best block */
+    bool WriteIndexes(const CIndexBlockEntries &entries, bool fUndo, const uint256 &hashBestBlock);
+    bool ReadIndexesBestBlock(uint256 &hashBestBlock);
+    bool WriteIndexesBestBlock(const uint256 &hashBestBlock);
+    /** Remove all address, spent, deposit and timestamp index entries */
+    bool EraseIndexes();
 
     bool WriteInstantPayLocks(std::map<CInstantPayIndexKey, CInstantPayValue> &mapLocks);
     bool ReadInstantPayIndex(std::vector<std::pair<CInstantPayIndexKey, CInstantPayValue> > &instantPayIndex,
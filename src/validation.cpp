@@ -951,20 +951,6 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
                 // Save these to avoid repeated lookups
                 setIterConflicting.insert(mi);
 
-                // If this entry is "dirty", then we don't have descendant
-                // state for this transaction, which means we probably have
-                // lots of in-mempool descendants.
-                // Don't allow replacements of dirty transactions, to ensure
-                // that we don't spend too much time walking descendants.
-                // This should be rare.
-                if (mi->IsDirty()) {
-                    return state.DoS(0,
-                            error("AcceptToMemoryPool: rejecting replacement %s; cannot replace tx %s with untracked descendants",
-                                hash.ToString(),
-                                mi->GetTx().GetHash().ToString()),
-                            REJECT_NONSTANDARD, "too many potential replacements");
-                }
-
                 // Don't allow the replacement to reduce the feerate of the
                 // mempool.
                 //
@@ -1095,7 +1081,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
                     FormatMoney(nModifiedFees - nConflictingFees),
                     (int)nSize - (int)nConflictingSize);
         }
-        pool.RemoveStaged(allConflicting);
+        pool.RemoveStaged(allConflicting, false);
 
         // Store transaction in memory
         pool.addUnchecked(hash, entry, setAncestors, !IsInitialBlockDownload());
@@ -1163,6 +1149,53 @@ bool GetAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool GetAddressTransactions(uint160 addressHash, int type, std::vector<std::tuple<uint256, int, CAmount> > &addressTxs,
+                            const CAddressIndexIteratorTxKey &start, int offset, int limit, bool reverse,
+                            CAddressIndexIteratorTxKey *pnext)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressTransactions(addressHash, type, addressTxs, start, offset, limit, reverse, pnext))
+        return error("unable to get transactions for address");
+
+    return true;
+}
+
+bool GetAddressSummary(uint160 addressHash, int type, CAddressSummaryValue &summary)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    // An address without any activity has no summary, report it empty
+    if (!pblocktree->ReadAddressSummary(addressHash, type, summary))
+        summary.SetNull();
+
+    return true;
+}
+
+bool GetAddressLocked(uint160 addressHash, int type, int nHeight, int64_t nTime, CAmount &nLocked)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressLocked(addressHash, type, nHeight, nTime, nLocked))
+        return error("unable to get locked amount for address");
+
+    return true;
+}
+
+bool GetAddressBalances(std::vector<CAddressListEntry> &addressList, CAddressBalanceKey &cursor, int limit, bool excludeZeroBalances, const CDBSnapshot *snapshot)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressBalances(addressList, cursor, limit, excludeZeroBalances, snapshot))
+        return error("unable to get address balances");
+
+    return true;
+}
+
 bool GetAddresses(std::vector<CAddressListEntry> &addressList, int nEndHeight, bool excludeZeroBalances)
 {
     if (!fAddressIndex)
@@ -1174,13 +1207,13 @@ bool GetAddresses(std::vector<CAddressListEntry> &addressList, int nEndHeight, b
     return true;
 }
 
-bool GetAddressUnspentCount(uint160 addressHash, int type, int &count, CAddressUnspentKey &lastIndex)
+bool GetAddressUnspentSummary(uint160 addressHash, int type, CAddressUnspentSummaryValue &summary, CAddressUnspentKey &lastIndex)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndexCount(addressHash, type, count, lastIndex))
-        return error("unable to get unspent count for address");
+    if (!pblocktree->ReadAddressUnspentSummary(addressHash, type, summary, lastIndex))
+        return error("unable to get unspent summary for address");
 
     return true;
 }
@@ -1738,6 +1771,8 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
+} // anon namespace
+
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
     // Open history file to read
@@ -1766,7 +1801,7 @@ bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uin
 }
 
 /** Abort with a message */
-bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
+bool AbortNode(const std::string& strMessage, const std::string& userMessage)
 {
     SetMiscWarning(strMessage);
     LogPrintf("*** %s\n", strMessage);
@@ -1777,9 +1812,11 @@ bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
     return false;
 }
 
+namespace {
+
 bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
 {
-    AbortNode(strMessage, userMessage);
+    ::AbortNode(strMessage, userMessage);
     return state.Error(strMessage);
 }
 
@@ -1847,10 +1884,6 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
         return DISCONNECT_FAILED;
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-    std::vector<std::pair<CDepositIndexKey, CDepositValue> > depositIndex;
     /* WIP-VOTING uncomment
     std::map<CVoteKey, CSmartAddress> mapVoteKeys;
     std::vector<CVoteKeyRegistrationKey> vecInvalidVoteKeyRegistrations;
@@ -1864,73 +1897,6 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
         const CTransaction &tx = block.vtx[i];
         uint256 hash = tx.GetHash();
         bool is_coinbase = tx.IsCoinBase();
-        std::map<std::pair<uint160, int>, CAmount> vecInputs;
-        std::map<std::pair<uint160, int>, CAmount> vecOutputs;
-
-        if (fAddressIndex || fDepositIndex) {
-
-            uint160 hashBytes;
-            int addressType;
-
-            for (unsigned int k = tx.vout.size(); k-- > 0;) {
-                const CTxOut &out = tx.vout[k];
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-
-                    hashBytes = uint160(vector<unsigned char>(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22));
-                    addressType = 2;
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-
-                    hashBytes = uint160(vector<unsigned char>(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23));
-                    addressType = 1;
-                } else if (out.scriptPubKey.IsPayToPublicKey()) {
-
-                    vector<unsigned char> pubKeyBytes(out.scriptPubKey.begin()+1, out.scriptPubKey.begin()+34);
-                    CPubKey pubKey(pubKeyBytes);
-                    hashBytes = pubKey.GetID();
-                    addressType = 1;
-                } else if (out.scriptPubKey.IsPayToScriptHashLocked()) {
-
-                    int nOffset = out.scriptPubKey[0] + 5;
-
-                    hashBytes = uint160(vector<unsigned char>(out.scriptPubKey.begin() + nOffset, out.scriptPubKey.begin() + nOffset + 20));
-                    addressType = 2;
-                } else if (out.scriptPubKey.IsPayToPublicKeyHashLocked()) {
-
-                    int nOffset = out.scriptPubKey[0] + 6;
-
-                    hashBytes = uint160(vector<unsigned char>(out.scriptPubKey.begin() + nOffset, out.scriptPubKey.begin() + nOffset + 20));
-                    addressType = 1;
-                } else {
-                    continue;
-                }
-
-                if( fAddressIndex ){
-
-                    // undo receiving activity
-                    addressIndex.push_back(make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, hash, k, false), out.nValue));
-
-                    // undo unspent index
-                    addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, hash, k, pindex->nHeight), CAddressUnspentValue()));
-                }
-
-                if ( fDepositIndex ) {
-
-                    auto it = vecOutputs.find(std::make_pair(hashBytes,addressType));
-
-                    if( it == vecOutputs.end() ){
-                        // For the first occurrence of the address it
-                        vecOutputs.insert(std::make_pair(std::make_pair(hashBytes,addressType), out.nValue));
-                    }else{
-                        // For further ones add up the amount
-                        it->second += out.nValue;
-                    }
-
-                }
-
-            }
-
-        }
 
         // Check that all outputs are available and match the outputs in the block itself
         // exactly.
@@ -1954,85 +1920,9 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
             }
             for (unsigned int j = tx.vin.size(); j-- > 0;) {
                 const COutPoint &out = tx.vin[j].prevout;
-                int undoHeight = txundo.vprevout[j].nHeight;
                 int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
                 if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
                 fClean = fClean && res != DISCONNECT_UNCLEAN;
-
-                const CTxIn input = tx.vin[j];
-
-                if (fSpentIndex) {
-                    // undo and delete the spent index
-                    spentIndex.push_back(make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
-                }
-
-                if (fAddressIndex || fDepositIndex) {
-
-                    const Coin &coin = view.AccessCoin(tx.vin[j].prevout);
-                    const CTxOut &prevout = coin.out;
-
-                    uint160 hashBytes;
-                    int addressType = 0;
-
-                    if (prevout.scriptPubKey.IsPayToScriptHash()) {
-
-                        hashBytes = uint160(vector<unsigned char>(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
-                        addressType = 2;
-
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-
-                        hashBytes = uint160(vector<unsigned char>(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
-                        addressType = 1;
-
-                    } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-
-                        vector<unsigned char> pubKeyBytes(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.begin()+34);
-                        CPubKey pubKey(pubKeyBytes);
-                        hashBytes = pubKey.GetID();
-                        addressType = 1;
-                    } else if (prevout.scriptPubKey.IsPayToScriptHashLocked()) {
-
-                        int nOffset = prevout.scriptPubKey[0] + 5;
-
-                        hashBytes = uint160(vector<unsigned char>(prevout.scriptPubKey.begin() + nOffset, prevout.scriptPubKey.begin() + nOffset + 20));
-                        addressType = 2;
-
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHashLocked()) {
-
-                        int nOffset = prevout.scriptPubKey[0] + 6;
-
-                        hashBytes = uint160(vector<unsigned char>(prevout.scriptPubKey.begin() + nOffset, prevout.scriptPubKey.begin() + nOffset + 20));
-                        addressType = 1;
-
-                    } else {
-                        continue;
-                    }
-
-                    if ( fDepositIndex ) {
-
-                        auto it = vecInputs.find(std::make_pair(hashBytes,addressType));
-
-                        if( it == vecInputs.end() ){
-                            // For the first occurrence of the address it
-                            vecInputs.insert(std::make_pair(std::make_pair(hashBytes,addressType), prevout.nValue));
-                        }else{
-                            // For further ones add up the amount
-                            it->second += prevout.nValue;
-                        }
-
-                    }
-
-                    if( fAddressIndex ){
-
-                        // undo spending activity
-                        addressIndex.push_back(make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, hash, j, true), prevout.nValue * -1));
-
-                        // restore unspent index
-                        addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n, undoHeight), CAddressUnspentValue(prevout.nValue, prevout.scriptPubKey, undoHeight)));
-                    }
-
-                }
-
             }
 
             /* WIP-VOTING uncomment
@@ -2062,28 +1952,6 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
             }
             */
 
-            if( fDepositIndex ){
-
-                for( auto const &output : vecOutputs ){
-
-                    auto input = vecInputs.find(std::make_pair( output.first.first, output.first.second ));
-
-                    if( input == vecInputs.end() ){
-                        // If there is no input related to the address of this output just add it as deposit
-                        depositIndex.push_back(std::make_pair(CDepositIndexKey(output.first.second, output.first.first, block.nTime, tx.GetHash() ),CDepositValue(output.second,pindex->nHeight)));
-                    }else{
-
-                        // If there is an input related to the address of this output evaluate if the outputs exceed the inputs
-                        CAmount nDeposit = output.second - input->second;
-
-                        if( nDeposit > 0 ){
-                            // If the outputs exceed the inputs add the deposit.
-                            depositIndex.push_back(std::make_pair(CDepositIndexKey(output.first.second, output.first.first, block.nTime, tx.GetHash() ),CDepositValue(nDeposit,pindex->nHeight)));
-                        }
-                    }
-                }
-            }
-
             // At this point, all of txundo.vprevout should have been moved out.
         }
 
@@ -2096,25 +1964,6 @@ static DisconnectResult DisconnectBlock(const CBlock& block, CValidationState& s
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
-    if (!fIsVerifyDB && fDepositIndex) {
-
-        if( !pblocktree->EraseDepositIndex(depositIndex) ){
-            AbortNode(state, "Failed to write deposit index");
-            return DISCONNECT_FAILED;
-        }
-    }
-
-    if (!fIsVerifyDB && fAddressIndex) {
-        if (!pblocktree->EraseAddressIndex(addressIndex)) {
-            AbortNode(state, "Failed to delete address index");
-            return DISCONNECT_FAILED;
-        }
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            AbortNode(state, "Failed to write address unspent index");
-            return DISCONNECT_FAILED;
-        }
-    }
-
     if( !fIsVerifyDB && !prewards->CommitUndoBlock( (CBlockIndex*) pindex, smartRewardsResult) ){
         AbortNode(state, "Failed to commit smartrewards block undo");
         return DISCONNECT_FAILED;
@@ -2234,6 +2083,7 @@ static ThresholdConditionCache warningcache[VERSIONBITS_NUM_BITS];
 static int64_t nTimeCheck = 0;
 static int64_t nTimeForks = 0;
 static int64_t nTimeVerify = 0;
+static int64_t nTimeRewards = 0;
 static int64_t nTimeConnect = 0;
 static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
@@ -2372,10 +2222,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-    std::vector<std::pair<CDepositIndexKey, CDepositValue> > depositIndex;
     /* WIP-VOTING uncomment
     std::vector<std::pair<CVoteKeyRegistrationKey, VoteKeyParseResult>> vecInvalidVoteKeyRegistrations;
     std::map<CVoteKey, CVoteKeyValue> mapVoteKeys;
@@ -2383,17 +2229,16 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
 
     // Result of the smartrewards block processing.
     CSmartRewardsUpdateResult smartRewardsResult(pindex);
+    // Inputs and outputs of the block for the rewards, applied after the loop
+    std::vector<CSmartRewardsUpdate> vSmartRewardsUpdates;
+    int nCurrentRewardsRound = prewards->GetCurrentRound()->number;
 
     //bool fDIP0001Active_context = (VersionBitsState(pindex->pprev, chainparams.GetConsensus(), Consensus::DEPLOYMENT_DIP0001, versionbitscache) == THRESHOLD_ACTIVE);
 
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = block.vtx[i];
-        const uint256 txhash = tx.GetHash();
-        std::map<std::pair<uint160, int>, CAmount> vecInputs;
-        std::map<std::pair<uint160, int>, CAmount> vecOutputs;
 
-        int nCurrentRewardsRound = prewards->GetCurrentRound()->number;
         bool fProcessRewards = !fIsVerifyDB && prewards->ProcessTransaction(pindex, tx, nCurrentRewardsRound);
 
         nInputs += tx.vin.size();
@@ -2431,69 +2276,8 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
                 const CTxOut &prevout = coin.out;
 
                 if( fProcessRewards && !input.scriptSig.IsZerocoinSpend() ){
-                    prewards->ProcessInput(tx, prevout, coin.nHeight, nCurrentRewardsRound, smartRewardsResult);
-                }
-
-                if (fAddressIndex || fSpentIndex || fDepositIndex)
-                {
-                    uint160 hashBytes;
-                    int addressType;
-
-                    if (prevout.scriptPubKey.IsPayToScriptHash()) {
-                        hashBytes = uint160(vector <unsigned char>(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
-                        addressType = 2;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-                        hashBytes = uint160(vector <unsigned char>(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
-                        addressType = 1;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-                        vector<unsigned char> pubKeyBytes(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.begin()+34);
-                        CPubKey pubKey(pubKeyBytes);
-                        hashBytes = pubKey.GetID();
-                        addressType = 1;
-                    } else if (prevout.scriptPubKey.IsPayToScriptHashLocked()) {
-                        int nOffset = prevout.scriptPubKey[0] + 5;
-
-                        hashBytes = uint160(vector<unsigned char>(prevout.scriptPubKey.begin() + nOffset, prevout.scriptPubKey.begin() + nOffset + 20));
-                        addressType = 2;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHashLocked()) {
-                        int nOffset = prevout.scriptPubKey[0] + 6;
-
-                        hashBytes = uint160(vector<unsigned char>(prevout.scriptPubKey.begin() + nOffset, prevout.scriptPubKey.begin() + nOffset + 20));
-                        addressType = 1;
-                    } else {
-                        hashBytes.SetNull();
-                        addressType = 0;
-                    }
-
-                    if (fDepositIndex && addressType) {
-
-                        auto it = vecInputs.find(std::make_pair(hashBytes,addressType));
-
-                        if( it == vecInputs.end() ){
-                            // For the first occurrence of the address it
-                            vecInputs.insert(std::make_pair(std::make_pair(hashBytes,addressType), prevout.nValue));
-                        }else{
-                            // For further ones add up the amount
-                            it->second += prevout.nValue;
-                        }
-
-                    }
-
-                    if (fAddressIndex && addressType > 0) {
-                        // record spending activity
-                        addressIndex.push_back(make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), prevout.nValue * -1));
-
-                        // remove address from unspent index
-                        addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n, coin.nHeight), CAddressUnspentValue()));
-                    }
-
-                    if (fSpentIndex) {
-                        // add the spent index to determine the txid and input that spent an output
-                        // and to find the amount and address from an input
-                        spentIndex.push_back(make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, prevout.nValue, addressType, hashBytes)));
-                    }
+                    vSmartRewardsUpdates.push_back(CSmartRewardsUpdate(&tx, prevout, coin.nHeight, true));
                 }
-
             }
 
             if (fStrictPayToScriptHash)
@@ -2522,83 +2306,7 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
             const CTxOut &out = tx.vout[k];
 
             if( fProcessRewards && !out.scriptPubKey.IsZerocoinMint() ){
-                prewards->ProcessOutput(tx, out, nCurrentRewardsRound, pindex->nHeight, pindex->nTime, smartRewardsResult);
-            }
-
-            if (fAddressIndex || fDepositIndex) {
-
-                uint160 hashBytes;
-                int addressType;
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-                    hashBytes = uint160(vector <unsigned char>(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22));
-                    addressType = 2;
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-                    hashBytes = uint160(vector <unsigned char>(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23));
-                    addressType = 1;
-                } else if (out.scriptPubKey.IsPayToPublicKey()) {
-                    vector<unsigned char> pubKeyBytes(out.scriptPubKey.begin()+1, out.scriptPubKey.begin()+34);
-                    CPubKey pubKey(pubKeyBytes);
-                    hashBytes = pubKey.GetID();
-                    addressType = 1;
-                } else if (out.scriptPubKey.IsPayToScriptHashLocked()) {
-                    int nOffset = out.scriptPubKey[0] + 5;
-
-                    hashBytes = uint160(vector<unsigned char>(out.scriptPubKey.begin() + nOffset, out.scriptPubKey.begin() + nOffset + 20));
-                    addressType = 2;
-                } else if (out.scriptPubKey.IsPayToPublicKeyHashLocked()) {
-                    int nOffset = out.scriptPubKey[0] + 6;
-
-                    hashBytes = uint160(vector<unsigned char>(out.scriptPubKey.begin() + nOffset, out.scriptPubKey.begin() + nOffset + 20));
-                    addressType = 1;
-                } else {
-                    continue;
-                }
-
-                if ( fDepositIndex ) {
-
-                    auto it = vecOutputs.find(std::make_pair(hashBytes,addressType));
-
-                    if( it == vecOutputs.end() ){
-                        // For the first occurrence of the address it
-                        vecOutputs.insert(std::make_pair(std::make_pair(hashBytes,addressType), out.nValue));
-                    }else{
-                        // For further ones add up the amount
-                        it->second += out.nValue;
-                    }
-
-                }
-
-                if( fAddressIndex ){
-
-                    // record receiving activity
-                    addressIndex.push_back(make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
-                    // record unspent output
-                    addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(addressType, hashBytes, txhash, k, pindex->nHeight), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-                }
-
-            }
-
-            if( fDepositIndex ){
-
-                for( auto const &output : vecOutputs ){
-
-                    auto input = vecInputs.find(std::make_pair( output.first.first, output.first.second ));
-
-                    if( input == vecInputs.end() ){
-                        // If there is no input related to the address of this output just add it as deposit
-                        depositIndex.push_back(std::make_pair(CDepositIndexKey(output.first.second, output.first.first, block.nTime, tx.GetHash() ),CDepositValue(output.second,pindex->nHeight)));
-                    }else{
-
-                        // If there is an input related to the address of this output evaluate if the outputs exceed the inputs
-                        CAmount nDeposit = output.second - input->second;
-
-                        if( nDeposit > 0 ){
-                            // If the outputs exceed the inputs add the deposit.
-                            depositIndex.push_back(std::make_pair(CDepositIndexKey(output.first.second, output.first.first, block.nTime, tx.GetHash() ),CDepositValue(nDeposit,pindex->nHeight)));
-                        }
-                    }
-                }
+                vSmartRewardsUpdates.push_back(CSmartRewardsUpdate(&tx, out, pindex->nHeight, false));
             }
         }
 
@@ -2685,6 +2393,12 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint("bench", "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs]\n", nInputs - 1, 0.001 * (nTime4 - nTime2), nInputs <= 1 ? 0 : 0.001 * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * 0.000001);
 
+    // Only valid blocks update the rewards entries
+    prewards->ProcessUpdates(pindex, vSmartRewardsUpdates, nCurrentRewardsRound, smartRewardsResult);
+    int64_t nTimeRewardsEnd = GetTimeMicros(); nTimeRewards += nTimeRewardsEnd - nTime4;
+    LogPrint("bench", "    - SmartRewards %u updates: %.2fms [%.2fs]\n", (unsigned)vSmartRewardsUpdates.size(), 0.001 * (nTimeRewardsEnd - nTime4), nTimeRewards * 0.000001);
+    nTime4 = nTimeRewardsEnd;
+
     if (fJustCheck)
         return true;
 
@@ -2715,31 +2429,6 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
-    if (!fIsVerifyDB && fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(addressIndex)) {
-            return AbortNode(state, "Failed to write address index");
-        }
-
-        if (!pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
-            return AbortNode(state, "Failed to write address unspent index");
-        }
-    }
-
-    if (!fIsVerifyDB && fSpentIndex)
-        if (!pblocktree->UpdateSpentIndex(spentIndex))
-            return AbortNode(state, "Failed to write spent index");
-
-    if (!fIsVerifyDB && fTimestampIndex)
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
-
-    if (!fIsVerifyDB && fDepositIndex) {
-
-        if( !pblocktree->WriteDepositIndex(depositIndex) ){
-            return AbortNode(state, "Failed to write deposit index");
-        }
-    }
-
     /* WIP-VOTING uncomment
     if ( vecInvalidVoteKeyRegistrations.size() && !pblocktree->WriteInvalidVoteKeyRegistrations(vecInvalidVoteKeyRegistrations) )
         return AbortNode(state, "Failed to write invalid VoteKey registrations");
@@ -3435,10 +3124,10 @@ bool ReconsiderBlock(CValidationState &state, CBlockIndex *pindex) {
     return true;
 }
 
-CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
+CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const uint256* phash = NULL)
 {
     // Check for duplicate
-    uint256 hash = block.GetHash();
+    uint256 hash = phash ? *phash : block.GetHash();
     BlockMap::iterator it = mapBlockIndex.find(hash);
     if (it != mapBlockIndex.end())
         return it->second;
@@ -3603,11 +3292,11 @@ bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigne
     return true;
 }
 
-bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW)
+bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW, const uint256* phash)
 {
     // Check proof of work matches claimed amount
     int nHeight = getNHeight(block);
-    if (fCheckPOW && !CheckProofOfWork(nHeight, block.GetHash(), block.nBits, Params().GetConsensus()))
+    if (fCheckPOW && !CheckProofOfWork(nHeight, phash ? *phash : block.GetHash(), block.nBits, Params().GetConsensus()))
         return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
 
     return true;
@@ -3891,11 +3580,11 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
     return true;
 }
 
-static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex=NULL)
+static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex=NULL, const uint256* phash=NULL)
 {
     AssertLockHeld(cs_main);
-    // Check for duplicate
-    uint256 hash = block.GetHash();
+    // Check for duplicate, the hash is passed on to the checks below instead of hashing the header again
+    uint256 hash = phash ? *phash : block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = NULL;
 
@@ -3912,7 +3601,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return true;
         }
 
-        if (!CheckBlockHeader(block, state))
+        if (!CheckBlockHeader(block, state, true, &hash))
             return false;
 
         // Get prev block index
@@ -3932,7 +3621,7 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
             return false;
     }
     if (pindex == NULL)
-        pindex = AddToBlockIndex(block);
+        pindex = AddToBlockIndex(block, &hash);
 
     if (ppindex)
         *ppindex = pindex;
@@ -3945,12 +3634,13 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
     return true;
 }
 
-bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, const std::vector<uint256>* pvHashes)
 {
+    assert(!pvHashes || pvHashes->size() == headers.size());
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
-            if (!AcceptBlockHeader(header, state, chainparams, ppindex)) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            if (!AcceptBlockHeader(headers[i], state, chainparams, ppindex, pvHashes ? &(*pvHashes)[i] : NULL)) {
                 return false;
             }
         }
@@ -4371,6 +4061,43 @@ bool static LoadBlockIndexDB()
     fReindex |= !fCheckIndex;
     LogPrintf("%s: addressindex index %s\n", __func__, fCheckIndex ? "enabled" : "disabled");
 
+    // Per address summaries are built once from the full address index
+    bool fSummaries = false;
+    pblocktree->ReadFlag("addresssummaryindex", fSummaries);
+    if (!fReindex && fCheckIndex && !fSummaries) {
+        if (!pblocktree->BuildAddressSummaryIndex())
+            return error("%s: failed to build address summary index", __func__);
+        pblocktree->WriteFlag("addresssummaryindex", true);
+    }
+
+    // The balance sorted address list is built once from the address summaries,
+    // again for lists written before negative balances got sorted behind the zero ones
+    bool fBalances = false;
+    pblocktree->ReadFlag("addressbalanceindexsigned", fBalances);
+    if (!fReindex && fCheckIndex && !fBalances) {
+        if (!pblocktree->BuildAddressBalanceIndex())
+            return error("%s: failed to build address balance index", __func__);
+        pblocktree->WriteFlag("addressbalanceindexsigned", true);
+    }
+
+    // Unspent output counters are built once from the address unspent index
+    bool fUnspentSummaries = false;
+    pblocktree->ReadFlag("addressunspentsummaryindex", fUnspentSummaries);
+    if (!fReindex && fCheckIndex && !fUnspentSummaries) {
+        if (!pblocktree->BuildAddressUnspentSummaryIndex())
+            return error("%s: failed to build address unspent summary index", __func__);
+        pblocktree->WriteFlag("addressunspentsummaryindex", true);
+    }
+
+    // The locks of unspent outputs are built once from the address unspent index
+    bool fLocks = false;
+    pblocktree->ReadFlag("addresslockindex", fLocks);
+    if (!fReindex && fCheckIndex && !fLocks) {
+        if (!pblocktree->BuildAddressLockIndex())
+            return error("%s: failed to build address lock index", __func__);
+        pblocktree->WriteFlag("addresslockindex", true);
+    }
+
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     if (it == mapBlockIndex.end())
@@ -4528,6 +4255,10 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -addressindex in the new database
     //fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
     pblocktree->WriteFlag("addressindex", fAddressIndex);
+    pblocktree->WriteFlag("addresssummaryindex", fAddressIndex);
+    pblocktree->WriteFlag("addressbalanceindexsigned", fAddressIndex);
+    pblocktree->WriteFlag("addressunspentsummaryindex", fAddressIndex);
+    pblocktree->WriteFlag("addresslockindex", fAddressIndex);
 
     // Use the provided setting for -timestampindex in the new database
     fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
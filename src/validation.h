@@ -27,6 +27,7 @@
 #include <set>
 #include <stdint.h>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -35,9 +36,11 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CBloomFilter;
 class CChainParams;
 class CCoinsViewDB;
+class CDBSnapshot;
 class CInv;
 class CConnman;
 class CScriptCheck;
@@ -192,6 +195,10 @@ extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
 extern bool fInstantPayIndex;
+extern bool fAddressIndex;
+extern bool fTimestampIndex;
+extern bool fSpentIndex;
+extern bool fDepositIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
@@ -275,8 +282,9 @@ bool IsSuperMajority(int minVersion, const CBlockIndex* pstart, unsigned nRequir
  * @param[out] state This may be set to an Error state if any error occurred processing them
  * @param[in]  chainparams The params for the chain we want to connect to
  * @param[out] ppindex If set, the pointer will be set to point to the last new block index object for the given headers
+ * @param[in]  pvHashes If set, the hashes of the headers, see ComputeBlockHeaderHashes
  */
-bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex=NULL);
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex=NULL, const std::vector<uint256>* pvHashes=NULL);
 /** Check whether enough disk space is available for an incoming block */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0);
 /** Open a block file (blk?????.dat) */
@@ -512,8 +520,15 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                      int start = 0, int end = 0);
+bool GetAddressTransactions(uint160 addressHash, int type, std::vector<std::tuple<uint256, int, CAmount> > &addressTxs,
+                            const CAddressIndexIteratorTxKey &start = CAddressIndexIteratorTxKey(),
+                            int offset = -1, int limit = -1, bool reverse = false,
+                            CAddressIndexIteratorTxKey *pnext = NULL);
+bool GetAddressSummary(uint160 addressHash, int type, CAddressSummaryValue &summary);
+bool GetAddressLocked(uint160 addressHash, int type, int nHeight, int64_t nTime, CAmount &nLocked);
 bool GetAddresses(std::vector<CAddressListEntry> &addressList,int nEndHeight = -1, bool excludeZeroBalances = false);
-bool GetAddressUnspentCount(uint160 addressHash, int type, int &count, CAddressUnspentKey &lastIndex);
+bool GetAddressBalances(std::vector<CAddressListEntry> &addressList, CAddressBalanceKey &cursor, int limit, bool excludeZeroBalances, const CDBSnapshot *snapshot = NULL);
+bool GetAddressUnspentSummary(uint160 addressHash, int type, CAddressUnspentSummaryValue &summary, CAddressUnspentKey &lastIndex);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
                        const CAddressUnspentKey &start = CAddressUnspentKey(),
@@ -536,11 +551,15 @@ bool GetInvalidVoteKeyRegistration(const uint256 &txHash);
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
+
+/** Abort with a message, shows it to the user and shuts the node down */
+bool AbortNode(const std::string& strMessage, const std::string& userMessage = "");
 
 /** Functions for validating blocks and updating the block tree */
 
 /** Context-independent validity checks */
-bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW = true);
+bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW = true, const uint256* phash = NULL);
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool isVerifyDB = false);
 
 /** Context-dependent validity checks */
@@ -6,9 +6,15 @@
 #ifndef BITCOIN_VALIDATIONINTERFACE_H
 #define BITCOIN_VALIDATIONINTERFACE_H
 
+#include "amount.h"
+
 #include <boost/signals2/signal.hpp>
 #include <boost/shared_ptr.hpp>
 
+#include <utility>
+#include <vector>
+
+struct CAddressIndexKey;
 class CBlock;
 struct CBlockLocator;
 class CBlockIndex;
@@ -42,6 +48,7 @@ protected:
     virtual void BlockChecked(const CBlock&, const CValidationState&) {}
     virtual void GetScriptForMining(boost::shared_ptr<CReserveScript>&) {}
     virtual void ResetRequestCount(const uint256 &hash) {}
+    virtual void AddressIndexUpdated(const CBlockIndex *pindex, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vecDeltas, bool fConnected) {}
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
@@ -72,6 +79,8 @@ struct CMainSignals {
     boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
     /** Notifies listeners that a block has been successfully mined */
     boost::signals2::signal<void (const uint256 &)> BlockFound;
+    /** Notifies listeners of the address index entries written (or erased if not fConnected) for a block */
+    boost::signals2::signal<void (const CBlockIndex *, const std::vector<std::pair<CAddressIndexKey, CAmount> > &, bool fConnected)> AddressIndexUpdated;
 };
 
 CMainSignals& GetMainSignals();
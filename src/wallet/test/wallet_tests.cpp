@@ -4,6 +4,13 @@
 
 #include "wallet/wallet.h"
 
+#include "consensus/consensus.h"
+#include "indexbuilder.h"
+#include "script/interpreter.h"
+#include "script/standard.h"
+#include "validation.h"
+#include "wallet/db.h"
+
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -13,6 +20,7 @@
 
 #include <boost/foreach.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 // how many times to run all the tests to have a chance to catch errors that only show up with particular random shuffles
 #define RUN_TESTS 100
@@ -48,7 +56,7 @@ static void add_coin(const CAmount& nValue, int nAge = 6*24, bool fIsFromMe = fa
         wtx->fDebitCached = true;
         wtx->nDebitCached = 1;
     }
-    COutput output(wtx, nInput, nAge, true, true);
+    COutput output(wtx, nInput, nAge, true, true, wtx->vout[nInput].GetLockTime());
     vCoins.push_back(output);
 }
 
@@ -351,4 +359,175 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     BOOST_CHECK_EQUAL(setCoinsRet.size(), 2U);
 }
 
+/** A wallet that exposes its unspent output set */
+class CWalletUTXOTest : public CWallet
+{
+public:
+    CWalletUTXOTest(const std::string& strWalletFileIn) : CWallet(strWalletFileIn) {}
+
+    using CWallet::MarkConflicted;
+
+    bool IsWalletUTXO(const COutPoint& outpoint) const
+    {
+        return setWalletUTXO.count(outpoint) != 0;
+    }
+
+    // Every unspent output of the wallet has to be in setWalletUTXO
+    bool HasAllUnspent() const
+    {
+        BOOST_FOREACH(const PAIRTYPE(uint256, CWalletTx)& item, mapWallet) {
+            for (unsigned int i = 0; i < item.second.vout.size(); i++) {
+                if (IsMine(item.second.vout[i]) != ISMINE_NO && !IsSpent(item.first, i) && !IsWalletUTXO(COutPoint(item.first, i)))
+                    return false;
+            }
+        }
+        return true;
+    }
+};
+
+/** A regtest chain with spendable coinbases and a mock wallet database */
+struct WalletChain100Setup : public TestChain100Setup {
+    WalletChain100Setup()
+    {
+        bitdb.MakeMock();
+    }
+
+    ~WalletChain100Setup()
+    {
+        bitdb.Flush(true);
+        bitdb.Reset();
+    }
+
+    CWalletUTXOTest* CreateWallet(const std::string& strWalletFile)
+    {
+        bool fFirstRun;
+        CWalletUTXOTest* pwallet = new CWalletUTXOTest(strWalletFile);
+        pwallet->LoadWallet(fFirstRun);
+        LOCK(pwallet->cs_wallet);
+        pwallet->AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        return pwallet;
+    }
+
+    // Spend the first output of a coinbase transaction to scriptPubKey
+    CMutableTransaction CreateSpend(const CTransaction& txPrev, const CScript& scriptPubKey)
+    {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(txPrev.GetHash(), 0);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = txPrev.vout[0].nValue - 10000;
+        tx.vout[0].scriptPubKey = scriptPubKey;
+
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(txPrev.vout[0].scriptPubKey, tx, 0, SIGHASH_ALL);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig << vchSig;
+        return tx;
+    }
+};
+
+// Check setWalletUTXO against the wallet after every kind of change that
+// updates it: adding, abandoning, conflicting and erasing a spend.
+BOOST_FIXTURE_TEST_CASE(wallet_utxo_set, WalletChain100Setup)
+{
+    CWalletUTXOTest* pwallet = CreateWallet("wallet_utxo_test.dat");
+    BOOST_CHECK_EQUAL(pwallet->ScanForWalletTransactions(chainActive.Genesis()), COINBASE_MATURITY);
+
+    {
+        LOCK2(cs_main, pwallet->cs_wallet);
+        CWalletDB walletdb(pwallet->strWalletFile);
+        BOOST_CHECK(pwallet->HasAllUnspent());
+
+        CKey key;
+        key.MakeNewKey(true);
+        BOOST_CHECK(pwallet->AddKeyPubKey(key, key.GetPubKey()));
+        CScript scriptMine = GetScriptForDestination(key.GetPubKey().GetID());
+
+        std::vector<uint256> vSpends;
+        for (int i = 0; i < 3; i++) {
+            CWalletTx wtx(pwallet, CreateSpend(coinbaseTxns[i], scriptMine));
+            BOOST_CHECK(pwallet->AddToWallet(wtx, false, &walletdb));
+            vSpends.push_back(wtx.GetHash());
+
+            BOOST_CHECK(!pwallet->IsWalletUTXO(COutPoint(coinbaseTxns[i].GetHash(), 0)));
+            BOOST_CHECK(pwallet->IsWalletUTXO(COutPoint(wtx.GetHash(), 0)));
+            BOOST_CHECK(pwallet->HasAllUnspent());
+        }
+
+        // The spent coinbase output is unspent again once its spend is abandoned
+        BOOST_CHECK(pwallet->AbandonTransaction(vSpends[0]));
+        BOOST_CHECK(pwallet->IsWalletUTXO(COutPoint(coinbaseTxns[0].GetHash(), 0)));
+        BOOST_CHECK(pwallet->HasAllUnspent());
+
+        // Or conflicted by a block
+        pwallet->MarkConflicted(chainActive.Tip()->GetBlockHash(), vSpends[1]);
+        BOOST_CHECK(pwallet->mapWallet[vSpends[1]].GetDepthInMainChain() < 0);
+        BOOST_CHECK(pwallet->IsWalletUTXO(COutPoint(coinbaseTxns[1].GetHash(), 0)));
+        BOOST_CHECK(pwallet->HasAllUnspent());
+
+        // Or erased from the wallet, which also drops the outputs of the spend
+        BOOST_CHECK(pwallet->EraseFromWallet(vSpends[2]));
+        BOOST_CHECK(pwallet->IsWalletUTXO(COutPoint(coinbaseTxns[2].GetHash(), 0)));
+        BOOST_CHECK(!pwallet->IsWalletUTXO(COutPoint(vSpends[2], 0)));
+        BOOST_CHECK(pwallet->HasAllUnspent());
+    }
+
+    delete pwallet;
+}
+
+// A rescan that reads the blocks found in the address index has to find the
+// same transactions as a rescan of every block.
+BOOST_FIXTURE_TEST_CASE(rescan_address_index, WalletChain100Setup)
+{
+    CKey keyOther;
+    keyOther.MakeNewKey(true);
+    CScript scriptOther = GetScriptForDestination(keyOther.GetPubKey().GetID());
+
+    // Blocks that don't pay the wallet, one of them with a spend from it
+    std::vector<CMutableTransaction> noTxns;
+    for (int i = 0; i < 5; i++)
+        CreateAndProcessBlock(noTxns, scriptOther);
+    CMutableTransaction txSpend = CreateSpend(coinbaseTxns[0], scriptOther);
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(1, txSpend), scriptOther);
+    CreateAndProcessBlock(noTxns, scriptOther);
+
+    // Build the address index up to the tip
+    fAddressIndex = true;
+    CIndexBuilder indexbuilder;
+    pindexbuilder = &indexbuilder;
+    BOOST_CHECK(indexbuilder.Init(true));
+    boost::thread threadIndex(boost::bind(&CIndexBuilder::ThreadIndexBuilder, &indexbuilder));
+    for (int i = 0; i < 1000 && indexbuilder.GetBestHeight() < chainActive.Height(); i++)
+        MilliSleep(10);
+    threadIndex.interrupt();
+    threadIndex.join();
+    BOOST_CHECK_EQUAL(indexbuilder.GetBestHeight(), chainActive.Height());
+
+    std::set<uint256> setFound[2];
+    int nBlocksRead[2];
+    for (int i = 0; i < 2; i++) {
+        mapArgs["-rescanaddressindex"] = i ? "1" : "0";
+        CWalletUTXOTest* pwallet = CreateWallet(i ? "wallet_rescan_index.dat" : "wallet_rescan_full.dat");
+        BOOST_CHECK_EQUAL(pwallet->ScanForWalletTransactions(chainActive.Genesis(), false, &nBlocksRead[i]), COINBASE_MATURITY + 1);
+        {
+            LOCK(pwallet->cs_wallet);
+            BOOST_FOREACH(const PAIRTYPE(uint256, CWalletTx)& item, pwallet->mapWallet)
+                setFound[i].insert(item.first);
+        }
+        delete pwallet;
+    }
+    BOOST_CHECK(setFound[0].count(txSpend.GetHash()));
+    BOOST_CHECK(setFound[0] == setFound[1]);
+
+    // The index run only read the blocks with the coinbases and the spend,
+    // a fallback to the full scan would have read the ones in between too.
+    BOOST_CHECK_EQUAL(nBlocksRead[1], COINBASE_MATURITY + 1);
+    BOOST_CHECK(nBlocksRead[0] > nBlocksRead[1]);
+
+    mapArgs.erase("-rescanaddressindex");
+    pindexbuilder = NULL;
+    fAddressIndex = false;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,10 +7,12 @@
 
 #include "base58.h"
 #include "checkpoints.h"
+#include "checkqueue.h"
 #include "chain.h"
 #include "coincontrol.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "indexbuilder.h"
 #include "key.h"
 #include "keystore.h"
 #include "validation.h"
@@ -415,6 +417,8 @@ bool CWallet::AddVotingKeyPubKey(const CKey &secret, const CPubKey &pubkey) {
     if (!CCryptoKeyStore::AddVotingKeyPubKey(secret, pubkey))
         return false;
 
+    NotifyVotingKeyAdded(pubkey.GetID());
+
     if (!fFileBacked)
         return true;
     if (!IsVotingCrypted()) {
@@ -1022,6 +1026,49 @@ void CWallet::AddToSpends(const uint256 &wtxid) {
     AddToSpends(txin.prevout, wtxid);
 }
 
+void CWallet::UpdateWalletUTXO(const CWalletTx &wtx) {
+    AssertLockHeld(cs_main); // IsSpent
+    AssertLockHeld(cs_wallet);
+
+    // The outputs it spends are unspent again once it got abandoned or conflicted
+    if (!wtx.IsCoinBase() && !wtx.IsZerocoinSpend()) {
+        BOOST_FOREACH(const CTxIn &txin, wtx.vin) {
+            map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(txin.prevout.hash);
+            if (mi == mapWallet.end() || txin.prevout.n >= mi->second.vout.size())
+                continue;
+            if (IsSpent(txin.prevout.hash, txin.prevout.n))
+                setWalletUTXO.erase(txin.prevout);
+            else if (IsMine(mi->second.vout[txin.prevout.n]) != ISMINE_NO)
+                setWalletUTXO.insert(txin.prevout);
+        }
+    }
+
+    const uint256 hash = wtx.GetHash();
+    bool fInWallet = mapWallet.count(hash) != 0;
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        if (fInWallet && IsMine(wtx.vout[i]) != ISMINE_NO && !IsSpent(hash, i))
+            setWalletUTXO.insert(COutPoint(hash, i));
+        else
+            setWalletUTXO.erase(COutPoint(hash, i));
+    }
+}
+
+void CWallet::GetWalletUTXOTransactions(std::vector<const CWalletTx*> &vWtx) const {
+    AssertLockHeld(cs_wallet);
+
+    vWtx.clear();
+    const uint256 *phashLast = NULL;
+    BOOST_FOREACH(const COutPoint &outpoint, setWalletUTXO) {
+        // The outputs of a transaction are next to each other in the set
+        if (phashLast && *phashLast == outpoint.hash)
+            continue;
+        phashLast = &outpoint.hash;
+        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(outpoint.hash);
+        if (mi != mapWallet.end())
+            vWtx.push_back(&mi->second);
+    }
+}
+
 
 int64_t CWallet::IncOrderPosNext(CWalletDB *pwalletdb) {
     AssertLockHeld(cs_wallet); // nOrderPosNext
@@ -1220,6 +1267,8 @@ bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFromLoadWallet, CWalletD
         // Break debit/credit balance caches:
         wtx.MarkDirty();
 
+        UpdateWalletUTXO(wtx);
+
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
 
@@ -1301,6 +1350,7 @@ bool CWallet::AbandonTransaction(const uint256 &hashTx) {
             wtx.setAbandoned();
             wtx.MarkDirty();
             wtx.WriteToDisk(&walletdb);
+            UpdateWalletUTXO(wtx);
             NotifyTransactionChanged(this, wtx.GetHash(), CT_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them abandoned too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(hashTx, 0));
@@ -1363,6 +1413,7 @@ void CWallet::MarkConflicted(const uint256 &hashBlock, const uint256 &hashTx) {
             wtx.hashBlock = hashBlock;
             wtx.MarkDirty();
             wtx.WriteToDisk(&walletdb);
+            UpdateWalletUTXO(wtx);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them conflicted too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(now, 0));
             while (iter != mapTxSpends.end() && iter->first.hash == now) {
@@ -1739,17 +1790,132 @@ bool CWalletTx::WriteToDisk(CWalletDB *pwalletdb)
     return pwalletdb->WriteTx(GetHash(), *this);
 }
 
+static CCheckQueue<CWalletScanCheck> walletscancheckqueue(1);
+// Only one batch of blocks gets read at a time
+static CCriticalSection cs_walletscancheckqueue;
+
+bool CWalletScanCheck::operator()()
+{
+    CWalletScanBlock& scanBlock = *pScanBlock;
+    const CBlock& block = scanBlock.block;
+
+    scanBlock.fRead = ReadBlockFromDisk(scanBlock.block, scanBlock.pos, Params().GetConsensus()) &&
+                      block.GetHash() == scanBlock.hash;
+    if (!scanBlock.fRead)
+        return true;
+
+    scanBlock.vMaybeMine.assign(block.vtx.size(), false);
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        BOOST_FOREACH(const CTxOut& txout, block.vtx[i].vout) {
+            if (txout.scriptPubKey.IsUnspendable())
+                continue;
+            uint160 hashBytes;
+            int type;
+            if (!GetScriptAddress(txout.scriptPubKey, hashBytes, type) || psetKeys->count(std::make_pair(type, hashBytes))) {
+                scanBlock.vMaybeMine[i] = true;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void ThreadWalletScanCheck()
+{
+    RenameThread("smartcash-walletscan");
+    walletscancheckqueue.Thread();
+}
+
+bool CWallet::GetAddressIndexKeys(WalletIndexKeySet& setKeys) const
+{
+    AssertLockHeld(cs_wallet);
+    bool fComplete = true;
+
+    std::set<CKeyID> setKeyIds;
+    GetKeys(setKeyIds);
+    BOOST_FOREACH(const PAIRTYPE(CKeyID, CHDPubKey)& item, mapHdPubKeys)
+        setKeyIds.insert(item.first);
+
+    BOOST_FOREACH(const CKeyID& keyid, setKeyIds) {
+        CPubKey pubkey;
+        if (GetPubKey(keyid, pubkey) && !pubkey.IsCompressed())
+            fComplete = false;
+        setKeys.insert(std::make_pair(1, uint160(keyid)));
+    }
+
+    BOOST_FOREACH(const CScriptID& scriptid, GetCScripts())
+        setKeys.insert(std::make_pair(2, uint160(scriptid)));
+
+    {
+        LOCK(cs_KeyStore);
+        BOOST_FOREACH(const CScript& script, setWatchOnly) {
+            uint160 hashBytes;
+            int type;
+            if (GetScriptAddress(script, hashBytes, type))
+                setKeys.insert(std::make_pair(type, hashBytes));
+            else
+                fComplete = false;
+        }
+    }
+
+    return fComplete;
+}
+
+int CWallet::ScanBlocks(std::vector<CWalletScanBlock>& vScanBlocks, const WalletIndexKeySet& setKeys, bool fUpdate)
+{
+    int ret = 0;
+
+    // Reading and deserializing the blocks is most of the work of a rescan,
+    // the checks only need the block positions and a copy of the wallet keys.
+    if (!nScriptCheckThreads || vScanBlocks.size() == 1) {
+        BOOST_FOREACH(CWalletScanBlock& scanBlock, vScanBlocks)
+            CWalletScanCheck(&scanBlock, &setKeys)();
+    } else {
+        LOCK(cs_walletscancheckqueue);
+        CCheckQueueControl<CWalletScanCheck> control(&walletscancheckqueue);
+        std::vector<CWalletScanCheck> vChecks;
+        BOOST_FOREACH(CWalletScanBlock& scanBlock, vScanBlocks)
+            vChecks.push_back(CWalletScanCheck(&scanBlock, &setKeys));
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    LOCK2(cs_main, cs_wallet);
+
+    BOOST_FOREACH(CWalletScanBlock& scanBlock, vScanBlocks) {
+        if (!scanBlock.fRead) {
+            LogPrintf("%s: failed to read block %s\n", __func__, scanBlock.hash.ToString());
+            continue;
+        }
+        for (size_t i = 0; i < scanBlock.block.vtx.size(); i++) {
+            const CTransaction& tx = scanBlock.block.vtx[i];
+            // Spending from the wallet is only found through the wallet's transactions
+            if (!scanBlock.vMaybeMine[i] && !mapWallet.count(tx.GetHash()) && !IsFromMe(tx))
+                continue;
+            if (AddToWalletIfInvolvingMe(tx, &scanBlock.block, fUpdate))
+                ret++;
+        }
+    }
+
+    return ret;
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
  */
-int CWallet::ScanForWalletTransactions(CBlockIndex *pindexStart, bool fUpdate) {
+int CWallet::ScanForWalletTransactions(CBlockIndex *pindexStart, bool fUpdate, int *pnBlocksRead) {
     int ret = 0;
+    int nBlocksRead = 0;
     int64_t nNow = GetTime();
     const CChainParams &chainParams = Params();
 
     CBlockIndex *pindex = pindexStart;
+    WalletIndexKeySet setKeys;
+    bool fIndexComplete;
+    double dProgressStart;
+    double dProgressTip;
     {
         LOCK2(cs_main, cs_wallet);
 
@@ -1758,35 +1924,103 @@ int CWallet::ScanForWalletTransactions(CBlockIndex *pindexStart, bool fUpdate) {
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)))
             pindex = chainActive.Next(pindex);
 
-        ShowProgress(_("Rescanning..."),
-                     0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
-        double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(),
-                                                                     false);
-        while (pindex) {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99,
-                                                                      (int) ((Checkpoints::GuessVerificationProgress(
-                                                                              chainParams.Checkpoints(), pindex,
-                                                                              false) - dProgressStart) /
-                                                                             (dProgressTip - dProgressStart) * 100))));
-
-            CBlock block;
-            ReadBlockFromDisk(block, pindex, Params().GetConsensus());
-            BOOST_FOREACH(CTransaction & tx, block.vtx)
-            {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-                    ret++;
+        fIndexComplete = GetAddressIndexKeys(setKeys);
+
+        dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
+        dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
+    }
+
+    ShowProgress(_("Rescanning..."),
+                 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
+
+    // Update the progress after a batch up to pindexLast, with cs_main held
+    auto showProgress = [&](CBlockIndex* pindexLast) {
+        double dProgress = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindexLast, false);
+        if (dProgressTip - dProgressStart > 0.0)
+            ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int) ((dProgress - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+        if (GetTime() >= nNow + 60) {
+            nNow = GetTime();
+            LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindexLast->nHeight,
+                      Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindexLast));
+        }
+    };
+
+    // The address index knows the blocks with transactions of the wallet's
+    // keys up to its best block, only those need to be read.
+    if (pindex && fIndexComplete && fAddressIndex && pindexbuilder && GetBoolArg("-rescanaddressindex", DEFAULT_RESCAN_ADDRESSINDEX)) {
+        int nIndexHeight = -1;
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexIndexed = pindexbuilder->GetBestBlock();
+            // Blocks of a reorg the index builder didn't follow yet are read in full
+            if (pindexIndexed && chainActive.Contains(pindex))
+                nIndexHeight = chainActive.FindFork(pindexIndexed)->nHeight;
+        }
+
+        std::set<int> setHeights;
+        bool fIndexRead = nIndexHeight >= pindex->nHeight;
+        for (WalletIndexKeySet::const_iterator it = setKeys.begin(); fIndexRead && it != setKeys.end(); ++it) {
+            std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+            if (!GetAddressIndex(it->second, it->first, addressIndex, pindex->nHeight, nIndexHeight)) {
+                fIndexRead = false;
+                break;
             }
-            pindex = chainActive.Next(pindex);
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight,
-                          Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+            for (size_t i = 0; i < addressIndex.size(); i++) {
+                int nHeight = addressIndex[i].first.blockHeight;
+                if (nHeight >= pindex->nHeight && nHeight <= nIndexHeight)
+                    setHeights.insert(nHeight);
             }
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+
+        if (fIndexRead) {
+            LogPrintf("Rescanning %u blocks found in the address index up to block %d\n", setHeights.size(), nIndexHeight);
+
+            std::set<int>::const_iterator it = setHeights.begin();
+            while (it != setHeights.end()) {
+                std::vector<CWalletScanBlock> vScanBlocks;
+                {
+                    LOCK(cs_main);
+                    for (; it != setHeights.end() && vScanBlocks.size() < WALLET_SCAN_BATCH_SIZE; ++it) {
+                        if (chainActive[*it])
+                            vScanBlocks.push_back(CWalletScanBlock(chainActive[*it]));
+                    }
+                }
+                ret += ScanBlocks(vScanBlocks, setKeys, fUpdate);
+                nBlocksRead += vScanBlocks.size();
+                if (!vScanBlocks.empty()) {
+                    LOCK(cs_main);
+                    showProgress(vScanBlocks.back().pindex);
+                }
+            }
+
+            // Continue with the blocks the index doesn't have yet
+            LOCK(cs_main);
+            pindex = chainActive[nIndexHeight] ? chainActive.Next(chainActive[nIndexHeight]) : NULL;
+        }
+    }
+
+    while (pindex) {
+        std::vector<CWalletScanBlock> vScanBlocks;
+        {
+            LOCK(cs_main);
+            // The chain can have been reorganized while cs_main was released,
+            // the wallet got the transactions of the new blocks connected since.
+            if (!chainActive.Contains(pindex))
+                pindex = chainActive.Next(chainActive.FindFork(pindex));
+            for (; pindex && vScanBlocks.size() < WALLET_SCAN_BATCH_SIZE; pindex = chainActive.Next(pindex))
+                vScanBlocks.push_back(CWalletScanBlock(pindex));
+        }
+        ret += ScanBlocks(vScanBlocks, setKeys, fUpdate);
+        nBlocksRead += vScanBlocks.size();
+        if (!vScanBlocks.empty()) {
+            LOCK(cs_main);
+            showProgress(vScanBlocks.back().pindex);
+        }
     }
+
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+    if (pnBlocksRead)
+        *pnBlocksRead = nBlocksRead;
     return ret;
 }
 
@@ -2114,8 +2348,9 @@ CAmount CWallet::GetBalance(bool countLocked) const {
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vWtx;
+        GetWalletUTXOTransactions(vWtx);
+        BOOST_FOREACH(const CWalletTx *pcoin, vWtx) {
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAvailableCredit(true, countLocked);
         }
@@ -2251,8 +2486,9 @@ CAmount CWallet::GetUnconfirmedBalance() const {
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vWtx;
+        GetWalletUTXOTransactions(vWtx);
+        BOOST_FOREACH(const CWalletTx *pcoin, vWtx) {
             if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
                 nTotal += pcoin->GetAvailableCredit();
         }
@@ -2264,8 +2500,9 @@ CAmount CWallet::GetImmatureBalance() const {
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vWtx;
+        GetWalletUTXOTransactions(vWtx);
+        BOOST_FOREACH(const CWalletTx *pcoin, vWtx) {
             nTotal += pcoin->GetImmatureCredit();
         }
     }
@@ -2276,8 +2513,9 @@ CAmount CWallet::GetWatchOnlyBalance() const {
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vWtx;
+        GetWalletUTXOTransactions(vWtx);
+        BOOST_FOREACH(const CWalletTx *pcoin, vWtx) {
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAvailableWatchOnlyCredit();
         }
@@ -2290,8 +2528,9 @@ CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const {
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vWtx;
+        GetWalletUTXOTransactions(vWtx);
+        BOOST_FOREACH(const CWalletTx *pcoin, vWtx) {
             if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
                 nTotal += pcoin->GetAvailableWatchOnlyCredit();
         }
@@ -2343,8 +2582,9 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const {
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vWtx;
+        GetWalletUTXOTransactions(vWtx);
+        BOOST_FOREACH(const CWalletTx *pcoin, vWtx) {
             nTotal += pcoin->GetImmatureWatchOnlyCredit();
         }
     }
@@ -2357,57 +2597,72 @@ void CWallet::AvailableCoins(vector <COutput> &vCoins, bool fOnlyConfirmed, cons
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256 &wtxid = it->first;
-            const CWalletTx *pcoin = &(*it).second;
+        uint256 hashLast;
+        const CWalletTx *pcoin = NULL;
+        int nDepth = 0;
+        BOOST_FOREACH(const COutPoint &outpoint, setWalletUTXO) {
+            const uint256 &wtxid = outpoint.hash;
+            const unsigned int i = outpoint.n;
+
+            // The checks of a transaction are done once for all its outputs
+            if (wtxid != hashLast) {
+                hashLast = wtxid;
+                pcoin = NULL;
+
+                map<uint256, CWalletTx>::const_iterator it = mapWallet.find(wtxid);
+                if (it == mapWallet.end())
+                    continue;
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+                if (!CheckFinalTx(it->second))
+                    continue;
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+                if (fOnlyConfirmed && !it->second.IsTrusted())
+                    continue;
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+                if (it->second.IsCoinBase() && it->second.GetBlocksToMaturity() > 0)
+                    continue;
 
-            int nDepth = pcoin->GetDepthInMainChain(false);
-            // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
-            if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
-                continue;
+                nDepth = it->second.GetDepthInMainChain(false);
+                // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
+                if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
+                    continue;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
-                continue;
+                // We should not consider coins which aren't at least in our mempool
+                // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                if (nDepth == 0 && !it->second.InMempool())
+                    continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                bool found = false;
-                if(nCoinType == ONLY_DENOMINATED) {
-                    //found = CPrivateSend::IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if(nCoinType == ONLY_NONDENOMINATED) {
-                    //if (CPrivateSend::IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
-                    //found = !CPrivateSend::IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if(nCoinType == ONLY_10000) {
-                    found = pcoin->vout[i].nValue == 100000*COIN;
-                } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
-                    //found = CPrivateSend::IsCollateralAmount(pcoin->vout[i].nValue);
-                } else {
-                    found = true;
-                }
-                if(!found) continue;
-
-                isminetype mine = IsMine(pcoin->vout[i]);
-                if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_10000) &&
-                    (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(COutPoint((*it).first, i)))){
-
-                        vCoins.push_back(COutput(pcoin, i, nDepth,
-                                                 ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
-                                                  (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
-                                                 (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO, pcoin->vout[i].GetLockTime()));
-                }
+                pcoin = &it->second;
+            }
 
+            if (pcoin == NULL)
+                continue;
+
+            bool found = false;
+            if(nCoinType == ONLY_DENOMINATED) {
+                //found = CPrivateSend::IsDenominatedAmount(pcoin->vout[i].nValue);
+            } else if(nCoinType == ONLY_NONDENOMINATED) {
+                //if (CPrivateSend::IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
+                //found = !CPrivateSend::IsDenominatedAmount(pcoin->vout[i].nValue);
+            } else if(nCoinType == ONLY_10000) {
+                found = pcoin->vout[i].nValue == 100000*COIN;
+            } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+                //found = CPrivateSend::IsCollateralAmount(pcoin->vout[i].nValue);
+            } else {
+                found = true;
+            }
+            if(!found) continue;
+
+            isminetype mine = IsMine(pcoin->vout[i]);
+            if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
+                (!IsLockedCoin(wtxid, i) || nCoinType == ONLY_10000) &&
+                (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
+                (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(outpoint))){
+
+                    vCoins.push_back(COutput(pcoin, i, nDepth,
+                                             ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
+                                              (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO),
+                                             (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO, pcoin->vout[i].GetLockTime()));
             }
         }
     }
@@ -2421,42 +2676,56 @@ void CWallet::AvailableCoins(vector <COutput> &vCoins, const CSmartAddress& addr
 
         CScript addressScript = address.GetScript();
 
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256 &wtxid = it->first;
-            const CWalletTx *pcoin = &(*it).second;
+        uint256 hashLast;
+        const CWalletTx *pcoin = NULL;
+        int nDepth = 0;
+        BOOST_FOREACH(const COutPoint &outpoint, setWalletUTXO) {
+            const uint256 &wtxid = outpoint.hash;
+            const unsigned int i = outpoint.n;
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+            // The checks of a transaction are done once for all its outputs
+            if (wtxid != hashLast) {
+                hashLast = wtxid;
+                pcoin = NULL;
 
-            if (!pcoin->IsTrusted())
-                continue;
+                map<uint256, CWalletTx>::const_iterator it = mapWallet.find(wtxid);
+                if (it == mapWallet.end())
+                    continue;
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+                if (!CheckFinalTx(it->second))
+                    continue;
 
-            int nDepth = pcoin->GetDepthInMainChain(false);
+                if (!it->second.IsTrusted())
+                    continue;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
-                continue;
+                if (it->second.IsCoinBase() && it->second.GetBlocksToMaturity() > 0)
+                    continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
+                nDepth = it->second.GetDepthInMainChain(false);
 
-                if( pcoin->vout[i].scriptPubKey != addressScript)
+                // We should not consider coins which aren't at least in our mempool
+                // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                if (nDepth == 0 && !it->second.InMempool())
                     continue;
 
-                isminetype mine = IsMine(pcoin->vout[i]);
-                if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    !IsLockedCoin((*it).first, i) &&
-                    pcoin->vout[i].nValue > 0){                        
-                        vCoins.push_back(COutput(pcoin, i, nDepth,
-                                                 ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
-                                                  false,
-                                                 (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO,
-                                                 pcoin->vout[i].GetLockTime()));
-                }
+                pcoin = &it->second;
+            }
 
+            if (pcoin == NULL)
+                continue;
+
+            if( pcoin->vout[i].scriptPubKey != addressScript)
+                continue;
+
+            isminetype mine = IsMine(pcoin->vout[i]);
+            if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
+                !IsLockedCoin(wtxid, i) &&
+                pcoin->vout[i].nValue > 0){                        
+                    vCoins.push_back(COutput(pcoin, i, nDepth,
+                                             ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
+                                              false,
+                                             (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO,
+                                             pcoin->vout[i].GetLockTime()));
             }
         }
     }
@@ -2929,9 +3198,10 @@ int CWallet::CountInputsWithAmount(CAmount nInputAmount)
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        std::vector<const CWalletTx*> vWtx;
+        GetWalletUTXOTransactions(vWtx);
+        BOOST_FOREACH(const CWalletTx *pcoin, vWtx)
         {
-            const CWalletTx* pcoin = &(*it).second;
             if (pcoin->IsTrusted()){
                 int nDepth = pcoin->GetDepthInMainChain(false);
 
@@ -3463,9 +3733,14 @@ bool CWallet::EraseFromWallet(uint256 hash)
     if (!fFileBacked)
         return false;
     {
-        LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        LOCK2(cs_main, cs_wallet);
+        map<uint256, CWalletTx>::iterator mi = mapWallet.find(hash);
+        if (mi != mapWallet.end()) {
+            CWalletTx wtx = mi->second;
+            mapWallet.erase(mi);
             CWalletDB(strWalletFile).EraseTx(hash);
+            UpdateWalletUTXO(wtx);
+        }
     }
     return true;
 }
@@ -4257,6 +4532,7 @@ std::string CWallet::GetWalletHelpString(bool showDebug) {
                                strprintf(_("Fee (in %s/kB) to add to transactions you send (default: %s)"),
                                          CURRENCY_UNIT, FormatMoney(payTxFee.GetFeePerK())));
     strUsage += HelpMessageOpt("-rescan", _("Rescan the block chain for missing wallet transactions on startup"));
+    strUsage += HelpMessageOpt("-rescanaddressindex", strprintf(_("Only read the blocks the address index has transactions of the wallet in when rescanning (default: %u)"), DEFAULT_RESCAN_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-salvagewallet", _("Attempt to recover private keys from a corrupt wallet on startup"));
     if (showDebug)
         strUsage += HelpMessageOpt("-sendfreetransactions",
@@ -8,6 +8,7 @@
 
 #include "amount.h"
 #include "../base58.h"
+#include "chain.h"
 #include "../libzerocoin/bitcoin_bignum/bignum.h"
 #include "streams.h"
 #include "tinyformat.h"
@@ -68,6 +69,10 @@ static const bool DEFAULT_WALLETBROADCAST = true;
 
 //! if set, all keys will be derived by using BIP32
 static const bool DEFAULT_USE_HD_WALLET = true;
+//! -rescanaddressindex default
+static const bool DEFAULT_RESCAN_ADDRESSINDEX = true;
+//! Number of blocks the rescan reads and filters at once
+static const size_t WALLET_SCAN_BATCH_SIZE = 32;
 
 extern const char * DEFAULT_WALLET_DAT;
 
@@ -587,6 +592,51 @@ private:
     std::vector<char> _ssExtra;
 };
 
+/** Address index keys (type, hash) of the wallet's keys and scripts */
+typedef std::set<std::pair<int, uint160> > WalletIndexKeySet;
+
+/** A block of a rescan, the position is taken under cs_main so it can be read without it */
+struct CWalletScanBlock
+{
+    CBlockIndex* pindex;
+    uint256 hash;
+    CDiskBlockPos pos;
+    CBlock block;
+    bool fRead;
+    //! Per transaction, whether one of its outputs may belong to the wallet
+    std::vector<bool> vMaybeMine;
+
+    CWalletScanBlock(CBlockIndex* pindexIn) :
+        pindex(pindexIn), hash(pindexIn->GetBlockHash()), pos(pindexIn->GetBlockPos()), fRead(false) {}
+};
+
+/**
+ * Read a block of a rescan and flag the transactions with an output that may
+ * belong to the wallet, run on the wallet scan threads. The outputs are
+ * matched against a copy of the wallet's address index keys, so it doesn't
+ * need any lock. Outputs that don't pay to an address are always flagged.
+ */
+class CWalletScanCheck
+{
+    CWalletScanBlock* pScanBlock;
+    const WalletIndexKeySet* psetKeys;
+
+public:
+    CWalletScanCheck() : pScanBlock(nullptr), psetKeys(nullptr) {}
+    CWalletScanCheck(CWalletScanBlock* pScanBlockIn, const WalletIndexKeySet* psetKeysIn) :
+        pScanBlock(pScanBlockIn), psetKeys(psetKeysIn) {}
+
+    bool operator()();
+
+    void swap(CWalletScanCheck& check) {
+        std::swap(pScanBlock, check.pScanBlock);
+        std::swap(psetKeys, check.psetKeys);
+    }
+};
+
+/** Run a worker thread of the wallet rescan queue */
+void ThreadWalletScanCheck();
+
 
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
@@ -630,16 +680,39 @@ private:
     void AddToSpends(const COutPoint& outpoint, const uint256& wtxid);
     void AddToSpends(const uint256& wtxid);
 
+protected:
+    /**
+     * The wallet's outputs that may be unspent, so balances and coin selection
+     * don't have to walk all of mapWallet. An output is added when it is mine
+     * and not spent, and removed when a wallet transaction spends it. A spender
+     * that gets confirmed again after being conflicted can leave a spent output
+     * in the set, so users still check IsSpent.
+     */
     std::set<COutPoint> setWalletUTXO;
+    /** Update setWalletUTXO for the inputs and outputs of a wallet transaction that was added or changed */
+    void UpdateWalletUTXO(const CWalletTx& wtx);
+    /** Get the wallet transactions with outputs in setWalletUTXO */
+    void GetWalletUTXOTransactions(std::vector<const CWalletTx*>& vWtx) const;
 
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
 
+private:
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/);
 
+    /**
+     * Get the address index keys of the wallet's keys, scripts and watch-only
+     * scripts. Returns false if the address index can miss some of the
+     * wallet's transactions: watch-only scripts that don't pay to an address
+     * and pay to pubkey outputs of uncompressed keys aren't indexed.
+     */
+    bool GetAddressIndexKeys(WalletIndexKeySet& setKeys) const;
+    /** Read and filter a batch of blocks in parallel, then add their transactions that involve the wallet in order */
+    int ScanBlocks(std::vector<CWalletScanBlock>& vScanBlocks, const WalletIndexKeySet& setKeys, bool fUpdate);
+
 public:
     /*
      * Main wallet lock.
@@ -879,7 +952,14 @@ public:
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
-    int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
+    /**
+     * Scan the active chain from pindexStart for transactions involving the
+     * wallet. With the address index only the blocks it has entries for the
+     * wallet's keys in are read, the blocks it doesn't cover yet are read in
+     * full. cs_main is released between batches of blocks. The number of
+     * blocks read is returned in pnBlocksRead if given.
+     */
+    int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false, int* pnBlocksRead = NULL);
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
@@ -1038,6 +1118,12 @@ public:
     /** Watch-only address added */
     boost::signals2::signal<void (bool fHaveWatchOnly)> NotifyWatchonlyChanged;
 
+    /**
+     * Voting key added.
+     * @note called with lock cs_wallet held.
+     */
+    boost::signals2::signal<void (const CKeyID &keyId)> NotifyVotingKeyAdded;
+
     /** Inquire whether this wallet broadcasts transactions. */
     bool GetBroadcastTransactions() const { return fBroadcastTransactions; }
     /** Set whether this wallet broadcasts transactions. */